@@ -0,0 +1,58 @@
+#include "bench_scene.h"
+
+#include <fstream>
+#include <stdexcept>
+
+std::vector<char> readShader(const std::string &name) {
+  std::ifstream file(std::string(CACUS_BENCH_SHADER_DIR) + "/" + name, std::ios::ate | std::ios::binary);
+  if (!file.is_open())
+    throw std::runtime_error("failed to open shader " + name + ", build the shaders target first!");
+
+  std::vector<char> code(static_cast<size_t>(file.tellg()));
+  file.seekg(0);
+  file.read(code.data(), code.size());
+  return code;
+}
+
+Cacus &getBenchScene() {
+  static Cacus *cacus = nullptr;
+  if (!cacus) {
+    cacus = new Cacus(BENCH_WIDTH, BENCH_HEIGHT);
+    cacus->setUniformRingSize(BENCH_UNIFORM_RING_SIZE);
+    cacus->setupOffscreen(readShader("vert.spv"), readShader("frag.spv"));
+
+    const unsigned char white[4] = { 255, 255, 255, 255 };
+    cacus->waitForUpload(cacus->loadTexture(1, 1, 4, white));
+    cacus->finalize();
+  }
+  return *cacus;
+}
+
+void flushBenchScene() {
+  // Meshes are released once the frames in flight after them completed
+  getBenchScene().draw();
+}
+
+void writeGridObj(const std::string &path, uint32_t resolution) {
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> indices;
+  buildGrid(resolution, vertices, indices);
+
+  std::ofstream file(path, std::ios::trunc);
+  if (!file)
+    throw std::runtime_error("failed to write " + path + "!");
+
+  for (const Vertex &vertex : vertices)
+    file << "v " << vertex.pos.x << ' ' << vertex.pos.y << ' ' << vertex.pos.z << '\n';
+  for (const Vertex &vertex : vertices)
+    file << "vt " << vertex.texCoord.x << ' ' << vertex.texCoord.y << '\n';
+  file << "vn 0 0 1\n";
+
+  // OBJ indices start at 1
+  for (size_t i = 0; i < indices.size(); i += 3) {
+    file << 'f';
+    for (size_t corner = 0; corner < 3; corner++)
+      file << ' ' << indices[i + corner] + 1 << '/' << indices[i + corner] + 1 << "/1";
+    file << '\n';
+  }
+}
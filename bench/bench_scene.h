@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cacus.h>
+
+#include "grid_mesh.h"
+
+#include <string>
+#include <vector>
+
+// Dimensions of the offscreen targets the benchmarks render to
+static const uint32_t BENCH_WIDTH = 800;
+static const uint32_t BENCH_HEIGHT = 600;
+
+// Uniform bytes of a frame, enough for BM_UpdateUniforms at its largest
+static const VkDeviceSize BENCH_UNIFORM_RING_SIZE = 8 * 1024 * 1024;
+
+/**
+ * @param name File of the compiled shader, in the build directory of the
+ *        basic example
+ * @throw Error if the file cannot be read
+ */
+std::vector<char> readShader(const std::string &name);
+
+/**
+ * @return Cacus shared by the benchmarks, set up without a surface on first
+ *         use, with the shaders of the basic example and a white texture
+ */
+Cacus &getBenchScene();
+
+/**
+ * Draws a frame, so that the meshes destroyed by benchmarks do not pile up.
+ */
+void flushBenchScene();
+
+/**
+ * Writes the grid of buildGrid as an OBJ file, with shared positions and
+ * texture coordinates as exported by modelling tools.
+ */
+void writeGridObj(const std::string &path, uint32_t resolution);
@@ -0,0 +1,107 @@
+#include <benchmark/benchmark.h>
+
+#include "bench_scene.h"
+
+#include <cmath>
+#include <cstring>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+/**
+ * Writes the uniforms of meshes drawn with their own transforms, one
+ * allocation per mesh and frame. Drawing the frame is not measured.
+ */
+static void BM_UpdateUniforms(benchmark::State &state) {
+  Cacus &cacus = getBenchScene();
+
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> indices;
+  buildGrid(1, vertices, indices);
+
+  UploadTicket ticket = 0;
+  std::vector<MeshHandle> meshes(static_cast<size_t>(state.range(0)));
+  for (MeshHandle &mesh : meshes)
+    mesh = cacus.createMesh(vertices, indices, &ticket);
+  cacus.waitForUpload(ticket);
+
+  UniformBufferObject ubo = {};
+  ubo.view = glm::lookAt(glm::vec3(2.0f), glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+  ubo.proj = glm::perspective(glm::radians(45.0f), BENCH_WIDTH / float(BENCH_HEIGHT), 0.1f, 10.0f);
+
+  for (auto _ : state) {
+    for (size_t i = 0; i < meshes.size(); i++) {
+      ubo.model = glm::rotate(glm::mat4(1.0f), float(i), glm::vec3(0.0f, 0.0f, 1.0f));
+
+      const UniformAllocation uniforms = cacus.allocateUniforms(sizeof(ubo));
+      memcpy(uniforms.data, &ubo, sizeof(ubo));
+      cacus.setMeshUniforms(meshes[i], uniforms);
+    }
+
+    // The uniforms are bound by the draws of the frame
+    state.PauseTiming();
+    for (MeshHandle mesh : meshes)
+      cacus.drawInstance(mesh, glm::mat4(1.0f));
+    cacus.draw();
+    state.ResumeTiming();
+  }
+
+  for (MeshHandle mesh : meshes)
+    cacus.destroyMesh(mesh);
+
+  state.SetItemsProcessed(state.iterations() * meshes.size());
+  state.SetBytesProcessed(state.iterations() * meshes.size() * sizeof(ubo));
+}
+BENCHMARK(BM_UpdateUniforms)->RangeMultiplier(4)->Range(16, 16384);
+
+// Quads per side of the grid drawn by BM_DrawFrame
+static const uint32_t GRID_RESOLUTION = 16;
+
+/**
+ * Draws frames of instances of a grid back to back, once the frames in
+ * flight are all in use.
+ */
+static void BM_DrawFrame(benchmark::State &state) {
+  Cacus &cacus = getBenchScene();
+
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> indices;
+  buildGrid(GRID_RESOLUTION, vertices, indices);
+
+  UploadTicket ticket;
+  const MeshHandle grid = cacus.createMesh(vertices, indices, &ticket);
+  cacus.waitForUpload(ticket);
+
+  // Instances on a square in front of the camera, one grid per cell
+  const size_t instanceCount = static_cast<size_t>(state.range(0));
+  const size_t side = static_cast<size_t>(std::ceil(std::sqrt(double(instanceCount))));
+  std::vector<glm::mat4> models(instanceCount);
+  for (size_t i = 0; i < instanceCount; i++) {
+    const glm::vec3 offset(float(i % side) / side - 0.5f, float(i / side) / side - 0.5f, 0.0f);
+    models[i] = glm::scale(glm::translate(glm::mat4(1.0f), offset), glm::vec3(1.0f / (side * GRID_RESOLUTION)));
+  }
+
+  cacus.setTransform(
+    glm::mat4(1.0f),
+    glm::lookAt(glm::vec3(0.0f, 0.0f, 2.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)),
+    glm::perspective(glm::radians(45.0f), BENCH_WIDTH / float(BENCH_HEIGHT), 0.1f, 10.0f));
+
+  // Fills the frames in flight, so that each frame measured waits on one
+  for (int i = 0; i < 4; i++) {
+    cacus.drawInstances(grid, models.data(), models.size());
+    cacus.draw();
+  }
+
+  for (auto _ : state) {
+    cacus.drawInstances(grid, models.data(), models.size());
+    cacus.draw();
+  }
+
+  cacus.destroyMesh(grid);
+
+  state.counters["fps"] = benchmark::Counter(static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+  state.SetItemsProcessed(state.iterations() * instanceCount);
+}
+BENCHMARK(BM_DrawFrame)
+  ->RangeMultiplier(10)->Range(1, 10000)
+  ->Unit(benchmark::kMillisecond)
+  ->UseRealTime();
@@ -0,0 +1,101 @@
+#include <benchmark/benchmark.h>
+
+#include "bench_scene.h"
+
+#include <mesh.h>
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "tiny_obj_loader.h"
+
+#include <cstdio>
+#include <stdexcept>
+
+// Quads per side of the grids, from a few hundred vertices to a quarter of a
+// million
+#define MESH_RESOLUTIONS RangeMultiplier(4)->Range(8, 512)
+
+/**
+ * Creates a mesh on the device and waits for its upload.
+ */
+static void BM_CreateMesh(benchmark::State &state) {
+  Cacus &cacus = getBenchScene();
+
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> indices;
+  buildGrid(static_cast<uint32_t>(state.range(0)), vertices, indices);
+
+  for (auto _ : state) {
+    UploadTicket ticket;
+    const MeshHandle mesh = cacus.createMesh(vertices, indices, &ticket);
+    cacus.waitForUpload(ticket);
+
+    state.PauseTiming();
+    cacus.destroyMesh(mesh);
+    flushBenchScene();
+    state.ResumeTiming();
+  }
+
+  state.SetItemsProcessed(state.iterations() * vertices.size());
+  state.counters["vertices"] = static_cast<double>(vertices.size());
+}
+BENCHMARK(BM_CreateMesh)->MESH_RESOLUTIONS->Unit(benchmark::kMillisecond)->UseRealTime();
+
+/**
+ * Parses an OBJ file, deduplicates its vertices and creates the mesh, as the
+ * basic example does.
+ */
+static void BM_LoadObjMesh(benchmark::State &state) {
+  Cacus &cacus = getBenchScene();
+
+  const std::string path = "bench_grid_" + std::to_string(state.range(0)) + ".obj";
+  writeGridObj(path, static_cast<uint32_t>(state.range(0)));
+
+  size_t vertexCount = 0;
+  for (auto _ : state) {
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warn, err;
+
+    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str()))
+      throw std::runtime_error(warn + err);
+
+    MeshBuilder builder;
+    for (const tinyobj::shape_t &shape : shapes) {
+      for (const tinyobj::index_t &index : shape.mesh.indices) {
+        Vertex vertex = {};
+        vertex.pos = {
+          attrib.vertices[3 * index.vertex_index + 0],
+          attrib.vertices[3 * index.vertex_index + 1],
+          attrib.vertices[3 * index.vertex_index + 2]
+        };
+        vertex.texCoord = {
+          attrib.texcoords[2 * index.texcoord_index + 0],
+          1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
+        };
+        vertex.normal = {
+          attrib.normals[3 * index.normal_index + 0],
+          attrib.normals[3 * index.normal_index + 1],
+          attrib.normals[3 * index.normal_index + 2]
+        };
+        vertex.color = { 1.0f, 1.0f, 1.0f };
+        builder.addVertex(vertex);
+      }
+    }
+
+    UploadTicket ticket;
+    const MeshHandle mesh = cacus.createMesh(builder.getVertices(), builder.getIndices(), &ticket);
+    cacus.waitForUpload(ticket);
+    vertexCount = builder.getVertices().size();
+
+    state.PauseTiming();
+    cacus.destroyMesh(mesh);
+    flushBenchScene();
+    state.ResumeTiming();
+  }
+
+  std::remove(path.c_str());
+  state.SetItemsProcessed(state.iterations() * vertexCount);
+  state.counters["vertices"] = static_cast<double>(vertexCount);
+}
+BENCHMARK(BM_LoadObjMesh)->MESH_RESOLUTIONS->Unit(benchmark::kMillisecond)->UseRealTime();
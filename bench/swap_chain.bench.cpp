@@ -0,0 +1,72 @@
+#include <benchmark/benchmark.h>
+
+#include "bench_scene.h"
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <stdexcept>
+
+/**
+ * Recreates the offscreen targets, alternating between two sizes.
+ */
+static void BM_RecreateOffscreenTargets(benchmark::State &state) {
+  Cacus &cacus = getBenchScene();
+
+  bool small = false;
+  for (auto _ : state) {
+    small = !small;
+    if (small)
+      cacus.recreateSwapChain(BENCH_WIDTH / 2, BENCH_HEIGHT / 2);
+    else
+      cacus.recreateSwapChain(BENCH_WIDTH, BENCH_HEIGHT);
+  }
+
+  cacus.recreateSwapChain(BENCH_WIDTH, BENCH_HEIGHT);
+}
+BENCHMARK(BM_RecreateOffscreenTargets)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+/**
+ * Recreates the swap chain of a window, as done when it is resized. Skipped
+ * without a display.
+ */
+static void BM_RecreateSwapChain(benchmark::State &state) {
+  if (!glfwInit()) {
+    state.SkipWithError("no display to create a window on");
+    return;
+  }
+
+  glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+  glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+  GLFWwindow *window = glfwCreateWindow(BENCH_WIDTH, BENCH_HEIGHT, "cacus_bench", nullptr, nullptr);
+  if (!window) {
+    glfwTerminate();
+    state.SkipWithError("failed to create a window");
+    return;
+  }
+
+  {
+    uint32_t extensionCount = 0;
+    const char **extensions = glfwGetRequiredInstanceExtensions(&extensionCount);
+    Cacus cacus(BENCH_WIDTH, BENCH_HEIGHT, extensions, extensionCount);
+
+    // Destroyed by Cacus
+    VkSurfaceKHR surface;
+    if (glfwCreateWindowSurface(cacus.getInstance(), window, nullptr, &surface) != VK_SUCCESS)
+      throw std::runtime_error("failed to create window surface!");
+
+    cacus.setup(surface, readShader("vert.spv"), readShader("frag.spv"));
+    const unsigned char white[4] = { 255, 255, 255, 255 };
+    cacus.waitForUpload(cacus.loadTexture(1, 1, 4, white));
+    cacus.finalize();
+
+    // The extent follows the window, the size given only matters if the
+    // surface lets the swap chain choose
+    for (auto _ : state)
+      cacus.recreateSwapChain(BENCH_WIDTH, BENCH_HEIGHT);
+  }
+
+  glfwDestroyWindow(window);
+  glfwTerminate();
+}
+BENCHMARK(BM_RecreateSwapChain)->Unit(benchmark::kMillisecond)->UseRealTime();
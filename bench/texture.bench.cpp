@@ -0,0 +1,29 @@
+#include <benchmark/benchmark.h>
+
+#include "bench_scene.h"
+
+// Textures are never released, iterations are bounded to keep memory in check
+static const int TEXTURE_ITERATIONS = 16;
+
+/**
+ * Uploads a texture from pixels, generating its mips, and waits for the
+ * upload.
+ */
+static void BM_LoadTexture(benchmark::State &state) {
+  Cacus &cacus = getBenchScene();
+
+  const int size = static_cast<int>(state.range(0));
+  std::vector<unsigned char> pixels(size_t(size) * size * 4);
+  for (size_t i = 0; i < pixels.size(); i++)
+    pixels[i] = static_cast<unsigned char>(i * 31);
+
+  for (auto _ : state)
+    cacus.waitForUpload(cacus.loadTexture(size, size, 4, pixels.data()));
+
+  state.SetBytesProcessed(state.iterations() * pixels.size());
+}
+BENCHMARK(BM_LoadTexture)
+  ->RangeMultiplier(4)->Range(64, 1024)
+  ->Iterations(TEXTURE_ITERATIONS)
+  ->Unit(benchmark::kMillisecond)
+  ->UseRealTime();
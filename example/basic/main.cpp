@@ -1,4 +1,8 @@
 #include <cacus.h>
+#include <mesh.h>
+#include <mesh_file.h>
+#include <mesh_optimizer.h>
+#include <mesh_simplifier.h>
 
 #include <iostream>
 
@@ -49,10 +53,11 @@ static void framebufferResizeCallback(GLFWwindow* window, int width, int height)
 
 static const string MODEL_PATH = "chalet.obj";
 static const string TEXTURE_PATH = "chalet.jpg";
+// Block compressed version of the texture, used instead if present
+static const string COMPRESSED_TEXTURE_PATH = "chalet.ktx2";
+static const string MESH_CACHE_PATH = "chalet.cmsh";
 
-void loadModel(
-  vector<Vertex> &vertices,
-  vector<uint32_t> &indices) {
+void loadModel(MeshBuilder &builder) {
   tinyobj::attrib_t attrib;
   std::vector<tinyobj::shape_t> shapes;
   std::vector<tinyobj::material_t> materials;
@@ -76,14 +81,55 @@ void loadModel(
         1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
       };
 
+      if (index.normal_index >= 0) {
+        vertex.normal = {
+          attrib.normals[3 * index.normal_index + 0],
+          attrib.normals[3 * index.normal_index + 1],
+          attrib.normals[3 * index.normal_index + 2]
+        };
+      }
+
       vertex.color = {1.0f, 1.0f, 1.0f};
 
-      vertices.push_back(vertex);
-      indices.push_back(indices.size());
+      builder.addVertex(vertex);
     }
   }
 }
 
+/**
+ * Cooks the OBJ model into a mesh file, unless the cached one was cooked
+ * from the same OBJ with the same layout.
+ */
+void cookModel(const VertexLayout &layout) {
+  const uint64_t sourceHash = MeshFile::hashFile(MODEL_PATH);
+  if (MeshFile::isCurrent(MESH_CACHE_PATH, sourceHash, layout))
+    return;
+
+  MeshBuilder builder;
+  loadModel(builder);
+  std::vector<Vertex> vertices = builder.getVertices();
+  std::vector<uint32_t> indices = builder.getIndices();
+
+  const VertexCacheStatistics before = analyzeVertexCache(indices, vertices.size());
+  optimizeMesh(vertices, indices);
+  const VertexCacheStatistics after = analyzeVertexCache(indices, vertices.size());
+
+  std::cout << "Cooked " << vertices.size() << " vertices and " << indices.size() << " indices"
+    << " (reuse ratio " << builder.getReuseRatio() << ")" << endl;
+  std::cout << "ACMR " << before.acmr << " -> " << after.acmr
+    << ", ATVR " << before.atvr << " -> " << after.atvr << endl;
+
+  // Coarser levels reuse the vertices, their triangles are reordered too
+  std::vector<MeshLod> lods = buildLodChain(vertices, indices);
+  for (size_t i = 1; i < lods.size(); i++)
+    optimizeVertexCache(lods[i].indices, vertices.size());
+
+  for (const MeshLod &lod : lods)
+    std::cout << "LOD " << lod.indices.size() / 3 << " triangles, error " << lod.error << endl;
+
+  MeshFile::write(MESH_CACHE_PATH, vertices, lods, sourceHash, layout);
+}
+
 /**
  * A basic example showing how to create and init a window.
  */
@@ -105,26 +151,35 @@ int main() {
   VkSurfaceKHR surface;
   glfwCreateWindowSurface(cacus.getInstance(), window, nullptr, &surface);
 
+  // CPU markers record from the start, T dumps them to a trace Perfetto opens
+  getCpuProfiler().setThreadName("main");
+  getCpuProfiler().setEnabled(true);
+
   // Read shader files
   auto vertShaderCode = readFile("./vert.spv");
   auto fragShaderCode = readFile("./frag.spv");
+  cacus.setVertexLayout(VertexLayout::quantized());
+  cacus.enableBindless(readFile("./frag_bindless.spv"));
   cacus.setup(surface, vertShaderCode, fragShaderCode);
+  cacus.enableGpuCulling(readFile("./cull.spv"));
 
   // Load texture
-  int texWidth, texHeight, texChannels;
-  stbi_uc* pixels = stbi_load(TEXTURE_PATH.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-  if (pixels) {
-    cacus.loadTexture(texWidth, texHeight, texChannels, pixels);
-    stbi_image_free(pixels);
-  } else
-    cerr << "Could not load texture :(" << endl;
+  if (ifstream(COMPRESSED_TEXTURE_PATH).good())
+    cacus.loadTexture(COMPRESSED_TEXTURE_PATH);
+  else {
+    int texWidth, texHeight, texChannels;
+    stbi_uc* pixels = stbi_load(TEXTURE_PATH.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+    if (pixels) {
+      cacus.loadTexture(texWidth, texHeight, texChannels, pixels);
+      stbi_image_free(pixels);
+    } else
+      cerr << "Could not load texture :(" << endl;
+  }
 
   //*
-  // Load mesh data
-  vector<Vertex> vertices;
-  vector<uint32_t> indices;
-  loadModel(vertices, indices);
-  std::cout << "Loaded " << vertices.size() << " vertices and " << indices.size() << " indices" << endl;
+  // Load mesh data, cooked from the OBJ model on first run
+  cookModel(cacus.getVertexLayout());
+  const MeshHandle chalet = cacus.loadMesh(MESH_CACHE_PATH);
   //*/
   /*
   const std::vector<Vertex> vertices = {
@@ -143,14 +198,38 @@ int main() {
     0, 1, 2, 2, 3, 0,
     4, 5, 6, 6, 7, 4
   };
+  const MeshHandle chalet = cacus.createMesh(vertices, indices);
   //*/
-  cacus.createMeshBuffers(vertices, indices);
   cacus.finalize();
 
   const auto startTime = chrono::high_resolution_clock::now();
+  bool traceKeyDown = false;
+
+  // P cycles through the frame policies, without rebuilding the pipeline
+  const FramePolicy policies[] = {
+    FramePolicy::balanced(), FramePolicy::lowLatency(), FramePolicy::throughput(), FramePolicy::powerSaving()
+  };
+  const char *policyNames[] = { "balanced", "low latency", "throughput", "power saving" };
+  size_t policy = 0;
+  bool policyKeyDown = false;
   while (!glfwWindowShouldClose(window)) {
     glfwPollEvents();
 
+    const bool traceKey = glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS;
+    if (traceKey && !traceKeyDown) {
+      getCpuProfiler().writeChromeTrace("trace.json");
+      cout << "Wrote trace.json" << endl;
+    }
+    traceKeyDown = traceKey;
+
+    const bool policyKey = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+    if (policyKey && !policyKeyDown) {
+      policy = (policy + 1) % 4;
+      cacus.setFramePolicy(policies[policy]);
+      cout << "Frame policy " << policyNames[policy] << ", present mode " << cacus.getPresentMode() << endl;
+    }
+    policyKeyDown = policyKey;
+
     auto currentTime = chrono::high_resolution_clock::now();
     float time = chrono::duration<float, chrono::seconds::period>(currentTime - startTime).count();
 
@@ -170,6 +249,7 @@ int main() {
       glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
 
     cacus.setTransform(model, view, proj);
+    cacus.drawInstance(chalet, glm::mat4(1.0f));
   
     // Recreate swap chain in case of window resize.
     if (cacus.draw()) {
@@ -1,21 +1,50 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-layout(binding = 0) uniform UniformBufferObject {
-    mat4 model;
-    mat4 view;
-    mat4 proj;
-} ubo;
+// Uniforms of the frame, then those of the meshes having their own, each
+// as three matrices: model, view and projection
+layout(binding = 0) readonly buffer Uniforms {
+    mat4 uniforms[];
+};
+
+// Maps quantized positions back to object space, identity for float ones
+layout(push_constant) uniform Dequantization {
+    vec4 offset;
+    vec4 scale;
+} dequantization;
+
+// True if normals are octahedral encoded
+layout(constant_id = 0) const bool OCTAHEDRAL_NORMALS = false;
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inTexCoord;
+layout(location = 3) in vec3 inNormal;
+
+// Per instance, takes locations 4 to 7
+layout(location = 4) in mat4 instanceModel;
+// Material, and first matrix of the uniforms of the instance
+layout(location = 8) in uvec2 instanceIndices;
 
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) out vec3 fragNormal;
+layout(location = 3) flat out uint fragMaterial;
+
+vec3 decodeOctahedral(vec2 encoded) {
+  vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+  const float fold = max(-normal.z, 0.0);
+  normal.x += normal.x >= 0.0 ? -fold : fold;
+  normal.y += normal.y >= 0.0 ? -fold : fold;
+  return normalize(normal);
+}
 
 void main() {
-  gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+  const vec3 position = inPosition * dequantization.scale.xyz + dequantization.offset.xyz;
+  const uint row = instanceIndices.y;
+  gl_Position = uniforms[row + 2] * uniforms[row + 1] * uniforms[row] * instanceModel * vec4(position, 1.0);
   fragColor = inColor;
   fragTexCoord = inTexCoord;
+  fragNormal = OCTAHEDRAL_NORMALS ? decodeOctahedral(inNormal.xy) : inNormal;
+  fragMaterial = instanceIndices.x;
 }
\ No newline at end of file
@@ -0,0 +1,28 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+// Runtime sized texture array
+#extension GL_EXT_nonuniform_qualifier : enable
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+layout(location = 3) flat in uint fragMaterial;
+
+layout(location = 0) out vec4 outColor;
+
+// Matches Material on the host
+struct Material {
+  vec4 baseColorFactor;
+  uint baseColorTexture;
+};
+
+layout(set = 1, binding = 0) readonly buffer Materials {
+  Material materials[];
+};
+
+// Only the textures loaded are valid
+layout(set = 1, binding = 1) uniform sampler2D textures[];
+
+void main() {
+  const Material material = materials[fragMaterial];
+  outColor = material.baseColorFactor * texture(textures[material.baseColorTexture], fragTexCoord);
+}
@@ -1,5 +1,6 @@
 #include <vulkan/vulkan.h>
 #include <optional>
+#include <string>
 #include <vector>
 #include <array>
 
@@ -7,9 +8,23 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 
+#include <vertex.h>
+#include <vertex_layout.h>
+#include <memory_allocator.h>
+#include <upload_batcher.h>
+#include <uniform_ring.h>
+#include <descriptor_allocator.h>
+#include <gpu_profiler.h>
+#include <cpu_profiler.h>
+#include <texture.h>
+#include <worker_pool.h>
+#include <render_graph.h>
+
 typedef struct QueueFamilyIndicesStruct {
   std::optional<uint32_t> graphicsFamily;
   std::optional<uint32_t> presentFamily;
+  // Dedicated to transfers if the device has such a family, graphics otherwise
+  std::optional<uint32_t> transferFamily;
 
   bool isComplete() {
     return graphicsFamily.has_value() && presentFamily.has_value();
@@ -22,42 +37,71 @@ typedef struct SwapChainSupportDetailsStruct {
     std::vector<VkPresentModeKHR> presentModes;
 } SwapChainSupportDetails ;
 
-typedef struct VertexStruct {
-  glm::vec3 pos;
-  glm::vec3 color;
-  glm::vec2 texCoord;
-
-  static VkVertexInputBindingDescription getBindingDescription() {
-    VkVertexInputBindingDescription bindingDescription = {};
-    bindingDescription.binding = 0;
-    bindingDescription.stride = sizeof(VertexStruct);
-    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-    return bindingDescription;
-  }
-
-  static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions() {
-    std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions = {};
-
-    attributeDescriptions[0].binding = 0;
-    attributeDescriptions[0].location = 0;
-    attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-    attributeDescriptions[0].offset = offsetof(VertexStruct, pos);
+/**
+ * Identifies a mesh created with Cacus::createMesh.
+ */
+typedef uint32_t MeshHandle;
+
+/**
+ * Identifies a texture loaded with Cacus::loadTexture, its index in the
+ * bindless texture array.
+ */
+typedef uint32_t TextureHandle;
+
+/**
+ * Identifies a material created with Cacus::createMaterial, its index in the
+ * bindless material buffer.
+ */
+typedef uint32_t MaterialHandle;
+
+/**
+ * Material of the meshes drawn in bindless mode, laid out as the std430
+ * struct the fragment shader reads.
+ */
+typedef struct MaterialStruct {
+  glm::vec4 baseColorFactor;
+  TextureHandle baseColorTexture;
+  uint32_t padding[3];
+} Material;
+
+// Frames in flight resources are allocated for, frame policies may use fewer
+static const uint32_t MAX_FRAMES_IN_FLIGHT = 3;
+
+/**
+ * Trades latency against throughput and power: how many frames the host
+ * records ahead of the device, how many images the swap chain has and how
+ * they are presented.
+ */
+typedef struct FramePolicyStruct {
+  // Frames recorded before waiting on the device
+  uint32_t framesInFlight;
+  // Swap chain images requested beyond the minimum of the surface
+  uint32_t extraImages;
+  // Present modes by preference, FIFO if none is supported
+  std::vector<VkPresentModeKHR> presentModes;
 
-    attributeDescriptions[1].binding = 0;
-    attributeDescriptions[1].location = 1;
-    attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-    attributeDescriptions[1].offset = offsetof(VertexStruct, color);
+  /**
+   * Mailbox with two frames in flight, the default.
+   */
+  static FramePolicyStruct balanced();
 
-    attributeDescriptions[2].binding = 0;
-    attributeDescriptions[2].location = 2;
-    attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-    attributeDescriptions[2].offset = offsetof(VertexStruct, texCoord);
+  /**
+   * Presents frames as soon as they are drawn, tearing rather than waiting
+   * for vertical blanks, with a single frame in flight and as few images as
+   * the surface allows.
+   */
+  static FramePolicyStruct lowLatency();
 
-    return attributeDescriptions;
-  }
+  /**
+   * Never blocks on presentation, with the most frames in flight.
+   */
+  static FramePolicyStruct throughput();
 
-} Vertex;
+  /**
+   * Draws at most at the refresh rate of the display.
+   */
+  static FramePolicyStruct powerSaving();
+} FramePolicy;
 
 typedef struct UniformBufferObjectStruct {
     glm::mat4 model;
@@ -100,7 +144,55 @@ public:
   }
 
   /**
-   * Set transform of current shape.
+   * Selects the layout meshes are stored with on the device. Must be called
+   * before setup. The vertex shader dequantizes positions with the push
+   * constants of VertexDequantization and decodes octahedral normals if
+   * specialization constant 0 is true.
+   */
+  void setVertexLayout(const VertexLayout &layout) {
+    vertexLayout = layout;
+  }
+
+  const VertexLayout &getVertexLayout() const {
+    return vertexLayout;
+  }
+
+  /**
+   * Sets the screen space error levels of detail may introduce: instances
+   * are drawn with the coarsest level whose error projects to at most this
+   * many pixels.
+   */
+  void setLodThreshold(float pixels) {
+    lodThreshold = pixels;
+  }
+
+  /**
+   * Sets the number of threads recording draws besides the calling one.
+   * Must be called before finalize.
+   */
+  void setRecordingThreads(uint32_t threads) {
+    recordingThreads = threads;
+  }
+
+  /**
+   * Sets the file compiled pipelines are cached in across runs, loaded at
+   * setup and saved on destruction. Must be called before setup. An empty
+   * path keeps the cache in memory only.
+   */
+  void setPipelineCachePath(const std::string &path) {
+    pipelineCachePath = path;
+  }
+
+  /**
+   * Sets the bytes each frame in flight can allocate with allocateUniforms,
+   * 1 MiB by default. Must be called before setup.
+   */
+  void setUniformRingSize(VkDeviceSize frameSize) {
+    uniformRingSize = frameSize;
+  }
+
+  /**
+   * Set camera transforms, model is applied to all instances.
    */
   void setTransform(const glm::mat4 &model, const glm::mat4 &view, const glm::mat4 &proj);
 
@@ -120,33 +212,299 @@ public:
     fragmentShader = fragment;
     init();
     createDescriptorSetLayout();
+    createRenderTargets();
+    buildFrameGraph();
     createGraphicsPipeline();
     createCommandPool();
   }
 
+  /**
+   * Performs setup of Vulkan without a surface. Frames are rendered into
+   * offscreen images owned by Cacus and can be read back with readFrame().
+   * @param framesInFlight Number of frames that can be processed concurrently,
+   *        0 to keep the one of the frame policy
+   */
+  void setupOffscreen(std::vector<char> vertex,
+                      std::vector<char> fragment,
+                      uint32_t framesInFlight = 0) {
+    headless = true;
+    if (framesInFlight > 0) {
+      maxFramesInFlight = framesInFlight;
+      framePolicy.framesInFlight = framesInFlight;
+    }
+    vertexShader = vertex;
+    fragmentShader = fragment;
+    init();
+    createDescriptorSetLayout();
+    createRenderTargets();
+    buildFrameGraph();
+    createGraphicsPipeline();
+    createCommandPool();
+  }
+
+  /**
+   * Culls instances against the view frustum on the device, before drawing
+   * them with indirect draws. Must be called after setup.
+   * @param computeShader Byte code of the culling compute shader
+   */
+  void enableGpuCulling(const std::vector<char> &computeShader);
+
+  /**
+   * Draws the whole scene with a single descriptor set bound per frame, if
+   * the device supports descriptor indexing: textures are indexed from an
+   * array by the material of each mesh. Must be called before setup.
+   * Falls back to the fragment shader given to setup if not supported.
+   * @param fragmentShader Byte code of the fragment shader indexing
+   *        materials and textures
+   */
+  void enableBindless(const std::vector<char> &fragmentShader) {
+    bindlessFragmentShader = fragmentShader;
+  }
+
+  /**
+   * @return True if drawing in bindless mode, known after setup
+   */
+  bool isBindless() const {
+    return bindless;
+  }
+
+  /**
+   * Creates a material, material 0 exists from setup with a white factor
+   * and texture 0. Bindless mode only.
+   * @return Handle of the material
+   * @throw Error if not in bindless mode, if the texture is not loaded or if
+   *        there are too many materials
+   */
+  MaterialHandle createMaterial(const Material &material);
+
+  /**
+   * Sets the material the mesh is drawn with, material 0 by default.
+   * @throw Error if the mesh or the material does not exist
+   */
+  void setMeshMaterial(MeshHandle mesh, MaterialHandle material);
+
+  /**
+   * Selects how frames are queued and presented. Before setup, it also sets
+   * the frames resources are allocated for, MAX_FRAMES_IN_FLIGHT or more.
+   * Afterwards, waits for the device and recreates the render targets if
+   * their count or present mode changed, keeping the pipeline.
+   * @throw Error if framesInFlight is 0 or more than the frames allocated,
+   *        or if the current frame has begun
+   */
+  void setFramePolicy(const FramePolicy &policy);
+
+  const FramePolicy &getFramePolicy() const {
+    return framePolicy;
+  }
+
+  /**
+   * @return Present mode chosen for the swap chain, known after setup
+   */
+  VkPresentModeKHR getPresentMode() const {
+    return swapChainPresentMode;
+  }
+
+  /**
+   * @return True if rendering offscreen (no surface)
+   */
+  bool isHeadless() const {
+    return headless;
+  }
+
   void finalize();
 
   /**
-   * Draws on surface.
+   * Waits until the resources of the next frame are no longer used by the
+   * device. Called by draw() and allocateUniforms() if needed.
+   */
+  void beginFrame();
+
+  /**
+   * Allocates uniforms for the next frame, valid until it is drawn.
+   * @param size Bytes to allocate
+   * @return Host address to write to and offset in the uniform buffer
+   * @throw Error if the uniforms of the frame exceed the ring capacity
+   */
+  UniformAllocation allocateUniforms(VkDeviceSize size);
+
+  /**
+   * Draws the mesh in the next frame with its own uniforms instead of those
+   * set with setTransform. Culling and levels of detail still use the
+   * camera of setTransform.
+   * @param uniforms Allocated for the next frame with allocateUniforms, at
+   *        least sizeof(UniformBufferObject) bytes laid out as one
+   * @throw Error if the mesh does not exist
+   */
+  void setMeshUniforms(MeshHandle mesh, const UniformAllocation &uniforms);
+
+  /**
+   * Draws on surface, or on the offscreen targets in headless mode.
    * @return true if swap chain must be recreated.
    */
   bool draw();
 
   /**
-   * Recreate the swap chain with new dimensions.
+   * Recreate the swap chain with new dimensions. Pipelines and render pass
+   * are kept unless the surface format changed.
    */
   void recreateSwapChain(uint32_t newWidth, uint32_t newHeight);
 
   /**
-   * Create vertex an index buffers for drawing shapes
-   * @param newVertices vertices
-   * @param newIndices indices
+   * Create vertex an index buffers of a mesh. Data is uploaded
+   * asynchronously, with the other uploads of the next frame or
+   * flushUploads. Indices are stored on 16 bits if they fit.
+   * @param vertices vertices
+   * @param indices indices
+   * @param outTicket If not null, set to the ticket of the upload
+   * @return Handle of the mesh
    */
-  void createMeshBuffers(
-    const std::vector<Vertex> &newVertices,
-    const std::vector<uint32_t> &newIndices);
+  MeshHandle createMesh(
+    const std::vector<Vertex> &vertices,
+    const std::vector<uint32_t> &indices,
+    UploadTicket *outTicket = nullptr);
 
-  void loadTexture(const int texWidth, const int texHeight, const int texChannels, const unsigned char *pixels);
+  /**
+   * Creates a mesh with levels of detail (see buildLodChain), selected per
+   * instance by distance to the camera.
+   * @param lods Levels indexing the vertices, finest first
+   * @param outTicket If not null, set to the ticket of the upload
+   * @return Handle of the mesh
+   * @throw Error if there are no levels or more than MAX_MESH_LODS
+   */
+  MeshHandle createMesh(
+    const std::vector<Vertex> &vertices,
+    const std::vector<MeshLod> &lods,
+    UploadTicket *outTicket = nullptr);
+
+  /**
+   * Creates a mesh from a mesh file (see MeshFile), mapped in memory.
+   * @param path Path of the file
+   * @param outTicket If not null, set to the ticket of the upload
+   * @return Handle of the mesh
+   * @throw Error if the file is invalid or its vertex layout is not the
+   *        one of the device
+   */
+  MeshHandle loadMesh(const std::string &path, UploadTicket *outTicket = nullptr);
+
+  /**
+   * Releases a mesh once the frames using it completed. The handle may be
+   * reused by a later createMesh.
+   */
+  void destroyMesh(MeshHandle mesh);
+
+  /**
+   * Adds instances of a mesh to the next frame. Instances of a mesh are
+   * drawn with a single instanced draw call per level of detail. They are
+   * skipped while the upload of the mesh or of the texture of its material
+   * is not visible to the device yet.
+   * @param mesh Mesh to draw
+   * @param models Model matrix of each instance
+   * @param count Number of instances
+   */
+  void drawInstances(MeshHandle mesh, const glm::mat4 *models, size_t count);
+
+  void drawInstance(MeshHandle mesh, const glm::mat4 &model) {
+    drawInstances(mesh, &model, 1);
+  }
+
+  /**
+   * Uploads a texture asynchronously, with the other uploads of the next
+   * frame or flushUploads. A full mip chain is generated from the pixels.
+   * @param outTexture Set to the handle of the texture if not null
+   * @return Ticket of the upload
+   * @throw Error if there are too many textures in bindless mode
+   */
+  UploadTicket loadTexture(const int texWidth, const int texHeight, const int texChannels, const unsigned char *pixels, TextureHandle *outTexture = nullptr);
+
+  /**
+   * Uploads a KTX2 texture asynchronously, with the mips it contains. Block
+   * compressed levels are uploaded as they are if the device can sample
+   * them, decoded on the host otherwise.
+   * @param outTexture Set to the handle of the texture if not null
+   * @return Ticket of the upload
+   * @throw Error if the file is not a supported KTX2 texture, if its format
+   *        can neither be sampled nor decoded, or if there are too many
+   *        textures in bindless mode
+   */
+  UploadTicket loadTexture(const std::string &path, TextureHandle *outTexture = nullptr);
+
+  /**
+   * Submits the uploads recorded since the last flush as a single batch.
+   * Frames flush them when they begin, this starts them earlier, e.g.
+   * once a set of assets is loaded.
+   * @return Ticket of the last submitted batch
+   */
+  UploadTicket flushUploads();
+
+  /**
+   * @return True if the upload of the ticket is complete
+   */
+  bool isUploadComplete(UploadTicket ticket);
+
+  /**
+   * Blocks until the upload of the ticket is complete, flushing it if
+   * needed.
+   */
+  void waitForUpload(UploadTicket ticket);
+
+  /**
+   * Headless mode only: copies the last drawn frame to host memory.
+   * @param pixels Filled with tightly packed RGBA8 (sRGB) rows
+   * @throw Error if not headless or no frame has been drawn yet
+   */
+  void readFrame(std::vector<unsigned char> &pixels);
+
+  /**
+   * Headless mode only.
+   * @return Image of the last drawn frame, in TRANSFER_SRC_OPTIMAL layout
+   */
+  VkImage getFrameImage() const;
+
+  /**
+   * @return Format of the images rendered to
+   */
+  VkFormat getFrameFormat() const {
+    return swapChainImageFormat;
+  }
+
+  /**
+   * Times the passes of each frame on the device, and gathers their
+   * pipeline statistics if supported. Results are read back without
+   * stalling once the frame in flight is reused.
+   * @throw Error if enabled and the graphics queue has no timestamps
+   */
+  void setGpuProfiling(bool enabled);
+
+  /**
+   * @return True if frames can be profiled on the device, known after setup
+   */
+  bool isGpuProfilingSupported() const {
+    return profiler.isInitialized();
+  }
+
+  /**
+   * @return Scopes of the last frame profiled whose results are available,
+   *         frames in flight behind the frame being drawn: "frame" for the
+   *         whole frame, then one per group of passes of the frame graph
+   */
+  const GpuFrameStats &getGpuFrameStats() const {
+    return profiler.getFrameStats();
+  }
+
+  /**
+   * @return Bytes and device time of the last upload batch whose copies
+   *         completed, untimed if the transfer queue has no timestamps
+   */
+  UploadBatchStats getLastUploadStats() {
+    return uploader.getLastBatchStats();
+  }
+
+  /**
+   * @return Device memory usage, indexed by memory heap
+   */
+  std::vector<MemoryHeapStats> getMemoryStats() const {
+    return allocator.getHeapStats();
+  }
 
 private:
   /**
@@ -154,11 +512,33 @@ private:
    */
   void init();
 
-  void preFinalize();
+  /**
+   * Describes the passes of a frame and builds their render passes and
+   * transient images, for the current render targets.
+   */
+  void buildFrameGraph();
+
+  /**
+   * Creates the swap chain, or the offscreen targets in headless mode.
+   */
+  void createRenderTargets();
 
+  /**
+   * Creates the pipeline layout and the graphics pipeline, for the render
+   * pass of the main pass of the frame graph. Viewport and scissor are
+   * dynamic, so the pipeline only depends on the formats of the targets.
+   */
   void createGraphicsPipeline();
 
-  void createFrameBuffers();
+  /**
+   * Creates the swap chain, retiring the previous one if any.
+   */
+  void createSwapChain();
+
+  /**
+   * Creates the images rendered to in headless mode, one per frame in flight.
+   */
+  void createOffscreenTargets();
 
   void createCommandPool();
 
@@ -168,38 +548,192 @@ private:
 
   void createDescriptorSetLayout();
 
-  void updateUniformBuffer(uint32_t currentImage);
+  /**
+   * Creates the descriptor set of bindless mode, with the material buffer
+   * and the textures loaded so far, and material 0.
+   */
+  void createBindlessDescriptorSet();
+
+  /**
+   * Writes a texture to its element of the bindless texture array.
+   */
+  void writeBindlessTexture(TextureHandle texture);
+
+  /**
+   * Enables descriptor indexing on device creation if requested and
+   * supported, and sets bindless accordingly.
+   * @param features Chained to the device create info if enabled
+   * @param extensions Extended with the extensions needed
+   * @return True if bindless mode is used
+   */
+  bool enableDescriptorIndexing(
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT &features,
+    std::vector<const char*> &extensions);
+
+  /**
+   * Creates a mesh from raw vertex and index data.
+   * @param vertexData Vertices, encoded with vertexLayout
+   * @param vertexDataSize Size of the vertices in bytes
+   * @param indexData Indices, of indexType
+   * @param chunks Ranges of indices drawn, covering indexCount indices
+   * @param lods Chunks of each level of detail
+   * @param bounds Bounds the positions were encoded within
+   * @throw Error if there are no levels or more than MAX_MESH_LODS
+   */
+  MeshHandle createMesh(
+    const void *vertexData,
+    VkDeviceSize vertexDataSize,
+    const void *indexData,
+    VkIndexType indexType,
+    uint32_t indexCount,
+    const std::vector<MeshChunk> &chunks,
+    const std::vector<MeshLodRange> &lods,
+    const MeshBounds &bounds,
+    UploadTicket *outTicket);
+
+  /**
+   * Called once the frame is submitted.
+   */
+  void endFrame();
+
+  /**
+   * @return Camera position in the space instances are transformed to in
+   *         xyz, and in w the factor turning an error over a distance into
+   *         pixels, divided by the LOD threshold
+   */
+  glm::vec4 getLodCamera() const;
+
+  /**
+   * Copies the instances of the frame to its instance buffer, growing it if
+   * needed, and sets the first instance of each mesh. Instances get the
+   * material and uniforms of their mesh. Without GPU culling, instances are
+   * sorted by level of detail.
+   * @param uniformOffset Offset of the frame uniforms, drawn with by meshes
+   *        without their own
+   */
+  void writeInstances(uint32_t uniformOffset);
+
+  /**
+   * Frees the meshes destroyed that are no longer used by any frame.
+   */
+  void releaseRetiredMeshes();
 
-  void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory);
+  /**
+   * Makes sure a buffer holds at least size bytes, replacing it with a larger
+   * one if needed. The buffer must not be in use by the device.
+   * @param capacity Size of the buffer, updated if replaced
+   * @return True if the buffer was replaced
+   */
+  bool reserveBuffer(
+    VkBuffer &buffer,
+    Allocation &memory,
+    VkDeviceSize &capacity,
+    VkDeviceSize size,
+    VkBufferUsageFlags usage,
+    VkMemoryPropertyFlags properties);
+
+  /**
+   * Writes the culling inputs of the frame and records the culling dispatch.
+   * @param commandBuffer Frame command buffer, outside of the render pass
+   */
+  void recordCulling(VkCommandBuffer commandBuffer);
+
+  void destroyCulling();
+
+  /**
+   * @return True if the physical device supports the extension
+   */
+  bool hasDeviceExtension(const char *name) const;
+
+  /**
+   * Records the command buffer of the current frame in flight.
+   * @param imageIndex Image to render to
+   */
+  void recordCommandBuffer(uint32_t imageIndex);
+
+  /**
+   * Splits the meshes drawn this frame into ranges of about the same number
+   * of draws, one per recording task.
+   */
+  void splitDraws();
+
+  /**
+   * Records the draws of a range of drawnMeshes into a secondary command
+   * buffer, continuing the render pass of the context. Called from recording
+   * threads.
+   */
+  void recordDraws(VkCommandBuffer commandBuffer, const RenderPassContext &context, size_t firstMesh, size_t meshEnd) const;
+
+  /**
+   * Submits a frame to the offscreen target of the current frame in flight.
+   */
+  void drawOffscreen();
+
+  void createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, Allocation& imageMemory);
   
   VkCommandBuffer beginSingleTimeCommands();
 
   void endSingleTimeCommands(VkCommandBuffer commandBuffer);
 
-  void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout);
+  /**
+   * Changes the layout of levelCount mip levels, starting at baseMipLevel.
+   */
+  void transitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t baseMipLevel, uint32_t levelCount);
 
-  void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
+  void copyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize bufferOffset, VkImage image, uint32_t width, uint32_t height, uint32_t mipLevel);
 
-  VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
+  VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels);
 
-  VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
   /**
-   * Creates a buffer.
+   * @return True if images of the format can be downsampled with linear blits
+   */
+  bool supportsLinearBlit(VkFormat format) const;
+
+  /**
+   * @return True if images of the format can be sampled with linear filtering
+   */
+  bool supportsSampledFormat(VkFormat format) const;
+
+  /**
+   * Uploads the levels of a texture, completing the mip chain of RGBA8
+   * textures.
+   */
+  UploadTicket uploadTexture(TextureData texture, TextureHandle *outTexture);
+
+  /**
+   * Fills the mip levels of an image from its first level with blits, each
+   * level from the previous one. Must be recorded on the graphics queue.
+   * Expects level 0 in TRANSFER_SRC_OPTIMAL layout and the others undefined,
+   * leaves all levels in SHADER_READ_ONLY_OPTIMAL layout.
+   */
+  void generateMipmaps(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels);
+
+  /**
+   * Creates the pipeline cache, from the saved one if it was created by the
+   * same driver and device.
    */
-  void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
+  void createPipelineCache(const VkPhysicalDeviceProperties &properties);
 
   /**
-   * Copy buffers.
+   * Saves the pipeline cache if a path is set, and destroys it.
    */
-  void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+  void destroyPipelineCache();
 
+  VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
   /**
-   * Returns the type of memory depending on application and buffer requirements
+   * Creates a buffer.
    */
-  uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+  void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, Allocation& bufferMemory);
 
   /**
-   * Cleanup the swap chain
+   * Records a copy between buffers.
+   */
+  void copyBuffer(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+
+  /**
+   * Destroys the resources sized as the render targets: image views and
+   * offscreen images. No frame may be in flight, the framebuffers of the
+   * frame graph using them are recreated when it is resized.
    */
   void cleanupSwapChain();
 
@@ -259,17 +793,28 @@ private:
 
 
   bool initialized;
+  bool headless;
 
   uint32_t width;
   uint32_t height;
 
+  FramePolicy framePolicy;
+  // Frames in flight resources are allocated for, at least maxFramesInFlight
+  uint32_t frameSlots;
+  uint32_t maxFramesInFlight;
   size_t currentFrame;
+  size_t lastFrame;
+  bool frameBegun;
 
-  std::vector<Vertex> vertices;
-  std::vector<uint32_t> indices;
+  // Frames submitted so far
+  uint64_t frameNumber;
 
   UniformBufferObject ubo;
 
+  float lodThreshold;
+
+  VertexLayout vertexLayout;
+
   std::vector<char> vertexShader;
   std::vector<char> fragmentShader;
 
@@ -278,52 +823,188 @@ private:
   VkDevice device;
   VkQueue graphicsQueue;
   VkQueue presentQueue;
+  VkQueue transferQueue;
   VkSurfaceKHR surface;
   VkSwapchainKHR swapChain;
 
+  MemoryAllocator allocator;
+  UploadBatcher uploader;
+  UniformRing uniforms;
+  // Uniform bytes available to each frame in flight
+  VkDeviceSize uniformRingSize;
+  // Sets of the pipelines, transient ones are rewritten every frame
+  DescriptorAllocator descriptors;
+  // Not initialized if the graphics queue has no timestamps
+  GpuProfiler profiler;
+  bool gpuProfiling;
+
   VkFormat swapChainImageFormat;
   VkExtent2D swapChainExtent;
+  // FIFO in headless mode
+  VkPresentModeKHR swapChainPresentMode;
 
+  // In headless mode, these are the offscreen render targets
   std::vector<VkImage> swapChainImages;
   std::vector<VkImageView> swapChainImageViews;
+  std::vector<Allocation> offscreenImagesMemory;
 
   VkDescriptorSetLayout descriptorSetLayout;
   VkPipelineLayout pipelineLayout;
-  VkRenderPass renderPass;
   VkPipeline graphicsPipeline;
 
-  std::vector<VkFramebuffer> swapChainFramebuffers;
+  // Used by all pipeline creations, saved to pipelineCachePath on destruction
+  VkPipelineCache pipelineCache;
+  std::string pipelineCachePath;
 
   VkCommandPool commandPool;
+  // One per frame in flight, recorded every frame
   std::vector<VkCommandBuffer> commandBuffers;
 
+  // Secondary command buffers the draws of a frame are recorded into, one
+  // per recording task. Each comes from its own pool, so that tasks record
+  // concurrently, and pools are reset together once the frame completed.
+  typedef struct RecordingFrameStruct {
+    std::vector<VkCommandPool> commandPools;
+    std::vector<VkCommandBuffer> commandBuffers;
+  } RecordingFrame;
+
+  std::vector<RecordingFrame> recordingFrames;
+  uint32_t recordingThreads;
+  WorkerPool workers;
+  // Meshes drawn this frame, split into a range per recording task
+  std::vector<MeshHandle> drawnMeshes;
+  std::vector<size_t> recordingRanges;
+
   std::vector<VkSemaphore> imageAvailableSemaphores;
   std::vector<VkSemaphore> renderFinishedSemaphores;
   std::vector<VkFence> inFlightFences;
   std::vector<VkFence> imagesInFlight;
 
-  // Vertex & index buffers
-  VkBuffer vertexBuffer;
-  VkDeviceMemory vertexBufferMemory;
-  VkBuffer indexBuffer;
-  VkDeviceMemory indexBufferMemory;
-
-  // Uniform buffers
-  std::vector<VkBuffer> uniformBuffers;
-  std::vector<VkDeviceMemory> uniformBuffersMemory;
-
-  VkDescriptorPool descriptorPool;
-  std::vector<VkDescriptorSet> descriptorSets;
-
-  // Texture mapping
-  VkImage textureImage;
-  VkDeviceMemory textureImageMemory;
-  VkImageView textureImageView;
+  typedef struct MeshStruct {
+    VkBuffer vertexBuffer;
+    Allocation vertexBufferMemory;
+    VkBuffer indexBuffer;
+    Allocation indexBufferMemory;
+    VkIndexType indexType;
+    // Drawn one after the other, usually a single one per level of detail
+    std::vector<MeshChunk> chunks;
+    std::vector<MeshLodRange> lods;
+    UploadTicket upload;
+
+    // Center in xyz, radius in w
+    glm::vec4 boundingSphere;
+    VertexDequantization dequantization;
+    // Copied to each instance
+    MaterialHandle material;
+    // Sampled by the material, the mesh is drawn once it is uploaded
+    TextureHandle texture;
+    // Offset of the uniforms of the frame being built,
+    // NO_MESH_UNIFORMS to draw with those of setTransform
+    uint32_t uniformOffset;
+
+    // Instances of the frame being built
+    std::vector<Instance> instances;
+    uint32_t firstInstance;
+    // Instances drawn with each level, without GPU culling
+    std::array<uint32_t, MAX_MESH_LODS> lodInstanceCounts;
+    // Index of the mesh among the meshes drawn this frame
+    uint32_t batch;
+    // With GPU culling, indirect command of the first chunk, culling record
+    // of the first level and first visible instance slot. Each level has
+    // room for all instances.
+    uint32_t firstCommand;
+    uint32_t firstLod;
+    uint32_t firstVisible;
+  } Mesh;
+
+  typedef struct RetiredMeshStruct {
+    Mesh mesh;
+    // Value of frameNumber when destroyed
+    uint64_t frameNumber;
+  } RetiredMesh;
+
+  // Indexed by handle, destroyed slots have a null vertex buffer
+  std::vector<Mesh> meshes;
+  std::vector<MeshHandle> freeMeshes;
+  std::vector<RetiredMesh> retiredMeshes;
+
+  // Instance buffers, one per frame in flight
+  std::vector<VkBuffer> instanceBuffers;
+  std::vector<Allocation> instanceBuffersMemory;
+  std::vector<VkDeviceSize> instanceBufferCapacities;
+
+  // GPU culling, one set of buffers per frame in flight
+  typedef struct CullingFrameStruct {
+    // Bounds and instance range of each batch, written by the host
+    VkBuffer batchBuffer;
+    Allocation batchBufferMemory;
+    VkDeviceSize batchBufferCapacity;
+
+    // Levels of detail of the batches follow, at lodDataOffset
+    VkDeviceSize lodDataOffset;
+
+    // Indirect commands of the batches, followed by the draw counts of each
+    // level
+    VkBuffer indirectBuffer;
+    Allocation indirectBufferMemory;
+    VkDeviceSize indirectBufferCapacity;
+    VkDeviceSize drawCountOffset;
+
+    // Instances that passed culling, compacted per batch
+    VkBuffer visibleBuffer;
+    Allocation visibleBufferMemory;
+    VkDeviceSize visibleBufferCapacity;
+  } CullingFrame;
+
+  bool gpuCulling;
+  VkDescriptorSetLayout cullDescriptorSetLayout;
+  // Writes the buffers of the frame to its transient set
+  DescriptorUpdateTemplate cullUpdateTemplate;
+  VkPipelineLayout cullPipelineLayout;
+  VkPipeline cullPipeline;
+  std::vector<CullingFrame> cullingFrames;
+
+  // Null if VK_KHR_draw_indirect_count is not supported
+  PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount;
+  bool multiDrawIndirect;
+  VkDeviceSize minStorageBufferOffsetAlignment;
+
+  // Uniforms of the frame are bound from the ring with a dynamic offset
+  VkDescriptorSet descriptorSet;
+
+  // Texture mapping, indexed by handle. Without bindless mode, texture 0
+  // is the one sampled.
+  typedef struct TextureStruct {
+    VkImage image;
+    Allocation memory;
+    VkImageView view;
+    UploadTicket upload;
+  } Texture;
+
+  std::vector<Texture> textures;
+  // Shared by all textures, created with the first one
   VkSampler textureSampler;
 
-  // Depth buffering
-  VkImage depthImage;
-  VkDeviceMemory depthImageMemory;
-  VkImageView depthImageView;
+  // Bindless mode, set 1 of the graphics pipeline holds the materials and
+  // an array of all textures
+  std::vector<char> bindlessFragmentShader;
+  bool bindless;
+  uint32_t bindlessTextureCapacity;
+  VkDescriptorSetLayout bindlessSetLayout;
+  VkDescriptorPool bindlessDescriptorPool;
+  VkDescriptorSet bindlessDescriptorSet;
+  // Host visible, material slots are written once and never reused
+  VkBuffer materialBuffer;
+  Allocation materialBufferMemory;
+  uint32_t materialCount;
+
+  // Depth buffering, the depth image is transient in the frame graph
   VkFormat depthFormat;
+
+  // Passes of a frame, rendering to backbuffer, the image acquired or the
+  // offscreen target of the frame
+  RenderGraph frameGraph;
+  RenderResource backbuffer;
+  // Draws the meshes, its render pass is the one of the graphics pipeline
+  RenderPassHandle mainPass;
 };
\ No newline at end of file
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Events each thread keeps, older ones are overwritten
+static const size_t DEFAULT_CPU_PROFILE_EVENTS = 1 << 16;
+
+/**
+ * Span of time a thread spent in a scope.
+ */
+typedef struct CpuProfileEventStruct {
+  // Static string, not copied
+  const char *name;
+  // Nanoseconds since the profiler was created
+  uint64_t start;
+  uint64_t duration;
+} CpuProfileEvent;
+
+/**
+ * Records scopes of the threads using it into a ring per thread, written
+ * without locks by its thread only. Rings are read when dumping, events
+ * overwritten meanwhile are dropped.
+ *
+ * Disabled until setEnabled(true), markers then cost a relaxed load. Built
+ * without CACUS_PROFILING, markers compile to nothing.
+ */
+class CpuProfiler {
+public:
+  /**
+   * @param eventsPerThread Capacity of the ring of each thread
+   */
+  explicit CpuProfiler(size_t eventsPerThread = DEFAULT_CPU_PROFILE_EVENTS);
+
+  void setEnabled(bool enabled) {
+    this->enabled.store(enabled, std::memory_order_relaxed);
+  }
+
+  bool isEnabled() const {
+    return enabled.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @return Nanoseconds since the profiler was created
+   */
+  uint64_t now() const;
+
+  /**
+   * Adds an event to the ring of the calling thread.
+   * @param name Static string
+   */
+  void record(const char *name, uint64_t start, uint64_t end);
+
+  /**
+   * Names the calling thread in traces.
+   */
+  void setThreadName(const std::string &name);
+
+  /**
+   * @return Events of all threads still in their ring, by thread
+   */
+  std::vector<std::vector<CpuProfileEvent>> getEvents() const;
+
+  /**
+   * Drops the events recorded so far.
+   */
+  void clear();
+
+  /**
+   * Writes the events in the Chrome trace event format, which Perfetto and
+   * chrome://tracing open.
+   */
+  void writeChromeTrace(std::ostream &out) const;
+
+  /**
+   * @throw Error if the file cannot be written
+   */
+  void writeChromeTrace(const std::string &path) const;
+
+private:
+  typedef struct ThreadRingStruct {
+    std::thread::id thread;
+    std::string name;
+    std::vector<CpuProfileEvent> events;
+    // Events ever recorded, written by the thread only
+    std::atomic<uint64_t> head;
+    // Value of head when cleared
+    std::atomic<uint64_t> tail;
+  } ThreadRing;
+
+  /**
+   * @return Ring of the calling thread, created on first use
+   */
+  ThreadRing &getThreadRing();
+
+  /**
+   * Copies the events of a ring that were not overwritten while copying.
+   */
+  std::vector<CpuProfileEvent> readRing(const ThreadRing &ring) const;
+
+  // Distinguishes profilers in the ring cache of threads
+  const uint64_t id;
+  const size_t eventsPerThread;
+  const std::chrono::steady_clock::time_point epoch;
+  std::atomic<bool> enabled;
+
+  // Guards the list, not the rings
+  mutable std::mutex mutex;
+  std::vector<std::unique_ptr<ThreadRing>> rings;
+};
+
+/**
+ * @return Profiler the markers of Cacus record to
+ */
+CpuProfiler &getCpuProfiler();
+
+/**
+ * Records the time spent until destruction, if the profiler is enabled on
+ * construction.
+ */
+class CpuProfileScope {
+public:
+  CpuProfileScope(CpuProfiler &profiler, const char *name) :
+    profiler(profiler),
+    name(name),
+    active(profiler.isEnabled()),
+    start(active ? profiler.now() : 0)
+  {}
+
+  ~CpuProfileScope() {
+    if (active)
+      profiler.record(name, start, profiler.now());
+  }
+
+  CpuProfileScope(const CpuProfileScope&) = delete;
+  CpuProfileScope &operator=(const CpuProfileScope&) = delete;
+
+private:
+  CpuProfiler &profiler;
+  const char *name;
+  const bool active;
+  const uint64_t start;
+};
+
+#define CACUS_PROFILE_CONCAT_(a, b) a##b
+#define CACUS_PROFILE_CONCAT(a, b) CACUS_PROFILE_CONCAT_(a, b)
+
+/**
+ * Profiles the enclosing scope under a static name.
+ */
+#ifdef CACUS_PROFILING
+#define CACUS_PROFILE_SCOPE(name) \
+  CpuProfileScope CACUS_PROFILE_CONCAT(cacusProfileScope, __LINE__)(getCpuProfiler(), name)
+#else
+#define CACUS_PROFILE_SCOPE(name) ((void) 0)
+#endif
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+
+/**
+ * Descriptors of a type a pool holds for each of its sets.
+ */
+typedef struct DescriptorPoolRatioStruct {
+  VkDescriptorType type;
+  float descriptorsPerSet;
+} DescriptorPoolRatio;
+
+/**
+ * Writes the descriptors of a set from a host struct, one entry per range
+ * of array elements. Backed by a VK_KHR_descriptor_update_template object
+ * if the device supports it, by the equivalent descriptor writes otherwise.
+ */
+typedef struct DescriptorUpdateTemplateStruct {
+  // Null without the extension
+  VkDescriptorUpdateTemplateKHR handle;
+  std::vector<VkDescriptorUpdateTemplateEntryKHR> entries;
+} DescriptorUpdateTemplate;
+
+/**
+ * Expands the entries of an update template into descriptor writes, reading
+ * infos from data the way vkUpdateDescriptorSetWithTemplate does. Writes
+ * point into data, which must outlive them.
+ * @param set Set written
+ * @param entries Ranges written, with the offset and stride of their infos
+ * @param data Infos of the entries
+ * @return One write per entry, or per element if infos are not contiguous
+ */
+std::vector<VkWriteDescriptorSet> expandDescriptorUpdate(
+  VkDescriptorSet set,
+  const std::vector<VkDescriptorUpdateTemplateEntryKHR> &entries,
+  const void *data);
+
+/**
+ * Hands out descriptor sets from chains of descriptor pools, sized from the
+ * descriptors each set needs on average. A chain grows by a larger pool
+ * when its pools are exhausted, instead of being sized upfront.
+ *
+ * Persistent sets live until destroy(). Transient sets are allocated from
+ * the chain of the current frame in flight, and freed all at once by
+ * resetting its pools when the frame is reused, keeping them for the next
+ * allocations.
+ *
+ * Not thread safe.
+ */
+class DescriptorAllocator {
+public:
+  DescriptorAllocator();
+
+  /**
+   * @param ratios Descriptors of each type per set
+   * @param frameCount Number of frames in flight
+   * @param updateTemplates True if VK_KHR_descriptor_update_template is
+   *        enabled on the device
+   */
+  void init(
+    VkDevice device,
+    const std::vector<DescriptorPoolRatio> &ratios,
+    uint32_t frameCount,
+    bool updateTemplates);
+
+  void destroy();
+
+  /**
+   * @return Set valid until destroy()
+   * @throw Error if the set cannot be allocated from a new pool either
+   */
+  VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+
+  /**
+   * Frees the transient sets of a frame, whose fence has been waited on, and
+   * allocates the next transient sets for it.
+   */
+  void beginFrame(uint32_t frame);
+
+  /**
+   * @return Set valid until the current frame is begun again
+   * @throw Error if the set cannot be allocated from a new pool either
+   */
+  VkDescriptorSet allocateTransient(VkDescriptorSetLayout layout);
+
+  /**
+   * @param layout Layout of the sets written
+   * @param entries Ranges written, with the offset and stride of their infos
+   *        in the data passed to update()
+   * @throw Error if the template cannot be created
+   */
+  DescriptorUpdateTemplate createUpdateTemplate(
+    VkDescriptorSetLayout layout,
+    const std::vector<VkDescriptorUpdateTemplateEntryKHR> &entries);
+
+  void destroyUpdateTemplate(DescriptorUpdateTemplate &updateTemplate);
+
+  /**
+   * Writes the descriptors of a set with a template.
+   * @param data Infos laid out as described by the entries of the template
+   */
+  void update(VkDescriptorSet set, const DescriptorUpdateTemplate &updateTemplate, const void *data) const;
+
+  /**
+   * @return Number of pools created, over all chains
+   */
+  size_t getPoolCount() const;
+
+private:
+  typedef struct PoolChainStruct {
+    std::vector<VkDescriptorPool> pools;
+    // Pool allocated from, the previous ones are exhausted
+    size_t current;
+  } PoolChain;
+
+  /**
+   * Allocates from the current pool of a chain, moving on to the next one,
+   * created if needed, when it is exhausted.
+   */
+  VkDescriptorSet allocate(PoolChain &chain, VkDescriptorSetLayout layout);
+
+  /**
+   * @return Pool holding setCount sets of the ratios
+   */
+  VkDescriptorPool createPool(uint32_t setCount) const;
+
+  void destroyChain(PoolChain &chain);
+
+  VkDevice device;
+  std::vector<DescriptorPoolRatio> ratios;
+
+  PoolChain persistentChain;
+  std::vector<PoolChain> frameChains;
+  uint32_t currentFrame;
+
+  PFN_vkCreateDescriptorUpdateTemplateKHR createDescriptorUpdateTemplate;
+  PFN_vkDestroyDescriptorUpdateTemplateKHR destroyDescriptorUpdateTemplate;
+  PFN_vkUpdateDescriptorSetWithTemplateKHR updateDescriptorSetWithTemplate;
+};
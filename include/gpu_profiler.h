@@ -0,0 +1,159 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <string>
+#include <vector>
+
+// Scopes a frame can record, the following ones are ignored
+static const uint32_t MAX_GPU_SCOPES = 32;
+
+// Returned by GpuProfiler::beginScope once the scopes of a frame are used up
+static const uint32_t GPU_SCOPE_NONE = UINT32_MAX;
+
+/**
+ * Pipeline statistics gathered for scopes, in the order the device writes
+ * them.
+ */
+typedef struct GpuPipelineStatisticsStruct {
+  uint64_t vertexInvocations;
+  uint64_t clippingInvocations;
+  // Primitives output by clipping, clippingInvocations minus the ones clipped
+  // out, plus the ones clipping split
+  uint64_t clippingPrimitives;
+  uint64_t fragmentInvocations;
+  uint64_t computeInvocations;
+} GpuPipelineStatistics;
+
+/**
+ * Time the device spent on a scope of a frame.
+ */
+typedef struct GpuScopeStatsStruct {
+  std::string name;
+  double milliseconds;
+  // Zero if the scope was recorded without pipeline statistics
+  bool hasStatistics;
+  GpuPipelineStatistics statistics;
+} GpuScopeStats;
+
+/**
+ * Scopes of a frame, in the order they began.
+ */
+typedef struct GpuFrameStatsStruct {
+  // Number of the frame, as counted by Cacus
+  uint64_t frameNumber;
+  std::vector<GpuScopeStats> scopes;
+} GpuFrameStats;
+
+/**
+ * @param begin Timestamp written at the beginning of the scope
+ * @param end Timestamp written at its end
+ * @param timestampPeriod Nanoseconds per timestamp tick
+ * @param timestampValidBits Bits of the timestamps that are valid
+ * @return Milliseconds between the timestamps, across wrap-arounds
+ */
+double getTimestampMilliseconds(uint64_t begin, uint64_t end, float timestampPeriod, uint32_t timestampValidBits);
+
+/**
+ * Times scopes of the frames on the device with timestamp queries, and
+ * gathers their pipeline statistics if supported. Each frame in flight has
+ * its own range of queries, read back once its fence has been waited on
+ * the next time the frame is begun, so reading never stalls.
+ *
+ * Pipeline statistics queries cannot nest, a scope beginning within one
+ * with statistics is only timed.
+ */
+class GpuProfiler {
+public:
+  GpuProfiler();
+
+  /**
+   * @param frameCount Number of frames in flight
+   * @param timestampPeriod Nanoseconds per timestamp tick
+   * @param timestampValidBits Bits of the timestamps of the queue scopes
+   *        are recorded on, not zero
+   * @param pipelineStatistics True if the pipelineStatisticsQuery and
+   *        inheritedQueries features are enabled
+   */
+  void init(
+    VkDevice device,
+    uint32_t frameCount,
+    float timestampPeriod,
+    uint32_t timestampValidBits,
+    bool pipelineStatistics);
+
+  void destroy();
+
+  bool isInitialized() const {
+    return timestampPool != VK_NULL_HANDLE;
+  }
+
+  /**
+   * Reads back the scopes recorded the last time the frame was used, whose
+   * fence has been waited on, into getFrameStats().
+   */
+  void beginFrame(uint32_t frame, uint64_t frameNumber);
+
+  /**
+   * Resets the queries of the current frame. Must be recorded outside of
+   * render passes, before its scopes.
+   */
+  void reset(VkCommandBuffer commandBuffer);
+
+  /**
+   * Records the beginning of a scope, outside of render passes.
+   * @param statistics True to gather the pipeline statistics of the scope
+   * @return Scope to end, GPU_SCOPE_NONE if the frame has too many
+   */
+  uint32_t beginScope(VkCommandBuffer commandBuffer, const std::string &name, bool statistics);
+
+  /**
+   * Records the end of a scope, in the command buffer it began in.
+   */
+  void endScope(VkCommandBuffer commandBuffer, uint32_t scope);
+
+  /**
+   * @return Scopes of the last frame read back
+   */
+  const GpuFrameStats &getFrameStats() const {
+    return frameStats;
+  }
+
+  /**
+   * @return Statistics gathered by scopes, to be inherited by the secondary
+   *         command buffers executed within them. Zero if not supported.
+   */
+  VkQueryPipelineStatisticFlags getStatisticFlags() const;
+
+private:
+  /**
+   * Reads back the scopes of a frame into frameStats, unless some of its
+   * queries are not available.
+   */
+  void readScopes(uint32_t frame);
+
+  typedef struct ScopeStruct {
+    std::string name;
+    bool statistics;
+  } Scope;
+
+  typedef struct FrameStruct {
+    std::vector<Scope> scopes;
+    uint64_t frameNumber;
+  } Frame;
+
+  VkDevice device;
+  float timestampPeriod;
+  uint32_t timestampValidBits;
+
+  // Two timestamps and one statistics query per scope, MAX_GPU_SCOPES per
+  // frame
+  VkQueryPool timestampPool;
+  VkQueryPool statisticsPool;
+
+  std::vector<Frame> frames;
+  uint32_t currentFrame;
+  // Scope whose pipeline statistics query is active, if any
+  uint32_t statisticsScope;
+
+  GpuFrameStats frameStats;
+};
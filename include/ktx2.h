@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+#include <texture.h>
+
+/**
+ * Reader of KTX 2.0 textures (Khronos), holding 2D textures and their mip
+ * chains in the layout Vulkan copies to images.
+ *
+ * Only textures of a known format (see getTextureFormatInfo) are supported:
+ * not Basis Universal, supercompression, 3D, array or cubemap textures.
+ */
+
+/**
+ * Parses a KTX2 file held in memory.
+ * @return Texture with the levels of the file, largest first
+ * @throw Error if the data is not a supported KTX2 texture
+ */
+TextureData parseKtx2(const void *data, size_t size);
+
+/**
+ * Reads and parses a KTX2 file.
+ * @throw Error if the file cannot be read or is not a supported KTX2 texture
+ */
+TextureData readKtx2(const std::string &path);
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <map>
+#include <mutex>
+
+/**
+ * Range of device memory handed out by the MemoryAllocator.
+ */
+typedef struct AllocationStruct {
+  VkDeviceMemory memory;
+  VkDeviceSize offset;
+  VkDeviceSize size;
+
+  // Host address of the range if the memory is host visible, null otherwise
+  void *mapped;
+
+  uint32_t memoryType;
+  bool linear;
+} Allocation;
+
+/**
+ * Memory usage of one heap.
+ */
+typedef struct MemoryHeapStatsStruct {
+  VkDeviceSize heapSize;
+  // Bytes obtained from vkAllocateMemory
+  VkDeviceSize blockBytes;
+  // Bytes handed out to resources (including size class rounding)
+  VkDeviceSize usedBytes;
+  uint32_t blockCount;
+  uint32_t allocationCount;
+} MemoryHeapStats;
+
+/**
+ * Free ranges of a block of memory, offset -> size.
+ */
+typedef std::map<VkDeviceSize, VkDeviceSize> MemoryFreeRanges;
+
+/**
+ * Rounds a request up to its size class: eight classes per power of two,
+ * so at most 12.5% of the request is wasted. Requests of 256 bytes or less
+ * all get the smallest class.
+ */
+VkDeviceSize getMemorySizeClass(VkDeviceSize size);
+
+/**
+ * Places a range in the smallest free range that can hold it once aligned,
+ * splitting off what is left on either side.
+ * @return True on success, outOffset set to the start of the range
+ */
+bool allocateFreeRange(MemoryFreeRanges &freeRanges, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &outOffset);
+
+/**
+ * Returns a range, merging it with the adjacent free ranges.
+ */
+void releaseFreeRange(MemoryFreeRanges &freeRanges, VkDeviceSize offset, VkDeviceSize size);
+
+/**
+ * @param bufferImageGranularity Limit of the device, optimal images get
+ *        pools of their own if above 1
+ * @return Index of the pool for a memory type and resource kind, two pools
+ *         per memory type
+ */
+size_t getMemoryPoolIndex(uint32_t memoryType, bool linear, VkDeviceSize bufferImageGranularity);
+
+/**
+ * Sub-allocates buffers and images from large blocks of device memory, so
+ * that the number of vkAllocateMemory calls does not grow with the number
+ * of resources.
+ *
+ * Each memory type has its own pools of blocks. Requests are rounded up to
+ * a size class and placed with a best-fit search in the free ranges of the
+ * blocks; freed ranges are merged with their neighbours. Linear resources
+ * (buffers) and optimal images are kept in separate blocks when the device
+ * has a bufferImageGranularity above 1, so they can never alias a page.
+ */
+class MemoryAllocator {
+public:
+  MemoryAllocator();
+
+  /**
+   * @param physicalDevice Device to query memory properties from
+   * @param device Logical device to allocate from
+   */
+  void init(VkPhysicalDevice physicalDevice, VkDevice device);
+
+  /**
+   * Frees all blocks. Must be called before the device is destroyed.
+   */
+  void destroy();
+
+  /**
+   * @param requirements Requirements of the resource to bind
+   * @param properties Required memory properties
+   * @param linear True for buffers and linear images, false for optimal images
+   * @throw Error if no memory type matches or memory is exhausted
+   */
+  Allocation allocate(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties, bool linear);
+
+  /**
+   * Returns a range to its block. The allocation is reset.
+   */
+  void free(Allocation &allocation);
+
+  /**
+   * @return Usage statistics, indexed by memory heap
+   */
+  std::vector<MemoryHeapStats> getHeapStats() const;
+
+  /**
+   * Returns the type of memory depending on application and buffer requirements
+   */
+  uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+private:
+  typedef struct BlockStruct {
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+    void *mapped;
+    MemoryFreeRanges freeRanges;
+    VkDeviceSize usedBytes;
+    uint32_t allocationCount;
+    bool dedicated;
+  } Block;
+
+  /**
+   * @return Preferred size of the blocks of a memory type
+   */
+  VkDeviceSize blockSize(uint32_t memoryType) const;
+
+  /**
+   * Creates a block and maps it if the memory is host visible.
+   */
+  Block *createBlock(uint32_t memoryType, VkDeviceSize size, bool dedicated);
+
+  void destroyBlock(Block *block);
+
+  VkDevice device;
+  VkPhysicalDeviceMemoryProperties memoryProperties;
+  VkDeviceSize bufferImageGranularity;
+
+  // One pool per memory type and resource kind (linear / optimal)
+  std::vector<std::vector<Block*>> pools;
+
+  mutable std::mutex mutex;
+};
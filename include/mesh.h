@@ -0,0 +1,156 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <vertex.h>
+
+/**
+ * Axis aligned box and sphere enclosing the positions of a mesh.
+ */
+typedef struct MeshBoundsStruct {
+  glm::vec3 min;
+  glm::vec3 max;
+  // Center in xyz, radius in w
+  glm::vec4 sphere;
+} MeshBounds;
+
+/**
+ * Computes the bounds of vertices. The sphere is centered on the box.
+ */
+MeshBounds computeBounds(const Vertex *vertices, size_t vertexCount);
+
+// Vertices a chunk can address with 16 bit indices
+static const uint32_t MAX_INDEX16_VERTICES = 65536;
+
+/**
+ * Range of the index buffer of a mesh, drawn with its own vertex offset.
+ */
+typedef struct MeshChunkStruct {
+  uint32_t firstIndex;
+  uint32_t indexCount;
+  // Added to each index of the chunk
+  int32_t vertexOffset;
+} MeshChunk;
+
+/**
+ * Splits a triangle list into chunks of consecutive triangles referencing
+ * at most maxVertices vertices each, so that every chunk can be drawn with
+ * 16 bit indices. Vertices used by several chunks are duplicated.
+ * @param outVertices Vertices of the chunks, contiguous per chunk
+ * @param outIndices Indices, relative to the vertex offset of their chunk
+ * @return Chunks in the order of the triangles, a single one if the mesh
+ *         has at most maxVertices vertices
+ * @throw Error if the indices are not a valid triangle list
+ */
+std::vector<MeshChunk> splitMesh(
+  const std::vector<Vertex> &vertices,
+  const std::vector<uint32_t> &indices,
+  uint32_t maxVertices,
+  std::vector<Vertex> &outVertices,
+  std::vector<uint32_t> &outIndices);
+
+// Levels of detail of a mesh, including the full detail one
+static const uint32_t MAX_MESH_LODS = 8;
+
+/**
+ * Level of detail of a mesh, indexing its vertices.
+ */
+typedef struct MeshLodStruct {
+  std::vector<uint32_t> indices;
+  // Largest deviation from the full detail mesh, in object space
+  float error;
+} MeshLod;
+
+/**
+ * Chunks drawing a level of detail.
+ */
+typedef struct MeshLodRangeStruct {
+  uint32_t firstChunk;
+  uint32_t chunkCount;
+  float error;
+} MeshLodRange;
+
+/**
+ * Levels of detail of a mesh laid out in a single vertex and index buffer.
+ */
+typedef struct PackedMeshStruct {
+  std::vector<Vertex> vertices;
+  // Relative to the vertex offset of their chunk
+  std::vector<uint32_t> indices;
+  std::vector<MeshChunk> chunks;
+  std::vector<MeshLodRange> lods;
+} PackedMesh;
+
+/**
+ * Appends the indices of each level after the previous one. Levels share
+ * the vertices if there are at most maxChunkVertices of them, otherwise
+ * each level is split with splitMesh.
+ * @throw Error if the levels are not valid triangle lists
+ */
+PackedMesh packMesh(const std::vector<Vertex> &vertices, const std::vector<MeshLod> &lods, uint32_t maxChunkVertices);
+
+/**
+ * @return True if all indices fit in 16 bits
+ */
+bool fitsIndex16(const uint32_t *indices, size_t indexCount);
+
+/**
+ * @return Indices narrowed to 16 bits, they must fit
+ */
+std::vector<uint16_t> narrowIndices(const uint32_t *indices, size_t indexCount);
+
+/**
+ * Builds an indexed mesh from a stream of vertices, welding vertices that
+ * are identical so that each one is stored and transformed once.
+ *
+ * Vertices are compared bitwise (after mapping -0 to +0) through an open
+ * addressing hash table of indices into the vertex array.
+ */
+class MeshBuilder {
+public:
+  /**
+   * @param expectedVertices Number of vertices expected to be added, used
+   *        to size the hash table upfront
+   */
+  MeshBuilder(size_t expectedVertices = 0);
+
+  /**
+   * Appends a vertex to the index buffer, reusing an identical vertex if one
+   * was already added.
+   * @return Index of the vertex
+   */
+  uint32_t addVertex(const Vertex &vertex);
+
+  const std::vector<Vertex> &getVertices() const {
+    return vertices;
+  }
+
+  const std::vector<uint32_t> &getIndices() const {
+    return indices;
+  }
+
+  /**
+   * @return Number of vertices added per unique vertex (1 means no reuse)
+   */
+  float getReuseRatio() const;
+
+  /**
+   * Removes all vertices and indices.
+   */
+  void clear();
+
+private:
+  /**
+   * Doubles the hash table and reinserts all vertices.
+   */
+  void grow();
+
+  static uint32_t hash(const Vertex &vertex);
+
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> indices;
+
+  // Vertex index + 1 of each slot, 0 when empty. Size is a power of two.
+  std::vector<uint32_t> table;
+};
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <vertex_layout.h>
+
+/**
+ * Binary mesh container, cooked offline and mapped in memory at load time.
+ *
+ * Layout: a MeshFileHeader, then the vertex, index, chunk and level of
+ * detail blobs, each aligned to MESH_FILE_ALIGNMENT bytes. Values are
+ * stored little endian. Files are invalidated by a version bump of the
+ * format or a change of the hash of their source.
+ */
+static const uint32_t MESH_FILE_VERSION = 4;
+static const uint32_t MESH_FILE_ALIGNMENT = 16;
+static const uint32_t MESH_FILE_MAX_ATTRIBUTES = 8;
+
+typedef struct MeshFileAttributeStruct {
+  uint32_t location;
+  // VkFormat of the attribute
+  uint32_t format;
+  uint32_t offset;
+} MeshFileAttribute;
+
+typedef struct MeshFileHeaderStruct {
+  char magic[4];
+  uint32_t version;
+  // Hash of the file the mesh was cooked from
+  uint64_t sourceHash;
+
+  // Vertex layout
+  uint32_t vertexStride;
+  uint32_t attributeCount;
+  MeshFileAttribute attributes[MESH_FILE_MAX_ATTRIBUTES];
+
+  // Blobs, offsets are from the start of the file
+  uint64_t vertexCount;
+  uint64_t vertexDataOffset;
+  uint64_t indexCount;
+  uint64_t indexDataOffset;
+  // 2 or 4 bytes
+  uint32_t indexSize;
+  uint32_t chunkCount;
+  // MeshChunk array
+  uint64_t chunkDataOffset;
+  uint32_t lodCount;
+  uint32_t reserved;
+  // MeshLodRange array, finest level first
+  uint64_t lodDataOffset;
+
+  float boundsMin[3];
+  float boundsMax[3];
+  // Center and radius
+  float boundingSphere[4];
+} MeshFileHeader;
+
+/**
+ * Read only memory mapping of a mesh file.
+ */
+class MeshFile {
+public:
+  MeshFile();
+  ~MeshFile();
+
+  MeshFile(const MeshFile&) = delete;
+  MeshFile &operator=(const MeshFile&) = delete;
+
+  /**
+   * Maps a file and validates its header and blob ranges.
+   * @throw Error if the file cannot be mapped or is not a valid mesh file
+   */
+  void open(const std::string &path);
+
+  void close();
+
+  const MeshFileHeader &getHeader() const {
+    return *static_cast<const MeshFileHeader*>(data);
+  }
+
+  const void *getVertexData() const {
+    return static_cast<const char*>(data) + getHeader().vertexDataOffset;
+  }
+
+  const void *getIndexData() const {
+    return static_cast<const char*>(data) + getHeader().indexDataOffset;
+  }
+
+  const MeshChunk *getChunks() const {
+    return reinterpret_cast<const MeshChunk*>(static_cast<const char*>(data) + getHeader().chunkDataOffset);
+  }
+
+  const MeshLodRange *getLods() const {
+    return reinterpret_cast<const MeshLodRange*>(static_cast<const char*>(data) + getHeader().lodDataOffset);
+  }
+
+  /**
+   * @return True if the vertices of the file are encoded with the layout
+   */
+  bool hasVertexLayout(const VertexLayout &layout) const;
+
+  /**
+   * @return Bounds the positions were quantized within
+   */
+  MeshBounds getBounds() const;
+
+  /**
+   * Writes a mesh file, replacing any existing one. Indices are stored on 16
+   * bits if the mesh has at most MAX_INDEX16_VERTICES vertices.
+   * @param lods Levels of detail indexing the vertices, see buildLodChain
+   * @param layout Layout the vertices are encoded with
+   * @param splitLargeMeshes If true, larger meshes are split into chunks
+   *        to be stored with 16 bit indices as well (see splitMesh)
+   * @throw Error if the file cannot be written
+   */
+  static void write(
+    const std::string &path,
+    const std::vector<Vertex> &vertices,
+    const std::vector<MeshLod> &lods,
+    uint64_t sourceHash,
+    const VertexLayout &layout,
+    bool splitLargeMeshes = true);
+
+  /**
+   * @return True if the file exists, has the current version and was cooked
+   *         from a source with the given hash, with the given layout
+   */
+  static bool isCurrent(const std::string &path, uint64_t sourceHash, const VertexLayout &layout);
+
+  /**
+   * @return 64 bit FNV-1a hash of the content of a file
+   * @throw Error if the file cannot be read
+   */
+  static uint64_t hashFile(const std::string &path);
+
+private:
+  void *data;
+  size_t size;
+
+#ifdef _WIN32
+  void *file;
+  void *mapping;
+#endif
+};
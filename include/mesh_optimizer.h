@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <vertex.h>
+
+// Entries of the FIFO post-transform cache optimized for
+static const uint32_t DEFAULT_VERTEX_CACHE_SIZE = 16;
+
+/**
+ * Efficiency of an index buffer with a FIFO post-transform vertex cache.
+ */
+typedef struct VertexCacheStatisticsStruct {
+  // Vertices transformed (cache misses)
+  uint32_t vertexTransforms;
+  // Transforms per triangle, 3 without reuse, about 0.5 at best
+  float acmr;
+  // Transforms per vertex referenced, 1 at best
+  float atvr;
+} VertexCacheStatistics;
+
+/**
+ * Simulates a FIFO vertex cache over a triangle list.
+ * @throw Error if the indices are not a valid triangle list
+ */
+VertexCacheStatistics analyzeVertexCache(
+  const std::vector<uint32_t> &indices,
+  size_t vertexCount,
+  uint32_t cacheSize = DEFAULT_VERTEX_CACHE_SIZE);
+
+/**
+ * Reorders triangles for the post-transform vertex cache, with Tipsify
+ * (Sander et al., "Fast Triangle Reordering for Vertex Locality and
+ * Reduced Overdraw"): triangles are emitted as fans around vertices chosen
+ * to still be in cache, in linear time.
+ * @throw Error if the indices are not a valid triangle list
+ */
+void optimizeVertexCache(
+  std::vector<uint32_t> &indices,
+  size_t vertexCount,
+  uint32_t cacheSize = DEFAULT_VERTEX_CACHE_SIZE);
+
+/**
+ * Reorders clusters of triangles so that those facing away from the center
+ * of the mesh, likely to occlude the others, are drawn first. Expects
+ * indices optimized with optimizeVertexCache, whose locality is kept
+ * within clusters.
+ * @param threshold Vertex cache degradation allowed to get smaller
+ *        clusters, 1.05 allows ACMR to grow by 5%
+ */
+void optimizeOverdraw(
+  std::vector<uint32_t> &indices,
+  const std::vector<Vertex> &vertices,
+  float threshold = 1.05f,
+  uint32_t cacheSize = DEFAULT_VERTEX_CACHE_SIZE);
+
+/**
+ * Reorders vertices in the order they are first referenced, so that they
+ * are fetched sequentially, and drops unreferenced ones. Indices are
+ * remapped.
+ */
+void optimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices);
+
+/**
+ * Runs optimizeVertexCache, optimizeOverdraw and optimizeVertexFetch.
+ */
+void optimizeMesh(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices);
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <vertex.h>
+#include <mesh.h>
+
+/**
+ * Options of simplifyMesh. Positions are normalized to the size of the
+ * mesh, so that the weights do not depend on its scale.
+ */
+typedef struct SimplifyOptionsStruct {
+  // Weights of the squared attribute differences a collapse introduces
+  float colorWeight = 1.0f;
+  float texCoordWeight = 1.0f;
+  float normalWeight = 0.5f;
+
+  // Keeps the vertices of open borders in place, so that meshes built of
+  // several parts do not crack
+  bool lockBorder = true;
+} SimplifyOptions;
+
+/**
+ * Simplifies a triangle list with quadric error metrics (Garland and
+ * Heckbert), collapsing vertices onto one of their neighbours. No vertex is
+ * created: the result indexes the same vertices, so levels of detail can
+ * share a vertex buffer. Vertices on attribute seams only collapse along
+ * the seam, and collapses flipping triangles are rejected.
+ * @param targetIndexCount Stops once the mesh has at most this many indices
+ * @param targetError Largest deviation allowed, in object space units
+ * @param outError If not null, set to the deviation of the result
+ * @return Indices of the simplified mesh
+ * @throw Error if the indices are not a valid triangle list
+ */
+std::vector<uint32_t> simplifyMesh(
+  const std::vector<Vertex> &vertices,
+  const std::vector<uint32_t> &indices,
+  size_t targetIndexCount,
+  float targetError,
+  float *outError = nullptr,
+  const SimplifyOptions &options = SimplifyOptions());
+
+/**
+ * Builds levels of detail, each with about reduction times the triangles of
+ * the previous one. Stops early once the mesh cannot be simplified further.
+ * @return Levels, the first one being the mesh itself with no error
+ */
+std::vector<MeshLod> buildLodChain(
+  const std::vector<Vertex> &vertices,
+  const std::vector<uint32_t> &indices,
+  uint32_t maxLods = MAX_MESH_LODS,
+  float reduction = 0.5f,
+  const SimplifyOptions &options = SimplifyOptions());
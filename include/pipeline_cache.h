@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <string>
+#include <vector>
+#include <cstddef>
+
+/**
+ * Header starting the data of pipeline caches, as of
+ * VK_PIPELINE_CACHE_HEADER_VERSION_ONE.
+ */
+typedef struct PipelineCacheHeaderStruct {
+  uint32_t headerSize;
+  uint32_t headerVersion;
+  uint32_t vendorID;
+  uint32_t deviceID;
+  uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+} PipelineCacheHeader;
+
+/**
+ * @return True if pipeline cache data was created by the same driver of the
+ *         same device, so that it can be given to vkCreatePipelineCache
+ */
+bool isPipelineCacheCompatible(const void *data, size_t size, const VkPhysicalDeviceProperties &properties);
+
+/**
+ * Reads the pipeline cache saved by writePipelineCache.
+ * @return Cache data, empty if the file does not exist or is not compatible
+ *         with the device
+ */
+std::vector<char> readPipelineCache(const std::string &path, const VkPhysicalDeviceProperties &properties);
+
+/**
+ * Replaces a pipeline cache file. Data is written to a temporary file first,
+ * then renamed, so that an interrupted write never leaves a truncated cache.
+ * @throw Error if the file cannot be written
+ */
+void writePipelineCache(const std::string &path, const std::vector<char> &data);
@@ -0,0 +1,511 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <memory_allocator.h>
+
+/**
+ * Identifies an image or buffer of a RenderGraph.
+ */
+typedef uint32_t RenderResource;
+
+/**
+ * Identifies a pass of a RenderGraph.
+ */
+typedef uint32_t RenderPassHandle;
+
+typedef enum RenderPassTypeEnum {
+  // Draws into attachments, within a render pass
+  RENDER_PASS_TYPE_GRAPHICS,
+  RENDER_PASS_TYPE_COMPUTE,
+  RENDER_PASS_TYPE_TRANSFER
+} RenderPassType;
+
+typedef struct RenderImageDescStruct {
+  uint32_t width;
+  uint32_t height;
+  VkFormat format;
+} RenderImageDesc;
+
+/**
+ * What a pass records its commands with. Render pass and framebuffer are
+ * null for compute and transfer passes.
+ */
+typedef struct RenderPassContextStruct {
+  VkCommandBuffer commandBuffer;
+  VkRenderPass renderPass;
+  uint32_t subpass;
+  VkFramebuffer framebuffer;
+  VkExtent2D extent;
+} RenderPassContext;
+
+/**
+ * Layout transition of an image, recorded in a RenderBarrierBatch.
+ */
+typedef struct RenderImageBarrierStruct {
+  RenderResource resource;
+  VkImageLayout oldLayout;
+  VkImageLayout newLayout;
+  VkAccessFlags srcAccess;
+  VkAccessFlags dstAccess;
+} RenderImageBarrier;
+
+/**
+ * Dependencies recorded with a single vkCmdPipelineBarrier. Buffers are
+ * synchronized with the global memory barrier.
+ */
+typedef struct RenderBarrierBatchStruct {
+  VkPipelineStageFlags srcStages;
+  VkPipelineStageFlags dstStages;
+  VkAccessFlags srcAccess;
+  VkAccessFlags dstAccess;
+  std::vector<RenderImageBarrier> images;
+} RenderBarrierBatch;
+
+/**
+ * Time and memory needed by a transient image, for assignAliasOffsets.
+ */
+typedef struct RenderAliasRequestStruct {
+  // Groups the image is used in, inclusive
+  uint32_t firstGroup;
+  uint32_t lastGroup;
+  VkDeviceSize size;
+  VkDeviceSize alignment;
+} RenderAliasRequest;
+
+/**
+ * Places resources in a shared range of memory, so that resources whose
+ * lifetimes overlap never overlap in memory. Largest resources are placed
+ * first, each at the lowest offset available.
+ * @param outOffsets Offset of each request
+ * @return Size of the range
+ */
+VkDeviceSize assignAliasOffsets(const std::vector<RenderAliasRequest> &requests, std::vector<VkDeviceSize> &outOffsets);
+
+/**
+ * Frame described as passes declaring the resources they read and write.
+ *
+ * compile() derives from the declarations, without any Vulkan call:
+ * - the passes contributing to an output or having side effects, others
+ *   are culled;
+ * - groups of consecutive graphics passes rendering to the same extent,
+ *   each group becoming a render pass with a subpass per pass;
+ * - the barriers and layout transitions each group needs, between
+ *   subpasses as subpass dependencies, before the group as one pipeline
+ *   barrier. Reads of a resource already visible need none;
+ * - the groups each transient image is used in.
+ *
+ * build() then creates the transient images, aliasing the memory of those
+ * whose lifetimes do not overlap, and the render passes. execute() records
+ * a frame. resize() recreates the transient images and framebuffers for a
+ * new size, keeping the render passes.
+ */
+class RenderGraph {
+public:
+  RenderGraph();
+
+  /**
+   * Creates an image owned by the graph, whose contents do not outlive a
+   * frame.
+   */
+  RenderResource createImage(const std::string &name, const RenderImageDesc &desc);
+
+  /**
+   * Declares an image owned by the caller, set with setImage before each
+   * execution.
+   * @param initialLayout Layout of the image when the frame starts
+   * @param initialStages Stages to wait for before the first use
+   * @param finalLayout Layout the image is left in, UNDEFINED to keep the
+   *        layout of its last use
+   */
+  RenderResource importImage(
+    const std::string &name,
+    const RenderImageDesc &desc,
+    VkImageLayout initialLayout,
+    VkPipelineStageFlags initialStages,
+    VkImageLayout finalLayout);
+
+  /**
+   * Declares a buffer owned by the caller. Host writes before the frame is
+   * submitted are visible to all passes.
+   */
+  RenderResource importBuffer(const std::string &name);
+
+  /**
+   * Sets the image and view of an imported image.
+   */
+  void setImage(RenderResource resource, VkImage image, VkImageView view);
+
+  /**
+   * Sets the value attachments are cleared to. Defaults to opaque black for
+   * colors, 1 for depth.
+   */
+  void setClearValue(RenderResource resource, const VkClearValue &value);
+
+  /**
+   * Keeps the passes writing the resource, and those they depend on.
+   */
+  void markOutput(RenderResource resource);
+
+  /**
+   * Adds a pass, executed after the passes added before it.
+   * @param record Records the commands of the pass
+   */
+  RenderPassHandle addPass(
+    const std::string &name,
+    RenderPassType type,
+    std::function<void(const RenderPassContext&)> record);
+
+  /**
+   * Keeps the pass even if no output depends on it.
+   */
+  void setSideEffects(RenderPassHandle pass);
+
+  /**
+   * Graphics passes only: the pass records its commands into secondary
+   * command buffers, executed with context.commandBuffer.
+   */
+  void setSecondaryContents(RenderPassHandle pass);
+
+  /**
+   * Renders to a color attachment. Graphics passes only.
+   * @param loadOp LOAD keeps the contents, the others discard them
+   * @throw Error if the resource is not an image or the pass not graphics
+   */
+  void writeColor(RenderPassHandle pass, RenderResource resource, VkAttachmentLoadOp loadOp);
+
+  /**
+   * Tests against and writes to a depth attachment. Graphics passes only.
+   * @param loadOp LOAD keeps the contents, the others discard them
+   * @throw Error if the resource is not an image or the pass not graphics
+   */
+  void writeDepth(RenderPassHandle pass, RenderResource resource, VkAttachmentLoadOp loadOp);
+
+  /**
+   * Reads an attachment written by a previous pass at the same pixel, as an
+   * input attachment. Graphics passes only.
+   * @throw Error if the resource is not an image or the pass not graphics
+   */
+  void readAttachment(RenderPassHandle pass, RenderResource resource);
+
+  /**
+   * Reads an image outside of attachments: sampled, storage or transfer
+   * source, depending on the layout.
+   * @throw Error if the resource is not an image
+   */
+  void readImage(RenderPassHandle pass, RenderResource resource, VkImageLayout layout, VkPipelineStageFlags stages, VkAccessFlags access);
+
+  /**
+   * Writes an image outside of attachments: storage or transfer destination,
+   * depending on the layout.
+   * @throw Error if the resource is not an image
+   */
+  void writeImage(RenderPassHandle pass, RenderResource resource, VkImageLayout layout, VkPipelineStageFlags stages, VkAccessFlags access);
+
+  /**
+   * @throw Error if the resource is not a buffer
+   */
+  void readBuffer(RenderPassHandle pass, RenderResource resource, VkPipelineStageFlags stages, VkAccessFlags access);
+
+  /**
+   * @throw Error if the resource is not a buffer
+   */
+  void writeBuffer(RenderPassHandle pass, RenderResource resource, VkPipelineStageFlags stages, VkAccessFlags access);
+
+  /**
+   * Culls passes, groups them into render passes and computes their
+   * barriers. Does not need a device.
+   * @throw Error if a graphics pass has no attachment or attachments of
+   *        different sizes
+   */
+  void compile();
+
+  /**
+   * Creates the transient images and render passes of the compiled graph.
+   * @throw Error if objects cannot be created
+   */
+  void build(VkDevice newDevice, MemoryAllocator *newAllocator);
+
+  /**
+   * Changes the size of all images, for graphs rendering at the size of
+   * their target. Recreates the transient images and framebuffers if
+   * built, the render passes and barriers do not depend on the size.
+   * Imported images must be set again. No execution may be pending.
+   * @throw Error if the images of the graph differ in size, or if objects
+   *        cannot be created
+   */
+  void resize(uint32_t width, uint32_t height);
+
+  /**
+   * Records the passes, their barriers and render passes.
+   * @param observer Called with true before the commands of each group and
+   *        false after them, outside of render passes, if not null
+   * @throw Error if an imported image used by the passes has not been set
+   */
+  void execute(
+    VkCommandBuffer commandBuffer,
+    const std::function<void(VkCommandBuffer, uint32_t group, bool begin)> &observer = nullptr);
+
+  /**
+   * @return Names of the passes of a group, joined with '+'
+   */
+  std::string getGroupName(uint32_t group) const;
+
+  /**
+   * Destroys the objects created by build, and removes all passes and
+   * resources.
+   */
+  void destroy();
+
+  /**
+   * @return True if no output depends on the pass
+   */
+  bool isPassCulled(RenderPassHandle pass) const {
+    return passes[pass].group == UINT32_MAX;
+  }
+
+  /**
+   * @return Number of groups of the compiled graph
+   */
+  uint32_t getGroupCount() const {
+    return static_cast<uint32_t>(groups.size());
+  }
+
+  /**
+   * @return Group of a pass that is not culled
+   */
+  uint32_t getPassGroup(RenderPassHandle pass) const {
+    return passes[pass].group;
+  }
+
+  /**
+   * @return Subpass of a graphics pass within its group
+   */
+  uint32_t getPassSubpass(RenderPassHandle pass) const {
+    return passes[pass].subpass;
+  }
+
+  /**
+   * @return Render pass of a graphics pass that is not culled, once built
+   */
+  VkRenderPass getPassRenderPass(RenderPassHandle pass) const {
+    return groups[passes[pass].group].renderPass;
+  }
+
+  /**
+   * @return Barriers recorded before a group
+   */
+  const RenderBarrierBatch &getGroupBarriers(uint32_t group) const {
+    return groups[group].barriers;
+  }
+
+  /**
+   * @return Subpass dependencies of the render pass of a graphics group
+   */
+  const std::vector<VkSubpassDependency> &getGroupDependencies(uint32_t group) const {
+    return groups[group].dependencies;
+  }
+
+  /**
+   * @return Barriers recorded after the last group
+   */
+  const RenderBarrierBatch &getFinalBarriers() const {
+    return finalBarriers;
+  }
+
+  /**
+   * @return False if the resource is not a transient image used by a pass,
+   *         otherwise true and the groups it is used in
+   */
+  bool getLifetime(RenderResource resource, uint32_t &outFirstGroup, uint32_t &outLastGroup) const;
+
+  /**
+   * @return Bytes of device memory shared by the transient images
+   */
+  VkDeviceSize getTransientMemorySize() const {
+    return transientMemory.size;
+  }
+
+private:
+  typedef enum UseKindEnum {
+    USE_COLOR_ATTACHMENT,
+    USE_DEPTH_ATTACHMENT,
+    USE_INPUT_ATTACHMENT,
+    USE_IMAGE,
+    USE_BUFFER
+  } UseKind;
+
+  typedef struct UseStruct {
+    RenderResource resource;
+    UseKind kind;
+    VkImageLayout layout;
+    VkPipelineStageFlags stages;
+    VkAccessFlags access;
+    bool write;
+    // The previous contents are not needed
+    bool discard;
+    VkAttachmentLoadOp loadOp;
+  } Use;
+
+  typedef struct ResourceStruct {
+    std::string name;
+    bool image;
+    bool transient;
+    bool output;
+    RenderImageDesc desc;
+    VkImageLayout initialLayout;
+    VkPipelineStageFlags initialStages;
+    VkImageLayout finalLayout;
+    VkClearValue clearValue;
+
+    // Groups the resource is used in, UINT32_MAX if unused
+    uint32_t firstGroup;
+    uint32_t lastGroup;
+
+    // Set by build for transients, by setImage otherwise
+    VkImage handle;
+    VkImageView view;
+  } Resource;
+
+  typedef struct PassStruct {
+    std::string name;
+    RenderPassType type;
+    std::function<void(const RenderPassContext&)> record;
+    std::vector<Use> uses;
+    bool sideEffects;
+    bool secondaryContents;
+    // UINT32_MAX if culled
+    uint32_t group;
+    uint32_t subpass;
+  } Pass;
+
+  typedef struct AttachmentStruct {
+    RenderResource resource;
+    VkAttachmentLoadOp loadOp;
+    VkAttachmentStoreOp storeOp;
+    VkImageLayout initialLayout;
+    VkImageLayout finalLayout;
+    uint32_t firstSubpass;
+    uint32_t lastSubpass;
+  } Attachment;
+
+  typedef struct SubpassStruct {
+    std::vector<VkAttachmentReference> colors;
+    // attachment is VK_ATTACHMENT_UNUSED without depth
+    VkAttachmentReference depth;
+    std::vector<VkAttachmentReference> inputs;
+    std::vector<uint32_t> preserves;
+  } Subpass;
+
+  typedef struct GroupStruct {
+    std::vector<RenderPassHandle> passes;
+    bool graphics;
+    VkExtent2D extent;
+
+    // Graphics groups only, attachments indexed as in the framebuffer
+    std::vector<Attachment> attachments;
+    std::vector<Subpass> subpasses;
+    std::vector<VkSubpassDependency> dependencies;
+
+    RenderBarrierBatch barriers;
+
+    VkRenderPass renderPass;
+    // Framebuffers of the image views used so far
+    std::map<std::vector<VkImageView>, VkFramebuffer> framebuffers;
+  } Group;
+
+  // Access of a resource since its last write, while compiling
+  typedef struct ResourceStateStruct {
+    VkImageLayout layout;
+    VkPipelineStageFlags writeStages;
+    VkAccessFlags writeAccess;
+    VkPipelineStageFlags readStages;
+    // Made visible since the last write
+    VkPipelineStageFlags visibleStages;
+    VkAccessFlags visibleAccess;
+    uint32_t lastGroup;
+    uint32_t lastSubpass;
+  } ResourceState;
+
+  typedef struct DependencyStruct {
+    VkPipelineStageFlags srcStages;
+    VkAccessFlags srcAccess;
+    VkImageLayout oldLayout;
+    bool layoutChange;
+  } Dependency;
+
+  static bool isAttachment(UseKind kind) {
+    return kind == USE_COLOR_ATTACHMENT || kind == USE_DEPTH_ATTACHMENT || kind == USE_INPUT_ATTACHMENT;
+  }
+
+  /**
+   * @return Usage an image needs for a use
+   */
+  static VkImageUsageFlags getImageUsage(const Use &use);
+
+  RenderResource addResource(const std::string &name, bool image, const RenderImageDesc &desc);
+
+  /**
+   * Adds a use to a pass, merged with its previous use of the resource.
+   * @throw Error if the uses of the resource disagree on kind or layout
+   */
+  void addUse(RenderPassHandle pass, const Use &use);
+
+  /**
+   * @return For each pass, true if an output depends on it
+   */
+  std::vector<bool> cullPasses() const;
+
+  void groupPasses(const std::vector<bool> &kept);
+
+  /**
+   * Updates the state of a resource for a use.
+   * @param outDependency Set if the use must wait for previous accesses
+   * @return True if a dependency is needed
+   */
+  static bool trackUse(ResourceState &state, const Use &use, bool image, Dependency &outDependency);
+
+  /**
+   * Tracks the uses of an attachment within the render pass of a group.
+   */
+  void addAttachmentUse(Group &group, uint32_t groupIndex, uint32_t subpass, ResourceState &state, const Use &use);
+
+  /**
+   * Adds a dependency to a subpass, merged with the one of the same
+   * subpasses.
+   */
+  static void addSubpassDependency(Group &group, uint32_t srcSubpass, uint32_t dstSubpass, const Dependency &dependency, const Use &use);
+
+  static void addBarrier(RenderBarrierBatch &batch, const Dependency &dependency, const Use &use);
+
+  void computeBarriers();
+
+  void createTransients();
+
+  /**
+   * Destroys the framebuffers and transient images, keeping the render
+   * passes.
+   */
+  void destroyTransients();
+
+  void createRenderPass(Group &group);
+
+  VkFramebuffer getFramebuffer(Group &group);
+
+  void recordBarriers(VkCommandBuffer commandBuffer, const RenderBarrierBatch &batch) const;
+
+  std::vector<Resource> resources;
+  std::vector<Pass> passes;
+  std::vector<Group> groups;
+  RenderBarrierBatch finalBarriers;
+
+  VkDevice device;
+  MemoryAllocator *allocator;
+  // Shared by the transient images
+  Allocation transientMemory;
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <cstdint>
+
+/**
+ * Size of the blocks texels of a format are stored in, 1x1 for uncompressed
+ * formats.
+ */
+typedef struct TextureFormatInfoStruct {
+  uint32_t blockWidth;
+  uint32_t blockHeight;
+  // Bytes per block
+  uint32_t blockSize;
+  bool srgb;
+} TextureFormatInfo;
+
+typedef struct TextureLevelStruct {
+  uint32_t width;
+  uint32_t height;
+  // Range of the level in TextureData::data
+  size_t offset;
+  size_t size;
+} TextureLevel;
+
+/**
+ * Texels of a 2D texture and of its mip levels, ready to be copied to an
+ * image of the format.
+ */
+typedef struct TextureDataStruct {
+  VkFormat format;
+  uint32_t width;
+  uint32_t height;
+  // Largest first
+  std::vector<TextureLevel> levels;
+  std::vector<unsigned char> data;
+} TextureData;
+
+/**
+ * @return Number of levels of a full mip chain, down to 1x1
+ */
+uint32_t getMipLevelCount(uint32_t width, uint32_t height);
+
+/**
+ * Describes the RGBA8, BC1/3/4/5/7, ETC2 and ASTC formats.
+ * @return False if the format is not one of them
+ */
+bool getTextureFormatInfo(VkFormat format, TextureFormatInfo &outInfo);
+
+/**
+ * @return Bytes of a level of the given size
+ */
+size_t getTextureLevelSize(const TextureFormatInfo &info, uint32_t width, uint32_t height);
+
+/**
+ * Appends a level to a texture, aligned for copies to images.
+ */
+void addTextureLevel(TextureData &texture, uint32_t width, uint32_t height, const unsigned char *texels, size_t size);
+
+/**
+ * Halves an RGBA8 image with a 2x2 box filter. Odd dimensions round down,
+ * the last row or column is then averaged with itself.
+ * @param srgb If true, colors are averaged in linear space, alpha never is
+ * @param out Receives the next level, of max(width / 2, 1) by
+ *        max(height / 2, 1) pixels
+ */
+void downsampleRgba8(
+  const unsigned char *pixels,
+  uint32_t width,
+  uint32_t height,
+  bool srgb,
+  std::vector<unsigned char> &out);
+
+/**
+ * Completes the mip chain of an RGBA8 texture from its last level.
+ * @throw Error if the format is not RGBA8
+ */
+void appendMipChain(TextureData &texture);
+
+/**
+ * @return True if decodeTexture can decode the format: BC1, BC3, BC4 and
+ *         BC5 unsigned, ETC2 RGB8 and RGBA8
+ */
+bool canDecodeTexture(VkFormat format);
+
+/**
+ * Decodes a block compressed texture on the host, for devices that cannot
+ * sample its format.
+ * @return Texture with the same levels, as R8G8B8A8_SRGB if the format is
+ *         sRGB and R8G8B8A8_UNORM otherwise
+ * @throw Error if the format cannot be decoded
+ */
+TextureData decodeTexture(const TextureData &texture);
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <atomic>
+
+#include <memory_allocator.h>
+
+/**
+ * Range of the ring written by the host for the frame being recorded.
+ */
+typedef struct UniformAllocationStruct {
+  // Host address to write the uniforms to
+  void *data;
+  // Offset of the range in the buffer
+  uint32_t offset;
+} UniformAllocation;
+
+/**
+ * @return Bytes between the regions of consecutive frames, frameSize
+ *         rounded up so that every region starts aligned
+ */
+VkDeviceSize getUniformRegionSize(VkDeviceSize frameSize, VkDeviceSize alignment);
+
+/**
+ * @return Bytes an allocation takes in a region, size rounded up so that
+ *         the next allocation starts aligned
+ */
+VkDeviceSize getUniformAllocationSize(VkDeviceSize size, VkDeviceSize alignment);
+
+/**
+ * One persistently mapped, host coherent buffer split into a region per
+ * frame in flight. Uniforms of a frame are sub-allocated linearly from its
+ * region, bound once with a dynamic offset and addressed relative to it, so
+ * writing them costs a memcpy regardless of the number of objects.
+ *
+ * A region is only reused once the fence of its frame has been waited on.
+ */
+class UniformRing {
+public:
+  UniformRing();
+
+  /**
+   * @param frameSize Bytes available to each frame, rounded up to the
+   *        alignment
+   * @param frameCount Number of frames in flight
+   * @param alignment Alignment of regions and allocations, at least the
+   *        one storage buffer dynamic offsets need on the device
+   * @throw Error if the regions are empty or too large for dynamic offsets
+   */
+  void init(
+    VkDevice device,
+    MemoryAllocator *allocator,
+    VkDeviceSize frameSize,
+    uint32_t frameCount,
+    VkDeviceSize alignment);
+
+  void destroy();
+
+  /**
+   * Starts sub-allocating from the region of a frame, discarding its content.
+   */
+  void beginFrame(uint32_t frame);
+
+  /**
+   * Thread safe.
+   * @param size Bytes to allocate
+   * @throw Error if the region of the frame is exhausted
+   */
+  UniformAllocation allocate(VkDeviceSize size);
+
+  VkBuffer getBuffer() const {
+    return buffer;
+  }
+
+  /**
+   * @return Offset of the region of the current frame, to bind it with
+   */
+  VkDeviceSize getFrameOffset() const {
+    return frameBegin;
+  }
+
+  /**
+   * @return Bytes of each region, rounded up to the alignment
+   */
+  VkDeviceSize getFrameSize() const {
+    return frameSize;
+  }
+
+private:
+  VkDevice device;
+  MemoryAllocator *allocator;
+
+  VkBuffer buffer;
+  Allocation memory;
+
+  VkDeviceSize frameSize;
+  VkDeviceSize alignment;
+
+  // Bounds of the region of the current frame
+  VkDeviceSize frameBegin;
+  std::atomic<VkDeviceSize> head;
+};
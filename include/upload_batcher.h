@@ -0,0 +1,234 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <deque>
+#include <mutex>
+
+#include <memory_allocator.h>
+
+/**
+ * Identifies a batch of uploads. Tickets grow monotonically, a ticket is
+ * complete once every batch up to it has been submitted and executed.
+ */
+typedef uint64_t UploadTicket;
+
+/**
+ * Time the device spent on the copies of a batch.
+ */
+typedef struct UploadBatchStatsStruct {
+  UploadTicket ticket;
+  // Bytes staged by the batch
+  VkDeviceSize bytes;
+  // False if the transfer queue has no timestamps or could not time the batch
+  bool timed;
+  double milliseconds;
+} UploadBatchStats;
+
+/**
+ * Records copies and barriers of many uploads into a single command buffer
+ * and submits them with a fence, instead of waiting for the queue to be idle
+ * after each copy. Uploads accumulate in the batch being recorded until it
+ * is flushed, typically once per frame. Staging buffers are released once
+ * their batch completes.
+ *
+ * Copies run on a transfer queue. When it belongs to another family than the
+ * graphics queue, each batch also has a graphics command buffer acquiring
+ * ownership of the uploaded resources. It is submitted by acquire() once the
+ * copies completed, so that the graphics queue never waits for them.
+ *
+ * Batches are timed with two timestamp queries if the transfer queue
+ * supports them. Queries can only be reset on a graphics or compute queue,
+ * so with a dedicated transfer queue they are reset by the acquire of the
+ * batch, and a batch is timed from its second use on.
+ */
+class UploadBatcher {
+public:
+  UploadBatcher();
+
+  /**
+   * @param transferQueue Queue copies are submitted to
+   * @param transferFamily Family of the transfer queue
+   * @param graphicsQueue Queue the uploaded resources are used on
+   * @param graphicsFamily Family of the graphics queue
+   * @param timestampPeriod Nanoseconds per timestamp tick
+   * @param timestampValidBits Valid bits of the timestamps of the transfer
+   *        queue, zero if batches are not timed
+   */
+  void init(
+    VkDevice device,
+    VkQueue transferQueue,
+    uint32_t transferFamily,
+    VkQueue graphicsQueue,
+    uint32_t graphicsFamily,
+    MemoryAllocator *allocator,
+    float timestampPeriod,
+    uint32_t timestampValidBits);
+
+  /**
+   * Waits for pending batches and frees all resources.
+   */
+  void destroy();
+
+  /**
+   * @return Transfer command buffer of the batch being recorded, begun if needed
+   */
+  VkCommandBuffer getCommandBuffer();
+
+  /**
+   * @return Graphics command buffer of the batch being recorded, executed
+   *         after the transfer one. Same as getCommandBuffer if both queues
+   *         are of the same family.
+   */
+  VkCommandBuffer getGraphicsCommandBuffer();
+
+  /**
+   * Makes the copies to a buffer visible to a stage of the graphics queue,
+   * transferring its ownership if needed.
+   */
+  void releaseBuffer(VkBuffer buffer, VkAccessFlags dstAccessMask, VkPipelineStageFlags dstStageMask);
+
+  /**
+   * Makes the copies to an image visible to a stage of the graphics queue,
+   * transferring its ownership if needed, and changes its layout.
+   */
+  void releaseImage(
+    VkImage image,
+    const VkImageSubresourceRange &range,
+    VkImageLayout oldLayout,
+    VkImageLayout newLayout,
+    VkAccessFlags dstAccessMask,
+    VkPipelineStageFlags dstStageMask);
+
+  /**
+   * Creates a staging buffer holding a copy of data, owned by the batch
+   * being recorded.
+   * @return Buffer to copy from
+   */
+  VkBuffer stage(const void *data, VkDeviceSize size);
+
+  /**
+   * @return Ticket of the batch being recorded, begun if needed, to hand
+   *         out for the uploads recorded into it
+   */
+  UploadTicket getRecordingTicket();
+
+  /**
+   * Submits the batch being recorded, if any.
+   * @return Ticket of the last submitted batch
+   */
+  UploadTicket flush();
+
+  /**
+   * Submits the ownership acquires of the batches whose copies completed.
+   * Must be called from the thread submitting to the graphics queue.
+   */
+  void acquire();
+
+  /**
+   * @return Ticket up to which the uploads are visible to the graphics
+   *         queue submissions made from now on
+   */
+  UploadTicket getLastAcquired();
+
+  /**
+   * @return True if the batch of the ticket and all previous ones completed
+   */
+  bool isComplete(UploadTicket ticket);
+
+  /**
+   * Blocks until the batch of the ticket completed, flushing it if needed.
+   */
+  void wait(UploadTicket ticket);
+
+  /**
+   * Releases the resources of completed batches.
+   */
+  void collect();
+
+  /**
+   * @return Stats of the last batch whose copies completed
+   */
+  UploadBatchStats getLastBatchStats();
+
+private:
+  typedef struct StagingBufferStruct {
+    VkBuffer buffer;
+    Allocation memory;
+  } StagingBuffer;
+
+  typedef struct BatchStruct {
+    VkCommandBuffer commandBuffer;
+    // Null when the queues are of the same family
+    VkCommandBuffer graphicsCommandBuffer;
+    // Signaled by the copies, and by the acquire if any
+    VkFence fence;
+    VkFence acquireFence;
+    bool acquired;
+    UploadTicket ticket;
+    std::vector<StagingBuffer> stagingBuffers;
+    VkDeviceSize bytes;
+    // Null if the transfer queue has no timestamps
+    VkQueryPool queryPool;
+    // Set once the queries are reset for the next use of the batch
+    bool queriesReset;
+    bool timed;
+  } Batch;
+
+  /**
+   * Must be called with the mutex held.
+   */
+  void collectLocked();
+
+  /**
+   * Must be called with the mutex held.
+   * @param wait Waits for the copies of the batches up to the ticket
+   */
+  void acquireLocked(UploadTicket ticket, bool wait);
+
+  /**
+   * Reads the timestamps of a batch whose copies completed. Must be called
+   * with the mutex held.
+   */
+  void readStatsLocked(const Batch &batch);
+
+  /**
+   * Reuses a completed batch or creates a new one.
+   */
+  Batch acquireBatch();
+
+  /**
+   * Begins a batch if none is being recorded. Must be called with the mutex held.
+   */
+  void beginLocked();
+
+  /**
+   * @return True if ownership must be transferred between the queues
+   */
+  bool separateQueues() const;
+
+  VkDevice device;
+  VkQueue transferQueue;
+  VkQueue graphicsQueue;
+  uint32_t transferFamily;
+  uint32_t graphicsFamily;
+  MemoryAllocator *allocator;
+  float timestampPeriod;
+  uint32_t timestampValidBits;
+
+  VkCommandPool commandPool;
+  VkCommandPool graphicsCommandPool;
+
+  bool recording;
+  Batch current;
+
+  std::deque<Batch> pending;
+  std::vector<Batch> available;
+
+  UploadTicket lastSubmitted;
+  UploadTicket lastAcquired;
+  UploadTicket lastCompleted;
+  UploadBatchStats lastStats;
+
+  std::mutex mutex;
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <array>
+#include <cstddef>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+/**
+ * Vertex as built on the host. It is encoded to the VertexLayout selected
+ * for the device (see vertex_layout.h) when uploaded.
+ */
+typedef struct VertexStruct {
+  glm::vec3 pos;
+  glm::vec3 color;
+  glm::vec2 texCoord;
+  // Zero if the source has no normals
+  glm::vec3 normal;
+} Vertex;
+
+/**
+ * Per instance data, streamed to binding 1 of the vertex shader.
+ */
+typedef struct InstanceStruct {
+  glm::mat4 model;
+  // Material drawn with, in bindless mode
+  uint32_t material;
+  // First matrix of the uniforms drawn with, from the start of the uniforms
+  // of the frame
+  uint32_t uniforms;
+  uint32_t padding[2];
+
+  static VkVertexInputBindingDescription getBindingDescription() {
+    VkVertexInputBindingDescription bindingDescription = {};
+    bindingDescription.binding = 1;
+    bindingDescription.stride = sizeof(InstanceStruct);
+    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+    return bindingDescription;
+  }
+
+  /**
+   * The model matrix takes one location per column, starting at 4. Material
+   * and uniforms follow at location 8.
+   */
+  static std::array<VkVertexInputAttributeDescription, 5> getAttributeDescriptions() {
+    std::array<VkVertexInputAttributeDescription, 5> attributeDescriptions = {};
+
+    for (uint32_t i = 0; i < 4; i++) {
+      attributeDescriptions[i].binding = 1;
+      attributeDescriptions[i].location = 4 + i;
+      attributeDescriptions[i].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+      attributeDescriptions[i].offset = offsetof(InstanceStruct, model) + i * sizeof(glm::vec4);
+    }
+
+    attributeDescriptions[4].binding = 1;
+    attributeDescriptions[4].location = 8;
+    attributeDescriptions[4].format = VK_FORMAT_R32G32_UINT;
+    attributeDescriptions[4].offset = offsetof(InstanceStruct, material);
+
+    return attributeDescriptions;
+  }
+} Instance;
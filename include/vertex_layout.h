@@ -0,0 +1,108 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <cstdint>
+
+#include <vertex.h>
+#include <mesh.h>
+
+typedef enum VertexPositionFormatEnum {
+  VERTEX_POSITION_FLOAT32,
+  // Normalized within the bounds of the mesh, see VertexDequantization
+  VERTEX_POSITION_UNORM16
+} VertexPositionFormat;
+
+typedef enum VertexColorFormatEnum {
+  VERTEX_COLOR_FLOAT32,
+  VERTEX_COLOR_UNORM8
+} VertexColorFormat;
+
+typedef enum VertexTexCoordFormatEnum {
+  VERTEX_TEXCOORD_FLOAT32,
+  VERTEX_TEXCOORD_FLOAT16,
+  // Coordinates are clamped to [0, 1], use FLOAT16 for repeated textures
+  VERTEX_TEXCOORD_UNORM16
+} VertexTexCoordFormat;
+
+typedef enum VertexNormalFormatEnum {
+  VERTEX_NORMAL_FLOAT32,
+  // Octahedral encoding, decoded by the vertex shader
+  VERTEX_NORMAL_OCT16
+} VertexNormalFormat;
+
+/**
+ * Maps quantized positions back to object space: the vertex shader computes
+ * position * scale + offset. Pushed as vertex shader constants per mesh.
+ */
+typedef struct VertexDequantizationStruct {
+  glm::vec4 offset;
+  glm::vec4 scale;
+} VertexDequantization;
+
+/**
+ * Format of each attribute of the vertices stored on the device, on
+ * binding 0. Attributes are packed in the order of Vertex: position
+ * (location 0), color (1), texCoord (2) and normal (3).
+ */
+typedef struct VertexLayoutStruct {
+  VertexPositionFormat position;
+  VertexColorFormat color;
+  VertexTexCoordFormat texCoord;
+  VertexNormalFormat normal;
+
+  /**
+   * @return Layout storing Vertex as is, 44 bytes per vertex
+   */
+  static VertexLayoutStruct uncompressed();
+
+  /**
+   * @return Layout with quantized attributes, 20 bytes per vertex
+   */
+  static VertexLayoutStruct quantized();
+
+  uint32_t getStride() const;
+
+  VkVertexInputBindingDescription getBindingDescription() const;
+
+  std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions() const;
+
+  /**
+   * @return True if the vertex shader must decode octahedral normals
+   */
+  bool hasOctahedralNormals() const {
+    return normal == VERTEX_NORMAL_OCT16;
+  }
+
+  /**
+   * @param bounds Bounds of the mesh the vertices belong to
+   */
+  VertexDequantization getDequantization(const MeshBounds &bounds) const;
+
+  /**
+   * Encodes vertices to this layout.
+   * @param bounds Bounds of the vertices, positions are quantized within them
+   * @param out Receives getStride() * vertexCount bytes
+   */
+  void encode(const Vertex *vertices, size_t vertexCount, const MeshBounds &bounds, void *out) const;
+
+  bool operator==(const VertexLayoutStruct &other) const {
+    return position == other.position && color == other.color && texCoord == other.texCoord && normal == other.normal;
+  }
+} VertexLayout;
+
+/**
+ * @return Half precision bits of a float, rounded to nearest
+ */
+uint16_t packHalf(float value);
+
+/**
+ * Octahedral encoding of a unit vector, as two signed normalized 16 bit
+ * values. A zero vector encodes to +Z.
+ */
+void packOctahedral(const glm::vec3 &normal, int16_t out[2]);
+
+/**
+ * @return Unit vector of an octahedral encoding
+ */
+glm::vec3 unpackOctahedral(const int16_t encoded[2]);
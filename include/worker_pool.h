@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Fixed set of threads running batches of independent tasks. The thread
+ * submitting a batch takes part in it and returns once all its tasks are
+ * done, so a pool without threads runs tasks inline.
+ *
+ * Tasks are picked in order from a shared counter: each task runs exactly
+ * once, on any thread.
+ */
+class WorkerPool {
+public:
+  WorkerPool();
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool &operator=(const WorkerPool&) = delete;
+
+  /**
+   * Starts the threads, replacing any running ones.
+   * @param threadCount Threads besides the one submitting batches
+   */
+  void start(uint32_t threadCount);
+
+  /**
+   * Waits for the threads to exit.
+   */
+  void stop();
+
+  /**
+   * @return Threads running tasks, including the one submitting batches
+   */
+  uint32_t getWorkerCount() const {
+    return static_cast<uint32_t>(threads.size()) + 1;
+  }
+
+  /**
+   * Runs task(i) for i in [0, taskCount). Not reentrant.
+   * @throw Rethrows the first exception thrown by a task, once all are done
+   */
+  void run(uint32_t taskCount, const std::function<void(uint32_t)> &task);
+
+private:
+  /**
+   * @param lastBatch Batch submitted before the thread started, which it
+   *        does not take part in
+   */
+  void workerLoop(uint64_t lastBatch);
+
+  /**
+   * Runs tasks of the current batch until none is left.
+   */
+  void runTasks();
+
+  std::vector<std::thread> threads;
+
+  std::mutex mutex;
+  std::condition_variable batchStarted;
+  std::condition_variable batchDone;
+
+  // Current batch
+  const std::function<void(uint32_t)> *task;
+  uint32_t taskCount;
+  std::atomic<uint32_t> nextTask;
+  // Threads still running tasks of the batch
+  uint32_t busyThreads;
+  uint64_t batch;
+  std::exception_ptr error;
+
+  bool stopping;
+};
@@ -1,9 +1,17 @@
 #include <cacus.h>
+#include <mesh.h>
+#include <mesh_file.h>
+#include <vertex_layout.h>
+#include <texture.h>
+#include <ktx2.h>
+#include <pipeline_cache.h>
 
 #include <set>
 #include <cstring>
 #include <stdexcept>
 #include <algorithm>
+#include <cmath>
+#include <thread>
 
 #ifdef NDEBUG
     const bool enableValidationLayers = false;
@@ -19,42 +27,131 @@ static const std::vector<const char*> deviceExtensions = {
     VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
 
-static const int MAX_FRAMES_IN_FLIGHT = 2;
+static const uint32_t DEFAULT_FRAMES_IN_FLIGHT = 2;
+
+// Uniform bytes available to each frame in flight by default
+static const VkDeviceSize DEFAULT_UNIFORM_RING_SIZE = 1024 * 1024;
+
+// The vertex shader reads uniforms as an array of matrices, instances
+// address theirs by index
+static const VkDeviceSize UNIFORM_ROW_SIZE = sizeof(glm::mat4);
+
+// Instances the per frame instance buffers can hold initially
+static const uint32_t MIN_INSTANCE_CAPACITY = 1024;
+
+// Invocations per workgroup of the culling shader (local_size_x)
+static const uint32_t CULL_WORKGROUP_SIZE = 64;
+
+// Draws worth handing to another recording thread
+static const uint32_t MIN_DRAWS_PER_RECORDING_TASK = 256;
+
+// Threads recording draws by default, besides the one calling draw()
+static const uint32_t MAX_DEFAULT_RECORDING_THREADS = 7;
+
+// File the pipeline cache is saved to, relative to the working directory
+static const char *DEFAULT_PIPELINE_CACHE_PATH = "pipeline_cache.bin";
+
+// Format of the offscreen render targets in headless mode
+static const VkFormat OFFSCREEN_FORMAT = VK_FORMAT_R8G8B8A8_SRGB;
+
+// Size of the bindless texture array, lowered to the limits of the device
+static const uint32_t MAX_BINDLESS_TEXTURES = 4096;
+
+// Materials the bindless material buffer holds
+static const uint32_t MAX_MATERIALS = 4096;
+
+// Uniform offset of meshes drawn with the uniforms of setTransform
+static const uint32_t NO_MESH_UNIFORMS = UINT32_MAX;
+
+FramePolicy FramePolicy::balanced() {
+  return { DEFAULT_FRAMES_IN_FLIGHT, 1, { VK_PRESENT_MODE_MAILBOX_KHR } };
+}
+
+FramePolicy FramePolicy::lowLatency() {
+  return { 1, 0, { VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR } };
+}
+
+FramePolicy FramePolicy::throughput() {
+  return { MAX_FRAMES_IN_FLIGHT, 1, { VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR } };
+}
+
+FramePolicy FramePolicy::powerSaving() {
+  return { DEFAULT_FRAMES_IN_FLIGHT, 0, { VK_PRESENT_MODE_FIFO_KHR } };
+}
 
 Cacus::Cacus(uint32_t width, uint32_t height) : Cacus(width, height, {}, 0) {}
 
 Cacus::Cacus(uint32_t width, uint32_t height, const char **extensionNames, size_t extensionCount) :
   surface(VK_NULL_HANDLE),
+  swapChain(VK_NULL_HANDLE),
   physicalDevice(VK_NULL_HANDLE),
   initialized(false),
+  headless(false),
   width(width),
   height(height),
-  currentFrame(0)
+  framePolicy(FramePolicy::balanced()),
+  frameSlots(MAX_FRAMES_IN_FLIGHT),
+  maxFramesInFlight(DEFAULT_FRAMES_IN_FLIGHT),
+  currentFrame(0),
+  lastFrame(SIZE_MAX),
+  frameBegun(false),
+  frameNumber(0),
+  uniformRingSize(DEFAULT_UNIFORM_RING_SIZE),
+  gpuProfiling(false),
+  swapChainPresentMode(VK_PRESENT_MODE_FIFO_KHR),
+  pipelineCache(VK_NULL_HANDLE),
+  pipelineCachePath(DEFAULT_PIPELINE_CACHE_PATH),
+  recordingThreads(std::min(std::max(std::thread::hardware_concurrency(), 1u) - 1, MAX_DEFAULT_RECORDING_THREADS)),
+  gpuCulling(false),
+  cullDescriptorSetLayout(VK_NULL_HANDLE),
+  cullPipelineLayout(VK_NULL_HANDLE),
+  cullPipeline(VK_NULL_HANDLE),
+  cmdDrawIndexedIndirectCount(nullptr),
+  multiDrawIndirect(false),
+  minStorageBufferOffsetAlignment(1),
+  textureSampler(VK_NULL_HANDLE),
+  bindless(false),
+  bindlessTextureCapacity(0),
+  bindlessSetLayout(VK_NULL_HANDLE),
+  bindlessDescriptorPool(VK_NULL_HANDLE),
+  bindlessDescriptorSet(VK_NULL_HANDLE),
+  materialBuffer(VK_NULL_HANDLE),
+  materialCount(0),
+  backbuffer(0),
+  mainPass(0)
 {
   ubo = {};
+  lodThreshold = 1.0f;
+  vertexLayout = VertexLayout::uncompressed();
 
   // Check if required extensions are available
-  if (extensionCount > 0) {
-    uint32_t vkCount = 0;
-    vkEnumerateInstanceExtensionProperties(nullptr, &vkCount, nullptr);
-    std::vector<VkExtensionProperties> vkExtensions(vkCount);
-    vkEnumerateInstanceExtensionProperties(nullptr, &vkCount, vkExtensions.data());
-
-    for (size_t i = 0; i < extensionCount; ++i) {
-      bool found = false;
-      for (const VkExtensionProperties &properties : vkExtensions) {
-        if (strcmp(extensionNames[i], properties.extensionName) == 0) {
-          found = true;
-          break;
-        }
-      }
-
-      if (!found) {
-        throw std::runtime_error("Extension not supported.");
-      }
+  uint32_t vkCount = 0;
+  vkEnumerateInstanceExtensionProperties(nullptr, &vkCount, nullptr);
+  std::vector<VkExtensionProperties> vkExtensions(vkCount);
+  vkEnumerateInstanceExtensionProperties(nullptr, &vkCount, vkExtensions.data());
+
+  const auto isInstanceExtensionSupported = [&vkExtensions](const char *name) {
+    for (const VkExtensionProperties &properties : vkExtensions) {
+      if (strcmp(name, properties.extensionName) == 0)
+        return true;
     }
+    return false;
+  };
+
+  std::vector<const char*> enabledExtensions(extensionNames, extensionNames + extensionCount);
+  for (const char *name : enabledExtensions) {
+    if (!isInstanceExtensionSupported(name))
+      throw std::runtime_error("Extension not supported.");
   }
 
+  // Needed to query the descriptor indexing support of devices
+  const char *properties2 = VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME;
+  const bool properties2Requested = std::any_of(
+    enabledExtensions.begin(), enabledExtensions.end(),
+    [properties2](const char *name) { return strcmp(name, properties2) == 0; });
+  if (!properties2Requested && isInstanceExtensionSupported(properties2))
+    enabledExtensions.push_back(properties2);
+
   // Check validation layers
   if (enableValidationLayers && !checkValidationLayersSupport())
     throw std::runtime_error("Validation layer not available.");
@@ -74,9 +171,9 @@ Cacus::Cacus(uint32_t width, uint32_t height, const char **extensionNames, size_
   createInfo.pApplicationInfo = &appInfo;
 
 
-  createInfo.enabledExtensionCount = extensionCount;
-  if (extensionCount > 0)
-    createInfo.ppEnabledExtensionNames = extensionNames;
+  createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+  if (!enabledExtensions.empty())
+    createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
   if (enableValidationLayers) {
     createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -90,45 +187,92 @@ Cacus::Cacus(uint32_t width, uint32_t height, const char **extensionNames, size_
 }
 
 Cacus::~Cacus() {
+  // Nothing but the instance exists before setup
+  if (!initialized) {
+    if (surface != VK_NULL_HANDLE)
+      vkDestroySurfaceKHR(instance, surface, nullptr);
+    vkDestroyInstance(instance, nullptr);
+    return;
+  }
+
   vkDeviceWaitIdle(device);
 
+  frameGraph.destroy();
   cleanupSwapChain();
+  if (!headless)
+    vkDestroySwapchainKHR(device, swapChain, nullptr);
+
+  vkFreeCommandBuffers(device, commandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+
+  workers.stop();
+  for (const RecordingFrame &frame : recordingFrames) {
+    for (VkCommandPool pool : frame.commandPools)
+      vkDestroyCommandPool(device, pool, nullptr);
+  }
+
+  vkDestroyPipeline(device, graphicsPipeline, nullptr);
+  vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
   
   vkDestroySampler(device, textureSampler, nullptr);
-  vkDestroyImageView(device, textureImageView, nullptr);
+  for (Texture &texture : textures) {
+    vkDestroyImageView(device, texture.view, nullptr);
+    vkDestroyImage(device, texture.image, nullptr);
+    allocator.free(texture.memory);
+  }
 
-  vkDestroyImage(device, textureImage, nullptr);
-  vkFreeMemory(device, textureImageMemory, nullptr);
+  if (bindless) {
+    vkDestroyDescriptorPool(device, bindlessDescriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(device, bindlessSetLayout, nullptr);
+    vkDestroyBuffer(device, materialBuffer, nullptr);
+    allocator.free(materialBufferMemory);
+  }
 
   vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 
-  vkDestroyBuffer(device, indexBuffer, nullptr);
-  vkFreeMemory(device, indexBufferMemory, nullptr);
+  for (MeshHandle mesh = 0; mesh < meshes.size(); mesh++) {
+    if (meshes[mesh].vertexBuffer != VK_NULL_HANDLE)
+      destroyMesh(mesh);
+  }
+  // The device is idle
+  frameNumber += maxFramesInFlight;
+  releaseRetiredMeshes();
+
+  for (size_t i = 0; i < instanceBuffers.size(); i++) {
+    vkDestroyBuffer(device, instanceBuffers[i], nullptr);
+    allocator.free(instanceBuffersMemory[i]);
+  }
 
-  vkDestroyBuffer(device, vertexBuffer, nullptr);
-  vkFreeMemory(device, vertexBufferMemory, nullptr);
+  destroyCulling();
 
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+  for (size_t i = 0; i < inFlightFences.size(); i++) {
     vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
     vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
     vkDestroyFence(device, inFlightFences[i], nullptr);
   }
 
   vkDestroyCommandPool(device, commandPool, nullptr);
+
+  destroyPipelineCache();
+
+  uniforms.destroy();
+  descriptors.destroy();
+  profiler.destroy();
+  uploader.destroy();
+  allocator.destroy();
   vkDestroyDevice(device, nullptr);
 
   vkDestroySurfaceKHR(instance, surface, nullptr);
   vkDestroyInstance(instance, nullptr);
 }
 
-void Cacus::createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory) {
+void Cacus::createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, Allocation& imageMemory) {
   VkImageCreateInfo imageInfo = {};
   imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
   imageInfo.imageType = VK_IMAGE_TYPE_2D;
   imageInfo.extent.width = width;
   imageInfo.extent.height = height;
   imageInfo.extent.depth = 1;
-  imageInfo.mipLevels = 1;
+  imageInfo.mipLevels = mipLevels;
   imageInfo.arrayLayers = 1;
   imageInfo.format = format;
   imageInfo.tiling = tiling;
@@ -143,16 +287,9 @@ void Cacus::createImage(uint32_t width, uint32_t height, VkFormat format, VkImag
   VkMemoryRequirements memRequirements;
   vkGetImageMemoryRequirements(device, image, &memRequirements);
 
-  VkMemoryAllocateInfo allocInfo = {};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+  imageMemory = allocator.allocate(memRequirements, properties, tiling == VK_IMAGE_TILING_LINEAR);
 
-  if (vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-      throw std::runtime_error("failed to allocate image memory!");
-  }
-
-  vkBindImageMemory(device, image, imageMemory, 0);
+  vkBindImageMemory(device, image, imageMemory.memory, imageMemory.offset);
 }
 
 VkCommandBuffer Cacus::beginSingleTimeCommands() {
@@ -188,15 +325,13 @@ void Cacus::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
   vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
 }
 
-void Cacus::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) {
-  VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
+void Cacus::copyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize bufferOffset, VkImage image, uint32_t width, uint32_t height, uint32_t mipLevel) {
   VkBufferImageCopy region = {};
-  region.bufferOffset = 0;
+  region.bufferOffset = bufferOffset;
   region.bufferRowLength = 0;
   region.bufferImageHeight = 0;
   region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  region.imageSubresource.mipLevel = 0;
+  region.imageSubresource.mipLevel = mipLevel;
   region.imageSubresource.baseArrayLayer = 0;
   region.imageSubresource.layerCount = 1;
   region.imageOffset = {0, 0, 0};
@@ -207,12 +342,9 @@ void Cacus::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, ui
   };
 
   vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-  endSingleTimeCommands(commandBuffer);
 }
 
-void Cacus::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout) {
-  VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
+void Cacus::transitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t baseMipLevel, uint32_t levelCount) {
   VkImageMemoryBarrier barrier = {};
   barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
   barrier.oldLayout = oldLayout;
@@ -221,8 +353,8 @@ void Cacus::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout
   barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
   barrier.image = image;
   barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  barrier.subresourceRange.baseMipLevel = 0;
-  barrier.subresourceRange.levelCount = 1;
+  barrier.subresourceRange.baseMipLevel = baseMipLevel;
+  barrier.subresourceRange.levelCount = levelCount;
   barrier.subresourceRange.baseArrayLayer = 0;
   barrier.subresourceRange.layerCount = 1;
 
@@ -239,6 +371,19 @@ void Cacus::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout
       barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
       barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
+      sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+      destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  } else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+      // A mip level written by a blit becomes the source of the next one
+      barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+      sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+      destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+  } else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+      barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+      barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
       sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
       destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
   } else {
@@ -253,11 +398,9 @@ void Cacus::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout
       0, nullptr,
       1, &barrier
   );
-
-  endSingleTimeCommands(commandBuffer);
 }
 
-VkImageView Cacus::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags) {
+VkImageView Cacus::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels) {
   VkImageViewCreateInfo viewInfo = {};
   viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
   viewInfo.image = image;
@@ -265,7 +408,7 @@ VkImageView Cacus::createImageView(VkImage image, VkFormat format, VkImageAspect
   viewInfo.format = format;
   viewInfo.subresourceRange.aspectMask = aspectFlags;
   viewInfo.subresourceRange.baseMipLevel = 0;
-  viewInfo.subresourceRange.levelCount = 1;
+  viewInfo.subresourceRange.levelCount = mipLevels;
   viewInfo.subresourceRange.baseArrayLayer = 0;
   viewInfo.subresourceRange.layerCount = 1;
 
@@ -276,86 +419,213 @@ VkImageView Cacus::createImageView(VkImage image, VkFormat format, VkImageAspect
   return imageView;
 }
 
-void Cacus::loadTexture(const int texWidth, const int texHeight, const int texChannels, const unsigned char *pixels) {
-  VkDeviceSize imageSize = texWidth * texHeight * 4;
+bool Cacus::supportsLinearBlit(VkFormat format) const {
+  VkFormatProperties properties;
+  vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+
+  const VkFormatFeatureFlags features =
+    VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+  return (properties.optimalTilingFeatures & features) == features;
+}
+
+void Cacus::generateMipmaps(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels) {
+  if (mipLevels > 1)
+    transitionImageLayout(commandBuffer, image, format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, mipLevels - 1);
+
+  int32_t levelWidth = static_cast<int32_t>(width);
+  int32_t levelHeight = static_cast<int32_t>(height);
+  for (uint32_t level = 1; level < mipLevels; level++) {
+    const int32_t nextWidth = std::max(levelWidth / 2, 1);
+    const int32_t nextHeight = std::max(levelHeight / 2, 1);
+
+    VkImageBlit blit = {};
+    blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    blit.srcSubresource.mipLevel = level - 1;
+    blit.srcSubresource.baseArrayLayer = 0;
+    blit.srcSubresource.layerCount = 1;
+    blit.srcOffsets[0] = {0, 0, 0};
+    blit.srcOffsets[1] = {levelWidth, levelHeight, 1};
+    blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    blit.dstSubresource.mipLevel = level;
+    blit.dstSubresource.baseArrayLayer = 0;
+    blit.dstSubresource.layerCount = 1;
+    blit.dstOffsets[0] = {0, 0, 0};
+    blit.dstOffsets[1] = {nextWidth, nextHeight, 1};
+
+    vkCmdBlitImage(
+      commandBuffer,
+      image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+      image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      1, &blit,
+      VK_FILTER_LINEAR);
+
+    transitionImageLayout(commandBuffer, image, format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, level, 1);
+
+    levelWidth = nextWidth;
+    levelHeight = nextHeight;
+  }
+
+  transitionImageLayout(commandBuffer, image, format, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0, mipLevels);
+}
+
+bool Cacus::supportsSampledFormat(VkFormat format) const {
+  VkFormatProperties properties;
+  vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+
+  const VkFormatFeatureFlags features =
+    VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+  return (properties.optimalTilingFeatures & features) == features;
+}
 
+UploadTicket Cacus::loadTexture(const int texWidth, const int texHeight, const int texChannels, const unsigned char *pixels, TextureHandle *outTexture) {
   if (!pixels)
     throw std::runtime_error("failed to load texture image!");
 
-  VkBuffer stagingBuffer;
-  VkDeviceMemory stagingBufferMemory;
-  createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+  TextureData texture = {};
+  texture.format = VK_FORMAT_R8G8B8A8_SRGB;
+  texture.width = static_cast<uint32_t>(texWidth);
+  texture.height = static_cast<uint32_t>(texHeight);
+  addTextureLevel(texture, texture.width, texture.height, pixels, size_t(texWidth) * texHeight * 4);
 
-  void* data;
-  vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &data);
-      memcpy(data, pixels, static_cast<size_t>(imageSize));
-  vkUnmapMemory(device, stagingBufferMemory);
+  return uploadTexture(texture, outTexture);
+}
 
-  createImage(texWidth, texHeight, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage, textureImageMemory);
+UploadTicket Cacus::loadTexture(const std::string &path, TextureHandle *outTexture) {
+  CACUS_PROFILE_SCOPE("loadTexture");
+  return uploadTexture(readKtx2(path), outTexture);
+}
 
-  transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-  copyBufferToImage(stagingBuffer, textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
-  transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+UploadTicket Cacus::uploadTexture(TextureData texture, TextureHandle *outTexture) {
+  CACUS_PROFILE_SCOPE("uploadTexture");
+  if (bindless && textures.size() >= bindlessTextureCapacity)
+    throw std::runtime_error("too many textures!");
+
+  // Compressed levels are uploaded as they are, and only decoded on the host
+  // if the device cannot sample them
+  if (!supportsSampledFormat(texture.format)) {
+    if (!canDecodeTexture(texture.format))
+      throw std::runtime_error("texture format not supported by the device!");
+    texture = decodeTexture(texture);
+  }
 
-  vkDestroyBuffer(device, stagingBuffer, nullptr);
-  vkFreeMemory(device, stagingBufferMemory, nullptr);
+  const VkFormat format = texture.format;
+  const uint32_t width = texture.width;
+  const uint32_t height = texture.height;
+  const bool rgba8 = format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_R8G8B8A8_UNORM;
+
+  // Missing mips of RGBA8 textures are blitted on the device if the format
+  // allows it, downsampled on the host and uploaded with the others
+  // otherwise. Compressed textures keep the levels they come with.
+  uint32_t mipLevels = static_cast<uint32_t>(texture.levels.size());
+  bool blitMips = false;
+  if (rgba8 && mipLevels < getMipLevelCount(width, height)) {
+    blitMips = supportsLinearBlit(format);
+    if (!blitMips)
+      appendMipChain(texture);
+    mipLevels = getMipLevelCount(width, height);
+  }
 
-  // Create image view
-  textureImageView = createImageView(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT);
-
-  // Create sampler
-  VkSamplerCreateInfo samplerInfo = {};
-  samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-  samplerInfo.magFilter = VK_FILTER_LINEAR;
-  samplerInfo.minFilter = VK_FILTER_LINEAR;
-  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-  samplerInfo.anisotropyEnable = VK_TRUE;
-  samplerInfo.maxAnisotropy = 16;
-  samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
-  samplerInfo.unnormalizedCoordinates = VK_FALSE;
-  samplerInfo.compareEnable = VK_FALSE;
-  samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
-  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-
-  if (vkCreateSampler(device, &samplerInfo, nullptr, &textureSampler) != VK_SUCCESS)
-    throw std::runtime_error("failed to create texture sampler!");
-}
+  const uint32_t uploadedLevels = blitMips ? 1 : static_cast<uint32_t>(texture.levels.size());
+  const TextureLevel &lastLevel = texture.levels[uploadedLevels - 1];
+  VkBuffer stagingBuffer = uploader.stage(texture.data.data(), lastLevel.offset + lastLevel.size);
 
-void Cacus::cleanupSwapChain() {
-  vkDestroyImageView(device, depthImageView, nullptr);
-  vkDestroyImage(device, depthImage, nullptr);
-  vkFreeMemory(device, depthImageMemory, nullptr);
+  Texture textureObject = {};
+  const VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | (blitMips ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0);
+  createImage(width, height, mipLevels, format, VK_IMAGE_TILING_OPTIMAL, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureObject.image, textureObject.memory);
 
-  for (auto framebuffer : swapChainFramebuffers)
-    vkDestroyFramebuffer(device, framebuffer, nullptr);
+  // Recorded in one batch on the transfer queue, submitted without waiting
+  VkCommandBuffer commandBuffer = uploader.getCommandBuffer();
+  transitionImageLayout(commandBuffer, textureObject.image, format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, uploadedLevels);
+  for (uint32_t i = 0; i < uploadedLevels; i++) {
+    const TextureLevel &level = texture.levels[i];
+    copyBufferToImage(commandBuffer, stagingBuffer, level.offset, textureObject.image, level.width, level.height, i);
+  }
 
-  vkFreeCommandBuffers(device, commandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+  VkImageSubresourceRange range = {};
+  range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  range.baseMipLevel = 0;
+  range.levelCount = uploadedLevels;
+  range.baseArrayLayer = 0;
+  range.layerCount = 1;
+
+  if (blitMips) {
+    // Blits need a graphics queue, the first level is handed over as their source
+    uploader.releaseImage(
+      textureObject.image, range,
+      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+      VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    generateMipmaps(uploader.getGraphicsCommandBuffer(), textureObject.image, format, width, height, mipLevels);
+  } else
+    uploader.releaseImage(
+      textureObject.image, range,
+      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+      VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
 
-  vkDestroyPipeline(device, graphicsPipeline, nullptr);
-  vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
-  vkDestroyRenderPass(device, renderPass, nullptr);
+  // Create image view
+  textureObject.view = createImageView(textureObject.image, format, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
+
+  // Submitted with the other uploads when the next frame begins
+  textureObject.upload = uploader.getRecordingTicket();
+
+  const TextureHandle handle = static_cast<TextureHandle>(textures.size());
+  textures.push_back(textureObject);
+  if (outTexture)
+    *outTexture = handle;
+
+  // Create sampler, clamped by the mips of each texture
+  if (textureSampler == VK_NULL_HANDLE) {
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.anisotropyEnable = VK_TRUE;
+    samplerInfo.maxAnisotropy = 16;
+    samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+    samplerInfo.unnormalizedCoordinates = VK_FALSE;
+    samplerInfo.compareEnable = VK_FALSE;
+    samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+    samplerInfo.mipLodBias = 0.0f;
+
+    if (vkCreateSampler(device, &samplerInfo, nullptr, &textureSampler) != VK_SUCCESS)
+      throw std::runtime_error("failed to create texture sampler!");
+  }
+
+  if (bindless)
+    writeBindlessTexture(handle);
 
+  return textureObject.upload;
+}
+
+void Cacus::cleanupSwapChain() {
   for (auto imageView : swapChainImageViews)
     vkDestroyImageView(device, imageView, nullptr);
+  swapChainImageViews.clear();
 
-  vkDestroySwapchainKHR(device, swapChain, nullptr);
-
-  for (size_t i = 0; i < swapChainImages.size(); i++) {
-    vkDestroyBuffer(device, uniformBuffers[i], nullptr);
-    vkFreeMemory(device, uniformBuffersMemory[i], nullptr);
+  // The swap chain itself is retired by the next one
+  if (headless) {
+    for (size_t i = 0; i < swapChainImages.size(); i++) {
+      vkDestroyImage(device, swapChainImages[i], nullptr);
+      allocator.free(offscreenImagesMemory[i]);
+    }
   }
-
-  vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+  swapChainImages.clear();
 }
 
 void Cacus::init() {
-  if (surface == VK_NULL_HANDLE)
+  if (!headless && surface == VK_NULL_HANDLE)
     throw std::runtime_error("Surface has not been set");
 
   initialized = true;
 
+  // Policies may use fewer frames later on, without reallocating
+  frameSlots = std::max(MAX_FRAMES_IN_FLIGHT, maxFramesInFlight);
+
   // Get physical device
   uint32_t deviceCount = 0;
   vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
@@ -376,14 +646,12 @@ void Cacus::init() {
 
   // Create logical device
   QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
-  uint32_t queueFamilyIndices[] = {indices.graphicsFamily.value(), indices.presentFamily.value()};
 
   // Create queues
   std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-  std::set<uint32_t> uniqueQueueFamilies = {
-    indices.graphicsFamily.value(),
-    indices.presentFamily.value()
-  };
+  std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.transferFamily.value() };
+  if (!headless)
+    uniqueQueueFamilies.insert(indices.presentFamily.value());
 
   float queuePriority = 1.0f;
   for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -395,8 +663,23 @@ void Cacus::init() {
     queueCreateInfos.push_back(queueCreateInfo);
   }
 
+  VkPhysicalDeviceFeatures supportedFeatures;
+  vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
   VkPhysicalDeviceFeatures deviceFeatures = {};
   deviceFeatures.samplerAnisotropy = VK_TRUE;
+  // Draws the chunks of a mesh with a single indirect draw
+  deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+  multiDrawIndirect = supportedFeatures.multiDrawIndirect == VK_TRUE;
+  // Compressed textures, sampled as they are where supported
+  deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+  deviceFeatures.textureCompressionETC2 = supportedFeatures.textureCompressionETC2;
+  deviceFeatures.textureCompressionASTC_LDR = supportedFeatures.textureCompressionASTC_LDR;
+  // Pipeline statistics of the scopes profiled, which execute secondary
+  // command buffers
+  const bool pipelineStatistics = supportedFeatures.pipelineStatisticsQuery && supportedFeatures.inheritedQueries;
+  deviceFeatures.pipelineStatisticsQuery = pipelineStatistics ? VK_TRUE : VK_FALSE;
+  deviceFeatures.inheritedQueries = pipelineStatistics ? VK_TRUE : VK_FALSE;
 
   VkDeviceCreateInfo deviceCreateInfo = {};
   deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -404,8 +687,30 @@ void Cacus::init() {
   deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
   deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
 
-  deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-  deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
+  // No swap chain extension needed when rendering offscreen
+  std::vector<const char*> enabledExtensions;
+  if (!headless)
+    enabledExtensions = deviceExtensions;
+
+  // Writes descriptor sets straight from structs of infos
+  const bool updateTemplates = hasDeviceExtension(VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME);
+  if (updateTemplates)
+    enabledExtensions.push_back(VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME);
+
+  // Lets the device skip the draws of meshes entirely culled
+  const bool drawIndirectCount = hasDeviceExtension(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+  if (drawIndirectCount)
+    enabledExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+
+  // Textures indexed from an array, written as they are loaded
+  VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+  if (enableDescriptorIndexing(indexingFeatures, enabledExtensions)) {
+    deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+    deviceCreateInfo.pNext = &indexingFeatures;
+  }
+
+  deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+  deviceCreateInfo.ppEnabledExtensionNames = enabledExtensions.empty() ? nullptr : enabledExtensions.data();
 
   if (enableValidationLayers) {
       deviceCreateInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -416,9 +721,60 @@ void Cacus::init() {
   if (vkCreateDevice(physicalDevice, &deviceCreateInfo, nullptr, &device) != VK_SUCCESS)
       throw std::runtime_error("Failed to create logical device!");
 
+  if (drawIndirectCount)
+    cmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+      vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR"));
+
   // Retrieve queue handles
   vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
-  vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+  if (!headless)
+    vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+  vkGetDeviceQueue(device, indices.transferFamily.value(), 0, &transferQueue);
+
+  allocator.init(physicalDevice, device);
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  minStorageBufferOffsetAlignment = std::max<VkDeviceSize>(properties.limits.minStorageBufferOffsetAlignment, 1);
+  uniforms.init(
+    device,
+    &allocator,
+    uniformRingSize,
+    frameSlots,
+    std::max(minStorageBufferOffsetAlignment, UNIFORM_ROW_SIZE));
+
+  // Uniforms and texture of the graphics set, buffers of the culling set
+  descriptors.init(
+    device,
+    {
+      { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1.0f },
+      { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1.0f },
+      { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6.0f }
+    },
+    frameSlots,
+    updateTemplates);
+
+  uint32_t queueFamilyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+  // Upload batches are timed on the transfer queue
+  uploader.init(
+    device,
+    transferQueue, indices.transferFamily.value(),
+    graphicsQueue, indices.graphicsFamily.value(),
+    &allocator,
+    properties.limits.timestampPeriod,
+    queueFamilies[indices.transferFamily.value()].timestampValidBits);
+
+  // Frames are profiled on the graphics queue
+
+  const uint32_t timestampValidBits = queueFamilies[indices.graphicsFamily.value()].timestampValidBits;
+  if (timestampValidBits > 0)
+    profiler.init(device, frameSlots, properties.limits.timestampPeriod, timestampValidBits, pipelineStatistics);
+
+  createPipelineCache(properties);
 
   // Retrieve depth format
   depthFormat = findSupportedFormat(
@@ -428,19 +784,118 @@ void Cacus::init() {
   );
 }
 
-void Cacus::preFinalize() {
-  createImage(swapChainExtent.width, swapChainExtent.height, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage, depthImageMemory);
-  depthImageView = createImageView(depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+void Cacus::buildFrameGraph() {
+  frameGraph.destroy();
+
+  const RenderImageDesc targetDesc = { swapChainExtent.width, swapChainExtent.height, swapChainImageFormat };
+  const RenderImageDesc depthDesc = { swapChainExtent.width, swapChainExtent.height, depthFormat };
+
+  // Acquired images are waited for at color output, offscreen targets are
+  // left ready to be copied back to the host
+  backbuffer = frameGraph.importImage(
+    "backbuffer",
+    targetDesc,
+    VK_IMAGE_LAYOUT_UNDEFINED,
+    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+    headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+  frameGraph.markOutput(backbuffer);
+
+  const RenderResource depth = frameGraph.createImage("depth", depthDesc);
+
+  // Indirect commands and visible instances, written by the culling
+  // dispatch and read by the draws
+  RenderResource culled = 0;
+  if (gpuCulling) {
+    culled = frameGraph.importBuffer("culled instances");
+    const RenderPassHandle cullPass = frameGraph.addPass("cull", RENDER_PASS_TYPE_COMPUTE, [this](const RenderPassContext &context) {
+      recordCulling(context.commandBuffer);
+    });
+    frameGraph.writeBuffer(cullPass, culled, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+  }
 
-  createFrameBuffers();
-  createCommandBuffers();
+  // Draws are recorded concurrently into secondary command buffers
+  mainPass = frameGraph.addPass("main", RENDER_PASS_TYPE_GRAPHICS, [this](const RenderPassContext &context) {
+    const RecordingFrame &recordingFrame = recordingFrames[currentFrame];
+    splitDraws();
+    const uint32_t taskCount = static_cast<uint32_t>(recordingRanges.size()) - 1;
+    workers.run(taskCount, [&](uint32_t task) {
+      recordDraws(
+        recordingFrame.commandBuffers[task],
+        context,
+        recordingRanges[task],
+        recordingRanges[task + 1]);
+    });
+
+    if (taskCount > 0)
+      vkCmdExecuteCommands(context.commandBuffer, taskCount, recordingFrame.commandBuffers.data());
+  });
+  frameGraph.writeColor(mainPass, backbuffer, VK_ATTACHMENT_LOAD_OP_CLEAR);
+  frameGraph.writeDepth(mainPass, depth, VK_ATTACHMENT_LOAD_OP_CLEAR);
+  frameGraph.setSecondaryContents(mainPass);
+  if (gpuCulling) {
+    frameGraph.readBuffer(
+      mainPass,
+      culled,
+      VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+      VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+  }
+
+  frameGraph.compile();
+  frameGraph.build(device, &allocator);
 }
 
 void Cacus::finalize() {
-  preFinalize();
+  createCommandBuffers();
   createSyncObjects();
 }
 
+void Cacus::createPipelineCache(const VkPhysicalDeviceProperties &properties) {
+  // Data of another driver or device is ignored rather than handed over
+  std::vector<char> data;
+  if (!pipelineCachePath.empty())
+    data = readPipelineCache(pipelineCachePath, properties);
+
+  VkPipelineCacheCreateInfo cacheInfo = {};
+  cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  cacheInfo.initialDataSize = data.size();
+  cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+  if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+    // Drivers may still reject data passing the header checks
+    cacheInfo.initialDataSize = 0;
+    cacheInfo.pInitialData = nullptr;
+    if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS)
+      throw std::runtime_error("failed to create pipeline cache!");
+  }
+}
+
+void Cacus::destroyPipelineCache() {
+  if (pipelineCache == VK_NULL_HANDLE)
+    return;
+
+  if (!pipelineCachePath.empty()) {
+    size_t size = 0;
+    std::vector<char> data;
+    if (vkGetPipelineCacheData(device, pipelineCache, &size, nullptr) == VK_SUCCESS) {
+      data.resize(size);
+      if (vkGetPipelineCacheData(device, pipelineCache, &size, data.data()) != VK_SUCCESS)
+        data.clear();
+      data.resize(std::min(size, data.size()));
+    }
+
+    // Losing the cache only costs compilation time on the next run
+    if (!data.empty()) {
+      try {
+        writePipelineCache(pipelineCachePath, data);
+      } catch (const std::runtime_error &) {
+      }
+    }
+  }
+
+  vkDestroyPipelineCache(device, pipelineCache, nullptr);
+  pipelineCache = VK_NULL_HANDLE;
+}
+
 VkFormat Cacus::findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features) {
   for (VkFormat format : candidates) {
     VkFormatProperties props;
@@ -460,85 +915,37 @@ void Cacus::createCommandPool() {
   VkCommandPoolCreateInfo poolInfo = {};
   poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
   poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+  // Frame command buffers are recorded again each frame
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
   if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS)
     throw std::runtime_error("Failed to create command pool!");
 }
 
 void Cacus::createGraphicsPipeline() {
-  // Create swap chain
-  SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice);
-
-  VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
-  VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
-  VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
-
-  // Request one more image than minimum count (to no wait on driver)
-  uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
-  // Clamp to maximum allowed
-  if (swapChainSupport.capabilities.maxImageCount > 0 &&
-    imageCount > swapChainSupport.capabilities.maxImageCount) {
-      imageCount = swapChainSupport.capabilities.maxImageCount;
-  }
-
-  VkSwapchainCreateInfoKHR swapChainCreateInfo = {};
-  swapChainCreateInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-  swapChainCreateInfo.surface = surface;
-  swapChainCreateInfo.minImageCount = imageCount;
-  swapChainCreateInfo.imageFormat = surfaceFormat.format;
-  swapChainCreateInfo.imageColorSpace = surfaceFormat.colorSpace;
-  swapChainCreateInfo.imageExtent = extent;
-  swapChainCreateInfo.imageArrayLayers = 1;
-  swapChainCreateInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-
-  QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
-  uint32_t queueFamilyIndices[] = {
-    indices.graphicsFamily.value(),
-    indices.presentFamily.value()
-  };
-
-  if (indices.graphicsFamily != indices.presentFamily) {
-      swapChainCreateInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
-      swapChainCreateInfo.queueFamilyIndexCount = 2;
-      swapChainCreateInfo.pQueueFamilyIndices = queueFamilyIndices;
-  } else {
-      swapChainCreateInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
-      swapChainCreateInfo.queueFamilyIndexCount = 0; // Optional
-      swapChainCreateInfo.pQueueFamilyIndices = nullptr; // Optional
-  }
-
-  swapChainCreateInfo.preTransform = swapChainSupport.capabilities.currentTransform;
-  swapChainCreateInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-  swapChainCreateInfo.presentMode = presentMode;
-  swapChainCreateInfo.clipped = VK_TRUE;
-  swapChainCreateInfo.oldSwapchain = VK_NULL_HANDLE;
-
-  if (vkCreateSwapchainKHR(device, &swapChainCreateInfo, nullptr, &swapChain) != VK_SUCCESS)
-      throw std::runtime_error("Failed to create swap chain!");
-
-  // Get swap chain images
-  vkGetSwapchainImagesKHR(device, swapChain, &imageCount, nullptr);
-  swapChainImages.resize(imageCount);
-  vkGetSwapchainImagesKHR(device, swapChain, &imageCount, swapChainImages.data());
-
-  swapChainImageFormat = surfaceFormat.format;
-  swapChainExtent = extent;
+  VkShaderModule vertShaderModule = createShaderModule(vertexShader);
+  VkShaderModule fragShaderModule = createShaderModule(bindless ? bindlessFragmentShader : fragmentShader);
 
-  // Create image views
-  swapChainImageViews.resize(swapChainImages.size());
+  // Constant 0 of the vertex shader selects the decoding of normals
+  const VkBool32 octahedralNormals = vertexLayout.hasOctahedralNormals() ? VK_TRUE : VK_FALSE;
 
-  for (uint32_t i = 0; i < swapChainImages.size(); i++)
-    swapChainImageViews[i] = createImageView(swapChainImages[i], swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+  VkSpecializationMapEntry specializationEntry = {};
+  specializationEntry.constantID = 0;
+  specializationEntry.offset = 0;
+  specializationEntry.size = sizeof(octahedralNormals);
 
-  // Create graphics pipeline
-  VkShaderModule vertShaderModule = createShaderModule(vertexShader);
-  VkShaderModule fragShaderModule = createShaderModule(fragmentShader);
+  VkSpecializationInfo specializationInfo = {};
+  specializationInfo.mapEntryCount = 1;
+  specializationInfo.pMapEntries = &specializationEntry;
+  specializationInfo.dataSize = sizeof(octahedralNormals);
+  specializationInfo.pData = &octahedralNormals;
 
   VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
   vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
   vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
   vertShaderStageInfo.module = vertShaderModule;
   vertShaderStageInfo.pName = "main";
+  vertShaderStageInfo.pSpecializationInfo = &specializationInfo;
 
   VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
   fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -548,14 +955,21 @@ void Cacus::createGraphicsPipeline() {
 
   VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
 
-  auto bindingDescription = Vertex::getBindingDescription();
-  auto attributeDescriptions = Vertex::getAttributeDescriptions();
+  // Per vertex data on binding 0, per instance data on binding 1
+  std::array<VkVertexInputBindingDescription, 2> bindingDescriptions = {
+    vertexLayout.getBindingDescription(),
+    Instance::getBindingDescription()
+  };
+
+  std::vector<VkVertexInputAttributeDescription> attributeDescriptions = vertexLayout.getAttributeDescriptions();
+  for (const auto &attribute : Instance::getAttributeDescriptions())
+    attributeDescriptions.push_back(attribute);
 
   VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
   vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-  vertexInputInfo.vertexBindingDescriptionCount = 1;
+  vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
   vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-  vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+  vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
   vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
   VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
@@ -603,92 +1017,43 @@ void Cacus::createGraphicsPipeline() {
   colorBlending.blendConstants[2] = 0.0f; // Optional
   colorBlending.blendConstants[3] = 0.0f; // Optional
 
-  VkViewport viewport = {};
-  viewport.x = 0.0f;
-  viewport.y = 0.0f;
-  viewport.width = (float) swapChainExtent.width;
-  viewport.height = (float) swapChainExtent.height;
-  viewport.minDepth = 0.0f;
-  viewport.maxDepth = 1.0f;
-
-  VkRect2D scissor = {};
-  scissor.offset = {0, 0};
-  scissor.extent = swapChainExtent;
-
+  // Viewport and scissor are set when recording, so that the pipeline
+  // outlives resizes
   VkPipelineViewportStateCreateInfo viewportState = {};
   viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
   viewportState.viewportCount = 1;
-  viewportState.pViewports = &viewport;
+  viewportState.pViewports = nullptr;
   viewportState.scissorCount = 1;
-  viewportState.pScissors = &scissor;
+  viewportState.pScissors = nullptr;
+
+  const std::array<VkDynamicState, 2> dynamicStates = {
+    VK_DYNAMIC_STATE_VIEWPORT,
+    VK_DYNAMIC_STATE_SCISSOR
+  };
+
+  VkPipelineDynamicStateCreateInfo dynamicState = {};
+  dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+  dynamicState.pDynamicStates = dynamicStates.data();
 
   VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
   pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-  pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
-  pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
-  pipelineLayoutInfo.setLayoutCount = 1;
-  pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+  // Dequantization of the positions of the mesh drawn, instances carry
+  // their material
+  VkPushConstantRange pushConstantRange = {};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = sizeof(VertexDequantization);
+
+  const std::array<VkDescriptorSetLayout, 2> setLayouts = { descriptorSetLayout, bindlessSetLayout };
+
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+  pipelineLayoutInfo.setLayoutCount = bindless ? 2 : 1;
+  pipelineLayoutInfo.pSetLayouts = setLayouts.data();
 
   if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
       throw std::runtime_error("failed to create pipeline layout!");
-  
-  // Create render pass
-  VkAttachmentDescription depthAttachment = {};
-  depthAttachment.format = depthFormat;
-  depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-  depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-  depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-  depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-  depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-  depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-  VkAttachmentReference depthAttachmentRef = {};
-  depthAttachmentRef.attachment = 1;
-  depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-  VkAttachmentDescription colorAttachment = {};
-  colorAttachment.format = swapChainImageFormat;
-  colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-  colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-  colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-
-  colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-  colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-
-  colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-  VkAttachmentReference colorAttachmentRef = {};
-  colorAttachmentRef.attachment = 0;
-  colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-  
-  VkSubpassDescription subpass = {};
-  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-  subpass.colorAttachmentCount = 1;
-  subpass.pColorAttachments = &colorAttachmentRef;
-  subpass.pDepthStencilAttachment = &depthAttachmentRef;
-
-  VkSubpassDependency dependency = {};
-  dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-  dependency.dstSubpass = 0;
-  dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-  dependency.srcAccessMask = 0;
-  dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-  dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-  std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
-  VkRenderPassCreateInfo renderPassInfo = {};
-  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-  renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-  renderPassInfo.pAttachments = attachments.data();
-  renderPassInfo.subpassCount = 1;
-  renderPassInfo.pSubpasses = &subpass;
-  renderPassInfo.dependencyCount = 1;
-  renderPassInfo.pDependencies = &dependency;
-
-  if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS)
-      throw std::runtime_error("Failed to create render pass!");
 
   VkPipelineDepthStencilStateCreateInfo depthStencil = {};
   depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
@@ -712,83 +1077,364 @@ void Cacus::createGraphicsPipeline() {
   pipelineInfo.pRasterizationState = &rasterizer;
   pipelineInfo.pMultisampleState = &multisampling;
   pipelineInfo.pColorBlendState = &colorBlending;
-  pipelineInfo.pDynamicState = nullptr; // Optional
+  pipelineInfo.pDynamicState = &dynamicState;
   pipelineInfo.layout = pipelineLayout;
-  pipelineInfo.renderPass = renderPass;
+  pipelineInfo.renderPass = frameGraph.getPassRenderPass(mainPass);
   pipelineInfo.subpass = 0;
   pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
   pipelineInfo.basePipelineIndex = -1; // Optional
   pipelineInfo.pDepthStencilState = &depthStencil;
 
-  if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS)
+  if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS)
     throw std::runtime_error("Failed to create graphics pipeline!");
 
   vkDestroyShaderModule(device, fragShaderModule, nullptr);
   vkDestroyShaderModule(device, vertShaderModule, nullptr);
 }
 
-void Cacus::createDescriptorSetLayout() {
-  // Create descriptor set layout
-  VkDescriptorSetLayoutBinding uboLayoutBinding = {};
-  uboLayoutBinding.binding = 0;
-  uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  uboLayoutBinding.descriptorCount = 1;
-  uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-  uboLayoutBinding.pImmutableSamplers = nullptr; // Optional
-
-  VkDescriptorSetLayoutBinding samplerLayoutBinding = {};
-  samplerLayoutBinding.binding = 1;
-  samplerLayoutBinding.descriptorCount = 1;
-  samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-  samplerLayoutBinding.pImmutableSamplers = nullptr;
-  samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-
-  std::array<VkDescriptorSetLayoutBinding, 2> bindings = {uboLayoutBinding, samplerLayoutBinding};
-  VkDescriptorSetLayoutCreateInfo layoutInfo = {};
-  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-  layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
-  layoutInfo.pBindings = bindings.data();
-
-  if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS)
-    throw std::runtime_error("failed to create descriptor set layout!");
-}
-
-void Cacus::createFrameBuffers() {
-  // Create framebuffers, one for each image in the swap chain
-  swapChainFramebuffers.resize(swapChainImageViews.size());
-  for (size_t i = 0; i < swapChainImageViews.size(); i++) {
-    std::array<VkImageView, 2> attachments = {
-      swapChainImageViews[i],
-      depthImageView
-    };
+void Cacus::createSwapChain() {
+  SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice);
 
-    VkFramebufferCreateInfo framebufferInfo = {};
-    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-    framebufferInfo.renderPass = renderPass;
-    framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-    framebufferInfo.pAttachments = attachments.data();
-    framebufferInfo.width = swapChainExtent.width;
-    framebufferInfo.height = swapChainExtent.height;
-    framebufferInfo.layers = 1;
+  VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
+  VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
+  VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
-    if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &swapChainFramebuffers[i]) != VK_SUCCESS)
-      throw std::runtime_error("Failed to create framebuffer!");
+  // Images beyond the minimum let the host draw while others are presented
+  uint32_t imageCount = swapChainSupport.capabilities.minImageCount + framePolicy.extraImages;
+  // Clamp to maximum allowed
+  if (swapChainSupport.capabilities.maxImageCount > 0 &&
+    imageCount > swapChainSupport.capabilities.maxImageCount) {
+      imageCount = swapChainSupport.capabilities.maxImageCount;
   }
-}
-
-uint32_t Cacus::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
-  VkPhysicalDeviceMemoryProperties memProperties;
-  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
 
-for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-  if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
-    return i;
-}
-
-  throw std::runtime_error("failed to find suitable memory type!");
-}
+  VkSwapchainCreateInfoKHR swapChainCreateInfo = {};
+  swapChainCreateInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+  swapChainCreateInfo.surface = surface;
+  swapChainCreateInfo.minImageCount = imageCount;
+  swapChainCreateInfo.imageFormat = surfaceFormat.format;
+  swapChainCreateInfo.imageColorSpace = surfaceFormat.colorSpace;
+  swapChainCreateInfo.imageExtent = extent;
+  swapChainCreateInfo.imageArrayLayers = 1;
+  swapChainCreateInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
-void Cacus::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
+  QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+  uint32_t queueFamilyIndices[] = {
+    indices.graphicsFamily.value(),
+    indices.presentFamily.value()
+  };
+
+  if (indices.graphicsFamily != indices.presentFamily) {
+      swapChainCreateInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
+      swapChainCreateInfo.queueFamilyIndexCount = 2;
+      swapChainCreateInfo.pQueueFamilyIndices = queueFamilyIndices;
+  } else {
+      swapChainCreateInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+      swapChainCreateInfo.queueFamilyIndexCount = 0; // Optional
+      swapChainCreateInfo.pQueueFamilyIndices = nullptr; // Optional
+  }
+
+  swapChainCreateInfo.preTransform = swapChainSupport.capabilities.currentTransform;
+  swapChainCreateInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+  swapChainCreateInfo.presentMode = presentMode;
+  swapChainCreateInfo.clipped = VK_TRUE;
+  // Lets the presentation engine reuse the resources of the previous swap
+  // chain, whose images may still be presented
+  const VkSwapchainKHR oldSwapChain = swapChain;
+  swapChainCreateInfo.oldSwapchain = oldSwapChain;
+
+  const VkResult result = vkCreateSwapchainKHR(device, &swapChainCreateInfo, nullptr, &swapChain);
+  if (oldSwapChain != VK_NULL_HANDLE)
+    vkDestroySwapchainKHR(device, oldSwapChain, nullptr);
+  if (result != VK_SUCCESS) {
+    swapChain = VK_NULL_HANDLE;
+    throw std::runtime_error("Failed to create swap chain!");
+  }
+
+  // Get swap chain images
+  vkGetSwapchainImagesKHR(device, swapChain, &imageCount, nullptr);
+  swapChainImages.resize(imageCount);
+  vkGetSwapchainImagesKHR(device, swapChain, &imageCount, swapChainImages.data());
+
+  swapChainImageFormat = surfaceFormat.format;
+  swapChainExtent = extent;
+  swapChainPresentMode = presentMode;
+
+  // Create image views
+  swapChainImageViews.resize(swapChainImages.size());
+
+  for (uint32_t i = 0; i < swapChainImages.size(); i++)
+    swapChainImageViews[i] = createImageView(swapChainImages[i], swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+}
+
+void Cacus::createRenderTargets() {
+  if (headless)
+    createOffscreenTargets();
+  else
+    createSwapChain();
+}
+
+void Cacus::createOffscreenTargets() {
+  swapChainImageFormat = OFFSCREEN_FORMAT;
+  swapChainExtent = { width, height };
+
+  // One target per frame in flight, so a frame never waits on another one
+  swapChainImages.resize(maxFramesInFlight);
+  swapChainImageViews.resize(maxFramesInFlight);
+  offscreenImagesMemory.resize(maxFramesInFlight);
+
+  for (uint32_t i = 0; i < maxFramesInFlight; i++) {
+    createImage(
+      width,
+      height,
+      1,
+      swapChainImageFormat,
+      VK_IMAGE_TILING_OPTIMAL,
+      VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+      swapChainImages[i],
+      offscreenImagesMemory[i]);
+
+    swapChainImageViews[i] = createImageView(swapChainImages[i], swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+  }
+}
+
+void Cacus::createDescriptorSetLayout() {
+  // Create descriptor set layout
+  VkDescriptorSetLayoutBinding uboLayoutBinding = {};
+  uboLayoutBinding.binding = 0;
+  uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+  uboLayoutBinding.descriptorCount = 1;
+  uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  uboLayoutBinding.pImmutableSamplers = nullptr; // Optional
+
+  VkDescriptorSetLayoutBinding samplerLayoutBinding = {};
+  samplerLayoutBinding.binding = 1;
+  samplerLayoutBinding.descriptorCount = 1;
+  samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  samplerLayoutBinding.pImmutableSamplers = nullptr;
+  samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+  std::array<VkDescriptorSetLayoutBinding, 2> bindings = {uboLayoutBinding, samplerLayoutBinding};
+  VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+  layoutInfo.pBindings = bindings.data();
+
+  if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS)
+    throw std::runtime_error("failed to create descriptor set layout!");
+
+  if (bindless)
+    createBindlessDescriptorSet();
+}
+
+bool Cacus::enableDescriptorIndexing(
+  VkPhysicalDeviceDescriptorIndexingFeaturesEXT &features,
+  std::vector<const char*> &extensions) {
+  bindless = false;
+  if (bindlessFragmentShader.empty())
+    return false;
+
+  if (!hasDeviceExtension(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) ||
+      !hasDeviceExtension(VK_KHR_MAINTENANCE3_EXTENSION_NAME))
+    return false;
+
+  // Vulkan 1.0 only queries features of extensions through
+  // VK_KHR_get_physical_device_properties2, enabled with the instance if
+  // available
+  auto getFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(
+    vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR"));
+  auto getProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2KHR>(
+    vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceProperties2KHR"));
+  if (!getFeatures2 || !getProperties2)
+    return false;
+
+  VkPhysicalDeviceDescriptorIndexingFeaturesEXT supported = {};
+  supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+  VkPhysicalDeviceFeatures2KHR features2 = {};
+  features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+  features2.pNext = &supported;
+  getFeatures2(physicalDevice, &features2);
+
+  // Texture slots are written while frames drawing others are in flight
+  if (!features2.features.shaderSampledImageArrayDynamicIndexing ||
+      !supported.runtimeDescriptorArray ||
+      !supported.descriptorBindingPartiallyBound ||
+      !supported.descriptorBindingSampledImageUpdateAfterBind ||
+      !supported.descriptorBindingUpdateUnusedWhilePending)
+    return false;
+
+  VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties = {};
+  indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+  VkPhysicalDeviceProperties2KHR properties2 = {};
+  properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+  properties2.pNext = &indexingProperties;
+  getProperties2(physicalDevice, &properties2);
+
+  // Combined image samplers count against both limits
+  bindlessTextureCapacity = std::min({
+    MAX_BINDLESS_TEXTURES,
+    indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+    indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers,
+    indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+    indexingProperties.maxDescriptorSetUpdateAfterBindSamplers });
+  if (bindlessTextureCapacity == 0)
+    return false;
+
+  features = {};
+  features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+  features.runtimeDescriptorArray = VK_TRUE;
+  features.descriptorBindingPartiallyBound = VK_TRUE;
+  features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+  features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+
+  extensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+  extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+
+  bindless = true;
+  return true;
+}
+
+void Cacus::createBindlessDescriptorSet() {
+  // Materials, written once before any frame
+  VkDescriptorSetLayoutBinding materialBinding = {};
+  materialBinding.binding = 0;
+  materialBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  materialBinding.descriptorCount = 1;
+  materialBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+  // Textures, only the ones loaded are valid
+  VkDescriptorSetLayoutBinding textureBinding = {};
+  textureBinding.binding = 1;
+  textureBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  textureBinding.descriptorCount = bindlessTextureCapacity;
+  textureBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+  const std::array<VkDescriptorSetLayoutBinding, 2> bindings = { materialBinding, textureBinding };
+  const std::array<VkDescriptorBindingFlagsEXT, 2> bindingFlags = {
+    0,
+    VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+    VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+    VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT
+  };
+
+  VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {};
+  bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+  bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+  bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.pNext = &bindingFlagsInfo;
+  layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+  layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+  layoutInfo.pBindings = bindings.data();
+
+  if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &bindlessSetLayout) != VK_SUCCESS)
+    throw std::runtime_error("failed to create descriptor set layout!");
+
+  std::array<VkDescriptorPoolSize, 2> poolSizes = {};
+  poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  poolSizes[0].descriptorCount = 1;
+  poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  poolSizes[1].descriptorCount = bindlessTextureCapacity;
+
+  VkDescriptorPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+  poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+  poolInfo.pPoolSizes = poolSizes.data();
+  poolInfo.maxSets = 1;
+
+  if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &bindlessDescriptorPool) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create descriptor pool!");
+
+  VkDescriptorSetAllocateInfo allocInfo = {};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = bindlessDescriptorPool;
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &bindlessSetLayout;
+
+  if (vkAllocateDescriptorSets(device, &allocInfo, &bindlessDescriptorSet) != VK_SUCCESS)
+    throw std::runtime_error("failed to allocate descriptor sets!");
+
+  createBuffer(
+    sizeof(Material) * MAX_MATERIALS,
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+    materialBuffer,
+    materialBufferMemory);
+
+  VkDescriptorBufferInfo bufferInfo = {};
+  bufferInfo.buffer = materialBuffer;
+  bufferInfo.offset = 0;
+  bufferInfo.range = VK_WHOLE_SIZE;
+
+  VkWriteDescriptorSet descriptorWrite = {};
+  descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  descriptorWrite.dstSet = bindlessDescriptorSet;
+  descriptorWrite.dstBinding = 0;
+  descriptorWrite.dstArrayElement = 0;
+  descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  descriptorWrite.descriptorCount = 1;
+  descriptorWrite.pBufferInfo = &bufferInfo;
+  vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+
+  for (TextureHandle texture = 0; texture < textures.size(); texture++)
+    writeBindlessTexture(texture);
+
+  // Material 0, drawn by meshes without one
+  Material defaultMaterial = {};
+  defaultMaterial.baseColorFactor = glm::vec4(1.0f);
+  defaultMaterial.baseColorTexture = 0;
+  std::memcpy(materialBufferMemory.mapped, &defaultMaterial, sizeof(Material));
+  materialCount = 1;
+}
+
+void Cacus::writeBindlessTexture(TextureHandle texture) {
+  VkDescriptorImageInfo imageInfo = {};
+  imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  imageInfo.imageView = textures[texture].view;
+  imageInfo.sampler = textureSampler;
+
+  VkWriteDescriptorSet descriptorWrite = {};
+  descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  descriptorWrite.dstSet = bindlessDescriptorSet;
+  descriptorWrite.dstBinding = 1;
+  descriptorWrite.dstArrayElement = texture;
+  descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  descriptorWrite.descriptorCount = 1;
+  descriptorWrite.pImageInfo = &imageInfo;
+  vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+}
+
+MaterialHandle Cacus::createMaterial(const Material &material) {
+  if (!bindless)
+    throw std::runtime_error("materials need bindless mode!");
+  if (material.baseColorTexture >= textures.size())
+    throw std::invalid_argument("invalid texture handle!");
+  if (materialCount >= MAX_MATERIALS)
+    throw std::runtime_error("too many materials!");
+
+  // Slots are never reused, frames in flight do not read this one
+  const MaterialHandle handle = materialCount++;
+  Material *materials = static_cast<Material*>(materialBufferMemory.mapped);
+  materials[handle] = material;
+  return handle;
+}
+
+void Cacus::setMeshMaterial(MeshHandle mesh, MaterialHandle material) {
+  if (mesh >= meshes.size() || meshes[mesh].vertexBuffer == VK_NULL_HANDLE)
+    throw std::invalid_argument("invalid mesh handle!");
+  // Without bindless mode, meshes all sample texture 0
+  if (material >= std::max(materialCount, 1u))
+    throw std::invalid_argument("invalid material handle!");
+
+  meshes[mesh].material = material;
+  if (bindless)
+    meshes[mesh].texture = static_cast<const Material*>(materialBufferMemory.mapped)[material].baseColorTexture;
+}
+
+void Cacus::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, Allocation& bufferMemory) {
   VkBufferCreateInfo bufferInfo = {};
   bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
   bufferInfo.size = size;
@@ -801,88 +1447,592 @@ void Cacus::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPr
   VkMemoryRequirements memRequirements;
   vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
 
-  VkMemoryAllocateInfo allocInfo = {};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+  bufferMemory = allocator.allocate(memRequirements, properties, true);
 
-  if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS)
-    throw std::runtime_error("failed to allocate buffer memory!");
-
-  vkBindBufferMemory(device, buffer, bufferMemory, 0);
+  vkBindBufferMemory(device, buffer, bufferMemory.memory, bufferMemory.offset);
 }
 
-void Cacus::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
+void Cacus::copyBuffer(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
     VkBufferCopy copyRegion = {};
     copyRegion.size = size;
     vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+}
 
-    endSingleTimeCommands(commandBuffer);
+MeshHandle Cacus::createMesh(
+  const std::vector<Vertex> &vertices,
+  const std::vector<uint32_t> &indices,
+  UploadTicket *outTicket) {
+  return createMesh(vertices, std::vector<MeshLod>{ { indices, 0.0f } }, outTicket);
 }
 
-void Cacus::createMeshBuffers(
-  const std::vector<Vertex> &newVertices,
-  const std::vector<uint32_t> &newIndices) {
-  vertices = newVertices;
-  indices = newIndices;
+MeshHandle Cacus::createMesh(
+  const std::vector<Vertex> &vertices,
+  const std::vector<MeshLod> &lods,
+  UploadTicket *outTicket) {
+  CACUS_PROFILE_SCOPE("packMesh");
+  const MeshBounds bounds = computeBounds(vertices.data(), vertices.size());
 
-  // Vertex buffer
-  VkBuffer stagingBuffer;
-  VkDeviceMemory stagingBufferMemory;
+  // Levels share the vertices, one chunk each
+  const PackedMesh packed = packMesh(vertices, lods, UINT32_MAX);
 
-  VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
-  createBuffer(bufferSize,
-    VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-    stagingBuffer,
-    stagingBufferMemory);
+  std::vector<char> vertexData(VkDeviceSize(vertexLayout.getStride()) * packed.vertices.size());
+  vertexLayout.encode(packed.vertices.data(), packed.vertices.size(), bounds, vertexData.data());
+
+  const uint32_t indexCount = static_cast<uint32_t>(packed.indices.size());
 
-  void* data;
-  vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-  memcpy(data, vertices.data(), (size_t) bufferSize);
-  vkUnmapMemory(device, stagingBufferMemory);
+  if (fitsIndex16(packed.indices.data(), packed.indices.size())) {
+    const std::vector<uint16_t> indices16 = narrowIndices(packed.indices.data(), packed.indices.size());
+    return createMesh(
+      vertexData.data(), vertexData.size(),
+      indices16.data(), VK_INDEX_TYPE_UINT16, indexCount,
+      packed.chunks, packed.lods, bounds, outTicket);
+  }
+
+  return createMesh(
+    vertexData.data(), vertexData.size(),
+    packed.indices.data(), VK_INDEX_TYPE_UINT32, indexCount,
+    packed.chunks, packed.lods, bounds, outTicket);
+}
 
-  createBuffer(bufferSize,
+MeshHandle Cacus::loadMesh(const std::string &path, UploadTicket *outTicket) {
+  CACUS_PROFILE_SCOPE("loadMesh");
+  MeshFile file;
+  file.open(path);
+
+  const MeshFileHeader &header = file.getHeader();
+  if (!file.hasVertexLayout(vertexLayout))
+    throw std::runtime_error("vertex layout of mesh file does not match!");
+
+  // Blobs are copied from the mapped file straight into staging memory
+  return createMesh(
+    file.getVertexData(), header.vertexStride * header.vertexCount,
+    file.getIndexData(),
+    header.indexSize == sizeof(uint16_t) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32,
+    static_cast<uint32_t>(header.indexCount),
+    std::vector<MeshChunk>(file.getChunks(), file.getChunks() + header.chunkCount),
+    std::vector<MeshLodRange>(file.getLods(), file.getLods() + header.lodCount),
+    file.getBounds(),
+    outTicket);
+}
+
+MeshHandle Cacus::createMesh(
+  const void *vertexData,
+  VkDeviceSize vertexDataSize,
+  const void *indexData,
+  VkIndexType indexType,
+  uint32_t indexCount,
+  const std::vector<MeshChunk> &chunks,
+  const std::vector<MeshLodRange> &lods,
+  const MeshBounds &bounds,
+  UploadTicket *outTicket) {
+  CACUS_PROFILE_SCOPE("createMesh");
+  if (lods.empty() || lods.size() > MAX_MESH_LODS)
+    throw std::invalid_argument("invalid level of detail count!");
+
+  Mesh mesh = {};
+  mesh.uniformOffset = NO_MESH_UNIFORMS;
+  mesh.indexType = indexType;
+  mesh.chunks = chunks;
+  mesh.lods = lods;
+  mesh.boundingSphere = bounds.sphere;
+  mesh.dequantization = vertexLayout.getDequantization(bounds);
+
+  VkCommandBuffer commandBuffer = uploader.getCommandBuffer();
+
+  // Vertex buffer
+  VkDeviceSize vertexBufferSize = vertexDataSize;
+  VkBuffer stagingBuffer = uploader.stage(vertexData, vertexBufferSize);
+
+  createBuffer(vertexBufferSize,
     VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-    vertexBuffer,
-    vertexBufferMemory);
+    mesh.vertexBuffer,
+    mesh.vertexBufferMemory);
 
-  copyBuffer(stagingBuffer, vertexBuffer, bufferSize);
-  vkDestroyBuffer(device, stagingBuffer, nullptr);
-  vkFreeMemory(device, stagingBufferMemory, nullptr);
+  copyBuffer(commandBuffer, stagingBuffer, mesh.vertexBuffer, vertexBufferSize);
 
   // Index buffer
-  bufferSize = sizeof(indices[0]) * indices.size();
-  createBuffer(bufferSize,
-    VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-    stagingBuffer,
-    stagingBufferMemory);
+  const VkDeviceSize indexSize = indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+  VkDeviceSize indexBufferSize = indexSize * indexCount;
+  stagingBuffer = uploader.stage(indexData, indexBufferSize);
 
-  vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-  memcpy(data, indices.data(), (size_t) bufferSize);
-  vkUnmapMemory(device, stagingBufferMemory);
-
-  createBuffer(bufferSize,
+  createBuffer(indexBufferSize,
     VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-    indexBuffer,
-    indexBufferMemory);
+    mesh.indexBuffer,
+    mesh.indexBufferMemory);
+
+  copyBuffer(commandBuffer, stagingBuffer, mesh.indexBuffer, indexBufferSize);
+
+  // Make the copies visible to the vertex input of the frames submitted next
+  uploader.releaseBuffer(mesh.vertexBuffer, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+  uploader.releaseBuffer(mesh.indexBuffer, VK_ACCESS_INDEX_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
 
-  copyBuffer(stagingBuffer, indexBuffer, bufferSize);
+  mesh.upload = uploader.getRecordingTicket();
+  if (outTicket)
+    *outTicket = mesh.upload;
+
+  MeshHandle handle;
+  if (!freeMeshes.empty()) {
+    handle = freeMeshes.back();
+    freeMeshes.pop_back();
+    meshes[handle] = mesh;
+  } else {
+    handle = static_cast<MeshHandle>(meshes.size());
+    meshes.push_back(mesh);
+  }
 
-  vkDestroyBuffer(device, stagingBuffer, nullptr);
-  vkFreeMemory(device, stagingBufferMemory, nullptr);
+  return handle;
+}
+
+void Cacus::destroyMesh(MeshHandle mesh) {
+  if (mesh >= meshes.size() || meshes[mesh].vertexBuffer == VK_NULL_HANDLE)
+    throw std::invalid_argument("invalid mesh handle!");
+
+  RetiredMesh retired = {};
+  retired.mesh = meshes[mesh];
+  retired.frameNumber = frameNumber;
+  retiredMeshes.push_back(retired);
+
+  meshes[mesh] = {};
+  freeMeshes.push_back(mesh);
+}
+
+void Cacus::releaseRetiredMeshes() {
+  // Frames complete in order: once the fence of the current frame has been
+  // waited on, every frame up to frameNumber - maxFramesInFlight completed
+  auto it = retiredMeshes.begin();
+  while (it != retiredMeshes.end()) {
+    const bool unused = it->frameNumber + maxFramesInFlight <= frameNumber + 1;
+    if (!unused || !uploader.isComplete(it->mesh.upload)) {
+      ++it;
+      continue;
+    }
+
+    vkDestroyBuffer(device, it->mesh.indexBuffer, nullptr);
+    allocator.free(it->mesh.indexBufferMemory);
+    vkDestroyBuffer(device, it->mesh.vertexBuffer, nullptr);
+    allocator.free(it->mesh.vertexBufferMemory);
+    it = retiredMeshes.erase(it);
+  }
+}
+
+void Cacus::drawInstances(MeshHandle mesh, const glm::mat4 *models, size_t count) {
+  if (mesh >= meshes.size() || meshes[mesh].vertexBuffer == VK_NULL_HANDLE)
+    throw std::invalid_argument("invalid mesh handle!");
+
+  std::vector<Instance> &instances = meshes[mesh].instances;
+  for (size_t i = 0; i < count; i++)
+    instances.push_back({ models[i] });
+}
+
+/**
+ * @param lodCamera See Cacus::getLodCamera
+ * @return Coarsest level of detail whose error is below the threshold at
+ *         the distance of an instance
+ */
+static uint32_t selectLod(
+  const std::vector<MeshLodRange> &lods,
+  const glm::vec4 &boundingSphere,
+  const glm::mat4 &model,
+  const glm::vec4 &lodCamera) {
+  const glm::vec3 center = glm::vec3(model * glm::vec4(glm::vec3(boundingSphere), 1.0f));
+  const float scale = std::max(
+    std::max(glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1]))),
+    glm::length(glm::vec3(model[2])));
+
+  // Distance to the closest point of the bounding sphere
+  const float distance = glm::length(center - glm::vec3(lodCamera)) - boundingSphere.w * scale;
+  if (distance <= 0.0f)
+    return 0;
+
+  uint32_t lod = 0;
+  for (uint32_t i = 1; i < lods.size(); i++) {
+    if (lods[i].error * scale * lodCamera.w <= distance)
+      lod = i;
+  }
+
+  return lod;
+}
+
+glm::vec4 Cacus::getLodCamera() const {
+  const glm::vec4 camera = glm::inverse(ubo.view * ubo.model) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+
+  // An error e at distance d spans e / d * proj[1][1] * height / 2 pixels
+  const float lodScale = swapChainExtent.height * 0.5f * std::fabs(ubo.proj[1][1]) / lodThreshold;
+  return glm::vec4(glm::vec3(camera), lodScale);
+}
+
+void Cacus::writeInstances(uint32_t uniformOffset) {
+  CACUS_PROFILE_SCOPE("writeInstances");
+  uint32_t instanceCount = 0;
+  uint32_t batchCount = 0;
+  uint32_t commandCount = 0;
+  uint32_t lodCount = 0;
+  uint32_t visibleCount = 0;
+  const UploadTicket acquired = uploader.getLastAcquired();
+  for (Mesh &mesh : meshes) {
+    // Meshes are skipped until their buffers and texture are uploaded
+    if (std::max(mesh.upload, textures[mesh.texture].upload) > acquired)
+      mesh.instances.clear();
+
+    mesh.firstInstance = instanceCount;
+    instanceCount += static_cast<uint32_t>(mesh.instances.size());
+    if (!mesh.instances.empty()) {
+      mesh.batch = batchCount++;
+      mesh.firstCommand = commandCount;
+      commandCount += static_cast<uint32_t>(mesh.chunks.size());
+      mesh.firstLod = lodCount;
+      lodCount += static_cast<uint32_t>(mesh.lods.size());
+      mesh.firstVisible = visibleCount;
+      visibleCount += static_cast<uint32_t>(mesh.instances.size() * mesh.lods.size());
+    }
+  }
+
+  // Also read by the culling shader
+  reserveBuffer(
+    instanceBuffers[currentFrame],
+    instanceBuffersMemory[currentFrame],
+    instanceBufferCapacities[currentFrame],
+    sizeof(Instance) * std::max(instanceCount, MIN_INSTANCE_CAPACITY),
+    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+  Instance *data = static_cast<Instance*>(instanceBuffersMemory[currentFrame].mapped);
+  const glm::vec4 lodCamera = getLodCamera();
+  std::vector<uint32_t> instanceLods;
+
+  for (Mesh &mesh : meshes) {
+    if (mesh.instances.empty())
+      continue;
+
+    const uint32_t meshUniformOffset = mesh.uniformOffset != NO_MESH_UNIFORMS ? mesh.uniformOffset : uniformOffset;
+    const uint32_t uniformRow = static_cast<uint32_t>((meshUniformOffset - uniforms.getFrameOffset()) / UNIFORM_ROW_SIZE);
+    for (Instance &instance : mesh.instances) {
+      instance.material = mesh.material;
+      instance.uniforms = uniformRow;
+    }
+
+    // The culling shader selects levels itself
+    mesh.lodInstanceCounts.fill(0);
+    if (gpuCulling || mesh.lods.size() == 1) {
+      memcpy(data + mesh.firstInstance, mesh.instances.data(), sizeof(Instance) * mesh.instances.size());
+      mesh.lodInstanceCounts[0] = static_cast<uint32_t>(mesh.instances.size());
+      continue;
+    }
+
+    // Counting sort, so that the instances of each level are contiguous
+    instanceLods.resize(mesh.instances.size());
+    for (size_t i = 0; i < mesh.instances.size(); i++) {
+      instanceLods[i] = selectLod(mesh.lods, mesh.boundingSphere, mesh.instances[i].model, lodCamera);
+      mesh.lodInstanceCounts[instanceLods[i]]++;
+    }
+
+    std::array<uint32_t, MAX_MESH_LODS> offsets;
+    uint32_t offset = mesh.firstInstance;
+    for (size_t lod = 0; lod < mesh.lods.size(); lod++) {
+      offsets[lod] = offset;
+      offset += mesh.lodInstanceCounts[lod];
+    }
+
+    for (size_t i = 0; i < mesh.instances.size(); i++)
+      data[offsets[instanceLods[i]]++] = mesh.instances[i];
+  }
+}
+
+bool Cacus::reserveBuffer(
+  VkBuffer &buffer,
+  Allocation &memory,
+  VkDeviceSize &capacity,
+  VkDeviceSize size,
+  VkBufferUsageFlags usage,
+  VkMemoryPropertyFlags properties) {
+  if (buffer != VK_NULL_HANDLE && size <= capacity)
+    return false;
+
+  // Grow geometrically to amortize replacements
+  VkDeviceSize newCapacity = std::max<VkDeviceSize>(capacity, 1);
+  while (newCapacity < size)
+    newCapacity *= 2;
+
+  if (buffer != VK_NULL_HANDLE) {
+    vkDestroyBuffer(device, buffer, nullptr);
+    allocator.free(memory);
+  }
+
+  createBuffer(newCapacity, usage, properties, buffer, memory);
+  capacity = newCapacity;
+  return true;
+}
+
+void Cacus::enableGpuCulling(const std::vector<char> &computeShader) {
+  // Instances, batches, visible instances, indirect commands, draw counts
+  // and levels of detail
+  std::array<VkDescriptorSetLayoutBinding, 6> bindings = {};
+  for (uint32_t i = 0; i < bindings.size(); i++) {
+    bindings[i].binding = i;
+    bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[i].descriptorCount = 1;
+    bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  }
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+  layoutInfo.pBindings = bindings.data();
+
+  if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &cullDescriptorSetLayout) != VK_SUCCESS)
+    throw std::runtime_error("failed to create culling descriptor set layout!");
+
+  // Frustum planes and LOD camera
+  VkPushConstantRange pushConstantRange = {};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = sizeof(glm::vec4) * 7;
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &cullDescriptorSetLayout;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+  if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &cullPipelineLayout) != VK_SUCCESS)
+    throw std::runtime_error("failed to create culling pipeline layout!");
+
+  VkShaderModule shaderModule = createShaderModule(computeShader);
+
+  VkComputePipelineCreateInfo pipelineInfo = {};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipelineInfo.stage.module = shaderModule;
+  pipelineInfo.stage.pName = "main";
+  pipelineInfo.layout = cullPipelineLayout;
+
+  if (vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &cullPipeline) != VK_SUCCESS)
+    throw std::runtime_error("failed to create culling pipeline!");
+
+  vkDestroyShaderModule(device, shaderModule, nullptr);
+
+  // Descriptor sets are transient and written every frame, buffers may
+  // have grown. Infos of the bindings follow each other.
+  std::vector<VkDescriptorUpdateTemplateEntryKHR> entries(bindings.size());
+  for (uint32_t i = 0; i < entries.size(); i++) {
+    entries[i].dstBinding = i;
+    entries[i].dstArrayElement = 0;
+    entries[i].descriptorCount = 1;
+    entries[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    entries[i].offset = sizeof(VkDescriptorBufferInfo) * i;
+    entries[i].stride = sizeof(VkDescriptorBufferInfo);
+  }
+  cullUpdateTemplate = descriptors.createUpdateTemplate(cullDescriptorSetLayout, entries);
+
+  cullingFrames.resize(frameSlots, CullingFrame{});
+
+  gpuCulling = true;
+
+  // The frame graph gains the culling pass. Its main render pass stays
+  // compatible with the one the pipeline was created with
+  if (!commandBuffers.empty())
+    vkDeviceWaitIdle(device);
+  buildFrameGraph();
+}
+
+void Cacus::destroyCulling() {
+  if (!gpuCulling)
+    return;
+
+  for (CullingFrame &frame : cullingFrames) {
+    const std::array<std::pair<VkBuffer, Allocation*>, 3> buffers = {{
+      { frame.batchBuffer, &frame.batchBufferMemory },
+      { frame.indirectBuffer, &frame.indirectBufferMemory },
+      { frame.visibleBuffer, &frame.visibleBufferMemory }
+    }};
+
+    for (const auto &buffer : buffers) {
+      if (buffer.first == VK_NULL_HANDLE)
+        continue;
+      vkDestroyBuffer(device, buffer.first, nullptr);
+      allocator.free(*buffer.second);
+    }
+  }
+  cullingFrames.clear();
+
+  descriptors.destroyUpdateTemplate(cullUpdateTemplate);
+  vkDestroyPipeline(device, cullPipeline, nullptr);
+  vkDestroyPipelineLayout(device, cullPipelineLayout, nullptr);
+  vkDestroyDescriptorSetLayout(device, cullDescriptorSetLayout, nullptr);
+  gpuCulling = false;
+}
+
+/**
+ * Extracts the planes of a view frustum, normals pointing inwards.
+ * Depth ranges from 0 to 1 in clip space.
+ */
+static void extractFrustumPlanes(const glm::mat4 &matrix, glm::vec4 planes[6]) {
+  glm::vec4 rows[4];
+  for (int i = 0; i < 4; i++)
+    rows[i] = glm::vec4(matrix[0][i], matrix[1][i], matrix[2][i], matrix[3][i]);
+
+  planes[0] = rows[3] + rows[0]; // Left
+  planes[1] = rows[3] - rows[0]; // Right
+  planes[2] = rows[3] + rows[1]; // Bottom
+  planes[3] = rows[3] - rows[1]; // Top
+  planes[4] = rows[2];           // Near
+  planes[5] = rows[3] - rows[2]; // Far
+
+  for (int i = 0; i < 6; i++)
+    planes[i] = planes[i] / glm::length(glm::vec3(planes[i]));
+}
+
+void Cacus::recordCulling(VkCommandBuffer commandBuffer) {
+  CullingFrame &frame = cullingFrames[currentFrame];
+
+  uint32_t batchCount = 0;
+  uint32_t commandCount = 0;
+  uint32_t lodCount = 0;
+  uint32_t instanceCount = 0;
+  uint32_t visibleCount = 0;
+  uint32_t maxBatchInstances = 0;
+  for (const Mesh &mesh : meshes) {
+    if (mesh.instances.empty())
+      continue;
+    batchCount++;
+    commandCount += static_cast<uint32_t>(mesh.chunks.size());
+    lodCount += static_cast<uint32_t>(mesh.lods.size());
+    instanceCount += static_cast<uint32_t>(mesh.instances.size());
+    visibleCount += static_cast<uint32_t>(mesh.instances.size() * mesh.lods.size());
+    maxBatchInstances = std::max(maxBatchInstances, static_cast<uint32_t>(mesh.instances.size()));
+  }
+
+  if (batchCount == 0)
+    return;
+
+  // Must match the Batch and Lod structs of the culling shader (std430)
+  typedef struct CullBatchStruct {
+    glm::vec4 boundingSphere;
+    uint32_t firstInstance;
+    uint32_t instanceCount;
+    // Levels of detail of the mesh
+    uint32_t firstLod;
+    uint32_t lodCount;
+  } CullBatch;
+
+  typedef struct CullLodStruct {
+    // Indirect commands of the chunks of the level
+    uint32_t firstCommand;
+    uint32_t commandCount;
+    uint32_t firstVisible;
+    float error;
+  } CullLod;
+
+  const VkDeviceSize alignment = minStorageBufferOffsetAlignment;
+  const VkDeviceSize lodDataOffset = (sizeof(CullBatch) * batchCount + alignment - 1) / alignment * alignment;
+  const VkDeviceSize commandsSize = sizeof(VkDrawIndexedIndirectCommand) * commandCount;
+  const VkDeviceSize drawCountOffset = (commandsSize + alignment - 1) / alignment * alignment;
+  const VkDeviceSize indirectSize = drawCountOffset + sizeof(uint32_t) * lodCount;
+
+  reserveBuffer(
+    frame.batchBuffer, frame.batchBufferMemory, frame.batchBufferCapacity,
+    lodDataOffset + sizeof(CullLod) * lodCount,
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  reserveBuffer(
+    frame.indirectBuffer, frame.indirectBufferMemory, frame.indirectBufferCapacity,
+    indirectSize,
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  reserveBuffer(
+    frame.visibleBuffer, frame.visibleBufferMemory, frame.visibleBufferCapacity,
+    sizeof(Instance) * std::max(visibleCount, MIN_INSTANCE_CAPACITY),
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  frame.lodDataOffset = lodDataOffset;
+  frame.drawCountOffset = drawCountOffset;
+
+  // Instance counts start at zero and are incremented by the shader
+  CullBatch *batches = static_cast<CullBatch*>(frame.batchBufferMemory.mapped);
+  CullLod *lods = reinterpret_cast<CullLod*>(static_cast<char*>(frame.batchBufferMemory.mapped) + lodDataOffset);
+  VkDrawIndexedIndirectCommand *commands = static_cast<VkDrawIndexedIndirectCommand*>(frame.indirectBufferMemory.mapped);
+  uint32_t *drawCounts = reinterpret_cast<uint32_t*>(static_cast<char*>(frame.indirectBufferMemory.mapped) + drawCountOffset);
+
+  for (const Mesh &mesh : meshes) {
+    if (mesh.instances.empty())
+      continue;
+
+    CullBatch &batch = batches[mesh.batch];
+    batch.boundingSphere = mesh.boundingSphere;
+    batch.firstInstance = mesh.firstInstance;
+    batch.instanceCount = static_cast<uint32_t>(mesh.instances.size());
+    batch.firstLod = mesh.firstLod;
+    batch.lodCount = static_cast<uint32_t>(mesh.lods.size());
+
+    for (size_t i = 0; i < mesh.lods.size(); i++) {
+      CullLod &lod = lods[mesh.firstLod + i];
+      lod.firstCommand = mesh.firstCommand + mesh.lods[i].firstChunk;
+      lod.commandCount = mesh.lods[i].chunkCount;
+      lod.firstVisible = mesh.firstVisible + static_cast<uint32_t>(i * mesh.instances.size());
+      lod.error = mesh.lods[i].error;
+
+      drawCounts[mesh.firstLod + i] = 0;
+    }
+
+    // Visible instances are addressed through the vertex buffer offset, so
+    // firstInstance stays 0 (drawIndirectFirstInstance is not required)
+    for (size_t i = 0; i < mesh.chunks.size(); i++) {
+      VkDrawIndexedIndirectCommand &command = commands[mesh.firstCommand + i];
+      command.indexCount = mesh.chunks[i].indexCount;
+      command.instanceCount = 0;
+      command.firstIndex = mesh.chunks[i].firstIndex;
+      command.vertexOffset = mesh.chunks[i].vertexOffset;
+      command.firstInstance = 0;
+    }
+  }
+
+  std::array<VkDescriptorBufferInfo, 6> bufferInfos = {};
+  bufferInfos[0] = { instanceBuffers[currentFrame], 0, sizeof(Instance) * std::max(instanceCount, 1u) };
+  bufferInfos[1] = { frame.batchBuffer, 0, sizeof(CullBatch) * batchCount };
+  bufferInfos[2] = { frame.visibleBuffer, 0, sizeof(Instance) * std::max(visibleCount, 1u) };
+  bufferInfos[3] = { frame.indirectBuffer, 0, commandsSize };
+  bufferInfos[4] = { frame.indirectBuffer, drawCountOffset, sizeof(uint32_t) * lodCount };
+  bufferInfos[5] = { frame.batchBuffer, lodDataOffset, sizeof(CullLod) * lodCount };
+
+  const VkDescriptorSet descriptorSet = descriptors.allocateTransient(cullDescriptorSetLayout);
+  descriptors.update(descriptorSet, cullUpdateTemplate, bufferInfos.data());
+
+  // Planes and camera in the space instances are transformed to, before the
+  // global model
+  glm::vec4 pushConstants[7];
+  extractFrustumPlanes(ubo.proj * ubo.view * ubo.model, pushConstants);
+  pushConstants[6] = getLodCamera();
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+  vkCmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), pushConstants);
+
+  // One row of workgroups per batch
+  const uint32_t groupCountX = (maxBatchInstances + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE;
+  vkCmdDispatch(commandBuffer, groupCountX, batchCount, 1);
+}
+
+UploadTicket Cacus::flushUploads() {
+  return uploader.flush();
+}
+
+bool Cacus::isUploadComplete(UploadTicket ticket) {
+  return uploader.isComplete(ticket);
+}
+
+void Cacus::waitForUpload(UploadTicket ticket) {
+  uploader.wait(ticket);
 }
 
 void Cacus::createSyncObjects() {
   // Setup semaphores
-  imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-  renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-  inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+  imageAvailableSemaphores.resize(frameSlots);
+  renderFinishedSemaphores.resize(frameSlots);
+  inFlightFences.resize(frameSlots);
   imagesInFlight.resize(swapChainImages.size(), VK_NULL_HANDLE);
 
   VkSemaphoreCreateInfo semaphoreInfo = {};
@@ -892,7 +2042,7 @@ void Cacus::createSyncObjects() {
   fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
   fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+  for (size_t i = 0; i < frameSlots; i++) {
     if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
         vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
         vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
@@ -902,86 +2052,54 @@ void Cacus::createSyncObjects() {
 }
 
 void Cacus::createCommandBuffers() {
-  // Create uniform buffers
-  VkDeviceSize bufferSize = sizeof(UniformBufferObject);
-
-  uniformBuffers.resize(swapChainImages.size());
-  uniformBuffersMemory.resize(swapChainImages.size());
-
-  for (size_t i = 0; i < swapChainImages.size(); i++) {
-    createBuffer(
-      bufferSize,
-      VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-      uniformBuffers[i],
-      uniformBuffersMemory[i]);
-  }
-
-  // Create descriptor pools
-  std::array<VkDescriptorPoolSize, 2> poolSizes = {};
-  poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  poolSizes[0].descriptorCount = static_cast<uint32_t>(swapChainImages.size());
-  poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-  poolSizes[1].descriptorCount = static_cast<uint32_t>(swapChainImages.size());
-
-  VkDescriptorPoolCreateInfo poolInfo = {};
-  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-  poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-  poolInfo.pPoolSizes = poolSizes.data();
-  poolInfo.maxSets = static_cast<uint32_t>(swapChainImages.size());
-
-  if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
-    throw std::runtime_error("Failed to create descriptor pool!");
-
-  // Create descriptor sets
-  std::vector<VkDescriptorSetLayout> layouts(swapChainImages.size(), descriptorSetLayout);
-  VkDescriptorSetAllocateInfo allocInfo = {};
-  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-  allocInfo.descriptorPool = descriptorPool;
-  allocInfo.descriptorSetCount = static_cast<uint32_t>(swapChainImages.size());
-  allocInfo.pSetLayouts = layouts.data();
-
-  descriptorSets.resize(swapChainImages.size());
-  if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()) != VK_SUCCESS)
-    throw std::runtime_error("failed to allocate descriptor sets!");
+  // Sampled by material 0, or by all meshes without bindless mode
+  if (textures.empty())
+    throw std::runtime_error("a texture must be loaded before finalize!");
+
+  // Create descriptor set, shared by all frames as uniforms use dynamic offsets
+  descriptorSet = descriptors.allocate(descriptorSetLayout);
+
+  // Uniforms of a whole frame, bound at the region of the frame
+  VkDescriptorBufferInfo bufferInfo = {};
+  bufferInfo.buffer = uniforms.getBuffer();
+  bufferInfo.offset = 0;
+  bufferInfo.range = uniforms.getFrameSize();
+
+  VkDescriptorImageInfo imageInfo = {};
+  imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  imageInfo.imageView = textures[0].view;
+  imageInfo.sampler = textureSampler;
+
+  std::array<VkWriteDescriptorSet, 2> descriptorWrites = {};
+
+  descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  descriptorWrites[0].dstSet = descriptorSet;
+  descriptorWrites[0].dstBinding = 0;
+  descriptorWrites[0].dstArrayElement = 0;
+  descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+  descriptorWrites[0].descriptorCount = 1;
+  descriptorWrites[0].pBufferInfo = &bufferInfo;
+
+  descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  descriptorWrites[1].dstSet = descriptorSet;
+  descriptorWrites[1].dstBinding = 1;
+  descriptorWrites[1].dstArrayElement = 0;
+  descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  descriptorWrites[1].descriptorCount = 1;
+  descriptorWrites[1].pImageInfo = &imageInfo;
+
+  vkUpdateDescriptorSets(
+    device,
+    static_cast<uint32_t>(descriptorWrites.size()),
+    descriptorWrites.data(), 0, nullptr);
 
-  for (size_t i = 0; i < swapChainImages.size(); i++) {
-    VkDescriptorBufferInfo bufferInfo = {};
-    bufferInfo.buffer = uniformBuffers[i];
-    bufferInfo.offset = 0;
-    bufferInfo.range = sizeof(UniformBufferObject);
-
-    VkDescriptorImageInfo imageInfo = {};
-    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    imageInfo.imageView = textureImageView;
-    imageInfo.sampler = textureSampler;
-
-    std::array<VkWriteDescriptorSet, 2> descriptorWrites = {};
-
-    descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    descriptorWrites[0].dstSet = descriptorSets[i];
-    descriptorWrites[0].dstBinding = 0;
-    descriptorWrites[0].dstArrayElement = 0;
-    descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    descriptorWrites[0].descriptorCount = 1;
-    descriptorWrites[0].pBufferInfo = &bufferInfo;
-
-    descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    descriptorWrites[1].dstSet = descriptorSets[i];
-    descriptorWrites[1].dstBinding = 1;
-    descriptorWrites[1].dstArrayElement = 0;
-    descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    descriptorWrites[1].descriptorCount = 1;
-    descriptorWrites[1].pImageInfo = &imageInfo;
-
-    vkUpdateDescriptorSets(
-      device,
-      static_cast<uint32_t>(descriptorWrites.size()),
-      descriptorWrites.data(), 0, nullptr);
-  }
+  // Instance buffers are created on first use
+  instanceBuffers.resize(frameSlots, VK_NULL_HANDLE);
+  instanceBuffersMemory.resize(frameSlots);
+  instanceBufferCapacities.resize(frameSlots, 0);
 
   // Create command buffers
-  commandBuffers.resize(swapChainFramebuffers.size());
+  commandBuffers.resize(frameSlots);
   VkCommandBufferAllocateInfo commandBufferAllocInfo = {};
   commandBufferAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
   commandBufferAllocInfo.commandPool = commandPool;
@@ -991,46 +2109,232 @@ void Cacus::createCommandBuffers() {
   if (vkAllocateCommandBuffers(device, &commandBufferAllocInfo, commandBuffers.data()) != VK_SUCCESS)
     throw std::runtime_error("Failed to allocate command buffers!");
 
-  for (size_t i = 0; i < commandBuffers.size(); i++) {
-    VkCommandBufferBeginInfo beginInfo = {};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = 0; // Optional
-    beginInfo.pInheritanceInfo = nullptr; // Optional
+  // One recording task per worker, each with a pool per frame in flight
+  workers.start(recordingThreads);
+  const uint32_t taskCount = workers.getWorkerCount();
+  QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+
+  recordingFrames.resize(frameSlots);
+  for (RecordingFrame &frame : recordingFrames) {
+    frame.commandPools.resize(taskCount);
+    frame.commandBuffers.resize(taskCount);
+
+    for (uint32_t i = 0; i < taskCount; i++) {
+      VkCommandPoolCreateInfo poolInfo = {};
+      poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+      poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+      // Reset as a whole each frame rather than per command buffer
+      poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+      if (vkCreateCommandPool(device, &poolInfo, nullptr, &frame.commandPools[i]) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create command pool!");
+
+      VkCommandBufferAllocateInfo secondaryAllocInfo = {};
+      secondaryAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+      secondaryAllocInfo.commandPool = frame.commandPools[i];
+      secondaryAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+      secondaryAllocInfo.commandBufferCount = 1;
+
+      if (vkAllocateCommandBuffers(device, &secondaryAllocInfo, &frame.commandBuffers[i]) != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate command buffers!");
+    }
+  }
+}
 
-    if (vkBeginCommandBuffer(commandBuffers[i], &beginInfo) != VK_SUCCESS)
-      throw std::runtime_error("Failed to begin recording command buffer!");
+void Cacus::recordCommandBuffer(uint32_t imageIndex) {
+  CACUS_PROFILE_SCOPE("recordCommandBuffer");
+  VkCommandBuffer commandBuffer = commandBuffers[currentFrame];
+  vkResetCommandBuffer(commandBuffer, 0);
+
+  // The frame completed, its secondary command buffers can be reused
+  const RecordingFrame &recordingFrame = recordingFrames[currentFrame];
+  for (VkCommandPool pool : recordingFrame.commandPools)
+    vkResetCommandPool(device, pool, 0);
+
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  beginInfo.pInheritanceInfo = nullptr; // Optional
+
+  if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+    throw std::runtime_error("Failed to begin recording command buffer!");
+
+  frameGraph.setImage(backbuffer, swapChainImages[imageIndex], swapChainImageViews[imageIndex]);
+
+  if (gpuProfiling) {
+    // Groups are timed outside of their render pass, statistics cover the
+    // secondary command buffers they execute
+    profiler.reset(commandBuffer);
+    const uint32_t frameScope = profiler.beginScope(commandBuffer, "frame", false);
+
+    uint32_t groupScope = GPU_SCOPE_NONE;
+    frameGraph.execute(commandBuffer, [this, &groupScope](VkCommandBuffer groupCommandBuffer, uint32_t group, bool begin) {
+      if (begin)
+        groupScope = profiler.beginScope(groupCommandBuffer, frameGraph.getGroupName(group), true);
+      else
+        profiler.endScope(groupCommandBuffer, groupScope);
+    });
+
+    profiler.endScope(commandBuffer, frameScope);
+  } else
+    frameGraph.execute(commandBuffer);
+
+  if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+    throw std::runtime_error("failed to record command buffer!");
+}
 
-    VkRenderPassBeginInfo renderPassInfo = {};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = renderPass;
-    renderPassInfo.framebuffer = swapChainFramebuffers[i];
-    renderPassInfo.renderArea.offset = {0, 0};
-    renderPassInfo.renderArea.extent = swapChainExtent;
+void Cacus::splitDraws() {
+  drawnMeshes.clear();
+  std::vector<uint32_t> drawCounts;
+  uint32_t totalDraws = 0;
+
+  for (MeshHandle handle = 0; handle < meshes.size(); handle++) {
+    const Mesh &mesh = meshes[handle];
+    if (mesh.instances.empty())
+      continue;
+
+    // Draw calls of the mesh, at most one per chunk of each level
+    uint32_t draws = 0;
+    for (size_t lod = 0; lod < mesh.lods.size(); lod++) {
+      if (gpuCulling || mesh.lodInstanceCounts[lod] > 0)
+        draws += gpuCulling && multiDrawIndirect ? 1 : mesh.lods[lod].chunkCount;
+    }
+
+    drawnMeshes.push_back(handle);
+    drawCounts.push_back(draws);
+    totalDraws += draws;
+  }
 
-    std::array<VkClearValue, 2> clearValues = {};
-    clearValues[0].color = {0.0f, 0.0f, 0.0f, 1.0f};
-    clearValues[1].depthStencil = {1.0f, 0};
+  // Small frames are recorded by fewer tasks, each range is contiguous
+  const uint32_t taskCount = std::max(1u, std::min(
+    workers.getWorkerCount(),
+    totalDraws / MIN_DRAWS_PER_RECORDING_TASK));
 
-    renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-    renderPassInfo.pClearValues = clearValues.data();
+  recordingRanges.clear();
+  recordingRanges.push_back(0);
+  if (drawnMeshes.empty())
+    return;
+
+  uint32_t draws = 0;
+  for (size_t i = 0; i < drawnMeshes.size(); i++) {
+    draws += drawCounts[i];
+    const uint64_t target = uint64_t(totalDraws) * recordingRanges.size() / taskCount;
+    if (draws >= target && recordingRanges.size() < taskCount)
+      recordingRanges.push_back(i + 1);
+  }
+
+  if (recordingRanges.back() != drawnMeshes.size())
+    recordingRanges.push_back(drawnMeshes.size());
+}
+
+void Cacus::recordDraws(VkCommandBuffer commandBuffer, const RenderPassContext &context, size_t firstMesh, size_t meshEnd) const {
+  CACUS_PROFILE_SCOPE("recordDraws");
+  VkCommandBufferInheritanceInfo inheritanceInfo = {};
+  inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+  inheritanceInfo.renderPass = context.renderPass;
+  inheritanceInfo.subpass = context.subpass;
+  inheritanceInfo.framebuffer = context.framebuffer;
+  inheritanceInfo.pipelineStatistics = gpuProfiling ? profiler.getStatisticFlags() : 0;
+
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+  beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+  if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+    throw std::runtime_error("Failed to begin recording command buffer!");
+
+  // Secondary command buffers inherit no state
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+
+  VkViewport viewport = {};
+  viewport.x = 0.0f;
+  viewport.y = 0.0f;
+  viewport.width = (float) context.extent.width;
+  viewport.height = (float) context.extent.height;
+  viewport.minDepth = 0.0f;
+  viewport.maxDepth = 1.0f;
+  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
-    vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-    vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+  VkRect2D scissor = {};
+  scissor.offset = {0, 0};
+  scissor.extent = context.extent;
+  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+  // Bound once at the uniforms of the frame, instances index their own
+  // uniforms and material
+  const uint32_t frameOffset = static_cast<uint32_t>(uniforms.getFrameOffset());
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 1, &frameOffset);
+  if (bindless)
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &bindlessDescriptorSet, 0, nullptr);
+
+  if (gpuCulling) {
+    // One indirect draw per level of detail of each mesh, over the instances
+    // that passed culling
+    const CullingFrame &frame = cullingFrames[currentFrame];
+    const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
+    for (size_t drawn = firstMesh; drawn < meshEnd; drawn++) {
+      const Mesh &mesh = meshes[drawnMeshes[drawn]];
+
+      vkCmdBindIndexBuffer(commandBuffer, mesh.indexBuffer, 0, mesh.indexType);
+      vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(VertexDequantization), &mesh.dequantization);
+
+      for (uint32_t lod = 0; lod < mesh.lods.size(); lod++) {
+        const MeshLodRange &range = mesh.lods[lod];
+        if (range.chunkCount == 0)
+          continue;
+
+        const uint32_t firstVisible = mesh.firstVisible + lod * static_cast<uint32_t>(mesh.instances.size());
+        const VkDeviceSize offsets[] = { 0, sizeof(Instance) * firstVisible };
+        const VkBuffer buffers[] = { mesh.vertexBuffer, frame.visibleBuffer };
+        vkCmdBindVertexBuffers(commandBuffer, 0, 2, buffers, offsets);
+
+        // Without multiDrawIndirect, one draw per chunk
+        const uint32_t drawsPerCall = multiDrawIndirect ? range.chunkCount : 1;
+
+        for (uint32_t chunk = 0; chunk < range.chunkCount; chunk += drawsPerCall) {
+          const VkDeviceSize commandOffset = stride * (mesh.firstCommand + range.firstChunk + chunk);
+          if (cmdDrawIndexedIndirectCount) {
+            const VkDeviceSize countOffset = frame.drawCountOffset + sizeof(uint32_t) * (mesh.firstLod + lod);
+            cmdDrawIndexedIndirectCount(commandBuffer, frame.indirectBuffer, commandOffset, frame.indirectBuffer, countOffset, drawsPerCall, stride);
+          } else
+            vkCmdDrawIndexedIndirect(commandBuffer, frame.indirectBuffer, commandOffset, drawsPerCall, stride);
+        }
+      }
+    }
+  } else {
+    // One instanced draw per level of detail of each mesh, instances are
+    // addressed with firstInstance
+    if (instanceBuffers[currentFrame] != VK_NULL_HANDLE) {
+      VkDeviceSize instanceOffset = 0;
+      vkCmdBindVertexBuffers(commandBuffer, 1, 1, &instanceBuffers[currentFrame], &instanceOffset);
+    }
 
-    VkBuffer vertexBuffers[] = { vertexBuffer };
-    VkDeviceSize offsets[] = { 0 };
+    for (size_t drawn = firstMesh; drawn < meshEnd; drawn++) {
+      const Mesh &mesh = meshes[drawnMeshes[drawn]];
 
-    vkCmdBindVertexBuffers(commandBuffers[i], 0, 1, vertexBuffers, offsets);
-    vkCmdBindIndexBuffer(commandBuffers[i], indexBuffer, 0, VK_INDEX_TYPE_UINT32);
-    
-    vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[i], 0, nullptr);
+      VkDeviceSize offset = 0;
+      vkCmdBindVertexBuffers(commandBuffer, 0, 1, &mesh.vertexBuffer, &offset);
+      vkCmdBindIndexBuffer(commandBuffer, mesh.indexBuffer, 0, mesh.indexType);
+      vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(VertexDequantization), &mesh.dequantization);
 
-    vkCmdDrawIndexed(commandBuffers[i], static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+      uint32_t firstInstance = mesh.firstInstance;
+      for (size_t lod = 0; lod < mesh.lods.size(); lod++) {
+        const uint32_t lodInstanceCount = mesh.lodInstanceCounts[lod];
+        const MeshLodRange &range = mesh.lods[lod];
 
-    vkCmdEndRenderPass(commandBuffers[i]);
-    if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS)
-      throw std::runtime_error("failed to record command buffer!");
+        for (uint32_t i = range.firstChunk; lodInstanceCount > 0 && i < range.firstChunk + range.chunkCount; i++) {
+          const MeshChunk &chunk = mesh.chunks[i];
+          vkCmdDrawIndexed(commandBuffer, chunk.indexCount, lodInstanceCount, chunk.firstIndex, chunk.vertexOffset, firstInstance);
+        }
+        firstInstance += lodInstanceCount;
+      }
+    }
   }
+
+  if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+    throw std::runtime_error("failed to record command buffer!");
 }
 
 void Cacus::setTransform(const glm::mat4 &model, const glm::mat4 &view, const glm::mat4 &proj) {
@@ -1039,38 +2343,143 @@ void Cacus::setTransform(const glm::mat4 &model, const glm::mat4 &view, const gl
   ubo.proj = proj;
 }
 
-void Cacus::updateUniformBuffer(uint32_t currentImage) {
-  void* data;
-  vkMapMemory(device, uniformBuffersMemory[currentImage], 0, sizeof(ubo), 0, &data);
-      memcpy(data, &ubo, sizeof(ubo));
-  vkUnmapMemory(device, uniformBuffersMemory[currentImage]);
+void Cacus::setFramePolicy(const FramePolicy &policy) {
+  if (policy.framesInFlight == 0 || (initialized && policy.framesInFlight > frameSlots))
+    throw std::invalid_argument("invalid number of frames in flight!");
+  if (frameBegun)
+    throw std::runtime_error("frame policy cannot change during a frame!");
+
+  // Offscreen targets are one per frame in flight
+  const bool targetsChanged = headless
+    ? policy.framesInFlight != maxFramesInFlight
+    : policy.extraImages != framePolicy.extraImages || policy.presentModes != framePolicy.presentModes;
+
+  framePolicy = policy;
+  if (!initialized) {
+    maxFramesInFlight = policy.framesInFlight;
+    return;
+  }
+
+  // Frames of the previous policy complete before any slot is reused
+  vkDeviceWaitIdle(device);
+  maxFramesInFlight = policy.framesInFlight;
+  currentFrame = 0;
+
+  if (!targetsChanged)
+    return;
+
+  if (headless)
+    lastFrame = SIZE_MAX;
+
+  recreateSwapChain(width, height);
+}
+
+void Cacus::setGpuProfiling(bool enabled) {
+  if (enabled && !profiler.isInitialized())
+    throw std::runtime_error("timestamps not supported by the graphics queue!");
+
+  gpuProfiling = enabled;
+}
+
+void Cacus::beginFrame() {
+  if (frameBegun)
+    return;
+
+  CACUS_PROFILE_SCOPE("beginFrame");
+  {
+    CACUS_PROFILE_SCOPE("wait for frame fence");
+    vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+  }
+
+  // Uploads recorded since the last frame share a single submission, the
+  // graphics queue acquires those whose copies completed meanwhile
+  uploader.flush();
+  uploader.acquire();
+  // Release staging memory of the uploads that completed meanwhile
+  uploader.collect();
+
+  // The region of this frame is no longer read by the device
+  uniforms.beginFrame(static_cast<uint32_t>(currentFrame));
+  descriptors.beginFrame(static_cast<uint32_t>(currentFrame));
+  if (profiler.isInitialized())
+    profiler.beginFrame(static_cast<uint32_t>(currentFrame), frameNumber);
+  releaseRetiredMeshes();
+  frameBegun = true;
+}
+
+void Cacus::endFrame() {
+  for (Mesh &mesh : meshes) {
+    mesh.instances.clear();
+    mesh.uniformOffset = NO_MESH_UNIFORMS;
+  }
+
+  frameNumber++;
+  frameBegun = false;
+}
+
+void Cacus::setMeshUniforms(MeshHandle mesh, const UniformAllocation &uniforms) {
+  if (mesh >= meshes.size() || meshes[mesh].vertexBuffer == VK_NULL_HANDLE)
+    throw std::invalid_argument("invalid mesh handle!");
+
+  meshes[mesh].uniformOffset = uniforms.offset;
+}
+
+UniformAllocation Cacus::allocateUniforms(VkDeviceSize size) {
+  beginFrame();
+  return uniforms.allocate(size);
 }
 
 bool Cacus::draw() {
-  vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+  CACUS_PROFILE_SCOPE("draw");
+  beginFrame();
+
+  if (headless) {
+    drawOffscreen();
+    return false;
+  }
 
   uint32_t imageIndex;
-  VkResult result = vkAcquireNextImageKHR(
-    device,
-    swapChain,
-    UINT64_MAX,
-    imageAvailableSemaphores[currentFrame],
-    VK_NULL_HANDLE,
-    &imageIndex);
+  VkResult result;
+  {
+    CACUS_PROFILE_SCOPE("acquire image");
+    result = vkAcquireNextImageKHR(
+      device,
+      swapChain,
+      UINT64_MAX,
+      imageAvailableSemaphores[currentFrame],
+      VK_NULL_HANDLE,
+      &imageIndex);
+  }
 
-  if (result == VK_ERROR_OUT_OF_DATE_KHR)
+  if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+    // The frame is skipped, instances are submitted again by the next one.
+    // It ends without counting, its fence is still signaled and waiting on
+    // it again when the next frame begins is harmless.
+    for (Mesh &mesh : meshes) {
+      mesh.instances.clear();
+      mesh.uniformOffset = NO_MESH_UNIFORMS;
+    }
+    frameBegun = false;
     return true;
-  else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+  } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
     throw std::runtime_error("failed to acquire swap chain image!");
 
   // Check if a previous frame is using this image (i.e. there is its fence to wait on)
-  if (imagesInFlight[imageIndex] != VK_NULL_HANDLE)
-      vkWaitForFences(device, 1, &imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+  if (imagesInFlight[imageIndex] != VK_NULL_HANDLE) {
+    CACUS_PROFILE_SCOPE("wait for image fence");
+    vkWaitForFences(device, 1, &imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+  }
 
   // Mark the image as now being in use by this frame
   imagesInFlight[imageIndex] = inFlightFences[currentFrame];
 
-  updateUniformBuffer(imageIndex);
+  UniformAllocation frameUniforms = allocateUniforms(sizeof(ubo));
+  {
+    CACUS_PROFILE_SCOPE("write uniforms");
+    memcpy(frameUniforms.data, &ubo, sizeof(ubo));
+  }
+  writeInstances(frameUniforms.offset);
+  recordCommandBuffer(imageIndex);
 
   VkSubmitInfo submitInfo = {};
   submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -1081,7 +2490,7 @@ bool Cacus::draw() {
   submitInfo.pWaitSemaphores = waitSemaphores;
   submitInfo.pWaitDstStageMask = waitStages;
   submitInfo.commandBufferCount = 1;
-  submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
+  submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
 
   VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
   submitInfo.signalSemaphoreCount = 1;
@@ -1089,8 +2498,12 @@ bool Cacus::draw() {
 
   vkResetFences(device, 1, &inFlightFences[currentFrame]);
 
-  if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS)
-      throw std::runtime_error("Failed to submit draw command buffer!");
+  {
+    CACUS_PROFILE_SCOPE("submit");
+    if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS)
+        throw std::runtime_error("Failed to submit draw command buffer!");
+  }
+  endFrame();
 
   VkPresentInfoKHR presentInfo = {};
   presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -1104,33 +2517,126 @@ bool Cacus::draw() {
   presentInfo.pImageIndices = &imageIndex;
 
   presentInfo.pResults = nullptr; // Optional
-  result = vkQueuePresentKHR(presentQueue, &presentInfo);
+  {
+    // Blocks when the swap chain has no image free, e.g. under FIFO
+    CACUS_PROFILE_SCOPE("present");
+    result = vkQueuePresentKHR(presentQueue, &presentInfo);
+  }
 
   if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
     return true;
   else if (result != VK_SUCCESS)
     throw std::runtime_error("failed to present swap chain image!");
 
-  currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+  currentFrame = (currentFrame + 1) % maxFramesInFlight;
   return false;
 }
 
+void Cacus::drawOffscreen() {
+  CACUS_PROFILE_SCOPE("drawOffscreen");
+  // Each frame in flight owns its render target
+  const uint32_t imageIndex = static_cast<uint32_t>(currentFrame);
+
+  UniformAllocation frameUniforms = allocateUniforms(sizeof(ubo));
+  {
+    CACUS_PROFILE_SCOPE("write uniforms");
+    memcpy(frameUniforms.data, &ubo, sizeof(ubo));
+  }
+  writeInstances(frameUniforms.offset);
+  recordCommandBuffer(imageIndex);
+
+  VkSubmitInfo submitInfo = {};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
+
+  vkResetFences(device, 1, &inFlightFences[currentFrame]);
+
+  {
+    CACUS_PROFILE_SCOPE("submit");
+    if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS)
+        throw std::runtime_error("Failed to submit draw command buffer!");
+  }
+  endFrame();
+
+  lastFrame = currentFrame;
+  currentFrame = (currentFrame + 1) % maxFramesInFlight;
+}
+
+VkImage Cacus::getFrameImage() const {
+  if (!headless || lastFrame == SIZE_MAX)
+    return VK_NULL_HANDLE;
+
+  return swapChainImages[lastFrame];
+}
+
+void Cacus::readFrame(std::vector<unsigned char> &pixels) {
+  if (!headless)
+    throw std::runtime_error("Frames can only be read back in headless mode");
+  if (lastFrame == SIZE_MAX)
+    throw std::runtime_error("No frame has been drawn");
+
+  vkWaitForFences(device, 1, &inFlightFences[lastFrame], VK_TRUE, UINT64_MAX);
+
+  VkDeviceSize imageSize = static_cast<VkDeviceSize>(swapChainExtent.width) * swapChainExtent.height * 4;
+
+  VkBuffer readbackBuffer;
+  Allocation readbackBufferMemory;
+  createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, readbackBuffer, readbackBufferMemory);
+
+  VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+
+  VkBufferImageCopy region = {};
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.layerCount = 1;
+  region.imageExtent = { swapChainExtent.width, swapChainExtent.height, 1 };
+
+  vkCmdCopyImageToBuffer(commandBuffer, swapChainImages[lastFrame], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer, 1, &region);
+  endSingleTimeCommands(commandBuffer);
+
+  pixels.resize(static_cast<size_t>(imageSize));
+
+  memcpy(pixels.data(), readbackBufferMemory.mapped, static_cast<size_t>(imageSize));
+
+  vkDestroyBuffer(device, readbackBuffer, nullptr);
+  allocator.free(readbackBufferMemory);
+}
+
 void Cacus::recreateSwapChain(uint32_t newWidth, uint32_t newHeight) {
   if (newWidth == 0 || newHeight == 0)
     return;
 
-  vkDeviceWaitIdle(device);
+  CACUS_PROFILE_SCOPE("recreateSwapChain");
+  {
+    CACUS_PROFILE_SCOPE("wait for device idle");
+    vkDeviceWaitIdle(device);
+  }
 
   cleanupSwapChain();
 
   width = newWidth;
   height = newHeight;
 
-  // Recreate swap chain
+  const VkFormat oldFormat = swapChainImageFormat;
+  createRenderTargets();
+
+  // The image count may have changed, and no frame is in flight
+  if (!imagesInFlight.empty())
+    imagesInFlight.assign(swapChainImages.size(), VK_NULL_HANDLE);
+
+  // Render passes and the pipeline only depend on the format of the
+  // targets, a new size only recreates the transient images and
+  // framebuffers
+  if (swapChainImageFormat == oldFormat) {
+    frameGraph.resize(swapChainExtent.width, swapChainExtent.height);
+    return;
+  }
+
+  vkDestroyPipeline(device, graphicsPipeline, nullptr);
+  vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+
+  buildFrameGraph();
   createGraphicsPipeline();
-  preFinalize();
-  createFrameBuffers();
-  createCommandBuffers();
 }
 
 VkShaderModule Cacus::createShaderModule(const std::vector<char> &code) const {
@@ -1159,9 +2665,9 @@ VkSurfaceFormatKHR Cacus::chooseSwapSurfaceFormat(const std::vector<VkSurfaceFor
 }
 
 VkPresentModeKHR Cacus::chooseSwapPresentMode(const std::vector<VkPresentModeKHR> &availablePresentModes) const {
-  for (const auto& availablePresentMode : availablePresentModes) {
-    if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR)
-      return availablePresentMode;
+  for (VkPresentModeKHR presentMode : framePolicy.presentModes) {
+    if (std::find(availablePresentModes.begin(), availablePresentModes.end(), presentMode) != availablePresentModes.end())
+      return presentMode;
   }
 
   // FIFO is guaranteed to be available
@@ -1189,6 +2695,14 @@ VkExtent2D Cacus::chooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities)
 bool Cacus::isDeviceSuitable(const VkPhysicalDevice &device) const {
   // Device is suitable if it allows a queue family
   QueueFamilyIndices indices = findQueueFamilies(device);
+
+  VkPhysicalDeviceFeatures supportedFeatures;
+  vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
+
+  // Offscreen rendering only needs graphics
+  if (headless)
+    return indices.graphicsFamily.has_value() && supportedFeatures.samplerAnisotropy;
+
   bool swapChainAdequate = false;
   const bool extensionsSupported = checkDeviceExtensionSupport(device);
   if (extensionsSupported) {
@@ -1196,9 +2710,6 @@ bool Cacus::isDeviceSuitable(const VkPhysicalDevice &device) const {
       swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
   }
 
-  VkPhysicalDeviceFeatures supportedFeatures;
-  vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
-
   return indices.isComplete() &&
           swapChainAdequate &&
           supportedFeatures.samplerAnisotropy &&
@@ -1241,17 +2752,44 @@ QueueFamilyIndices Cacus::findQueueFamilies(const VkPhysicalDevice &device) cons
     if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
         indices.graphicsFamily = i;
 
+    // Prefer a transfer only family (DMA engine) over an async compute one
+    if ((queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+      const bool transferOnly = !(queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT);
+      if (!indices.transferFamily.has_value() || transferOnly)
+        indices.transferFamily = i;
+    }
+
     VkBool32 presentSupport = false;
-    vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+    if (surface != VK_NULL_HANDLE)
+      vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
     if (presentSupport)
       indices.presentFamily = i;
 
     ++i;
   }
 
+  // Graphics queues implicitly support transfers
+  if (!indices.transferFamily.has_value())
+    indices.transferFamily = indices.graphicsFamily;
+
   return indices;
 }
 
+bool Cacus::hasDeviceExtension(const char *name) const {
+  uint32_t extensionCount;
+  vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+
+  std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+
+  for (const auto& extension : availableExtensions) {
+    if (strcmp(extension.extensionName, name) == 0)
+      return true;
+  }
+
+  return false;
+}
+
 bool Cacus::checkDeviceExtensionSupport(const VkPhysicalDevice &device) const {
   uint32_t extensionCount;
   vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
@@ -0,0 +1,168 @@
+#include <cpu_profiler.h>
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+static std::atomic<uint64_t> nextProfilerId(1);
+
+/**
+ * Writes a string as a JSON string literal.
+ */
+static void writeJsonString(std::ostream &out, const char *text) {
+  out << '"';
+  for (const char *c = text; *c; c++) {
+    if (*c == '"' || *c == '\\')
+      out << '\\' << *c;
+    else if (static_cast<unsigned char>(*c) < 0x20)
+      out << ' ';
+    else
+      out << *c;
+  }
+  out << '"';
+}
+
+CpuProfiler::CpuProfiler(size_t eventsPerThread) :
+  id(nextProfilerId++),
+  eventsPerThread(eventsPerThread > 0 ? eventsPerThread : 1),
+  epoch(std::chrono::steady_clock::now()),
+  enabled(false)
+{}
+
+uint64_t CpuProfiler::now() const {
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now() - epoch).count());
+}
+
+CpuProfiler::ThreadRing &CpuProfiler::getThreadRing() {
+  // Threads mostly record to one profiler, the last ring used is cached
+  thread_local uint64_t cachedProfiler = 0;
+  thread_local ThreadRing *cachedRing = nullptr;
+  if (cachedProfiler == id)
+    return *cachedRing;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  const std::thread::id thread = std::this_thread::get_id();
+
+  ThreadRing *ring = nullptr;
+  for (const std::unique_ptr<ThreadRing> &existing : rings) {
+    if (existing->thread == thread)
+      ring = existing.get();
+  }
+
+  if (!ring) {
+    rings.emplace_back(new ThreadRing());
+    ring = rings.back().get();
+    ring->thread = thread;
+    ring->name = "thread " + std::to_string(rings.size() - 1);
+    ring->events.resize(eventsPerThread);
+    ring->head = 0;
+    ring->tail = 0;
+  }
+
+  cachedProfiler = id;
+  cachedRing = ring;
+  return *ring;
+}
+
+void CpuProfiler::record(const char *name, uint64_t start, uint64_t end) {
+  ThreadRing &ring = getThreadRing();
+
+  const uint64_t head = ring.head.load(std::memory_order_relaxed);
+  CpuProfileEvent &event = ring.events[head % ring.events.size()];
+  event.name = name;
+  event.start = start;
+  event.duration = end > start ? end - start : 0;
+
+  // Publishes the event to readers
+  ring.head.store(head + 1, std::memory_order_release);
+}
+
+void CpuProfiler::setThreadName(const std::string &name) {
+  ThreadRing &ring = getThreadRing();
+
+  std::lock_guard<std::mutex> lock(mutex);
+  ring.name = name;
+}
+
+std::vector<CpuProfileEvent> CpuProfiler::readRing(const ThreadRing &ring) const {
+  const uint64_t capacity = ring.events.size();
+  const uint64_t head = ring.head.load(std::memory_order_acquire);
+  const uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+  uint64_t first = std::max(tail, head > capacity ? head - capacity : 0);
+
+  std::vector<CpuProfileEvent> events;
+  events.reserve(static_cast<size_t>(head - first));
+  for (uint64_t i = first; i < head; i++)
+    events.push_back(ring.events[i % capacity]);
+
+  // Events the thread wrapped around to while copying may be torn
+  std::atomic_thread_fence(std::memory_order_acquire);
+  const uint64_t headAfter = ring.head.load(std::memory_order_relaxed);
+  if (headAfter > capacity && headAfter - capacity > first) {
+    const uint64_t overwritten = std::min(headAfter - capacity, head) - first;
+    events.erase(events.begin(), events.begin() + static_cast<ptrdiff_t>(overwritten));
+  }
+
+  return events;
+}
+
+std::vector<std::vector<CpuProfileEvent>> CpuProfiler::getEvents() const {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  std::vector<std::vector<CpuProfileEvent>> events;
+  for (const std::unique_ptr<ThreadRing> &ring : rings)
+    events.push_back(readRing(*ring));
+  return events;
+}
+
+void CpuProfiler::clear() {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (const std::unique_ptr<ThreadRing> &ring : rings)
+    ring->tail.store(ring->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+}
+
+void CpuProfiler::writeChromeTrace(std::ostream &out) const {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  out << "{\"traceEvents\":[";
+  bool first = true;
+
+  for (size_t thread = 0; thread < rings.size(); thread++) {
+    const ThreadRing &ring = *rings[thread];
+
+    // Names the track of the thread
+    out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << thread
+        << ",\"args\":{\"name\":";
+    writeJsonString(out, ring.name.c_str());
+    out << "}}";
+    first = false;
+
+    // Complete events, in microseconds
+    for (const CpuProfileEvent &event : readRing(ring)) {
+      out << ",\n{\"name\":";
+      writeJsonString(out, event.name);
+      out << ",\"ph\":\"X\",\"pid\":0,\"tid\":" << thread
+          << ",\"ts\":" << event.start / 1000 << '.' << (event.start % 1000) / 100 << (event.start % 100) / 10 << event.start % 10
+          << ",\"dur\":" << event.duration / 1000 << '.' << (event.duration % 1000) / 100 << (event.duration % 100) / 10 << event.duration % 10
+          << '}';
+    }
+  }
+
+  out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+void CpuProfiler::writeChromeTrace(const std::string &path) const {
+  std::ofstream file(path, std::ios::trunc);
+  if (!file)
+    throw std::runtime_error("failed to open trace file!");
+
+  writeChromeTrace(file);
+  if (!file)
+    throw std::runtime_error("failed to write trace file!");
+}
+
+CpuProfiler &getCpuProfiler() {
+  static CpuProfiler profiler;
+  return profiler;
+}
@@ -0,0 +1,245 @@
+#include <descriptor_allocator.h>
+
+#include <cmath>
+#include <stdexcept>
+
+// Sets of the first pool of a chain, each next pool holds twice as many
+static const uint32_t INITIAL_POOL_SETS = 16;
+static const uint32_t MAX_POOL_SETS = 1024;
+
+// Info a descriptor is written from
+typedef enum DescriptorInfoKindEnum {
+  DESCRIPTOR_INFO_IMAGE,
+  DESCRIPTOR_INFO_BUFFER,
+  DESCRIPTOR_INFO_TEXEL_BUFFER
+} DescriptorInfoKind;
+
+static DescriptorInfoKind getDescriptorInfoKind(VkDescriptorType type) {
+  switch (type) {
+    case VK_DESCRIPTOR_TYPE_SAMPLER:
+    case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+    case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+    case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+    case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+      return DESCRIPTOR_INFO_IMAGE;
+    case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+    case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+      return DESCRIPTOR_INFO_TEXEL_BUFFER;
+    default:
+      return DESCRIPTOR_INFO_BUFFER;
+  }
+}
+
+static size_t getDescriptorInfoSize(DescriptorInfoKind kind) {
+  switch (kind) {
+    case DESCRIPTOR_INFO_IMAGE:
+      return sizeof(VkDescriptorImageInfo);
+    case DESCRIPTOR_INFO_TEXEL_BUFFER:
+      return sizeof(VkBufferView);
+    default:
+      return sizeof(VkDescriptorBufferInfo);
+  }
+}
+
+std::vector<VkWriteDescriptorSet> expandDescriptorUpdate(
+  VkDescriptorSet set,
+  const std::vector<VkDescriptorUpdateTemplateEntryKHR> &entries,
+  const void *data) {
+  std::vector<VkWriteDescriptorSet> writes;
+
+  for (const VkDescriptorUpdateTemplateEntryKHR &entry : entries) {
+    const DescriptorInfoKind kind = getDescriptorInfoKind(entry.descriptorType);
+
+    // Contiguous infos are written at once
+    const bool contiguous = entry.descriptorCount <= 1 || entry.stride == getDescriptorInfoSize(kind);
+    const uint32_t writeCount = contiguous ? 1 : entry.descriptorCount;
+
+    for (uint32_t i = 0; i < writeCount; i++) {
+      const char *info = static_cast<const char*>(data) + entry.offset + entry.stride * i;
+
+      VkWriteDescriptorSet write = {};
+      write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      write.dstSet = set;
+      write.dstBinding = entry.dstBinding;
+      write.dstArrayElement = entry.dstArrayElement + i;
+      write.descriptorType = entry.descriptorType;
+      write.descriptorCount = contiguous ? entry.descriptorCount : 1;
+
+      if (kind == DESCRIPTOR_INFO_IMAGE)
+        write.pImageInfo = reinterpret_cast<const VkDescriptorImageInfo*>(info);
+      else if (kind == DESCRIPTOR_INFO_TEXEL_BUFFER)
+        write.pTexelBufferView = reinterpret_cast<const VkBufferView*>(info);
+      else
+        write.pBufferInfo = reinterpret_cast<const VkDescriptorBufferInfo*>(info);
+
+      writes.push_back(write);
+    }
+  }
+
+  return writes;
+}
+
+DescriptorAllocator::DescriptorAllocator() :
+  device(VK_NULL_HANDLE),
+  currentFrame(0),
+  createDescriptorUpdateTemplate(nullptr),
+  destroyDescriptorUpdateTemplate(nullptr),
+  updateDescriptorSetWithTemplate(nullptr)
+{
+  persistentChain.current = 0;
+}
+
+void DescriptorAllocator::init(
+  VkDevice newDevice,
+  const std::vector<DescriptorPoolRatio> &newRatios,
+  uint32_t frameCount,
+  bool updateTemplates) {
+  device = newDevice;
+  ratios = newRatios;
+
+  persistentChain = {};
+  frameChains.assign(frameCount, PoolChain{});
+  currentFrame = 0;
+
+  if (updateTemplates) {
+    createDescriptorUpdateTemplate = reinterpret_cast<PFN_vkCreateDescriptorUpdateTemplateKHR>(
+      vkGetDeviceProcAddr(device, "vkCreateDescriptorUpdateTemplateKHR"));
+    destroyDescriptorUpdateTemplate = reinterpret_cast<PFN_vkDestroyDescriptorUpdateTemplateKHR>(
+      vkGetDeviceProcAddr(device, "vkDestroyDescriptorUpdateTemplateKHR"));
+    updateDescriptorSetWithTemplate = reinterpret_cast<PFN_vkUpdateDescriptorSetWithTemplateKHR>(
+      vkGetDeviceProcAddr(device, "vkUpdateDescriptorSetWithTemplateKHR"));
+  }
+}
+
+void DescriptorAllocator::destroy() {
+  destroyChain(persistentChain);
+  for (PoolChain &chain : frameChains)
+    destroyChain(chain);
+  frameChains.clear();
+}
+
+void DescriptorAllocator::destroyChain(PoolChain &chain) {
+  for (VkDescriptorPool pool : chain.pools)
+    vkDestroyDescriptorPool(device, pool, nullptr);
+  chain.pools.clear();
+  chain.current = 0;
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout) {
+  return allocate(persistentChain, layout);
+}
+
+void DescriptorAllocator::beginFrame(uint32_t frame) {
+  currentFrame = frame;
+
+  PoolChain &chain = frameChains[frame];
+  for (size_t i = 0; i < chain.pools.size() && i <= chain.current; i++)
+    vkResetDescriptorPool(device, chain.pools[i], 0);
+  chain.current = 0;
+}
+
+VkDescriptorSet DescriptorAllocator::allocateTransient(VkDescriptorSetLayout layout) {
+  return allocate(frameChains[currentFrame], layout);
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(PoolChain &chain, VkDescriptorSetLayout layout) {
+  VkDescriptorSetAllocateInfo allocInfo = {};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &layout;
+
+  // Exhausted pools report VK_ERROR_OUT_OF_POOL_MEMORY_KHR or
+  // VK_ERROR_FRAGMENTED_POOL, or any error before VK_KHR_maintenance1.
+  // Only a failure from a pool just created is final.
+  while (true) {
+    bool created = false;
+    if (chain.current == chain.pools.size()) {
+      uint32_t setCount = INITIAL_POOL_SETS;
+      for (size_t i = 0; i < chain.pools.size() && setCount < MAX_POOL_SETS; i++)
+        setCount *= 2;
+      chain.pools.push_back(createPool(setCount));
+      created = true;
+    }
+
+    allocInfo.descriptorPool = chain.pools[chain.current];
+
+    VkDescriptorSet set;
+    const VkResult result = vkAllocateDescriptorSets(device, &allocInfo, &set);
+    if (result == VK_SUCCESS)
+      return set;
+    if (created)
+      throw std::runtime_error("failed to allocate descriptor set!");
+
+    chain.current++;
+  }
+}
+
+VkDescriptorPool DescriptorAllocator::createPool(uint32_t setCount) const {
+  std::vector<VkDescriptorPoolSize> poolSizes;
+  for (const DescriptorPoolRatio &ratio : ratios) {
+    VkDescriptorPoolSize poolSize = {};
+    poolSize.type = ratio.type;
+    poolSize.descriptorCount = static_cast<uint32_t>(std::ceil(ratio.descriptorsPerSet * setCount));
+    if (poolSize.descriptorCount > 0)
+      poolSizes.push_back(poolSize);
+  }
+
+  VkDescriptorPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+  poolInfo.pPoolSizes = poolSizes.data();
+  poolInfo.maxSets = setCount;
+
+  VkDescriptorPool pool;
+  if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS)
+    throw std::runtime_error("failed to create descriptor pool!");
+
+  return pool;
+}
+
+DescriptorUpdateTemplate DescriptorAllocator::createUpdateTemplate(
+  VkDescriptorSetLayout layout,
+  const std::vector<VkDescriptorUpdateTemplateEntryKHR> &entries) {
+  DescriptorUpdateTemplate updateTemplate = {};
+  updateTemplate.handle = VK_NULL_HANDLE;
+  updateTemplate.entries = entries;
+
+  if (!createDescriptorUpdateTemplate)
+    return updateTemplate;
+
+  VkDescriptorUpdateTemplateCreateInfoKHR createInfo = {};
+  createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO_KHR;
+  createInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(entries.size());
+  createInfo.pDescriptorUpdateEntries = entries.data();
+  createInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET_KHR;
+  createInfo.descriptorSetLayout = layout;
+
+  if (createDescriptorUpdateTemplate(device, &createInfo, nullptr, &updateTemplate.handle) != VK_SUCCESS)
+    throw std::runtime_error("failed to create descriptor update template!");
+
+  return updateTemplate;
+}
+
+void DescriptorAllocator::destroyUpdateTemplate(DescriptorUpdateTemplate &updateTemplate) {
+  if (updateTemplate.handle != VK_NULL_HANDLE)
+    destroyDescriptorUpdateTemplate(device, updateTemplate.handle, nullptr);
+  updateTemplate.handle = VK_NULL_HANDLE;
+  updateTemplate.entries.clear();
+}
+
+void DescriptorAllocator::update(VkDescriptorSet set, const DescriptorUpdateTemplate &updateTemplate, const void *data) const {
+  if (updateTemplate.handle != VK_NULL_HANDLE) {
+    updateDescriptorSetWithTemplate(device, set, updateTemplate.handle, data);
+    return;
+  }
+
+  const std::vector<VkWriteDescriptorSet> writes = expandDescriptorUpdate(set, updateTemplate.entries, data);
+  vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+size_t DescriptorAllocator::getPoolCount() const {
+  size_t count = persistentChain.pools.size();
+  for (const PoolChain &chain : frameChains)
+    count += chain.pools.size();
+  return count;
+}
@@ -0,0 +1,161 @@
+#include <gpu_profiler.h>
+
+#include <stdexcept>
+
+// Written in the order of GpuPipelineStatistics
+static const VkQueryPipelineStatisticFlags PIPELINE_STATISTICS =
+  VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+  VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+  VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+  VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+  VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+double getTimestampMilliseconds(uint64_t begin, uint64_t end, float timestampPeriod, uint32_t timestampValidBits) {
+  const uint64_t mask = timestampValidBits >= 64 ? UINT64_MAX : (uint64_t(1) << timestampValidBits) - 1;
+  const uint64_t ticks = (end - begin) & mask;
+  return static_cast<double>(ticks) * timestampPeriod / 1e6;
+}
+
+GpuProfiler::GpuProfiler() :
+  device(VK_NULL_HANDLE),
+  timestampPeriod(1.0f),
+  timestampValidBits(64),
+  timestampPool(VK_NULL_HANDLE),
+  statisticsPool(VK_NULL_HANDLE),
+  currentFrame(0),
+  statisticsScope(GPU_SCOPE_NONE)
+{
+  frameStats.frameNumber = 0;
+}
+
+void GpuProfiler::init(
+  VkDevice newDevice,
+  uint32_t frameCount,
+  float newTimestampPeriod,
+  uint32_t newTimestampValidBits,
+  bool pipelineStatistics) {
+  device = newDevice;
+  timestampPeriod = newTimestampPeriod;
+  timestampValidBits = newTimestampValidBits;
+
+  VkQueryPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  poolInfo.queryCount = frameCount * MAX_GPU_SCOPES * 2;
+
+  if (vkCreateQueryPool(device, &poolInfo, nullptr, &timestampPool) != VK_SUCCESS)
+    throw std::runtime_error("failed to create timestamp query pool!");
+
+  if (pipelineStatistics) {
+    poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+    poolInfo.queryCount = frameCount * MAX_GPU_SCOPES;
+    poolInfo.pipelineStatistics = PIPELINE_STATISTICS;
+
+    if (vkCreateQueryPool(device, &poolInfo, nullptr, &statisticsPool) != VK_SUCCESS)
+      throw std::runtime_error("failed to create pipeline statistics query pool!");
+  }
+
+  frames.assign(frameCount, Frame{});
+  currentFrame = 0;
+}
+
+void GpuProfiler::destroy() {
+  if (timestampPool == VK_NULL_HANDLE)
+    return;
+
+  vkDestroyQueryPool(device, timestampPool, nullptr);
+  if (statisticsPool != VK_NULL_HANDLE)
+    vkDestroyQueryPool(device, statisticsPool, nullptr);
+
+  timestampPool = VK_NULL_HANDLE;
+  statisticsPool = VK_NULL_HANDLE;
+  frames.clear();
+}
+
+VkQueryPipelineStatisticFlags GpuProfiler::getStatisticFlags() const {
+  return statisticsPool != VK_NULL_HANDLE ? PIPELINE_STATISTICS : 0;
+}
+
+void GpuProfiler::beginFrame(uint32_t frame, uint64_t frameNumber) {
+  currentFrame = frame;
+
+  Frame &previous = frames[frame];
+  if (!previous.scopes.empty())
+    readScopes(frame);
+
+  // Not read again if the next use of the frame records no scopes
+  previous.scopes.clear();
+  previous.frameNumber = frameNumber;
+}
+
+void GpuProfiler::readScopes(uint32_t frame) {
+  const Frame &previous = frames[frame];
+  const uint32_t scopeCount = static_cast<uint32_t>(previous.scopes.size());
+  std::vector<uint64_t> timestamps(scopeCount * 2);
+
+  // Complete since the fence of the frame was waited on, a frame whose
+  // queries are not all available is skipped rather than waited for
+  const VkResult result = vkGetQueryPoolResults(
+    device, timestampPool,
+    frame * MAX_GPU_SCOPES * 2, scopeCount * 2,
+    sizeof(uint64_t) * timestamps.size(), timestamps.data(),
+    sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+
+  if (result == VK_SUCCESS) {
+    frameStats.frameNumber = previous.frameNumber;
+    frameStats.scopes.resize(scopeCount);
+
+    for (uint32_t i = 0; i < scopeCount; i++) {
+      GpuScopeStats &stats = frameStats.scopes[i];
+      stats.name = previous.scopes[i].name;
+      stats.milliseconds = getTimestampMilliseconds(timestamps[i * 2], timestamps[i * 2 + 1], timestampPeriod, timestampValidBits);
+      stats.statistics = {};
+      stats.hasStatistics = previous.scopes[i].statistics && vkGetQueryPoolResults(
+        device, statisticsPool,
+        frame * MAX_GPU_SCOPES + i, 1,
+        sizeof(GpuPipelineStatistics), &stats.statistics,
+        sizeof(GpuPipelineStatistics), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS;
+    }
+  }
+}
+
+void GpuProfiler::reset(VkCommandBuffer commandBuffer) {
+  Frame &frame = frames[currentFrame];
+  frame.scopes.clear();
+  statisticsScope = GPU_SCOPE_NONE;
+
+  vkCmdResetQueryPool(commandBuffer, timestampPool, currentFrame * MAX_GPU_SCOPES * 2, MAX_GPU_SCOPES * 2);
+  if (statisticsPool != VK_NULL_HANDLE)
+    vkCmdResetQueryPool(commandBuffer, statisticsPool, currentFrame * MAX_GPU_SCOPES, MAX_GPU_SCOPES);
+}
+
+uint32_t GpuProfiler::beginScope(VkCommandBuffer commandBuffer, const std::string &name, bool statistics) {
+  Frame &frame = frames[currentFrame];
+  if (frame.scopes.size() >= MAX_GPU_SCOPES)
+    return GPU_SCOPE_NONE;
+
+  const uint32_t scope = static_cast<uint32_t>(frame.scopes.size());
+  const bool gatherStatistics = statistics && statisticsPool != VK_NULL_HANDLE && statisticsScope == GPU_SCOPE_NONE;
+  frame.scopes.push_back({ name, gatherStatistics });
+
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool, (currentFrame * MAX_GPU_SCOPES + scope) * 2);
+
+  if (gatherStatistics) {
+    vkCmdBeginQuery(commandBuffer, statisticsPool, currentFrame * MAX_GPU_SCOPES + scope, 0);
+    statisticsScope = scope;
+  }
+
+  return scope;
+}
+
+void GpuProfiler::endScope(VkCommandBuffer commandBuffer, uint32_t scope) {
+  if (scope == GPU_SCOPE_NONE)
+    return;
+
+  if (scope == statisticsScope) {
+    vkCmdEndQuery(commandBuffer, statisticsPool, currentFrame * MAX_GPU_SCOPES + scope);
+    statisticsScope = GPU_SCOPE_NONE;
+  }
+
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, (currentFrame * MAX_GPU_SCOPES + scope) * 2 + 1);
+}
@@ -0,0 +1,103 @@
+#include <ktx2.h>
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <algorithm>
+#include <vector>
+
+static const unsigned char KTX2_IDENTIFIER[12] = {
+  0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'
+};
+
+typedef struct Ktx2HeaderStruct {
+  unsigned char identifier[12];
+  uint32_t vkFormat;
+  uint32_t typeSize;
+  uint32_t pixelWidth;
+  uint32_t pixelHeight;
+  uint32_t pixelDepth;
+  uint32_t layerCount;
+  uint32_t faceCount;
+  uint32_t levelCount;
+  uint32_t supercompressionScheme;
+
+  // Index, offsets are from the start of the file
+  uint32_t dfdByteOffset;
+  uint32_t dfdByteLength;
+  uint32_t kvdByteOffset;
+  uint32_t kvdByteLength;
+  uint64_t sgdByteOffset;
+  uint64_t sgdByteLength;
+} Ktx2Header;
+
+typedef struct Ktx2LevelStruct {
+  uint64_t byteOffset;
+  uint64_t byteLength;
+  uint64_t uncompressedByteLength;
+} Ktx2Level;
+
+static_assert(sizeof(Ktx2Header) == 80, "KTX2 header must be packed");
+static_assert(sizeof(Ktx2Level) == 24, "KTX2 level index must be packed");
+
+TextureData parseKtx2(const void *data, size_t size) {
+  const unsigned char *bytes = static_cast<const unsigned char*>(data);
+
+  Ktx2Header header;
+  if (size < sizeof(header))
+    throw std::invalid_argument("KTX2 file truncated!");
+  memcpy(&header, bytes, sizeof(header));
+
+  if (memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0)
+    throw std::invalid_argument("not a KTX2 file!");
+  if (header.vkFormat == 0)
+    throw std::invalid_argument("Basis Universal KTX2 textures are not supported!");
+  if (header.supercompressionScheme != 0)
+    throw std::invalid_argument("supercompressed KTX2 textures are not supported!");
+  if (header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1)
+    throw std::invalid_argument("only 2D KTX2 textures are supported!");
+  if (header.pixelWidth == 0 || header.pixelHeight == 0)
+    throw std::invalid_argument("KTX2 texture is empty!");
+
+  TextureFormatInfo info;
+  if (!getTextureFormatInfo(static_cast<VkFormat>(header.vkFormat), info))
+    throw std::invalid_argument("unsupported KTX2 texture format!");
+
+  // A level count of 0 asks for the mip chain to be generated at load time
+  const uint32_t levelCount = header.levelCount ? header.levelCount : 1;
+  if (levelCount > getMipLevelCount(header.pixelWidth, header.pixelHeight))
+    throw std::invalid_argument("too many KTX2 levels!");
+  if (sizeof(Ktx2Header) + uint64_t(levelCount) * sizeof(Ktx2Level) > size)
+    throw std::invalid_argument("KTX2 file truncated!");
+
+  TextureData texture = {};
+  texture.format = static_cast<VkFormat>(header.vkFormat);
+  texture.width = header.pixelWidth;
+  texture.height = header.pixelHeight;
+
+  for (uint32_t i = 0; i < levelCount; i++) {
+    Ktx2Level level;
+    memcpy(&level, bytes + sizeof(Ktx2Header) + i * sizeof(Ktx2Level), sizeof(level));
+
+    const uint32_t width = std::max(header.pixelWidth >> i, 1u);
+    const uint32_t height = std::max(header.pixelHeight >> i, 1u);
+    if (level.byteLength != getTextureLevelSize(info, width, height))
+      throw std::invalid_argument("KTX2 level has the wrong size!");
+    if (level.byteOffset > size || level.byteLength > size - level.byteOffset)
+      throw std::invalid_argument("KTX2 level out of range!");
+
+    addTextureLevel(texture, width, height, bytes + level.byteOffset, static_cast<size_t>(level.byteLength));
+  }
+
+  return texture;
+}
+
+TextureData readKtx2(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open())
+    throw std::runtime_error("failed to open texture file!");
+
+  const std::vector<char> content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  return parseKtx2(content.data(), content.size());
+}
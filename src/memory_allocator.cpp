@@ -0,0 +1,300 @@
+#include <memory_allocator.h>
+
+#include <stdexcept>
+#include <algorithm>
+
+// Smallest size class
+static const VkDeviceSize MIN_SIZE_CLASS = 256;
+
+// Block size used on heaps large enough to hold several of them
+static const VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+static const VkDeviceSize SMALL_HEAP_SIZE = 1024ull * 1024 * 1024;
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+VkDeviceSize getMemorySizeClass(VkDeviceSize size) {
+  if (size <= MIN_SIZE_CLASS)
+    return MIN_SIZE_CLASS;
+
+  // Eight classes up to the next power of two, in steps of an eighth of
+  // the previous one, so at most 12.5% of the size is wasted
+  VkDeviceSize powerOfTwo = MIN_SIZE_CLASS;
+  while (powerOfTwo * 2 <= size)
+    powerOfTwo <<= 1;
+
+  return alignUp(size, powerOfTwo / 8);
+}
+
+bool allocateFreeRange(MemoryFreeRanges &freeRanges, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &outOffset) {
+  // Best fit: smallest free range that can hold the aligned request
+  auto best = freeRanges.end();
+  VkDeviceSize bestWaste = 0;
+
+  for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+    const VkDeviceSize padding = alignUp(it->first, alignment) - it->first;
+    if (it->second < padding + size)
+      continue;
+
+    const VkDeviceSize waste = it->second - padding - size;
+    if (best == freeRanges.end() || waste < bestWaste) {
+      best = it;
+      bestWaste = waste;
+      if (waste == 0)
+        break;
+    }
+  }
+
+  if (best == freeRanges.end())
+    return false;
+
+  const VkDeviceSize rangeOffset = best->first;
+  const VkDeviceSize rangeSize = best->second;
+  const VkDeviceSize offset = alignUp(rangeOffset, alignment);
+
+  freeRanges.erase(best);
+  if (offset > rangeOffset)
+    freeRanges[rangeOffset] = offset - rangeOffset;
+  if (rangeOffset + rangeSize > offset + size)
+    freeRanges[offset + size] = rangeOffset + rangeSize - offset - size;
+
+  outOffset = offset;
+  return true;
+}
+
+void releaseFreeRange(MemoryFreeRanges &freeRanges, VkDeviceSize offset, VkDeviceSize size) {
+  auto next = freeRanges.lower_bound(offset);
+  if (next != freeRanges.end() && offset + size == next->first) {
+    size += next->second;
+    next = freeRanges.erase(next);
+  }
+
+  if (next != freeRanges.begin()) {
+    auto previous = std::prev(next);
+    if (previous->first + previous->second == offset) {
+      offset = previous->first;
+      size += previous->second;
+      freeRanges.erase(previous);
+    }
+  }
+
+  freeRanges[offset] = size;
+}
+
+size_t getMemoryPoolIndex(uint32_t memoryType, bool linear, VkDeviceSize bufferImageGranularity) {
+  // Without a granularity constraint, buffers and images can share blocks
+  const bool separate = bufferImageGranularity > 1 && !linear;
+  return memoryType * 2 + (separate ? 1 : 0);
+}
+
+MemoryAllocator::MemoryAllocator() :
+  device(VK_NULL_HANDLE),
+  memoryProperties({}),
+  bufferImageGranularity(1)
+{}
+
+void MemoryAllocator::init(VkPhysicalDevice physicalDevice, VkDevice newDevice) {
+  device = newDevice;
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  bufferImageGranularity = properties.limits.bufferImageGranularity;
+
+  pools.resize(memoryProperties.memoryTypeCount * 2);
+}
+
+void MemoryAllocator::destroy() {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  for (auto &pool : pools) {
+    for (Block *block : pool)
+      destroyBlock(block);
+    pool.clear();
+  }
+}
+
+uint32_t MemoryAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+  for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+    if ((typeFilter & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+      return i;
+  }
+
+  throw std::runtime_error("failed to find suitable memory type!");
+}
+
+VkDeviceSize MemoryAllocator::blockSize(uint32_t memoryType) const {
+  const uint32_t heapIndex = memoryProperties.memoryTypes[memoryType].heapIndex;
+  const VkDeviceSize heapSize = memoryProperties.memoryHeaps[heapIndex].size;
+
+  if (heapSize <= SMALL_HEAP_SIZE)
+    return alignUp(heapSize / 8, MIN_SIZE_CLASS);
+
+  return DEFAULT_BLOCK_SIZE;
+}
+
+MemoryAllocator::Block *MemoryAllocator::createBlock(uint32_t memoryType, VkDeviceSize size, bool dedicated) {
+  VkMemoryAllocateInfo allocInfo = {};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = size;
+  allocInfo.memoryTypeIndex = memoryType;
+
+  VkDeviceMemory memory;
+  if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+    return nullptr;
+
+  Block *block = new Block();
+  block->memory = memory;
+  block->size = size;
+  block->mapped = nullptr;
+  block->usedBytes = 0;
+  block->allocationCount = 0;
+  block->dedicated = dedicated;
+  block->freeRanges[0] = size;
+
+  // Host visible blocks stay mapped for their whole lifetime
+  if (memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+    if (vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &block->mapped) != VK_SUCCESS) {
+      vkFreeMemory(device, memory, nullptr);
+      delete block;
+      throw std::runtime_error("failed to map memory block!");
+    }
+  }
+
+  return block;
+}
+
+void MemoryAllocator::destroyBlock(Block *block) {
+  if (block->mapped)
+    vkUnmapMemory(device, block->memory);
+
+  vkFreeMemory(device, block->memory, nullptr);
+  delete block;
+}
+
+Allocation MemoryAllocator::allocate(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties, bool linear) {
+  const uint32_t memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+  const VkDeviceSize preferredBlockSize = blockSize(memoryType);
+
+  std::lock_guard<std::mutex> lock(mutex);
+  std::vector<Block*> &pool = pools[getMemoryPoolIndex(memoryType, linear, bufferImageGranularity)];
+
+  Allocation allocation = {};
+  allocation.memoryType = memoryType;
+  allocation.linear = linear;
+
+  // Large resources get a block of their own
+  if (requirements.size > preferredBlockSize / 2) {
+    Block *block = createBlock(memoryType, requirements.size, true);
+    if (!block)
+      throw std::runtime_error("failed to allocate device memory!");
+
+    block->freeRanges.clear();
+    block->usedBytes = requirements.size;
+    block->allocationCount = 1;
+    pool.push_back(block);
+
+    allocation.memory = block->memory;
+    allocation.offset = 0;
+    allocation.size = requirements.size;
+    allocation.mapped = block->mapped;
+    return allocation;
+  }
+
+  const VkDeviceSize size = getMemorySizeClass(requirements.size);
+  const VkDeviceSize alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+
+  Block *target = nullptr;
+  VkDeviceSize offset = 0;
+  for (Block *block : pool) {
+    if (!block->dedicated && allocateFreeRange(block->freeRanges, size, alignment, offset)) {
+      target = block;
+      break;
+    }
+  }
+
+  if (!target) {
+    // Shrink the new block if the heap cannot fit a full one
+    VkDeviceSize newBlockSize = preferredBlockSize;
+    while (!target && newBlockSize >= size) {
+      target = createBlock(memoryType, newBlockSize, false);
+      newBlockSize /= 2;
+    }
+
+    if (!target)
+      throw std::runtime_error("failed to allocate device memory!");
+
+    pool.push_back(target);
+    if (!allocateFreeRange(target->freeRanges, size, alignment, offset))
+      throw std::runtime_error("failed to sub-allocate device memory!");
+  }
+
+  target->usedBytes += size;
+  target->allocationCount++;
+
+  allocation.memory = target->memory;
+  allocation.offset = offset;
+  allocation.size = size;
+  allocation.mapped = target->mapped ? static_cast<char*>(target->mapped) + offset : nullptr;
+  return allocation;
+}
+
+void MemoryAllocator::free(Allocation &allocation) {
+  if (allocation.memory == VK_NULL_HANDLE)
+    return;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  std::vector<Block*> &pool = pools[getMemoryPoolIndex(allocation.memoryType, allocation.linear, bufferImageGranularity)];
+
+  auto it = std::find_if(pool.begin(), pool.end(), [&](const Block *block) {
+    return block->memory == allocation.memory;
+  });
+  if (it == pool.end())
+    throw std::invalid_argument("allocation does not belong to this allocator!");
+
+  Block *block = *it;
+  block->usedBytes -= allocation.size;
+  block->allocationCount--;
+
+  if (!block->dedicated) {
+    // Insert the range back, merging it with adjacent free ranges
+    releaseFreeRange(block->freeRanges, allocation.offset, allocation.size);
+  }
+
+  // Keep a single empty block around to avoid reallocating on every load
+  if (block->allocationCount == 0) {
+    const bool otherEmptyBlock = block->dedicated || std::any_of(pool.begin(), pool.end(), [&](const Block *other) {
+      return other != block && !other->dedicated && other->allocationCount == 0;
+    });
+
+    if (otherEmptyBlock) {
+      pool.erase(it);
+      destroyBlock(block);
+    }
+  }
+
+  allocation = {};
+}
+
+std::vector<MemoryHeapStats> MemoryAllocator::getHeapStats() const {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  std::vector<MemoryHeapStats> stats(memoryProperties.memoryHeapCount, MemoryHeapStats{});
+  for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+    stats[i].heapSize = memoryProperties.memoryHeaps[i].size;
+
+  for (size_t i = 0; i < pools.size(); i++) {
+    const uint32_t memoryType = static_cast<uint32_t>(i / 2);
+    MemoryHeapStats &heap = stats[memoryProperties.memoryTypes[memoryType].heapIndex];
+
+    for (const Block *block : pools[i]) {
+      heap.blockBytes += block->size;
+      heap.usedBytes += block->usedBytes;
+      heap.blockCount++;
+      heap.allocationCount += block->allocationCount;
+    }
+  }
+
+  return stats;
+}
@@ -0,0 +1,250 @@
+#include <mesh.h>
+
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+
+// Hash table slots per vertex, kept at most half full
+static const size_t TABLE_SLOTS_PER_VERTEX = 2;
+static const size_t MIN_TABLE_SIZE = 64;
+
+static_assert(sizeof(Vertex) % sizeof(uint32_t) == 0, "vertices are hashed as 32 bit words");
+
+/**
+ * Maps -0 to +0 so that both weld together, other values are unchanged.
+ */
+static Vertex canonicalize(const Vertex &vertex) {
+  Vertex result = vertex;
+  float *values = reinterpret_cast<float*>(&result);
+  for (size_t i = 0; i < sizeof(Vertex) / sizeof(float); i++)
+    values[i] += 0.0f;
+
+  return result;
+}
+
+MeshBounds computeBounds(const Vertex *vertices, size_t vertexCount) {
+  MeshBounds bounds = {};
+  if (vertexCount == 0)
+    return bounds;
+
+  bounds.min = vertices[0].pos;
+  bounds.max = vertices[0].pos;
+  for (size_t i = 0; i < vertexCount; i++) {
+    bounds.min = glm::min(bounds.min, vertices[i].pos);
+    bounds.max = glm::max(bounds.max, vertices[i].pos);
+  }
+
+  const glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+  float radius = 0.0f;
+  for (size_t i = 0; i < vertexCount; i++)
+    radius = std::max(radius, glm::length(vertices[i].pos - center));
+
+  bounds.sphere = glm::vec4(center, radius);
+  return bounds;
+}
+
+std::vector<MeshChunk> splitMesh(
+  const std::vector<Vertex> &vertices,
+  const std::vector<uint32_t> &indices,
+  uint32_t maxVertices,
+  std::vector<Vertex> &outVertices,
+  std::vector<uint32_t> &outIndices) {
+  if (indices.size() % 3 != 0 || maxVertices < 3)
+    throw std::invalid_argument("cannot split mesh, not a triangle list!");
+
+  std::vector<MeshChunk> chunks;
+  if (vertices.size() <= maxVertices) {
+    outVertices = vertices;
+    outIndices = indices;
+    if (!indices.empty())
+      chunks.push_back({ 0, static_cast<uint32_t>(indices.size()), 0 });
+    return chunks;
+  }
+
+  outVertices.clear();
+  outIndices.clear();
+  outIndices.reserve(indices.size());
+
+  // Index of each vertex in the current chunk, UINT32_MAX if not in it
+  std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+  std::vector<uint32_t> chunkVertices;
+
+  MeshChunk chunk = {};
+  for (size_t i = 0; i < indices.size(); i += 3) {
+    const uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+    if (a >= vertices.size() || b >= vertices.size() || c >= vertices.size())
+      throw std::invalid_argument("cannot split mesh, index out of range!");
+
+    const uint32_t newVertices =
+      (remap[a] == UINT32_MAX) +
+      (remap[b] == UINT32_MAX && b != a) +
+      (remap[c] == UINT32_MAX && c != a && c != b);
+
+    if (chunkVertices.size() + newVertices > maxVertices) {
+      chunk.indexCount = static_cast<uint32_t>(outIndices.size()) - chunk.firstIndex;
+      chunks.push_back(chunk);
+
+      for (uint32_t vertex : chunkVertices)
+        remap[vertex] = UINT32_MAX;
+      chunkVertices.clear();
+
+      chunk.firstIndex = static_cast<uint32_t>(outIndices.size());
+      chunk.vertexOffset = static_cast<int32_t>(outVertices.size());
+    }
+
+    for (uint32_t vertex : { a, b, c }) {
+      if (remap[vertex] == UINT32_MAX) {
+        remap[vertex] = static_cast<uint32_t>(chunkVertices.size());
+        chunkVertices.push_back(vertex);
+        outVertices.push_back(vertices[vertex]);
+      }
+      outIndices.push_back(remap[vertex]);
+    }
+  }
+
+  chunk.indexCount = static_cast<uint32_t>(outIndices.size()) - chunk.firstIndex;
+  if (chunk.indexCount > 0)
+    chunks.push_back(chunk);
+
+  return chunks;
+}
+
+PackedMesh packMesh(const std::vector<Vertex> &vertices, const std::vector<MeshLod> &lods, uint32_t maxChunkVertices) {
+  PackedMesh packed;
+  const bool shared = vertices.size() <= maxChunkVertices;
+  if (shared)
+    packed.vertices = vertices;
+
+  std::vector<Vertex> lodVertices;
+  std::vector<uint32_t> lodIndices;
+  for (const MeshLod &lod : lods) {
+    MeshLodRange range = {};
+    range.firstChunk = static_cast<uint32_t>(packed.chunks.size());
+    range.error = lod.error;
+
+    const uint32_t firstIndex = static_cast<uint32_t>(packed.indices.size());
+    if (shared) {
+      if (lod.indices.size() % 3 != 0)
+        throw std::invalid_argument("cannot pack mesh, not a triangle list!");
+
+      packed.indices.insert(packed.indices.end(), lod.indices.begin(), lod.indices.end());
+      if (!lod.indices.empty())
+        packed.chunks.push_back({ firstIndex, static_cast<uint32_t>(lod.indices.size()), 0 });
+    } else {
+      const int32_t firstVertex = static_cast<int32_t>(packed.vertices.size());
+      for (MeshChunk chunk : splitMesh(vertices, lod.indices, maxChunkVertices, lodVertices, lodIndices)) {
+        chunk.firstIndex += firstIndex;
+        chunk.vertexOffset += firstVertex;
+        packed.chunks.push_back(chunk);
+      }
+
+      packed.vertices.insert(packed.vertices.end(), lodVertices.begin(), lodVertices.end());
+      packed.indices.insert(packed.indices.end(), lodIndices.begin(), lodIndices.end());
+    }
+
+    range.chunkCount = static_cast<uint32_t>(packed.chunks.size()) - range.firstChunk;
+    packed.lods.push_back(range);
+  }
+
+  return packed;
+}
+
+bool fitsIndex16(const uint32_t *indices, size_t indexCount) {
+  for (size_t i = 0; i < indexCount; i++) {
+    if (indices[i] > UINT16_MAX)
+      return false;
+  }
+
+  return true;
+}
+
+std::vector<uint16_t> narrowIndices(const uint32_t *indices, size_t indexCount) {
+  return std::vector<uint16_t>(indices, indices + indexCount);
+}
+
+MeshBuilder::MeshBuilder(size_t expectedVertices) {
+  size_t size = MIN_TABLE_SIZE;
+  while (size < expectedVertices * TABLE_SLOTS_PER_VERTEX)
+    size *= 2;
+
+  table.resize(size, 0);
+  vertices.reserve(expectedVertices);
+  indices.reserve(expectedVertices);
+}
+
+uint32_t MeshBuilder::hash(const Vertex &vertex) {
+  uint32_t words[sizeof(Vertex) / sizeof(uint32_t)];
+  memcpy(words, &vertex, sizeof(Vertex));
+
+  // Murmur3 style mixing of each word
+  uint32_t h = 0x9747b28c;
+  for (uint32_t word : words) {
+    word *= 0xcc9e2d51;
+    word = (word << 15) | (word >> 17);
+    word *= 0x1b873593;
+
+    h ^= word;
+    h = (h << 13) | (h >> 19);
+    h = h * 5 + 0xe6546b64;
+  }
+
+  h ^= h >> 16;
+  h *= 0x85ebca6b;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35;
+  h ^= h >> 16;
+  return h;
+}
+
+uint32_t MeshBuilder::addVertex(const Vertex &input) {
+  if ((vertices.size() + 1) * TABLE_SLOTS_PER_VERTEX > table.size())
+    grow();
+
+  const Vertex vertex = canonicalize(input);
+  const size_t mask = table.size() - 1;
+
+  // Linear probing until the vertex or an empty slot is found
+  size_t slot = hash(vertex) & mask;
+  while (table[slot] != 0) {
+    const uint32_t index = table[slot] - 1;
+    if (memcmp(&vertices[index], &vertex, sizeof(Vertex)) == 0) {
+      indices.push_back(index);
+      return index;
+    }
+    slot = (slot + 1) & mask;
+  }
+
+  if (vertices.size() >= UINT32_MAX)
+    throw std::length_error("too many vertices in mesh!");
+
+  const uint32_t index = static_cast<uint32_t>(vertices.size());
+  vertices.push_back(vertex);
+  table[slot] = index + 1;
+  indices.push_back(index);
+  return index;
+}
+
+void MeshBuilder::grow() {
+  table.assign(table.size() * 2, 0);
+
+  const size_t mask = table.size() - 1;
+  for (size_t i = 0; i < vertices.size(); i++) {
+    size_t slot = hash(vertices[i]) & mask;
+    while (table[slot] != 0)
+      slot = (slot + 1) & mask;
+    table[slot] = static_cast<uint32_t>(i + 1);
+  }
+}
+
+float MeshBuilder::getReuseRatio() const {
+  if (vertices.empty())
+    return 1.0f;
+
+  return static_cast<float>(indices.size()) / static_cast<float>(vertices.size());
+}
+
+void MeshBuilder::clear() {
+  vertices.clear();
+  indices.clear();
+  std::fill(table.begin(), table.end(), 0);
+}
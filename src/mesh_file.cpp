@@ -0,0 +1,333 @@
+#include <mesh_file.h>
+#include <mesh.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+  #define WIN32_LEAN_AND_MEAN
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+static const char MESH_FILE_MAGIC[4] = { 'C', 'M', 'S', 'H' };
+
+static uint64_t alignUp(uint64_t value, uint64_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+/**
+ * Fills the vertex layout of a header.
+ */
+static void describeVertexLayout(const VertexLayout &layout, MeshFileHeader &header) {
+  const auto attributeDescriptions = layout.getAttributeDescriptions();
+  if (attributeDescriptions.size() > MESH_FILE_MAX_ATTRIBUTES)
+    throw std::runtime_error("too many vertex attributes!");
+
+  header.vertexStride = layout.getStride();
+  header.attributeCount = static_cast<uint32_t>(attributeDescriptions.size());
+  for (size_t i = 0; i < attributeDescriptions.size(); i++) {
+    header.attributes[i].location = attributeDescriptions[i].location;
+    header.attributes[i].format = static_cast<uint32_t>(attributeDescriptions[i].format);
+    header.attributes[i].offset = attributeDescriptions[i].offset;
+  }
+}
+
+/**
+ * @return True if the vertex layout of a header is the one given
+ */
+static bool matchesVertexLayout(const MeshFileHeader &header, const VertexLayout &layout) {
+  MeshFileHeader expected = {};
+  describeVertexLayout(layout, expected);
+
+  return header.vertexStride == expected.vertexStride &&
+    header.attributeCount == expected.attributeCount &&
+    memcmp(header.attributes, expected.attributes, sizeof(MeshFileAttribute) * header.attributeCount) == 0;
+}
+
+/**
+ * @return True if count elements of stride bytes at offset fit in size
+ *         bytes, without overflowing
+ */
+static bool fitsRange(uint64_t offset, uint64_t count, uint64_t stride, uint64_t size) {
+  return offset <= size && count <= (size - offset) / stride;
+}
+
+/**
+ * @return Largest of the indices
+ */
+template<typename Index>
+static uint64_t getMaxIndex(const Index *indices, uint64_t count) {
+  uint64_t maxIndex = 0;
+  for (uint64_t i = 0; i < count; i++)
+    maxIndex = std::max<uint64_t>(maxIndex, indices[i]);
+  return maxIndex;
+}
+
+/**
+ * @return True if the chunks lie within the indices of the header, and their
+ *         indices within its vertices once offset
+ */
+static bool validChunks(const MeshFileHeader &header, const MeshChunk *chunks, const void *indexData) {
+  for (uint32_t i = 0; i < header.chunkCount; i++) {
+    const MeshChunk &chunk = chunks[i];
+    if (uint64_t(chunk.firstIndex) + chunk.indexCount > header.indexCount || chunk.vertexOffset < 0)
+      return false;
+    if (chunk.indexCount == 0)
+      continue;
+
+    const uint64_t maxIndex = header.indexSize == sizeof(uint16_t)
+      ? getMaxIndex(static_cast<const uint16_t*>(indexData) + chunk.firstIndex, chunk.indexCount)
+      : getMaxIndex(static_cast<const uint32_t*>(indexData) + chunk.firstIndex, chunk.indexCount);
+    if (uint64_t(chunk.vertexOffset) + maxIndex >= header.vertexCount)
+      return false;
+  }
+
+  return true;
+}
+
+/**
+ * @return True if the levels of detail lie within the chunks of the header
+ */
+static bool validLods(const MeshFileHeader &header, const MeshLodRange *lods) {
+  for (uint32_t i = 0; i < header.lodCount; i++) {
+    if (uint64_t(lods[i].firstChunk) + lods[i].chunkCount > header.chunkCount)
+      return false;
+  }
+
+  return true;
+}
+
+MeshFile::MeshFile() :
+  data(nullptr),
+  size(0)
+#ifdef _WIN32
+  , file(INVALID_HANDLE_VALUE),
+  mapping(nullptr)
+#endif
+{}
+
+MeshFile::~MeshFile() {
+  close();
+}
+
+void MeshFile::open(const std::string &path) {
+  close();
+
+#ifdef _WIN32
+  file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+    throw std::runtime_error("failed to open mesh file!");
+
+  LARGE_INTEGER fileSize;
+  GetFileSizeEx(file, &fileSize);
+  size = static_cast<size_t>(fileSize.QuadPart);
+
+  mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping)
+    data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error("failed to open mesh file!");
+
+  struct stat status;
+  if (fstat(fd, &status) == 0 && status.st_size > 0) {
+    size = static_cast<size_t>(status.st_size);
+    data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED)
+      data = nullptr;
+    else {
+      // The blobs are read once, front to back. Advice values are not flags,
+      // each is given on its own.
+      madvise(data, size, MADV_SEQUENTIAL);
+      madvise(data, size, MADV_WILLNEED);
+    }
+  }
+
+  // The mapping stays valid after closing the descriptor
+  ::close(fd);
+#endif
+
+  if (!data) {
+    close();
+    throw std::runtime_error("failed to map mesh file!");
+  }
+
+  const MeshFileHeader &header = getHeader();
+  const bool valid =
+    size >= sizeof(MeshFileHeader) &&
+    memcmp(header.magic, MESH_FILE_MAGIC, sizeof(MESH_FILE_MAGIC)) == 0 &&
+    header.version == MESH_FILE_VERSION &&
+    header.attributeCount <= MESH_FILE_MAX_ATTRIBUTES &&
+    (header.indexSize == sizeof(uint16_t) || header.indexSize == sizeof(uint32_t)) &&
+    header.vertexDataOffset % MESH_FILE_ALIGNMENT == 0 &&
+    header.indexDataOffset % MESH_FILE_ALIGNMENT == 0 &&
+    header.chunkDataOffset % MESH_FILE_ALIGNMENT == 0 &&
+    header.lodDataOffset % MESH_FILE_ALIGNMENT == 0 &&
+    header.lodCount >= 1 && header.lodCount <= MAX_MESH_LODS &&
+    header.vertexStride > 0 &&
+    fitsRange(header.vertexDataOffset, header.vertexCount, header.vertexStride, size) &&
+    fitsRange(header.indexDataOffset, header.indexCount, header.indexSize, size) &&
+    fitsRange(header.chunkDataOffset, header.chunkCount, sizeof(MeshChunk), size) &&
+    fitsRange(header.lodDataOffset, header.lodCount, sizeof(MeshLodRange), size) &&
+    validChunks(header, getChunks(), getIndexData()) &&
+    validLods(header, getLods());
+
+  if (!valid) {
+    close();
+    throw std::runtime_error("invalid mesh file!");
+  }
+}
+
+void MeshFile::close() {
+#ifdef _WIN32
+  if (data)
+    UnmapViewOfFile(data);
+  if (mapping)
+    CloseHandle(mapping);
+  if (file != INVALID_HANDLE_VALUE)
+    CloseHandle(file);
+  mapping = nullptr;
+  file = INVALID_HANDLE_VALUE;
+#else
+  if (data)
+    munmap(data, size);
+#endif
+
+  data = nullptr;
+  size = 0;
+}
+
+bool MeshFile::hasVertexLayout(const VertexLayout &layout) const {
+  return matchesVertexLayout(getHeader(), layout);
+}
+
+MeshBounds MeshFile::getBounds() const {
+  const MeshFileHeader &header = getHeader();
+
+  MeshBounds bounds = {};
+  for (int i = 0; i < 3; i++) {
+    bounds.min[i] = header.boundsMin[i];
+    bounds.max[i] = header.boundsMax[i];
+  }
+  for (int i = 0; i < 4; i++)
+    bounds.sphere[i] = header.boundingSphere[i];
+
+  return bounds;
+}
+
+void MeshFile::write(
+  const std::string &path,
+  const std::vector<Vertex> &vertices,
+  const std::vector<MeshLod> &lods,
+  uint64_t sourceHash,
+  const VertexLayout &layout,
+  bool splitLargeMeshes) {
+  if (lods.empty() || lods.size() > MAX_MESH_LODS)
+    throw std::invalid_argument("invalid level of detail count!");
+
+  // Splitting only duplicates vertices, the bounds are the same
+  const MeshBounds bounds = computeBounds(vertices.data(), vertices.size());
+
+  const uint32_t maxVertices = splitLargeMeshes ? MAX_INDEX16_VERTICES : UINT32_MAX;
+  const PackedMesh packed = packMesh(vertices, lods, maxVertices);
+  const std::vector<Vertex> &chunkVertices = packed.vertices;
+  const std::vector<uint32_t> &chunkIndices = packed.indices;
+  const std::vector<MeshChunk> &chunks = packed.chunks;
+
+  const bool index16 = fitsIndex16(chunkIndices.data(), chunkIndices.size());
+  const std::vector<uint16_t> indices16 = index16 ? narrowIndices(chunkIndices.data(), chunkIndices.size()) : std::vector<uint16_t>();
+  const char *indexData = index16
+    ? reinterpret_cast<const char*>(indices16.data())
+    : reinterpret_cast<const char*>(chunkIndices.data());
+
+  MeshFileHeader header = {};
+  memcpy(header.magic, MESH_FILE_MAGIC, sizeof(MESH_FILE_MAGIC));
+  header.version = MESH_FILE_VERSION;
+  header.sourceHash = sourceHash;
+  describeVertexLayout(layout, header);
+
+  const uint64_t vertexDataSize = uint64_t(header.vertexStride) * chunkVertices.size();
+
+  header.vertexCount = chunkVertices.size();
+  header.vertexDataOffset = alignUp(sizeof(MeshFileHeader), MESH_FILE_ALIGNMENT);
+  header.indexCount = chunkIndices.size();
+  header.indexSize = index16 ? sizeof(uint16_t) : sizeof(uint32_t);
+  header.indexDataOffset = alignUp(header.vertexDataOffset + vertexDataSize, MESH_FILE_ALIGNMENT);
+  header.chunkCount = static_cast<uint32_t>(chunks.size());
+  header.chunkDataOffset = alignUp(header.indexDataOffset + header.indexCount * header.indexSize, MESH_FILE_ALIGNMENT);
+  header.lodCount = static_cast<uint32_t>(packed.lods.size());
+  header.lodDataOffset = alignUp(header.chunkDataOffset + sizeof(MeshChunk) * chunks.size(), MESH_FILE_ALIGNMENT);
+
+  for (int i = 0; i < 3; i++) {
+    header.boundsMin[i] = bounds.min[i];
+    header.boundsMax[i] = bounds.max[i];
+  }
+  for (int i = 0; i < 4; i++)
+    header.boundingSphere[i] = bounds.sphere[i];
+
+  std::vector<char> vertexData(vertexDataSize);
+  layout.encode(chunkVertices.data(), chunkVertices.size(), bounds, vertexData.data());
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file.is_open())
+    throw std::runtime_error("failed to create mesh file!");
+
+  const char padding[MESH_FILE_ALIGNMENT] = {};
+
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(padding, header.vertexDataOffset - sizeof(header));
+  file.write(vertexData.data(), vertexData.size());
+  file.write(padding, header.indexDataOffset - header.vertexDataOffset - vertexDataSize);
+  file.write(indexData, header.indexCount * header.indexSize);
+  file.write(padding, header.chunkDataOffset - header.indexDataOffset - header.indexCount * header.indexSize);
+  file.write(reinterpret_cast<const char*>(chunks.data()), sizeof(MeshChunk) * chunks.size());
+  file.write(padding, header.lodDataOffset - header.chunkDataOffset - sizeof(MeshChunk) * chunks.size());
+  file.write(reinterpret_cast<const char*>(packed.lods.data()), sizeof(MeshLodRange) * packed.lods.size());
+
+  if (!file.good())
+    throw std::runtime_error("failed to write mesh file!");
+}
+
+bool MeshFile::isCurrent(const std::string &path, uint64_t sourceHash, const VertexLayout &layout) {
+  // Only the header is read, the file is not mapped
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open())
+    return false;
+
+  MeshFileHeader header = {};
+  file.read(reinterpret_cast<char*>(&header), sizeof(header));
+  if (!file.good())
+    return false;
+
+  return memcmp(header.magic, MESH_FILE_MAGIC, sizeof(MESH_FILE_MAGIC)) == 0 &&
+    header.version == MESH_FILE_VERSION &&
+    header.sourceHash == sourceHash &&
+    matchesVertexLayout(header, layout);
+}
+
+uint64_t MeshFile::hashFile(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open())
+    throw std::runtime_error("failed to open file to hash!");
+
+  uint64_t hash = 0xcbf29ce484222325ull;
+  std::vector<char> buffer(1 << 16);
+  while (file) {
+    file.read(buffer.data(), buffer.size());
+    const std::streamsize count = file.gcount();
+    for (std::streamsize i = 0; i < count; i++) {
+      hash ^= static_cast<unsigned char>(buffer[i]);
+      hash *= 0x100000001b3ull;
+    }
+  }
+
+  return hash;
+}
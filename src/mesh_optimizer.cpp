@@ -0,0 +1,330 @@
+#include <mesh_optimizer.h>
+
+#include <stdexcept>
+#include <algorithm>
+
+static void validateTriangles(const std::vector<uint32_t> &indices, size_t vertexCount) {
+  if (indices.size() % 3 != 0)
+    throw std::invalid_argument("indices are not a triangle list!");
+
+  for (uint32_t index : indices) {
+    if (index >= vertexCount)
+      throw std::invalid_argument("index out of range!");
+  }
+}
+
+/**
+ * FIFO cache simulated with timestamps: a vertex is cached if less than
+ * cacheSize vertices were transformed since it was.
+ */
+class VertexCache {
+public:
+  VertexCache(size_t vertexCount, uint32_t cacheSize) :
+    timestamps(vertexCount, 0),
+    time(cacheSize + 1),
+    cacheSize(cacheSize)
+  {}
+
+  /**
+   * @return True if the vertex had to be transformed
+   */
+  bool access(uint32_t vertex) {
+    if (time - timestamps[vertex] > cacheSize) {
+      timestamps[vertex] = time++;
+      return true;
+    }
+    return false;
+  }
+
+  /**
+   * @return Position of the vertex in the cache, larger than cacheSize if
+   *         not in it
+   */
+  uint32_t age(uint32_t vertex) const {
+    return time - timestamps[vertex];
+  }
+
+  void clear() {
+    time += cacheSize + 1;
+  }
+
+private:
+  std::vector<uint32_t> timestamps;
+  uint32_t time;
+  uint32_t cacheSize;
+};
+
+VertexCacheStatistics analyzeVertexCache(const std::vector<uint32_t> &indices, size_t vertexCount, uint32_t cacheSize) {
+  validateTriangles(indices, vertexCount);
+
+  VertexCache cache(vertexCount, cacheSize);
+  std::vector<bool> referenced(vertexCount, false);
+  uint32_t referencedCount = 0;
+
+  VertexCacheStatistics statistics = {};
+  for (uint32_t index : indices) {
+    if (cache.access(index))
+      statistics.vertexTransforms++;
+
+    if (!referenced[index]) {
+      referenced[index] = true;
+      referencedCount++;
+    }
+  }
+
+  const size_t triangleCount = indices.size() / 3;
+  statistics.acmr = triangleCount ? static_cast<float>(statistics.vertexTransforms) / triangleCount : 0.0f;
+  statistics.atvr = referencedCount ? static_cast<float>(statistics.vertexTransforms) / referencedCount : 0.0f;
+  return statistics;
+}
+
+void optimizeVertexCache(std::vector<uint32_t> &indices, size_t vertexCount, uint32_t cacheSize) {
+  validateTriangles(indices, vertexCount);
+
+  const size_t triangleCount = indices.size() / 3;
+  if (triangleCount == 0)
+    return;
+
+  // Triangles of each vertex, as ranges of adjacency
+  std::vector<uint32_t> liveTriangles(vertexCount, 0);
+  for (uint32_t index : indices)
+    liveTriangles[index]++;
+
+  std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+  for (size_t i = 0; i < vertexCount; i++)
+    adjacencyOffsets[i + 1] = adjacencyOffsets[i] + liveTriangles[i];
+
+  std::vector<uint32_t> adjacency(indices.size());
+  std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+  for (size_t i = 0; i < indices.size(); i++)
+    adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+
+  VertexCache cache(vertexCount, cacheSize);
+  std::vector<bool> emitted(triangleCount, false);
+  std::vector<uint32_t> deadEnds;
+  std::vector<uint32_t> candidates;
+
+  std::vector<uint32_t> result;
+  result.reserve(indices.size());
+
+  size_t cursor = 0;
+  int64_t fanning = 0;
+  while (fanning >= 0) {
+    const uint32_t vertex = static_cast<uint32_t>(fanning);
+    candidates.clear();
+
+    // Emit the remaining triangles around the fanning vertex
+    for (uint32_t i = adjacencyOffsets[vertex]; i < adjacencyOffsets[vertex + 1]; i++) {
+      const uint32_t triangle = adjacency[i];
+      if (emitted[triangle])
+        continue;
+
+      for (int corner = 0; corner < 3; corner++) {
+        const uint32_t v = indices[triangle * 3 + corner];
+        result.push_back(v);
+        deadEnds.push_back(v);
+        candidates.push_back(v);
+        liveTriangles[v]--;
+        cache.access(v);
+      }
+      emitted[triangle] = true;
+    }
+
+    // Next fanning vertex: the oldest candidate still in cache once its
+    // remaining triangles are emitted
+    fanning = -1;
+    int64_t bestPriority = -1;
+    for (uint32_t v : candidates) {
+      if (liveTriangles[v] == 0)
+        continue;
+
+      int64_t priority = 0;
+      if (cache.age(v) + 2 * liveTriangles[v] <= cacheSize)
+        priority = cache.age(v);
+
+      if (priority > bestPriority) {
+        bestPriority = priority;
+        fanning = v;
+      }
+    }
+
+    // Dead end: recently used vertices first, then in input order
+    while (fanning < 0 && !deadEnds.empty()) {
+      const uint32_t v = deadEnds.back();
+      deadEnds.pop_back();
+      if (liveTriangles[v] > 0)
+        fanning = v;
+    }
+
+    while (fanning < 0 && cursor < vertexCount) {
+      if (liveTriangles[cursor] > 0)
+        fanning = static_cast<int64_t>(cursor);
+      cursor++;
+    }
+  }
+
+  indices.swap(result);
+}
+
+/**
+ * Starts a cluster where the cache is cold, at triangles missing all their
+ * vertices, which is where optimizeVertexCache hit a dead end.
+ */
+static std::vector<size_t> findHardBoundaries(const std::vector<uint32_t> &indices, size_t vertexCount, uint32_t cacheSize) {
+  VertexCache cache(vertexCount, cacheSize);
+  std::vector<size_t> boundaries;
+
+  for (size_t triangle = 0; triangle < indices.size() / 3; triangle++) {
+    int misses = 0;
+    for (int corner = 0; corner < 3; corner++)
+      misses += cache.access(indices[triangle * 3 + corner]) ? 1 : 0;
+
+    if (triangle == 0 || misses == 3)
+      boundaries.push_back(triangle);
+  }
+
+  return boundaries;
+}
+
+/**
+ * Splits each hard cluster further wherever its running ACMR is within the
+ * threshold of the ACMR of the whole cluster.
+ */
+static std::vector<size_t> findSoftBoundaries(
+  const std::vector<uint32_t> &indices,
+  size_t vertexCount,
+  const std::vector<size_t> &hardBoundaries,
+  float threshold,
+  uint32_t cacheSize) {
+  const size_t triangleCount = indices.size() / 3;
+  VertexCache cache(vertexCount, cacheSize);
+  std::vector<size_t> boundaries;
+
+  for (size_t cluster = 0; cluster < hardBoundaries.size(); cluster++) {
+    const size_t start = hardBoundaries[cluster];
+    const size_t end = cluster + 1 < hardBoundaries.size() ? hardBoundaries[cluster + 1] : triangleCount;
+
+    cache.clear();
+    uint32_t clusterMisses = 0;
+    for (size_t i = start * 3; i < end * 3; i++)
+      clusterMisses += cache.access(indices[i]) ? 1 : 0;
+    const float clusterAcmr = static_cast<float>(clusterMisses) / (end - start);
+
+    cache.clear();
+    boundaries.push_back(start);
+    size_t softStart = start;
+    uint32_t misses = 0;
+    for (size_t triangle = start; triangle < end; triangle++) {
+      for (int corner = 0; corner < 3; corner++)
+        misses += cache.access(indices[triangle * 3 + corner]) ? 1 : 0;
+
+      const float acmr = static_cast<float>(misses) / (triangle + 1 - softStart);
+      if (triangle + 1 < end && acmr <= clusterAcmr * threshold) {
+        boundaries.push_back(triangle + 1);
+        softStart = triangle + 1;
+        misses = 0;
+        cache.clear();
+      }
+    }
+  }
+
+  return boundaries;
+}
+
+void optimizeOverdraw(
+  std::vector<uint32_t> &indices,
+  const std::vector<Vertex> &vertices,
+  float threshold,
+  uint32_t cacheSize) {
+  validateTriangles(indices, vertices.size());
+
+  const size_t triangleCount = indices.size() / 3;
+  if (triangleCount == 0)
+    return;
+
+  const std::vector<size_t> hardBoundaries = findHardBoundaries(indices, vertices.size(), cacheSize);
+  const std::vector<size_t> boundaries = findSoftBoundaries(indices, vertices.size(), hardBoundaries, threshold, cacheSize);
+
+  // Area weighted centroid and normal of each cluster, and of the mesh
+  std::vector<glm::vec3> centroids(boundaries.size(), glm::vec3(0.0f));
+  std::vector<glm::vec3> normals(boundaries.size(), glm::vec3(0.0f));
+  std::vector<float> areas(boundaries.size(), 0.0f);
+  glm::vec3 meshCentroid(0.0f);
+  float meshArea = 0.0f;
+
+  for (size_t cluster = 0; cluster < boundaries.size(); cluster++) {
+    const size_t end = cluster + 1 < boundaries.size() ? boundaries[cluster + 1] : triangleCount;
+
+    for (size_t triangle = boundaries[cluster]; triangle < end; triangle++) {
+      const glm::vec3 &a = vertices[indices[triangle * 3 + 0]].pos;
+      const glm::vec3 &b = vertices[indices[triangle * 3 + 1]].pos;
+      const glm::vec3 &c = vertices[indices[triangle * 3 + 2]].pos;
+
+      const glm::vec3 normal = glm::cross(b - a, c - a);
+      const float area = glm::length(normal);
+
+      centroids[cluster] += (a + b + c) * (area / 3.0f);
+      normals[cluster] += normal;
+      areas[cluster] += area;
+    }
+
+    meshCentroid += centroids[cluster];
+    meshArea += areas[cluster];
+  }
+
+  if (meshArea > 0.0f)
+    meshCentroid /= meshArea;
+
+  // Clusters facing outwards, away from the centroid, are drawn first
+  std::vector<float> keys(boundaries.size(), 0.0f);
+  for (size_t cluster = 0; cluster < boundaries.size(); cluster++) {
+    if (areas[cluster] == 0.0f)
+      continue;
+
+    const glm::vec3 centroid = centroids[cluster] / areas[cluster];
+    const float normalLength = glm::length(normals[cluster]);
+    if (normalLength > 0.0f)
+      keys[cluster] = glm::dot(centroid - meshCentroid, normals[cluster] / normalLength);
+  }
+
+  std::vector<size_t> order(boundaries.size());
+  for (size_t i = 0; i < order.size(); i++)
+    order[i] = i;
+
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return keys[a] > keys[b];
+  });
+
+  std::vector<uint32_t> result;
+  result.reserve(indices.size());
+  for (size_t cluster : order) {
+    const size_t end = cluster + 1 < boundaries.size() ? boundaries[cluster + 1] : triangleCount;
+    result.insert(result.end(), indices.begin() + boundaries[cluster] * 3, indices.begin() + end * 3);
+  }
+
+  indices.swap(result);
+}
+
+void optimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices) {
+  validateTriangles(indices, vertices.size());
+
+  std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+  std::vector<Vertex> result;
+  result.reserve(vertices.size());
+
+  for (uint32_t &index : indices) {
+    if (remap[index] == UINT32_MAX) {
+      remap[index] = static_cast<uint32_t>(result.size());
+      result.push_back(vertices[index]);
+    }
+    index = remap[index];
+  }
+
+  vertices.swap(result);
+}
+
+void optimizeMesh(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices) {
+  optimizeVertexCache(indices, vertices.size());
+  optimizeOverdraw(indices, vertices);
+  optimizeVertexFetch(vertices, indices);
+}
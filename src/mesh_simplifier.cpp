@@ -0,0 +1,430 @@
+#include <mesh_simplifier.h>
+
+#include <stdexcept>
+#include <algorithm>
+#include <unordered_map>
+#include <limits>
+#include <cmath>
+
+static void validateTriangles(const std::vector<uint32_t> &indices, size_t vertexCount) {
+  if (indices.size() % 3 != 0)
+    throw std::invalid_argument("indices are not a triangle list!");
+
+  for (uint32_t index : indices) {
+    if (index >= vertexCount)
+      throw std::invalid_argument("index out of range!");
+  }
+}
+
+/**
+ * Sum of squared distances to planes, weighted, in double precision as the
+ * coefficients of large meshes cancel out.
+ */
+typedef struct QuadricStruct {
+  double a2, b2, c2, ab, ac, bc, ad, bd, cd, d2;
+  double weight;
+
+  void addPlane(const glm::vec3 &normal, double d, double w) {
+    const double a = normal.x, b = normal.y, c = normal.z;
+    a2 += a * a * w; b2 += b * b * w; c2 += c * c * w;
+    ab += a * b * w; ac += a * c * w; bc += b * c * w;
+    ad += a * d * w; bd += b * d * w; cd += c * d * w;
+    d2 += d * d * w;
+    weight += w;
+  }
+
+  void add(const QuadricStruct &other) {
+    a2 += other.a2; b2 += other.b2; c2 += other.c2;
+    ab += other.ab; ac += other.ac; bc += other.bc;
+    ad += other.ad; bd += other.bd; cd += other.cd;
+    d2 += other.d2;
+    weight += other.weight;
+  }
+
+  /**
+   * @return Weighted mean of the squared distances of a point to the planes
+   */
+  double error(const glm::vec3 &p) const {
+    const double x = p.x, y = p.y, z = p.z;
+    const double sum =
+      a2 * x * x + b2 * y * y + c2 * z * z +
+      2.0 * (ab * x * y + ac * x * z + bc * y * z) +
+      2.0 * (ad * x + bd * y + cd * z) +
+      d2;
+    return weight > 0.0 ? std::fabs(sum) / weight : 0.0;
+  }
+} Quadric;
+
+typedef struct CollapseStruct {
+  // Wedge removed and wedge it collapses onto
+  uint32_t from;
+  uint32_t to;
+  double error;
+  double cost;
+} Collapse;
+
+static uint64_t edgeKey(uint32_t a, uint32_t b) {
+  return a < b ? (static_cast<uint64_t>(a) << 32) | b : (static_cast<uint64_t>(b) << 32) | a;
+}
+
+/**
+ * Identifies vertices sharing a position, which differ by other attributes
+ * along seams.
+ * @return Position of each vertex, the lowest vertex index sharing it
+ */
+static std::vector<uint32_t> groupPositions(const std::vector<Vertex> &vertices) {
+  std::vector<uint32_t> order(vertices.size());
+  for (size_t i = 0; i < order.size(); i++)
+    order[i] = static_cast<uint32_t>(i);
+
+  auto less = [&](uint32_t a, uint32_t b) {
+    const glm::vec3 &pa = vertices[a].pos;
+    const glm::vec3 &pb = vertices[b].pos;
+    if (pa.x != pb.x)
+      return pa.x < pb.x;
+    if (pa.y != pb.y)
+      return pa.y < pb.y;
+    return pa.z < pb.z;
+  };
+  std::stable_sort(order.begin(), order.end(), less);
+
+  std::vector<uint32_t> positions(vertices.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    if (i > 0 && !less(order[i - 1], order[i]))
+      positions[order[i]] = positions[order[i - 1]];
+    else
+      positions[order[i]] = order[i];
+  }
+
+  return positions;
+}
+
+static double attributeCost(const Vertex &a, const Vertex &b, const SimplifyOptions &options) {
+  const glm::vec3 color = a.color - b.color;
+  const glm::vec2 texCoord = a.texCoord - b.texCoord;
+  const glm::vec3 normal = a.normal - b.normal;
+  return options.colorWeight * glm::dot(color, color) +
+    options.texCoordWeight * glm::dot(texCoord, texCoord) +
+    options.normalWeight * glm::dot(normal, normal);
+}
+
+std::vector<uint32_t> simplifyMesh(
+  const std::vector<Vertex> &vertices,
+  const std::vector<uint32_t> &indices,
+  size_t targetIndexCount,
+  float targetError,
+  float *outError,
+  const SimplifyOptions &options) {
+  validateTriangles(indices, vertices.size());
+
+  if (outError)
+    *outError = 0.0f;
+
+  std::vector<uint32_t> result = indices;
+  if (result.size() <= targetIndexCount)
+    return result;
+
+  // Positions normalized to the largest extent of the mesh
+  const MeshBounds bounds = computeBounds(vertices.data(), vertices.size());
+  const glm::vec3 extent = bounds.max - bounds.min;
+  const float scale = std::max(extent.x, std::max(extent.y, extent.z));
+  if (scale <= 0.0f)
+    return result;
+
+  std::vector<glm::vec3> points(vertices.size());
+  for (size_t i = 0; i < vertices.size(); i++)
+    points[i] = (vertices[i].pos - bounds.min) / scale;
+
+  const std::vector<uint32_t> positions = groupPositions(vertices);
+
+  // Edges in position space used by other than two triangles
+  auto findBorders = [&](std::vector<bool> &borderPositions) {
+    std::unordered_map<uint64_t, uint32_t> edgeCounts;
+    for (size_t i = 0; i < result.size(); i += 3) {
+      for (int corner = 0; corner < 3; corner++) {
+        const uint32_t a = positions[result[i + corner]];
+        const uint32_t b = positions[result[i + (corner + 1) % 3]];
+        edgeCounts[edgeKey(a, b)]++;
+      }
+    }
+
+    borderPositions.assign(vertices.size(), false);
+    for (const auto &edge : edgeCounts) {
+      if (edge.second != 2) {
+        borderPositions[edge.first >> 32] = true;
+        borderPositions[edge.first & 0xffffffff] = true;
+      }
+    }
+    return edgeCounts;
+  };
+
+  std::vector<bool> borderPositions;
+  std::unordered_map<uint64_t, uint32_t> edgeCounts = findBorders(borderPositions);
+
+  // Planes of the triangles around each position, weighted by area. Open
+  // borders also get planes perpendicular to them, keeping their shape.
+  std::vector<Quadric> quadrics(vertices.size(), Quadric());
+  for (size_t i = 0; i < result.size(); i += 3) {
+    const uint32_t p[3] = { positions[result[i]], positions[result[i + 1]], positions[result[i + 2]] };
+    const glm::vec3 cross = glm::cross(points[p[1]] - points[p[0]], points[p[2]] - points[p[0]]);
+    const float length = glm::length(cross);
+    if (length == 0.0f)
+      continue;
+
+    const glm::vec3 normal = cross / length;
+    const double area = length * 0.5;
+    for (int corner = 0; corner < 3; corner++)
+      quadrics[p[corner]].addPlane(normal, -glm::dot(normal, points[p[corner]]), area);
+
+    if (options.lockBorder)
+      continue;
+
+    for (int corner = 0; corner < 3; corner++) {
+      const uint32_t a = p[corner];
+      const uint32_t b = p[(corner + 1) % 3];
+      if (edgeCounts[edgeKey(a, b)] != 1)
+        continue;
+
+      const glm::vec3 edge = points[b] - points[a];
+      const float edgeLength = glm::length(edge);
+      if (edgeLength == 0.0f)
+        continue;
+
+      const glm::vec3 borderNormal = glm::normalize(glm::cross(edge, normal));
+      const double d = -glm::dot(borderNormal, points[a]);
+      quadrics[a].addPlane(borderNormal, d, edgeLength * edgeLength);
+      quadrics[b].addPlane(borderNormal, d, edgeLength * edgeLength);
+    }
+  }
+
+  const double errorLimit = static_cast<double>(targetError) / scale;
+  const double squaredErrorLimit = errorLimit * errorLimit;
+  double maxError = 0.0;
+
+  std::vector<uint32_t> adjacencyOffsets;
+  std::vector<uint32_t> adjacency;
+  std::vector<Collapse> collapses;
+  std::vector<bool> touched;
+  std::vector<bool> removed;
+  std::vector<std::pair<uint32_t, uint32_t>> wedgeMap;
+
+  while (result.size() > targetIndexCount) {
+    const size_t triangleCount = result.size() / 3;
+    const size_t targetTriangles = targetIndexCount / 3;
+
+    // Triangles around each position
+    adjacencyOffsets.assign(vertices.size() + 1, 0);
+    for (uint32_t index : result)
+      adjacencyOffsets[positions[index] + 1]++;
+    for (size_t i = 0; i < vertices.size(); i++)
+      adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+
+    adjacency.resize(result.size());
+    std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (size_t i = 0; i < result.size(); i++)
+      adjacency[fill[positions[result[i]]]++] = static_cast<uint32_t>(i / 3);
+
+    // Every edge of every triangle, in both directions
+    collapses.clear();
+    for (size_t i = 0; i < result.size(); i += 3) {
+      for (int corner = 0; corner < 3; corner++) {
+        const uint32_t wedges[2] = { result[i + corner], result[i + (corner + 1) % 3] };
+
+        for (int direction = 0; direction < 2; direction++) {
+          const uint32_t from = wedges[direction];
+          const uint32_t to = wedges[1 - direction];
+          const uint32_t pa = positions[from];
+          const uint32_t pb = positions[to];
+          if (pa == pb)
+            continue;
+
+          // Border vertices only slide along their border
+          if (borderPositions[pa] && (options.lockBorder || edgeCounts[edgeKey(pa, pb)] != 1))
+            continue;
+
+          Quadric quadric = quadrics[pa];
+          quadric.add(quadrics[pb]);
+
+          Collapse collapse = {};
+          collapse.from = from;
+          collapse.to = to;
+          collapse.error = quadric.error(points[pb]);
+          collapse.cost = collapse.error + attributeCost(vertices[from], vertices[to], options);
+          if (collapse.error <= squaredErrorLimit)
+            collapses.push_back(collapse);
+        }
+      }
+    }
+
+    std::stable_sort(collapses.begin(), collapses.end(), [](const Collapse &a, const Collapse &b) {
+      return a.cost < b.cost;
+    });
+
+    touched.assign(vertices.size(), false);
+    removed.assign(triangleCount, false);
+    size_t removedCount = 0;
+    size_t applied = 0;
+
+    for (const Collapse &collapse : collapses) {
+      if (triangleCount - removedCount <= targetTriangles)
+        break;
+
+      const uint32_t pa = positions[collapse.from];
+      const uint32_t pb = positions[collapse.to];
+      if (touched[pa] || touched[pb])
+        continue;
+
+      // Each wedge of the removed position moves to a wedge of the other one
+      // it shares a triangle with, so that seams only collapse along
+      // themselves
+      wedgeMap.clear();
+      bool valid = true;
+      for (uint32_t i = adjacencyOffsets[pa]; i < adjacencyOffsets[pa + 1] && valid; i++) {
+        if (removed[adjacency[i]])
+          continue;
+
+        const uint32_t *triangle = &result[adjacency[i] * 3];
+        uint32_t from = UINT32_MAX, to = UINT32_MAX;
+        for (int corner = 0; corner < 3; corner++) {
+          if (positions[triangle[corner]] == pa)
+            from = triangle[corner];
+          else if (positions[triangle[corner]] == pb)
+            to = triangle[corner];
+        }
+
+        if (to == UINT32_MAX)
+          continue;
+
+        auto mapped = std::find_if(wedgeMap.begin(), wedgeMap.end(), [&](const std::pair<uint32_t, uint32_t> &entry) {
+          return entry.first == from;
+        });
+        if (mapped == wedgeMap.end())
+          wedgeMap.push_back({ from, to });
+        else if (mapped->second != to)
+          valid = false;
+      }
+
+      for (uint32_t i = adjacencyOffsets[pa]; i < adjacencyOffsets[pa + 1] && valid; i++) {
+        const uint32_t triangle = adjacency[i];
+        if (removed[triangle])
+          continue;
+
+        const uint32_t *corners = &result[triangle * 3];
+
+        bool hasTarget = false;
+        int moved = -1;
+        for (int corner = 0; corner < 3; corner++) {
+          if (positions[corners[corner]] == pb)
+            hasTarget = true;
+          else if (positions[corners[corner]] == pa)
+            moved = corner;
+        }
+
+        const bool mapped = std::any_of(wedgeMap.begin(), wedgeMap.end(), [&](const std::pair<uint32_t, uint32_t> &entry) {
+          return entry.first == corners[moved];
+        });
+        if (!mapped) {
+          valid = false;
+          break;
+        }
+
+        if (hasTarget)
+          continue;
+
+        // Triangles kept by the collapse must not flip
+        const glm::vec3 &a = points[positions[corners[(moved + 1) % 3]]];
+        const glm::vec3 &b = points[positions[corners[(moved + 2) % 3]]];
+        const glm::vec3 before = glm::cross(a - points[pa], b - points[pa]);
+        const glm::vec3 after = glm::cross(a - points[pb], b - points[pb]);
+        if (glm::dot(before, after) <= 0.0f)
+          valid = false;
+      }
+
+      if (!valid)
+        continue;
+
+      for (uint32_t i = adjacencyOffsets[pa]; i < adjacencyOffsets[pa + 1]; i++) {
+        const uint32_t triangle = adjacency[i];
+        if (removed[triangle])
+          continue;
+
+        uint32_t *corners = &result[triangle * 3];
+
+        for (int corner = 0; corner < 3; corner++) {
+          for (const auto &entry : wedgeMap) {
+            if (corners[corner] == entry.first) {
+              corners[corner] = entry.second;
+              break;
+            }
+          }
+        }
+
+        const bool degenerate = positions[corners[0]] == positions[corners[1]] ||
+          positions[corners[1]] == positions[corners[2]] ||
+          positions[corners[2]] == positions[corners[0]];
+        if (degenerate) {
+          removed[triangle] = true;
+          removedCount++;
+        }
+      }
+
+      quadrics[pb].add(quadrics[pa]);
+      maxError = std::max(maxError, collapse.error);
+      touched[pa] = true;
+      touched[pb] = true;
+      applied++;
+    }
+
+    if (applied == 0)
+      break;
+
+    size_t write = 0;
+    for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+      if (removed[triangle])
+        continue;
+
+      for (int corner = 0; corner < 3; corner++)
+        result[write++] = result[triangle * 3 + corner];
+    }
+    result.resize(write);
+
+    edgeCounts = findBorders(borderPositions);
+  }
+
+  if (outError)
+    *outError = static_cast<float>(std::sqrt(maxError) * scale);
+
+  return result;
+}
+
+std::vector<MeshLod> buildLodChain(
+  const std::vector<Vertex> &vertices,
+  const std::vector<uint32_t> &indices,
+  uint32_t maxLods,
+  float reduction,
+  const SimplifyOptions &options) {
+  std::vector<MeshLod> lods;
+  lods.push_back({ indices, 0.0f });
+
+  const size_t triangleCount = indices.size() / 3;
+  float ratio = 1.0f;
+  for (uint32_t level = 1; level < maxLods; level++) {
+    ratio *= reduction;
+    const size_t target = static_cast<size_t>(triangleCount * ratio) * 3;
+
+    // Simplifying the full mesh rather than the previous level does not
+    // accumulate errors
+    MeshLod lod = {};
+    lod.indices = simplifyMesh(vertices, indices, target, std::numeric_limits<float>::max(), &lod.error, options);
+
+    const size_t previousCount = lods.back().indices.size();
+    if (lod.indices.empty() || lod.indices.size() >= previousCount * 9 / 10)
+      break;
+
+    // Coarser levels never claim to be more accurate than finer ones
+    lod.error = std::max(lod.error, lods.back().error);
+    lods.push_back(std::move(lod));
+  }
+
+  return lods;
+}
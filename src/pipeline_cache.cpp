@@ -0,0 +1,62 @@
+#include <pipeline_cache.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#ifdef _WIN32
+  #define WIN32_LEAN_AND_MEAN
+  #include <windows.h>
+#endif
+
+bool isPipelineCacheCompatible(const void *data, size_t size, const VkPhysicalDeviceProperties &properties) {
+  PipelineCacheHeader header;
+  if (size < sizeof(header))
+    return false;
+  memcpy(&header, data, sizeof(header));
+
+  return header.headerSize >= sizeof(header) &&
+    header.headerSize <= size &&
+    header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+    header.vendorID == properties.vendorID &&
+    header.deviceID == properties.deviceID &&
+    memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+std::vector<char> readPipelineCache(const std::string &path, const VkPhysicalDeviceProperties &properties) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open())
+    return {};
+
+  std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  if (!isPipelineCacheCompatible(data.data(), data.size(), properties))
+    return {};
+
+  return data;
+}
+
+void writePipelineCache(const std::string &path, const std::vector<char> &data) {
+  const std::string temporaryPath = path + ".tmp";
+
+  {
+    std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+      throw std::runtime_error("failed to create pipeline cache file!");
+
+    file.write(data.data(), data.size());
+    if (!file.good())
+      throw std::runtime_error("failed to write pipeline cache file!");
+  }
+
+#ifdef _WIN32
+  const bool renamed = MoveFileExA(temporaryPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+  const bool renamed = std::rename(temporaryPath.c_str(), path.c_str()) == 0;
+#endif
+  if (!renamed) {
+    std::remove(temporaryPath.c_str());
+    throw std::runtime_error("failed to replace pipeline cache file!");
+  }
+}
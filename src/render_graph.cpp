@@ -0,0 +1,1002 @@
+#include <render_graph.h>
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+// Access flags that write memory, made available by dependencies
+static const VkAccessFlags WRITE_ACCESS =
+  VK_ACCESS_SHADER_WRITE_BIT |
+  VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+  VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+  VK_ACCESS_TRANSFER_WRITE_BIT |
+  VK_ACCESS_HOST_WRITE_BIT |
+  VK_ACCESS_MEMORY_WRITE_BIT;
+
+static bool isDepthFormat(VkFormat format) {
+  switch (format) {
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_X8_D24_UNORM_PACK32:
+    case VK_FORMAT_D32_SFLOAT:
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+      return true;
+    default:
+      return false;
+  }
+}
+
+static bool hasStencil(VkFormat format) {
+  return format == VK_FORMAT_D16_UNORM_S8_UINT ||
+    format == VK_FORMAT_D24_UNORM_S8_UINT ||
+    format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+}
+
+/**
+ * @param barrier Barriers of depth stencil images must include both aspects,
+ *        views only the depth one
+ */
+static VkImageAspectFlags getImageAspect(VkFormat format, bool barrier) {
+  if (!isDepthFormat(format))
+    return VK_IMAGE_ASPECT_COLOR_BIT;
+  if (barrier && hasStencil(format))
+    return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+  return VK_IMAGE_ASPECT_DEPTH_BIT;
+}
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+VkDeviceSize assignAliasOffsets(const std::vector<RenderAliasRequest> &requests, std::vector<VkDeviceSize> &outOffsets) {
+  std::vector<size_t> order(requests.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return requests[a].size > requests[b].size;
+  });
+
+  outOffsets.assign(requests.size(), 0);
+  std::vector<bool> placed(requests.size(), false);
+  VkDeviceSize totalSize = 0;
+
+  for (size_t i : order) {
+    const RenderAliasRequest &request = requests[i];
+    const VkDeviceSize alignment = std::max<VkDeviceSize>(request.alignment, 1);
+
+    // Memory of the placed resources alive at the same time
+    std::vector<std::pair<VkDeviceSize, VkDeviceSize>> busy;
+    for (size_t j = 0; j < requests.size(); j++) {
+      if (placed[j] && requests[j].firstGroup <= request.lastGroup && request.firstGroup <= requests[j].lastGroup)
+        busy.push_back({ outOffsets[j], outOffsets[j] + requests[j].size });
+    }
+    std::sort(busy.begin(), busy.end());
+
+    // Lowest gap large enough, past every range starting before it
+    VkDeviceSize offset = 0;
+    for (const auto &range : busy) {
+      if (offset + request.size <= range.first)
+        break;
+      offset = std::max(offset, alignUp(range.second, alignment));
+    }
+
+    outOffsets[i] = offset;
+    placed[i] = true;
+    totalSize = std::max(totalSize, offset + request.size);
+  }
+
+  return totalSize;
+}
+
+RenderGraph::RenderGraph() :
+  device(VK_NULL_HANDLE),
+  allocator(nullptr)
+{
+  finalBarriers = {};
+  transientMemory = {};
+}
+
+RenderResource RenderGraph::addResource(const std::string &name, bool image, const RenderImageDesc &desc) {
+  Resource resource = {};
+  resource.name = name;
+  resource.image = image;
+  resource.desc = desc;
+  resource.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  resource.finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  resource.firstGroup = UINT32_MAX;
+  resource.lastGroup = UINT32_MAX;
+  resource.handle = VK_NULL_HANDLE;
+  resource.view = VK_NULL_HANDLE;
+
+  if (image && isDepthFormat(desc.format))
+    resource.clearValue.depthStencil = { 1.0f, 0 };
+  else
+    resource.clearValue.color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+
+  resources.push_back(resource);
+  return static_cast<RenderResource>(resources.size() - 1);
+}
+
+RenderResource RenderGraph::createImage(const std::string &name, const RenderImageDesc &desc) {
+  const RenderResource resource = addResource(name, true, desc);
+  resources[resource].transient = true;
+  return resource;
+}
+
+RenderResource RenderGraph::importImage(
+  const std::string &name,
+  const RenderImageDesc &desc,
+  VkImageLayout initialLayout,
+  VkPipelineStageFlags initialStages,
+  VkImageLayout finalLayout)
+{
+  const RenderResource resource = addResource(name, true, desc);
+  resources[resource].initialLayout = initialLayout;
+  resources[resource].initialStages = initialStages;
+  resources[resource].finalLayout = finalLayout;
+  return resource;
+}
+
+RenderResource RenderGraph::importBuffer(const std::string &name) {
+  return addResource(name, false, RenderImageDesc{});
+}
+
+void RenderGraph::setImage(RenderResource resource, VkImage image, VkImageView view) {
+  resources[resource].handle = image;
+  resources[resource].view = view;
+}
+
+void RenderGraph::setClearValue(RenderResource resource, const VkClearValue &value) {
+  resources[resource].clearValue = value;
+}
+
+void RenderGraph::markOutput(RenderResource resource) {
+  resources[resource].output = true;
+}
+
+RenderPassHandle RenderGraph::addPass(
+  const std::string &name,
+  RenderPassType type,
+  std::function<void(const RenderPassContext&)> record)
+{
+  Pass pass = {};
+  pass.name = name;
+  pass.type = type;
+  pass.record = std::move(record);
+  pass.group = UINT32_MAX;
+
+  passes.push_back(pass);
+  return static_cast<RenderPassHandle>(passes.size() - 1);
+}
+
+void RenderGraph::setSideEffects(RenderPassHandle pass) {
+  passes[pass].sideEffects = true;
+}
+
+void RenderGraph::setSecondaryContents(RenderPassHandle pass) {
+  passes[pass].secondaryContents = true;
+}
+
+void RenderGraph::addUse(RenderPassHandle pass, const Use &use) {
+  if (pass >= passes.size() || use.resource >= resources.size())
+    throw std::invalid_argument("Unknown pass or resource");
+  if (resources[use.resource].image != (use.kind != USE_BUFFER))
+    throw std::invalid_argument("Resource " + resources[use.resource].name + " is not of the right kind");
+  if (isAttachment(use.kind) && passes[pass].type != RENDER_PASS_TYPE_GRAPHICS)
+    throw std::invalid_argument("Pass " + passes[pass].name + " cannot use attachments");
+
+  for (Use &previous : passes[pass].uses) {
+    if (previous.resource != use.resource)
+      continue;
+    if (previous.kind != use.kind || previous.layout != use.layout)
+      throw std::invalid_argument("Pass " + passes[pass].name + " uses " + resources[use.resource].name + " in different ways");
+
+    previous.stages |= use.stages;
+    previous.access |= use.access;
+    previous.write = previous.write || use.write;
+    previous.discard = previous.discard && use.discard;
+    return;
+  }
+
+  passes[pass].uses.push_back(use);
+}
+
+void RenderGraph::writeColor(RenderPassHandle pass, RenderResource resource, VkAttachmentLoadOp loadOp) {
+  const bool load = loadOp == VK_ATTACHMENT_LOAD_OP_LOAD;
+  addUse(pass, {
+    resource,
+    USE_COLOR_ATTACHMENT,
+    VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+    (load ? VK_ACCESS_COLOR_ATTACHMENT_READ_BIT : 0) | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+    true,
+    !load,
+    loadOp
+  });
+}
+
+void RenderGraph::writeDepth(RenderPassHandle pass, RenderResource resource, VkAttachmentLoadOp loadOp) {
+  addUse(pass, {
+    resource,
+    USE_DEPTH_ATTACHMENT,
+    VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+    VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+    true,
+    loadOp != VK_ATTACHMENT_LOAD_OP_LOAD,
+    loadOp
+  });
+}
+
+void RenderGraph::readAttachment(RenderPassHandle pass, RenderResource resource) {
+  addUse(pass, {
+    resource,
+    USE_INPUT_ATTACHMENT,
+    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+    VK_ACCESS_INPUT_ATTACHMENT_READ_BIT,
+    false,
+    false,
+    VK_ATTACHMENT_LOAD_OP_LOAD
+  });
+}
+
+void RenderGraph::readImage(RenderPassHandle pass, RenderResource resource, VkImageLayout layout, VkPipelineStageFlags stages, VkAccessFlags access) {
+  addUse(pass, { resource, USE_IMAGE, layout, stages, access, false, false, VK_ATTACHMENT_LOAD_OP_LOAD });
+}
+
+void RenderGraph::writeImage(RenderPassHandle pass, RenderResource resource, VkImageLayout layout, VkPipelineStageFlags stages, VkAccessFlags access) {
+  addUse(pass, { resource, USE_IMAGE, layout, stages, access, true, false, VK_ATTACHMENT_LOAD_OP_LOAD });
+}
+
+void RenderGraph::readBuffer(RenderPassHandle pass, RenderResource resource, VkPipelineStageFlags stages, VkAccessFlags access) {
+  addUse(pass, { resource, USE_BUFFER, VK_IMAGE_LAYOUT_UNDEFINED, stages, access, false, false, VK_ATTACHMENT_LOAD_OP_LOAD });
+}
+
+void RenderGraph::writeBuffer(RenderPassHandle pass, RenderResource resource, VkPipelineStageFlags stages, VkAccessFlags access) {
+  addUse(pass, { resource, USE_BUFFER, VK_IMAGE_LAYOUT_UNDEFINED, stages, access, true, false, VK_ATTACHMENT_LOAD_OP_LOAD });
+}
+
+void RenderGraph::compile() {
+  groupPasses(cullPasses());
+  computeBarriers();
+}
+
+std::vector<bool> RenderGraph::cullPasses() const {
+  // Resources whose current contents are read by a kept pass, walking
+  // backwards
+  std::vector<bool> needed(resources.size(), false);
+  for (size_t i = 0; i < resources.size(); i++)
+    needed[i] = resources[i].output;
+
+  std::vector<bool> kept(passes.size(), false);
+  for (size_t i = passes.size(); i-- > 0;) {
+    const Pass &pass = passes[i];
+
+    bool keep = pass.sideEffects;
+    for (const Use &use : pass.uses)
+      keep = keep || (use.write && needed[use.resource]);
+
+    if (!keep)
+      continue;
+    kept[i] = true;
+
+    // Contents overwritten entirely are not needed from earlier passes
+    for (const Use &use : pass.uses)
+      needed[use.resource] = !(use.write && use.discard);
+  }
+
+  return kept;
+}
+
+void RenderGraph::groupPasses(const std::vector<bool> &kept) {
+  groups.clear();
+
+  for (RenderPassHandle handle = 0; handle < passes.size(); handle++) {
+    Pass &pass = passes[handle];
+    pass.group = UINT32_MAX;
+    pass.subpass = 0;
+    if (!kept[handle])
+      continue;
+
+    const bool graphics = pass.type == RENDER_PASS_TYPE_GRAPHICS;
+    VkExtent2D extent = { 0, 0 };
+    if (graphics) {
+      bool hasAttachment = false;
+      for (const Use &use : pass.uses) {
+        if (!isAttachment(use.kind))
+          continue;
+
+        const RenderImageDesc &desc = resources[use.resource].desc;
+        if (hasAttachment && (desc.width != extent.width || desc.height != extent.height))
+          throw std::invalid_argument("Attachments of pass " + pass.name + " differ in size");
+        extent = { desc.width, desc.height };
+        hasAttachment = true;
+      }
+
+      if (!hasAttachment)
+        throw std::invalid_argument("Graphics pass " + pass.name + " has no attachment");
+    }
+
+    // Graphics passes become subpasses of the previous group if they only
+    // access what it wrote as attachments, at the same pixel
+    bool merge = graphics && !groups.empty() && groups.back().graphics &&
+      groups.back().extent.width == extent.width &&
+      groups.back().extent.height == extent.height;
+
+    for (size_t i = 0; merge && i < groups.back().passes.size(); i++) {
+      for (const Use &previous : passes[groups.back().passes[i]].uses) {
+        for (const Use &use : pass.uses) {
+          if (use.resource != previous.resource)
+            continue;
+
+          const bool attachments = isAttachment(use.kind) && isAttachment(previous.kind);
+          const bool reads = !isAttachment(use.kind) && !isAttachment(previous.kind) && !use.write && !previous.write;
+          if (!attachments && !reads)
+            merge = false;
+        }
+      }
+    }
+
+    if (!merge) {
+      Group group = {};
+      group.graphics = graphics;
+      group.extent = extent;
+      group.renderPass = VK_NULL_HANDLE;
+      groups.push_back(group);
+    }
+
+    Group &group = groups.back();
+    pass.group = static_cast<uint32_t>(groups.size() - 1);
+    pass.subpass = static_cast<uint32_t>(group.passes.size());
+    group.passes.push_back(handle);
+  }
+
+  for (Resource &resource : resources) {
+    resource.firstGroup = UINT32_MAX;
+    resource.lastGroup = UINT32_MAX;
+  }
+
+  for (uint32_t g = 0; g < groups.size(); g++) {
+    for (RenderPassHandle handle : groups[g].passes) {
+      for (const Use &use : passes[handle].uses) {
+        Resource &resource = resources[use.resource];
+        if (resource.firstGroup == UINT32_MAX)
+          resource.firstGroup = g;
+        resource.lastGroup = g;
+      }
+    }
+  }
+}
+
+bool RenderGraph::trackUse(ResourceState &state, const Use &use, bool image, Dependency &outDependency) {
+  const bool layoutChange = image && use.layout != state.layout;
+  outDependency.oldLayout = use.discard ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout;
+  outDependency.layoutChange = layoutChange;
+
+  if (use.write || layoutChange) {
+    // Writes and transitions wait for all accesses since the last write
+    outDependency.srcStages = state.writeStages | state.readStages;
+    outDependency.srcAccess = state.writeAccess;
+    const bool needed = layoutChange || outDependency.srcStages != 0;
+
+    state.layout = use.layout;
+    if (use.write) {
+      state.writeStages = use.stages;
+      state.writeAccess = use.access & WRITE_ACCESS;
+      state.readStages = 0;
+      state.visibleStages = 0;
+      state.visibleAccess = 0;
+    } else {
+      // The transition is the last write, visible to this use only
+      state.writeStages = use.stages;
+      state.writeAccess = 0;
+      state.readStages = use.stages;
+      state.visibleStages = use.stages;
+      state.visibleAccess = use.access;
+    }
+    return needed;
+  }
+
+  // Reads only wait for the last write, once per stage and access
+  outDependency.srcStages = state.writeStages;
+  outDependency.srcAccess = state.writeAccess;
+  const bool visible =
+    (use.stages & ~state.visibleStages) == 0 &&
+    (use.access & ~state.visibleAccess) == 0;
+  const bool needed = state.writeStages != 0 && !visible;
+
+  if (needed) {
+    state.visibleStages |= use.stages;
+    state.visibleAccess |= use.access;
+  }
+  state.readStages |= use.stages;
+  return needed;
+}
+
+void RenderGraph::addSubpassDependency(Group &group, uint32_t srcSubpass, uint32_t dstSubpass, const Dependency &dependency, const Use &use) {
+  const VkPipelineStageFlags srcStages = dependency.srcStages != 0 ? dependency.srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+
+  for (VkSubpassDependency &previous : group.dependencies) {
+    if (previous.srcSubpass == srcSubpass && previous.dstSubpass == dstSubpass) {
+      previous.srcStageMask |= srcStages;
+      previous.srcAccessMask |= dependency.srcAccess;
+      previous.dstStageMask |= use.stages;
+      previous.dstAccessMask |= use.access;
+      return;
+    }
+  }
+
+  VkSubpassDependency subpassDependency = {};
+  subpassDependency.srcSubpass = srcSubpass;
+  subpassDependency.dstSubpass = dstSubpass;
+  subpassDependency.srcStageMask = srcStages;
+  subpassDependency.srcAccessMask = dependency.srcAccess;
+  subpassDependency.dstStageMask = use.stages;
+  subpassDependency.dstAccessMask = use.access;
+  // Attachments are only accessed at the pixel being shaded
+  if (srcSubpass != VK_SUBPASS_EXTERNAL)
+    subpassDependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+  group.dependencies.push_back(subpassDependency);
+}
+
+void RenderGraph::addBarrier(RenderBarrierBatch &batch, const Dependency &dependency, const Use &use) {
+  batch.srcStages |= dependency.srcStages != 0 ? dependency.srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+  batch.dstStages |= use.stages;
+
+  // Images keeping their layout are covered by the global memory barrier
+  if (dependency.layoutChange) {
+    batch.images.push_back({
+      use.resource,
+      dependency.oldLayout,
+      use.layout,
+      dependency.srcAccess,
+      use.access
+    });
+  } else {
+    batch.srcAccess |= dependency.srcAccess;
+    batch.dstAccess |= use.access;
+  }
+}
+
+void RenderGraph::addAttachmentUse(Group &group, uint32_t groupIndex, uint32_t subpass, ResourceState &state, const Use &use) {
+  uint32_t index = 0;
+  while (index < group.attachments.size() && group.attachments[index].resource != use.resource)
+    index++;
+
+  Dependency dependency;
+  if (index == group.attachments.size()) {
+    // The render pass transitions the attachment from its current layout,
+    // after the previous accesses
+    Attachment attachment = {};
+    attachment.resource = use.resource;
+    attachment.loadOp = use.loadOp;
+    attachment.initialLayout = use.discard ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout;
+    attachment.firstSubpass = subpass;
+    attachment.lastSubpass = subpass;
+    group.attachments.push_back(attachment);
+
+    if (trackUse(state, use, true, dependency))
+      addSubpassDependency(group, VK_SUBPASS_EXTERNAL, subpass, dependency, use);
+  } else {
+    group.attachments[index].lastSubpass = subpass;
+    const uint32_t srcSubpass = state.lastGroup == groupIndex ? state.lastSubpass : VK_SUBPASS_EXTERNAL;
+    if (trackUse(state, use, true, dependency))
+      addSubpassDependency(group, srcSubpass, subpass, dependency, use);
+  }
+
+  Subpass &description = group.subpasses[subpass];
+  const VkAttachmentReference reference = { index, use.layout };
+  if (use.kind == USE_COLOR_ATTACHMENT)
+    description.colors.push_back(reference);
+  else if (use.kind == USE_DEPTH_ATTACHMENT)
+    description.depth = reference;
+  else
+    description.inputs.push_back(reference);
+}
+
+void RenderGraph::computeBarriers() {
+  // A transient may alias the memory of any other one, and the same image
+  // is used by the previous frame: its first use waits for all of them
+  VkPipelineStageFlags transientStages = 0;
+  VkAccessFlags transientWrites = 0;
+  for (const Group &group : groups) {
+    for (RenderPassHandle handle : group.passes) {
+      for (const Use &use : passes[handle].uses) {
+        if (!resources[use.resource].transient)
+          continue;
+        transientStages |= use.stages;
+        if (use.write)
+          transientWrites |= use.access & WRITE_ACCESS;
+      }
+    }
+  }
+
+  std::vector<ResourceState> states(resources.size());
+  for (size_t i = 0; i < resources.size(); i++) {
+    const Resource &resource = resources[i];
+    ResourceState &state = states[i];
+    state = {};
+    state.layout = resource.transient ? VK_IMAGE_LAYOUT_UNDEFINED : resource.initialLayout;
+    state.writeStages = resource.transient ? transientStages : resource.initialStages;
+    state.writeAccess = resource.transient ? transientWrites : 0;
+    state.lastGroup = UINT32_MAX;
+  }
+
+  for (uint32_t g = 0; g < groups.size(); g++) {
+    Group &group = groups[g];
+    group.barriers = {};
+    group.attachments.clear();
+    group.dependencies.clear();
+    group.subpasses.assign(group.graphics ? group.passes.size() : 0, Subpass{});
+
+    for (uint32_t subpass = 0; subpass < group.passes.size(); subpass++) {
+      if (group.graphics)
+        group.subpasses[subpass].depth = { VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_UNDEFINED };
+
+      for (const Use &use : passes[group.passes[subpass]].uses) {
+        ResourceState &state = states[use.resource];
+        const bool image = resources[use.resource].image;
+
+        if (group.graphics && isAttachment(use.kind))
+          addAttachmentUse(group, g, subpass, state, use);
+        else {
+          // Non attachment accesses of the group do not conflict, so they
+          // all wait before the render pass
+          Dependency dependency;
+          if (trackUse(state, use, image, dependency))
+            addBarrier(group.barriers, dependency, use);
+        }
+
+        state.lastGroup = g;
+        state.lastSubpass = subpass;
+      }
+    }
+
+    for (uint32_t index = 0; index < group.attachments.size(); index++) {
+      Attachment &attachment = group.attachments[index];
+      const Resource &resource = resources[attachment.resource];
+      ResourceState &state = states[attachment.resource];
+
+      // Transients not used afterwards never leave the tile
+      const bool usedLater = resource.lastGroup > g;
+      attachment.storeOp = resource.transient && !resource.output && !usedLater
+        ? VK_ATTACHMENT_STORE_OP_DONT_CARE
+        : VK_ATTACHMENT_STORE_OP_STORE;
+
+      // Imported images reach their final layout with the render pass of
+      // their last use rather than a barrier
+      attachment.finalLayout = state.layout;
+      if (!resource.transient && !usedLater && resource.finalLayout != VK_IMAGE_LAYOUT_UNDEFINED) {
+        attachment.finalLayout = resource.finalLayout;
+        state.layout = resource.finalLayout;
+      }
+
+      // Contents must be preserved through the subpasses not using them
+      for (uint32_t subpass = attachment.firstSubpass + 1; subpass < attachment.lastSubpass; subpass++) {
+        const Subpass &description = group.subpasses[subpass];
+        bool referenced = description.depth.attachment == index;
+        for (const VkAttachmentReference &reference : description.colors)
+          referenced = referenced || reference.attachment == index;
+        for (const VkAttachmentReference &reference : description.inputs)
+          referenced = referenced || reference.attachment == index;
+
+        if (!referenced)
+          group.subpasses[subpass].preserves.push_back(index);
+      }
+    }
+  }
+
+  finalBarriers = {};
+  for (size_t i = 0; i < resources.size(); i++) {
+    const Resource &resource = resources[i];
+    ResourceState &state = states[i];
+    if (!resource.image || resource.transient || resource.firstGroup == UINT32_MAX)
+      continue;
+    if (resource.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED || resource.finalLayout == state.layout)
+      continue;
+
+    // Whatever uses the image next synchronizes with the submission
+    const Use use = {
+      static_cast<RenderResource>(i),
+      USE_IMAGE,
+      resource.finalLayout,
+      VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+      0,
+      false,
+      false,
+      VK_ATTACHMENT_LOAD_OP_LOAD
+    };
+
+    Dependency dependency;
+    if (trackUse(state, use, true, dependency))
+      addBarrier(finalBarriers, dependency, use);
+  }
+}
+
+bool RenderGraph::getLifetime(RenderResource resource, uint32_t &outFirstGroup, uint32_t &outLastGroup) const {
+  const Resource &description = resources[resource];
+  if (!description.transient || description.firstGroup == UINT32_MAX)
+    return false;
+
+  outFirstGroup = description.firstGroup;
+  outLastGroup = description.lastGroup;
+  return true;
+}
+
+VkImageUsageFlags RenderGraph::getImageUsage(const Use &use) {
+  if (use.kind == USE_COLOR_ATTACHMENT)
+    return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+  if (use.kind == USE_DEPTH_ATTACHMENT)
+    return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+  if (use.kind == USE_INPUT_ATTACHMENT)
+    return VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+
+  switch (use.layout) {
+    case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+    case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL:
+      return VK_IMAGE_USAGE_SAMPLED_BIT;
+    case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+      return VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+      return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    default:
+      return VK_IMAGE_USAGE_STORAGE_BIT;
+  }
+}
+
+void RenderGraph::build(VkDevice newDevice, MemoryAllocator *newAllocator) {
+  device = newDevice;
+  allocator = newAllocator;
+
+  createTransients();
+  for (Group &group : groups) {
+    if (group.graphics)
+      createRenderPass(group);
+  }
+}
+
+void RenderGraph::createTransients() {
+  std::vector<RenderResource> transients;
+  std::vector<RenderAliasRequest> requests;
+  VkMemoryRequirements memoryRequirements = {};
+  memoryRequirements.memoryTypeBits = UINT32_MAX;
+
+  for (RenderResource i = 0; i < resources.size(); i++) {
+    Resource &resource = resources[i];
+    if (!resource.transient || resource.firstGroup == UINT32_MAX)
+      continue;
+
+    VkImageUsageFlags usage = 0;
+    for (uint32_t g = resource.firstGroup; g <= resource.lastGroup; g++) {
+      for (RenderPassHandle handle : groups[g].passes) {
+        for (const Use &use : passes[handle].uses) {
+          if (use.resource == i)
+            usage |= getImageUsage(use);
+        }
+      }
+    }
+
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = resource.desc.width;
+    imageInfo.extent.height = resource.desc.height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = resource.desc.format;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = usage;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateImage(device, &imageInfo, nullptr, &resource.handle) != VK_SUCCESS)
+      throw std::runtime_error("Failed to create image " + resource.name);
+
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(device, resource.handle, &requirements);
+    memoryRequirements.alignment = std::max(memoryRequirements.alignment, requirements.alignment);
+    memoryRequirements.memoryTypeBits &= requirements.memoryTypeBits;
+
+    transients.push_back(i);
+    requests.push_back({ resource.firstGroup, resource.lastGroup, requirements.size, requirements.alignment });
+  }
+
+  if (transients.empty())
+    return;
+
+  std::vector<VkDeviceSize> offsets;
+  memoryRequirements.size = assignAliasOffsets(requests, offsets);
+  if (memoryRequirements.memoryTypeBits == 0)
+    throw std::runtime_error("Transient images cannot share memory");
+
+  transientMemory = allocator->allocate(memoryRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false);
+
+  for (size_t i = 0; i < transients.size(); i++) {
+    Resource &resource = resources[transients[i]];
+    vkBindImageMemory(device, resource.handle, transientMemory.memory, transientMemory.offset + offsets[i]);
+
+    VkImageViewCreateInfo viewInfo = {};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = resource.handle;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = resource.desc.format;
+    viewInfo.subresourceRange.aspectMask = getImageAspect(resource.desc.format, false);
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    if (vkCreateImageView(device, &viewInfo, nullptr, &resource.view) != VK_SUCCESS)
+      throw std::runtime_error("Failed to create image view " + resource.name);
+  }
+}
+
+void RenderGraph::createRenderPass(Group &group) {
+  std::vector<VkAttachmentDescription> attachments;
+  for (const Attachment &attachment : group.attachments) {
+    VkAttachmentDescription description = {};
+    description.format = resources[attachment.resource].desc.format;
+    description.samples = VK_SAMPLE_COUNT_1_BIT;
+    description.loadOp = attachment.loadOp;
+    description.storeOp = attachment.storeOp;
+    description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    description.initialLayout = attachment.initialLayout;
+    description.finalLayout = attachment.finalLayout;
+    attachments.push_back(description);
+  }
+
+  std::vector<VkSubpassDescription> subpasses;
+  for (const Subpass &subpass : group.subpasses) {
+    VkSubpassDescription description = {};
+    description.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    description.colorAttachmentCount = static_cast<uint32_t>(subpass.colors.size());
+    description.pColorAttachments = subpass.colors.empty() ? nullptr : subpass.colors.data();
+    description.inputAttachmentCount = static_cast<uint32_t>(subpass.inputs.size());
+    description.pInputAttachments = subpass.inputs.empty() ? nullptr : subpass.inputs.data();
+    description.pDepthStencilAttachment = subpass.depth.attachment != VK_ATTACHMENT_UNUSED ? &subpass.depth : nullptr;
+    description.preserveAttachmentCount = static_cast<uint32_t>(subpass.preserves.size());
+    description.pPreserveAttachments = subpass.preserves.empty() ? nullptr : subpass.preserves.data();
+    subpasses.push_back(description);
+  }
+
+  VkRenderPassCreateInfo renderPassInfo = {};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+  renderPassInfo.pAttachments = attachments.data();
+  renderPassInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
+  renderPassInfo.pSubpasses = subpasses.data();
+  renderPassInfo.dependencyCount = static_cast<uint32_t>(group.dependencies.size());
+  renderPassInfo.pDependencies = group.dependencies.empty() ? nullptr : group.dependencies.data();
+
+  if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &group.renderPass) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create render pass!");
+}
+
+VkFramebuffer RenderGraph::getFramebuffer(Group &group) {
+  std::vector<VkImageView> views;
+  for (const Attachment &attachment : group.attachments) {
+    const Resource &resource = resources[attachment.resource];
+    if (resource.view == VK_NULL_HANDLE)
+      throw std::runtime_error("Image " + resource.name + " has not been set");
+    views.push_back(resource.view);
+  }
+
+  // Imported images change from frame to frame, swap chain images cycle
+  auto found = group.framebuffers.find(views);
+  if (found != group.framebuffers.end())
+    return found->second;
+
+  VkFramebufferCreateInfo framebufferInfo = {};
+  framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+  framebufferInfo.renderPass = group.renderPass;
+  framebufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+  framebufferInfo.pAttachments = views.data();
+  framebufferInfo.width = group.extent.width;
+  framebufferInfo.height = group.extent.height;
+  framebufferInfo.layers = 1;
+
+  VkFramebuffer framebuffer;
+  if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create framebuffer!");
+
+  group.framebuffers[views] = framebuffer;
+  return framebuffer;
+}
+
+void RenderGraph::recordBarriers(VkCommandBuffer commandBuffer, const RenderBarrierBatch &batch) const {
+  if (batch.srcStages == 0)
+    return;
+
+  std::vector<VkImageMemoryBarrier> imageBarriers;
+  for (const RenderImageBarrier &image : batch.images) {
+    const Resource &resource = resources[image.resource];
+    if (resource.handle == VK_NULL_HANDLE)
+      throw std::runtime_error("Image " + resource.name + " has not been set");
+
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = image.srcAccess;
+    barrier.dstAccessMask = image.dstAccess;
+    barrier.oldLayout = image.oldLayout;
+    barrier.newLayout = image.newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = resource.handle;
+    barrier.subresourceRange.aspectMask = getImageAspect(resource.desc.format, true);
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    imageBarriers.push_back(barrier);
+  }
+
+  VkMemoryBarrier memoryBarrier = {};
+  memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  memoryBarrier.srcAccessMask = batch.srcAccess;
+  memoryBarrier.dstAccessMask = batch.dstAccess;
+  const uint32_t memoryBarrierCount = (batch.srcAccess | batch.dstAccess) != 0 ? 1 : 0;
+
+  vkCmdPipelineBarrier(
+    commandBuffer,
+    batch.srcStages,
+    batch.dstStages,
+    0,
+    memoryBarrierCount, &memoryBarrier,
+    0, nullptr,
+    static_cast<uint32_t>(imageBarriers.size()), imageBarriers.empty() ? nullptr : imageBarriers.data());
+}
+
+void RenderGraph::execute(
+  VkCommandBuffer commandBuffer,
+  const std::function<void(VkCommandBuffer, uint32_t group, bool begin)> &observer) {
+  for (uint32_t groupIndex = 0; groupIndex < groups.size(); groupIndex++) {
+    Group &group = groups[groupIndex];
+    recordBarriers(commandBuffer, group.barriers);
+
+    if (observer)
+      observer(commandBuffer, groupIndex, true);
+
+    RenderPassContext context = {};
+    context.commandBuffer = commandBuffer;
+
+    if (!group.graphics) {
+      for (RenderPassHandle handle : group.passes) {
+        if (passes[handle].record)
+          passes[handle].record(context);
+      }
+
+      if (observer)
+        observer(commandBuffer, groupIndex, false);
+      continue;
+    }
+
+    context.renderPass = group.renderPass;
+    context.framebuffer = getFramebuffer(group);
+    context.extent = group.extent;
+
+    std::vector<VkClearValue> clearValues;
+    for (const Attachment &attachment : group.attachments)
+      clearValues.push_back(resources[attachment.resource].clearValue);
+
+    VkRenderPassBeginInfo renderPassInfo = {};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = group.renderPass;
+    renderPassInfo.framebuffer = context.framebuffer;
+    renderPassInfo.renderArea.offset = {0, 0};
+    renderPassInfo.renderArea.extent = group.extent;
+    renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+    renderPassInfo.pClearValues = clearValues.data();
+
+    for (uint32_t subpass = 0; subpass < group.passes.size(); subpass++) {
+      const Pass &pass = passes[group.passes[subpass]];
+      const VkSubpassContents contents = pass.secondaryContents
+        ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+        : VK_SUBPASS_CONTENTS_INLINE;
+
+      if (subpass == 0)
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+      else
+        vkCmdNextSubpass(commandBuffer, contents);
+
+      context.subpass = subpass;
+      if (pass.record)
+        pass.record(context);
+    }
+
+    vkCmdEndRenderPass(commandBuffer);
+
+    if (observer)
+      observer(commandBuffer, groupIndex, false);
+  }
+
+  recordBarriers(commandBuffer, finalBarriers);
+}
+
+std::string RenderGraph::getGroupName(uint32_t group) const {
+  std::string name;
+  for (RenderPassHandle pass : groups[group].passes) {
+    if (!name.empty())
+      name += '+';
+    name += passes[pass].name;
+  }
+  return name;
+}
+
+void RenderGraph::destroyTransients() {
+  for (Group &group : groups) {
+    for (const auto &framebuffer : group.framebuffers)
+      vkDestroyFramebuffer(device, framebuffer.second, nullptr);
+    group.framebuffers.clear();
+  }
+
+  for (Resource &resource : resources) {
+    if (!resource.transient)
+      continue;
+    if (resource.view != VK_NULL_HANDLE)
+      vkDestroyImageView(device, resource.view, nullptr);
+    if (resource.handle != VK_NULL_HANDLE)
+      vkDestroyImage(device, resource.handle, nullptr);
+    resource.view = VK_NULL_HANDLE;
+    resource.handle = VK_NULL_HANDLE;
+  }
+
+  if (transientMemory.memory != VK_NULL_HANDLE)
+    allocator->free(transientMemory);
+  transientMemory = {};
+}
+
+void RenderGraph::resize(uint32_t width, uint32_t height) {
+  // Groups only depend on the size through the extents of their attachments
+  const Resource *first = nullptr;
+  for (const Resource &resource : resources) {
+    if (!resource.image)
+      continue;
+    if (first && (resource.desc.width != first->desc.width || resource.desc.height != first->desc.height))
+      throw std::invalid_argument("Images of the graph differ in size");
+    first = &resource;
+  }
+
+  if (device != VK_NULL_HANDLE)
+    destroyTransients();
+
+  for (Resource &resource : resources) {
+    if (!resource.image)
+      continue;
+    resource.desc.width = width;
+    resource.desc.height = height;
+    if (!resource.transient) {
+      resource.handle = VK_NULL_HANDLE;
+      resource.view = VK_NULL_HANDLE;
+    }
+  }
+
+  for (Group &group : groups) {
+    if (group.graphics)
+      group.extent = { width, height };
+  }
+
+  if (device != VK_NULL_HANDLE)
+    createTransients();
+}
+
+void RenderGraph::destroy() {
+  if (device != VK_NULL_HANDLE) {
+    destroyTransients();
+    for (Group &group : groups) {
+      if (group.renderPass != VK_NULL_HANDLE)
+        vkDestroyRenderPass(device, group.renderPass, nullptr);
+    }
+  }
+
+  resources.clear();
+  passes.clear();
+  groups.clear();
+  finalBarriers = {};
+  device = VK_NULL_HANDLE;
+  allocator = nullptr;
+}
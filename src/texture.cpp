@@ -0,0 +1,559 @@
+#include <texture.h>
+
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+
+// Offsets of levels, enough for the texel blocks of every format
+static const size_t TEXTURE_LEVEL_ALIGNMENT = 16;
+
+uint32_t getMipLevelCount(uint32_t width, uint32_t height) {
+  uint32_t levels = 1;
+  uint32_t size = std::max(width, height);
+  while (size > 1) {
+    size /= 2;
+    levels++;
+  }
+
+  return levels;
+}
+
+bool getTextureFormatInfo(VkFormat format, TextureFormatInfo &outInfo) {
+  switch (format) {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+      outInfo = { 1, 1, 4, false };
+      return true;
+    case VK_FORMAT_R8G8B8A8_SRGB:
+      outInfo = { 1, 1, 4, true };
+      return true;
+
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+    case VK_FORMAT_BC4_SNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK:
+      outInfo = { 4, 4, 8, false };
+      return true;
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK:
+      outInfo = { 4, 4, 8, true };
+      return true;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC5_SNORM_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+      outInfo = { 4, 4, 16, false };
+      return true;
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+      outInfo = { 4, 4, 16, true };
+      return true;
+
+    // ASTC blocks are always 16 bytes, of varying footprint
+    case VK_FORMAT_ASTC_4x4_UNORM_BLOCK: outInfo = { 4, 4, 16, false }; return true;
+    case VK_FORMAT_ASTC_4x4_SRGB_BLOCK: outInfo = { 4, 4, 16, true }; return true;
+    case VK_FORMAT_ASTC_5x4_UNORM_BLOCK: outInfo = { 5, 4, 16, false }; return true;
+    case VK_FORMAT_ASTC_5x4_SRGB_BLOCK: outInfo = { 5, 4, 16, true }; return true;
+    case VK_FORMAT_ASTC_5x5_UNORM_BLOCK: outInfo = { 5, 5, 16, false }; return true;
+    case VK_FORMAT_ASTC_5x5_SRGB_BLOCK: outInfo = { 5, 5, 16, true }; return true;
+    case VK_FORMAT_ASTC_6x5_UNORM_BLOCK: outInfo = { 6, 5, 16, false }; return true;
+    case VK_FORMAT_ASTC_6x5_SRGB_BLOCK: outInfo = { 6, 5, 16, true }; return true;
+    case VK_FORMAT_ASTC_6x6_UNORM_BLOCK: outInfo = { 6, 6, 16, false }; return true;
+    case VK_FORMAT_ASTC_6x6_SRGB_BLOCK: outInfo = { 6, 6, 16, true }; return true;
+    case VK_FORMAT_ASTC_8x5_UNORM_BLOCK: outInfo = { 8, 5, 16, false }; return true;
+    case VK_FORMAT_ASTC_8x5_SRGB_BLOCK: outInfo = { 8, 5, 16, true }; return true;
+    case VK_FORMAT_ASTC_8x6_UNORM_BLOCK: outInfo = { 8, 6, 16, false }; return true;
+    case VK_FORMAT_ASTC_8x6_SRGB_BLOCK: outInfo = { 8, 6, 16, true }; return true;
+    case VK_FORMAT_ASTC_8x8_UNORM_BLOCK: outInfo = { 8, 8, 16, false }; return true;
+    case VK_FORMAT_ASTC_8x8_SRGB_BLOCK: outInfo = { 8, 8, 16, true }; return true;
+    case VK_FORMAT_ASTC_10x5_UNORM_BLOCK: outInfo = { 10, 5, 16, false }; return true;
+    case VK_FORMAT_ASTC_10x5_SRGB_BLOCK: outInfo = { 10, 5, 16, true }; return true;
+    case VK_FORMAT_ASTC_10x6_UNORM_BLOCK: outInfo = { 10, 6, 16, false }; return true;
+    case VK_FORMAT_ASTC_10x6_SRGB_BLOCK: outInfo = { 10, 6, 16, true }; return true;
+    case VK_FORMAT_ASTC_10x8_UNORM_BLOCK: outInfo = { 10, 8, 16, false }; return true;
+    case VK_FORMAT_ASTC_10x8_SRGB_BLOCK: outInfo = { 10, 8, 16, true }; return true;
+    case VK_FORMAT_ASTC_10x10_UNORM_BLOCK: outInfo = { 10, 10, 16, false }; return true;
+    case VK_FORMAT_ASTC_10x10_SRGB_BLOCK: outInfo = { 10, 10, 16, true }; return true;
+    case VK_FORMAT_ASTC_12x10_UNORM_BLOCK: outInfo = { 12, 10, 16, false }; return true;
+    case VK_FORMAT_ASTC_12x10_SRGB_BLOCK: outInfo = { 12, 10, 16, true }; return true;
+    case VK_FORMAT_ASTC_12x12_UNORM_BLOCK: outInfo = { 12, 12, 16, false }; return true;
+    case VK_FORMAT_ASTC_12x12_SRGB_BLOCK: outInfo = { 12, 12, 16, true }; return true;
+
+    default:
+      return false;
+  }
+}
+
+size_t getTextureLevelSize(const TextureFormatInfo &info, uint32_t width, uint32_t height) {
+  const size_t blocksX = (width + info.blockWidth - 1) / info.blockWidth;
+  const size_t blocksY = (height + info.blockHeight - 1) / info.blockHeight;
+  return blocksX * blocksY * info.blockSize;
+}
+
+void addTextureLevel(TextureData &texture, uint32_t width, uint32_t height, const unsigned char *texels, size_t size) {
+  TextureLevel level = {};
+  level.width = width;
+  level.height = height;
+  level.offset = (texture.data.size() + TEXTURE_LEVEL_ALIGNMENT - 1) / TEXTURE_LEVEL_ALIGNMENT * TEXTURE_LEVEL_ALIGNMENT;
+  level.size = size;
+
+  texture.data.resize(level.offset + size);
+  memcpy(texture.data.data() + level.offset, texels, size);
+  texture.levels.push_back(level);
+}
+
+static float decodeSrgb(unsigned char value) {
+  const float c = value / 255.0f;
+  return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static unsigned char encodeSrgb(float value) {
+  const float c = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+  return static_cast<unsigned char>(std::round(std::min(std::max(c, 0.0f), 1.0f) * 255.0f));
+}
+
+void downsampleRgba8(
+  const unsigned char *pixels,
+  uint32_t width,
+  uint32_t height,
+  bool srgb,
+  std::vector<unsigned char> &out) {
+  const uint32_t outWidth = std::max(width / 2, 1u);
+  const uint32_t outHeight = std::max(height / 2, 1u);
+  out.resize(size_t(outWidth) * outHeight * 4);
+
+  // Decoded once rather than per texel
+  float decoded[256];
+  for (int i = 0; i < 256; i++)
+    decoded[i] = srgb ? decodeSrgb(static_cast<unsigned char>(i)) : i / 255.0f;
+
+  for (uint32_t y = 0; y < outHeight; y++) {
+    const uint32_t y0 = std::min(y * 2, height - 1);
+    const uint32_t y1 = std::min(y * 2 + 1, height - 1);
+
+    for (uint32_t x = 0; x < outWidth; x++) {
+      const uint32_t x0 = std::min(x * 2, width - 1);
+      const uint32_t x1 = std::min(x * 2 + 1, width - 1);
+      const unsigned char *texels[4] = {
+        pixels + (size_t(y0) * width + x0) * 4,
+        pixels + (size_t(y0) * width + x1) * 4,
+        pixels + (size_t(y1) * width + x0) * 4,
+        pixels + (size_t(y1) * width + x1) * 4
+      };
+
+      unsigned char *destination = &out[(size_t(y) * outWidth + x) * 4];
+      for (int c = 0; c < 3; c++) {
+        float sum = 0.0f;
+        for (const unsigned char *texel : texels)
+          sum += decoded[texel[c]];
+
+        destination[c] = srgb
+          ? encodeSrgb(sum * 0.25f)
+          : static_cast<unsigned char>(std::round(sum * 0.25f * 255.0f));
+      }
+
+      const uint32_t alpha = texels[0][3] + texels[1][3] + texels[2][3] + texels[3][3];
+      destination[3] = static_cast<unsigned char>((alpha + 2) / 4);
+    }
+  }
+}
+
+void appendMipChain(TextureData &texture) {
+  if (texture.format != VK_FORMAT_R8G8B8A8_UNORM && texture.format != VK_FORMAT_R8G8B8A8_SRGB)
+    throw std::invalid_argument("mip chains can only be generated for RGBA8 textures!");
+  if (texture.levels.empty())
+    throw std::invalid_argument("texture has no level to downsample!");
+
+  const bool srgb = texture.format == VK_FORMAT_R8G8B8A8_SRGB;
+  const uint32_t levelCount = getMipLevelCount(texture.width, texture.height);
+
+  std::vector<unsigned char> level(texture.data.begin() + texture.levels.back().offset,
+    texture.data.begin() + texture.levels.back().offset + texture.levels.back().size);
+  std::vector<unsigned char> nextLevel;
+
+  while (texture.levels.size() < levelCount) {
+    const TextureLevel last = texture.levels.back();
+    downsampleRgba8(level.data(), last.width, last.height, srgb, nextLevel);
+    level.swap(nextLevel);
+
+    addTextureLevel(texture, std::max(last.width / 2, 1u), std::max(last.height / 2, 1u), level.data(), level.size());
+  }
+}
+
+typedef struct Rgba8Struct {
+  unsigned char r, g, b, a;
+} Rgba8;
+
+static unsigned char clampByte(int value) {
+  return static_cast<unsigned char>(std::min(std::max(value, 0), 255));
+}
+
+static Rgba8 unpack565(uint16_t color) {
+  const int r = (color >> 11) & 0x1f;
+  const int g = (color >> 5) & 0x3f;
+  const int b = color & 0x1f;
+  return { clampByte((r << 3) | (r >> 2)), clampByte((g << 2) | (g >> 4)), clampByte((b << 3) | (b >> 2)), 255 };
+}
+
+/**
+ * Decodes the color block of BC1 to BC3.
+ * @param alwaysOpaque True for BC2 and BC3, whose color blocks have no
+ *        transparent mode
+ */
+static void decodeBc1Block(const unsigned char *block, bool alwaysOpaque, bool rgba, Rgba8 out[16]) {
+  const uint16_t color0 = block[0] | (block[1] << 8);
+  const uint16_t color1 = block[2] | (block[3] << 8);
+  const uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) | (uint32_t(block[7]) << 24);
+
+  Rgba8 palette[4];
+  palette[0] = unpack565(color0);
+  palette[1] = unpack565(color1);
+  const Rgba8 &c0 = palette[0];
+  const Rgba8 &c1 = palette[1];
+
+  if (color0 > color1 || alwaysOpaque) {
+    palette[2] = { clampByte((2 * c0.r + c1.r) / 3), clampByte((2 * c0.g + c1.g) / 3), clampByte((2 * c0.b + c1.b) / 3), 255 };
+    palette[3] = { clampByte((c0.r + 2 * c1.r) / 3), clampByte((c0.g + 2 * c1.g) / 3), clampByte((c0.b + 2 * c1.b) / 3), 255 };
+  } else {
+    palette[2] = { clampByte((c0.r + c1.r) / 2), clampByte((c0.g + c1.g) / 2), clampByte((c0.b + c1.b) / 2), 255 };
+    palette[3] = { 0, 0, 0, static_cast<unsigned char>(rgba ? 0 : 255) };
+  }
+
+  for (int i = 0; i < 16; i++)
+    out[i] = palette[(indices >> (i * 2)) & 3];
+}
+
+/**
+ * Decodes a BC4 block, also the alpha of BC3 and each channel of BC5.
+ */
+static void decodeBc4Block(const unsigned char *block, unsigned char out[16]) {
+  const int value0 = block[0];
+  const int value1 = block[1];
+
+  int palette[8] = { value0, value1 };
+  if (value0 > value1) {
+    for (int i = 1; i < 7; i++)
+      palette[i + 1] = ((7 - i) * value0 + i * value1) / 7;
+  } else {
+    for (int i = 1; i < 5; i++)
+      palette[i + 1] = ((5 - i) * value0 + i * value1) / 5;
+    palette[6] = 0;
+    palette[7] = 255;
+  }
+
+  uint64_t indices = 0;
+  for (int i = 0; i < 6; i++)
+    indices |= uint64_t(block[2 + i]) << (i * 8);
+
+  for (int i = 0; i < 16; i++)
+    out[i] = clampByte(palette[(indices >> (i * 3)) & 7]);
+}
+
+static const int ETC1_MODIFIERS[8][2] = {
+  { 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 }, { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 }
+};
+
+static const int ETC2_DISTANCES[8] = { 3, 6, 11, 16, 23, 32, 41, 64 };
+
+static const int EAC_MODIFIERS[16][8] = {
+  { -3, -6, -9, -15, 2, 5, 8, 14 },
+  { -3, -7, -10, -13, 2, 6, 9, 12 },
+  { -2, -5, -8, -13, 1, 4, 7, 12 },
+  { -2, -4, -6, -13, 1, 3, 5, 12 },
+  { -3, -6, -8, -12, 2, 5, 7, 11 },
+  { -3, -7, -9, -11, 2, 6, 8, 10 },
+  { -4, -7, -8, -11, 3, 6, 7, 10 },
+  { -3, -5, -8, -11, 2, 4, 7, 10 },
+  { -2, -6, -8, -10, 1, 5, 7, 9 },
+  { -2, -5, -8, -10, 1, 4, 7, 9 },
+  { -2, -4, -8, -10, 1, 3, 7, 9 },
+  { -2, -5, -7, -10, 1, 4, 6, 9 },
+  { -3, -4, -7, -10, 2, 3, 6, 9 },
+  { -1, -2, -3, -10, 0, 1, 2, 9 },
+  { -4, -6, -8, -9, 3, 5, 7, 8 },
+  { -3, -5, -7, -9, 2, 4, 6, 8 }
+};
+
+static int extend4(int value) {
+  return (value << 4) | value;
+}
+
+static int extend5(int value) {
+  return (value << 3) | (value >> 2);
+}
+
+static int extend6(int value) {
+  return (value << 2) | (value >> 4);
+}
+
+static int extend7(int value) {
+  return (value << 1) | (value >> 6);
+}
+
+/**
+ * @return 3 bit two's complement value as an int
+ */
+static int signExtend3(int value) {
+  return (value & 4) ? value - 8 : value;
+}
+
+static Rgba8 offsetColor(const int color[3], int offset) {
+  return { clampByte(color[0] + offset), clampByte(color[1] + offset), clampByte(color[2] + offset), 255 };
+}
+
+/**
+ * Decodes an ETC2 RGB8 block, which extends ETC1 with the T, H and planar
+ * modes encoded as overflowing differential colors. Texels of the result
+ * are in row-major order.
+ */
+static void decodeEtc2Block(const unsigned char *block, Rgba8 out[16]) {
+  const uint32_t indices = (uint32_t(block[4]) << 24) | (block[5] << 16) | (block[6] << 8) | block[7];
+  const bool differential = (block[3] & 2) != 0;
+
+  // Pixel indices are stored column-major, most significant bits first
+  auto pixelIndex = [&](int x, int y) {
+    const int bit = x * 4 + y;
+    return static_cast<int>(((indices >> (bit + 15)) & 2) | ((indices >> bit) & 1));
+  };
+
+  if (differential) {
+    const int r = (block[0] >> 3) + signExtend3(block[0] & 7);
+    const int g = (block[1] >> 3) + signExtend3(block[1] & 7);
+    const int b = (block[2] >> 3) + signExtend3(block[2] & 7);
+
+    if (r < 0 || r > 31) {
+      // T mode
+      const int color0[3] = {
+        extend4(((block[0] >> 1) & 0xc) | (block[0] & 3)), extend4(block[1] >> 4), extend4(block[1] & 0xf)
+      };
+      const int color1[3] = { extend4(block[2] >> 4), extend4(block[2] & 0xf), extend4(block[3] >> 4) };
+      const int distance = ETC2_DISTANCES[((block[3] >> 1) & 6) | (block[3] & 1)];
+
+      const Rgba8 palette[4] = {
+        offsetColor(color0, 0), offsetColor(color1, distance), offsetColor(color1, 0), offsetColor(color1, -distance)
+      };
+      for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 4; x++)
+          out[y * 4 + x] = palette[pixelIndex(x, y)];
+      }
+      return;
+    }
+
+    if (g < 0 || g > 31) {
+      // H mode
+      const int color0[3] = {
+        extend4((block[0] >> 3) & 0xf),
+        extend4(((block[0] & 7) << 1) | ((block[1] >> 4) & 1)),
+        extend4((block[1] & 8) | ((block[1] & 3) << 1) | (block[2] >> 7))
+      };
+      const int color1[3] = {
+        extend4((block[2] >> 3) & 0xf),
+        extend4(((block[2] & 7) << 1) | (block[3] >> 7)),
+        extend4((block[3] >> 3) & 0xf)
+      };
+
+      const int value0 = (color0[0] << 16) | (color0[1] << 8) | color0[2];
+      const int value1 = (color1[0] << 16) | (color1[1] << 8) | color1[2];
+      const int distance = ETC2_DISTANCES[(block[3] & 4) | ((block[3] & 1) << 1) | (value0 >= value1 ? 1 : 0)];
+
+      const Rgba8 palette[4] = {
+        offsetColor(color0, distance), offsetColor(color0, -distance), offsetColor(color1, distance), offsetColor(color1, -distance)
+      };
+      for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 4; x++)
+          out[y * 4 + x] = palette[pixelIndex(x, y)];
+      }
+      return;
+    }
+
+    if (b < 0 || b > 31) {
+      // Planar mode: colors at the origin, right and bottom of the block
+      const int origin[3] = {
+        extend6((block[0] >> 1) & 0x3f),
+        extend7(((block[0] & 1) << 6) | ((block[1] >> 1) & 0x3f)),
+        extend6(((block[1] & 1) << 5) | (block[2] & 0x18) | ((block[2] & 3) << 1) | (block[3] >> 7))
+      };
+      const int horizontal[3] = {
+        extend6((((block[3] >> 2) & 0x1f) << 1) | (block[3] & 1)),
+        extend7((block[4] >> 1) & 0x7f),
+        extend6(((block[4] & 1) << 5) | ((block[5] >> 3) & 0x1f))
+      };
+      const int vertical[3] = {
+        extend6(((block[5] & 7) << 3) | ((block[6] >> 5) & 7)),
+        extend7(((block[6] & 0x1f) << 2) | ((block[7] >> 6) & 3)),
+        extend6(block[7] & 0x3f)
+      };
+
+      for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 4; x++) {
+          unsigned char channels[3];
+          for (int c = 0; c < 3; c++)
+            channels[c] = clampByte((x * (horizontal[c] - origin[c]) + y * (vertical[c] - origin[c]) + 4 * origin[c] + 2) >> 2);
+          out[y * 4 + x] = { channels[0], channels[1], channels[2], 255 };
+        }
+      }
+      return;
+    }
+  }
+
+  // ETC1 individual and differential modes, two sub-blocks
+  int colors[2][3];
+  for (int c = 0; c < 3; c++) {
+    if (differential) {
+      const int base = block[c] >> 3;
+      colors[0][c] = extend5(base);
+      colors[1][c] = extend5(base + signExtend3(block[c] & 7));
+    } else {
+      colors[0][c] = extend4(block[c] >> 4);
+      colors[1][c] = extend4(block[c] & 0xf);
+    }
+  }
+
+  const int tables[2] = { (block[3] >> 5) & 7, (block[3] >> 2) & 7 };
+  const bool flipped = (block[3] & 1) != 0;
+
+  for (int y = 0; y < 4; y++) {
+    for (int x = 0; x < 4; x++) {
+      const int subBlock = flipped ? (y >= 2) : (x >= 2);
+      const int index = pixelIndex(x, y);
+      const int modifier = ETC1_MODIFIERS[tables[subBlock]][index & 1];
+      out[y * 4 + x] = offsetColor(colors[subBlock], index & 2 ? -modifier : modifier);
+    }
+  }
+}
+
+/**
+ * Decodes the EAC alpha block of ETC2 RGBA8, in row-major order.
+ */
+static void decodeEacBlock(const unsigned char *block, unsigned char out[16]) {
+  const int base = block[0];
+  const int multiplier = block[1] >> 4;
+  const int *modifiers = EAC_MODIFIERS[block[1] & 0xf];
+
+  uint64_t indices = 0;
+  for (int i = 2; i < 8; i++)
+    indices = (indices << 8) | block[i];
+
+  // Column-major, first texel in the most significant bits
+  for (int x = 0; x < 4; x++) {
+    for (int y = 0; y < 4; y++) {
+      const int index = (indices >> (45 - (x * 4 + y) * 3)) & 7;
+      out[y * 4 + x] = clampByte(base + modifiers[index] * multiplier);
+    }
+  }
+}
+
+bool canDecodeTexture(VkFormat format) {
+  switch (format) {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+      return true;
+    default:
+      return false;
+  }
+}
+
+/**
+ * Decodes a block to row-major RGBA8 texels.
+ */
+static void decodeBlock(VkFormat format, const unsigned char *block, Rgba8 out[16]) {
+  unsigned char channel[16];
+
+  switch (format) {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+      decodeBc1Block(block, false, false, out);
+      break;
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+      decodeBc1Block(block, false, true, out);
+      break;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+      decodeBc1Block(block + 8, true, false, out);
+      decodeBc4Block(block, channel);
+      for (int i = 0; i < 16; i++)
+        out[i].a = channel[i];
+      break;
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+      // Single channel formats sample as (r, 0, 0, 1)
+      decodeBc4Block(block, channel);
+      for (int i = 0; i < 16; i++)
+        out[i] = { channel[i], 0, 0, 255 };
+      break;
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+      decodeBc4Block(block, channel);
+      for (int i = 0; i < 16; i++)
+        out[i] = { channel[i], 0, 0, 255 };
+      decodeBc4Block(block + 8, channel);
+      for (int i = 0; i < 16; i++)
+        out[i].g = channel[i];
+      break;
+    case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+      decodeEtc2Block(block, out);
+      break;
+    case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+      decodeEtc2Block(block + 8, out);
+      decodeEacBlock(block, channel);
+      for (int i = 0; i < 16; i++)
+        out[i].a = channel[i];
+      break;
+    default:
+      throw std::invalid_argument("texture format cannot be decoded!");
+  }
+}
+
+TextureData decodeTexture(const TextureData &texture) {
+  TextureFormatInfo info;
+  if (!canDecodeTexture(texture.format) || !getTextureFormatInfo(texture.format, info))
+    throw std::invalid_argument("texture format cannot be decoded!");
+
+  TextureData decoded = {};
+  decoded.format = info.srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+  decoded.width = texture.width;
+  decoded.height = texture.height;
+
+  std::vector<unsigned char> pixels;
+  Rgba8 texels[16];
+  for (const TextureLevel &level : texture.levels) {
+    if (level.offset + getTextureLevelSize(info, level.width, level.height) > texture.data.size())
+      throw std::invalid_argument("texture level out of range!");
+
+    pixels.resize(size_t(level.width) * level.height * 4);
+    const unsigned char *block = texture.data.data() + level.offset;
+
+    for (uint32_t blockY = 0; blockY < level.height; blockY += 4) {
+      for (uint32_t blockX = 0; blockX < level.width; blockX += 4, block += info.blockSize) {
+        decodeBlock(texture.format, block, texels);
+
+        // Blocks overhanging the level are cropped
+        for (uint32_t y = 0; y < 4 && blockY + y < level.height; y++) {
+          for (uint32_t x = 0; x < 4 && blockX + x < level.width; x++)
+            memcpy(&pixels[((blockY + y) * size_t(level.width) + blockX + x) * 4], &texels[y * 4 + x], 4);
+        }
+      }
+    }
+
+    addTextureLevel(decoded, level.width, level.height, pixels.data(), pixels.size());
+  }
+
+  return decoded;
+}
@@ -0,0 +1,88 @@
+#include <uniform_ring.h>
+
+#include <stdexcept>
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+VkDeviceSize getUniformRegionSize(VkDeviceSize frameSize, VkDeviceSize alignment) {
+  return alignUp(frameSize, alignment);
+}
+
+VkDeviceSize getUniformAllocationSize(VkDeviceSize size, VkDeviceSize alignment) {
+  return alignUp(size, alignment);
+}
+
+UniformRing::UniformRing() :
+  device(VK_NULL_HANDLE),
+  allocator(nullptr),
+  buffer(VK_NULL_HANDLE),
+  memory({}),
+  frameSize(0),
+  alignment(1),
+  frameBegin(0),
+  head(0)
+{}
+
+void UniformRing::init(
+  VkDevice newDevice,
+  MemoryAllocator *newAllocator,
+  VkDeviceSize newFrameSize,
+  uint32_t frameCount,
+  VkDeviceSize newAlignment) {
+  device = newDevice;
+  allocator = newAllocator;
+  alignment = newAlignment > 0 ? newAlignment : 1;
+  frameSize = getUniformRegionSize(newFrameSize, alignment);
+
+  // Allocations are bound with 32 bit dynamic offsets
+  if (frameSize == 0 || frameSize * frameCount > UINT32_MAX)
+    throw std::invalid_argument("invalid uniform ring size!");
+
+  VkBufferCreateInfo bufferInfo = {};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size = frameSize * frameCount;
+  // Read as an array by the vertex shader, indexed per instance
+  bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
+    throw std::runtime_error("failed to create uniform buffer!");
+
+  VkMemoryRequirements memRequirements;
+  vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+
+  memory = allocator->allocate(
+    memRequirements,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+    true);
+  vkBindBufferMemory(device, buffer, memory.memory, memory.offset);
+
+  beginFrame(0);
+}
+
+void UniformRing::destroy() {
+  if (buffer == VK_NULL_HANDLE)
+    return;
+
+  vkDestroyBuffer(device, buffer, nullptr);
+  allocator->free(memory);
+  buffer = VK_NULL_HANDLE;
+}
+
+void UniformRing::beginFrame(uint32_t frame) {
+  frameBegin = frameSize * frame;
+  head = frameBegin;
+}
+
+UniformAllocation UniformRing::allocate(VkDeviceSize size) {
+  const VkDeviceSize offset = head.fetch_add(getUniformAllocationSize(size, alignment));
+  if (offset + size > frameBegin + frameSize)
+    throw std::runtime_error("uniform ring exhausted for this frame!");
+
+  UniformAllocation allocation;
+  allocation.data = static_cast<char*>(memory.mapped) + offset;
+  allocation.offset = static_cast<uint32_t>(offset);
+  return allocation;
+}
@@ -0,0 +1,454 @@
+#include <upload_batcher.h>
+#include <gpu_profiler.h>
+
+#include <cstring>
+#include <stdexcept>
+
+UploadBatcher::UploadBatcher() :
+  device(VK_NULL_HANDLE),
+  transferQueue(VK_NULL_HANDLE),
+  graphicsQueue(VK_NULL_HANDLE),
+  transferFamily(0),
+  graphicsFamily(0),
+  allocator(nullptr),
+  timestampPeriod(0.0f),
+  timestampValidBits(0),
+  commandPool(VK_NULL_HANDLE),
+  graphicsCommandPool(VK_NULL_HANDLE),
+  recording(false),
+  current({}),
+  lastSubmitted(0),
+  lastAcquired(0),
+  lastCompleted(0),
+  lastStats({})
+{}
+
+void UploadBatcher::init(
+  VkDevice newDevice,
+  VkQueue newTransferQueue,
+  uint32_t newTransferFamily,
+  VkQueue newGraphicsQueue,
+  uint32_t newGraphicsFamily,
+  MemoryAllocator *newAllocator,
+  float newTimestampPeriod,
+  uint32_t newTimestampValidBits) {
+  device = newDevice;
+  transferQueue = newTransferQueue;
+  transferFamily = newTransferFamily;
+  graphicsQueue = newGraphicsQueue;
+  graphicsFamily = newGraphicsFamily;
+  allocator = newAllocator;
+  timestampPeriod = newTimestampPeriod;
+  timestampValidBits = newTimestampValidBits;
+
+  VkCommandPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  poolInfo.queueFamilyIndex = transferFamily;
+
+  if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create upload command pool!");
+
+  if (separateQueues()) {
+    poolInfo.queueFamilyIndex = graphicsFamily;
+
+    if (vkCreateCommandPool(device, &poolInfo, nullptr, &graphicsCommandPool) != VK_SUCCESS)
+      throw std::runtime_error("Failed to create upload command pool!");
+  }
+}
+
+bool UploadBatcher::separateQueues() const {
+  return transferFamily != graphicsFamily;
+}
+
+void UploadBatcher::destroy() {
+  if (commandPool == VK_NULL_HANDLE)
+    return;
+
+  wait(flush());
+
+  std::lock_guard<std::mutex> lock(mutex);
+  for (Batch &batch : available) {
+    vkDestroyFence(device, batch.fence, nullptr);
+    if (batch.acquireFence != VK_NULL_HANDLE)
+      vkDestroyFence(device, batch.acquireFence, nullptr);
+    if (batch.queryPool != VK_NULL_HANDLE)
+      vkDestroyQueryPool(device, batch.queryPool, nullptr);
+  }
+  available.clear();
+
+  vkDestroyCommandPool(device, commandPool, nullptr);
+  commandPool = VK_NULL_HANDLE;
+
+  if (graphicsCommandPool != VK_NULL_HANDLE) {
+    vkDestroyCommandPool(device, graphicsCommandPool, nullptr);
+    graphicsCommandPool = VK_NULL_HANDLE;
+  }
+}
+
+UploadBatcher::Batch UploadBatcher::acquireBatch() {
+  if (!available.empty()) {
+    Batch batch = available.back();
+    available.pop_back();
+
+    vkResetCommandBuffer(batch.commandBuffer, 0);
+    if (batch.graphicsCommandBuffer != VK_NULL_HANDLE)
+      vkResetCommandBuffer(batch.graphicsCommandBuffer, 0);
+    vkResetFences(device, 1, &batch.fence);
+    if (batch.acquireFence != VK_NULL_HANDLE)
+      vkResetFences(device, 1, &batch.acquireFence);
+    batch.acquired = false;
+    batch.bytes = 0;
+    batch.timed = false;
+    return batch;
+  }
+
+  Batch batch = {};
+
+  VkCommandBufferAllocateInfo allocInfo = {};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandPool = commandPool;
+  allocInfo.commandBufferCount = 1;
+
+  if (vkAllocateCommandBuffers(device, &allocInfo, &batch.commandBuffer) != VK_SUCCESS)
+    throw std::runtime_error("Failed to allocate upload command buffer!");
+
+  VkFenceCreateInfo fenceInfo = {};
+  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+  if (vkCreateFence(device, &fenceInfo, nullptr, &batch.fence) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create upload fence!");
+
+  if (separateQueues()) {
+    allocInfo.commandPool = graphicsCommandPool;
+
+    if (vkAllocateCommandBuffers(device, &allocInfo, &batch.graphicsCommandBuffer) != VK_SUCCESS)
+      throw std::runtime_error("Failed to allocate upload command buffer!");
+
+    if (vkCreateFence(device, &fenceInfo, nullptr, &batch.acquireFence) != VK_SUCCESS)
+      throw std::runtime_error("Failed to create upload fence!");
+  }
+
+  if (timestampValidBits != 0) {
+    VkQueryPoolCreateInfo queryPoolInfo = {};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = 2;
+
+    if (vkCreateQueryPool(device, &queryPoolInfo, nullptr, &batch.queryPool) != VK_SUCCESS)
+      throw std::runtime_error("Failed to create upload query pool!");
+  }
+
+  return batch;
+}
+
+void UploadBatcher::beginLocked() {
+  if (recording)
+    return;
+
+  collectLocked();
+  current = acquireBatch();
+
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  vkBeginCommandBuffer(current.commandBuffer, &beginInfo);
+  if (current.graphicsCommandBuffer != VK_NULL_HANDLE)
+    vkBeginCommandBuffer(current.graphicsCommandBuffer, &beginInfo);
+
+  if (current.queryPool != VK_NULL_HANDLE) {
+    // A dedicated transfer queue cannot reset queries, the previous acquire did
+    if (!separateQueues())
+      vkCmdResetQueryPool(current.commandBuffer, current.queryPool, 0, 2);
+    current.timed = !separateQueues() || current.queriesReset;
+    current.queriesReset = false;
+
+    if (current.timed)
+      vkCmdWriteTimestamp(current.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, current.queryPool, 0);
+  }
+
+  recording = true;
+}
+
+VkCommandBuffer UploadBatcher::getCommandBuffer() {
+  std::lock_guard<std::mutex> lock(mutex);
+  beginLocked();
+  return current.commandBuffer;
+}
+
+VkCommandBuffer UploadBatcher::getGraphicsCommandBuffer() {
+  std::lock_guard<std::mutex> lock(mutex);
+  beginLocked();
+
+  if (current.graphicsCommandBuffer != VK_NULL_HANDLE)
+    return current.graphicsCommandBuffer;
+  return current.commandBuffer;
+}
+
+void UploadBatcher::releaseBuffer(VkBuffer buffer, VkAccessFlags dstAccessMask, VkPipelineStageFlags dstStageMask) {
+  std::lock_guard<std::mutex> lock(mutex);
+  beginLocked();
+
+  VkBufferMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = dstAccessMask;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.buffer = buffer;
+  barrier.offset = 0;
+  barrier.size = VK_WHOLE_SIZE;
+
+  if (!separateQueues()) {
+    vkCmdPipelineBarrier(current.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStageMask, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+    return;
+  }
+
+  // Release on the transfer queue, access masks of the other queue are ignored
+  barrier.srcQueueFamilyIndex = transferFamily;
+  barrier.dstQueueFamilyIndex = graphicsFamily;
+  barrier.dstAccessMask = 0;
+  vkCmdPipelineBarrier(current.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+  // Acquire on the graphics queue, submitted once the copies completed
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = dstAccessMask;
+  vkCmdPipelineBarrier(current.graphicsCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStageMask, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+void UploadBatcher::releaseImage(
+  VkImage image,
+  const VkImageSubresourceRange &range,
+  VkImageLayout oldLayout,
+  VkImageLayout newLayout,
+  VkAccessFlags dstAccessMask,
+  VkPipelineStageFlags dstStageMask) {
+  std::lock_guard<std::mutex> lock(mutex);
+  beginLocked();
+
+  VkImageMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = dstAccessMask;
+  barrier.oldLayout = oldLayout;
+  barrier.newLayout = newLayout;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.subresourceRange = range;
+
+  if (!separateQueues()) {
+    vkCmdPipelineBarrier(current.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStageMask, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    return;
+  }
+
+  // Both halves of the transfer must describe the same layout transition
+  barrier.srcQueueFamilyIndex = transferFamily;
+  barrier.dstQueueFamilyIndex = graphicsFamily;
+  barrier.dstAccessMask = 0;
+  vkCmdPipelineBarrier(current.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = dstAccessMask;
+  vkCmdPipelineBarrier(current.graphicsCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStageMask, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+VkBuffer UploadBatcher::stage(const void *data, VkDeviceSize size) {
+  // Makes sure a batch is being recorded to own the buffer
+  getCommandBuffer();
+
+  StagingBuffer staging = {};
+
+  VkBufferCreateInfo bufferInfo = {};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size = size;
+  bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  if (vkCreateBuffer(device, &bufferInfo, nullptr, &staging.buffer) != VK_SUCCESS)
+    throw std::runtime_error("failed to create staging buffer!");
+
+  VkMemoryRequirements memRequirements;
+  vkGetBufferMemoryRequirements(device, staging.buffer, &memRequirements);
+
+  staging.memory = allocator->allocate(
+    memRequirements,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+    true);
+  vkBindBufferMemory(device, staging.buffer, staging.memory.memory, staging.memory.offset);
+
+  memcpy(staging.memory.mapped, data, static_cast<size_t>(size));
+
+  std::lock_guard<std::mutex> lock(mutex);
+  current.stagingBuffers.push_back(staging);
+  current.bytes += size;
+  return staging.buffer;
+}
+
+UploadTicket UploadBatcher::getRecordingTicket() {
+  std::lock_guard<std::mutex> lock(mutex);
+  beginLocked();
+
+  // Batches are submitted one at a time, in ticket order
+  return lastSubmitted + 1;
+}
+
+UploadTicket UploadBatcher::flush() {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  if (!recording)
+    return lastSubmitted;
+
+  if (current.timed)
+    vkCmdWriteTimestamp(current.commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, current.queryPool, 1);
+  vkEndCommandBuffer(current.commandBuffer);
+
+  if (current.graphicsCommandBuffer != VK_NULL_HANDLE) {
+    // Executed once the timestamps are read, for the next use of the batch
+    if (current.queryPool != VK_NULL_HANDLE)
+      vkCmdResetQueryPool(current.graphicsCommandBuffer, current.queryPool, 0, 2);
+    vkEndCommandBuffer(current.graphicsCommandBuffer);
+  }
+
+  VkSubmitInfo submitInfo = {};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &current.commandBuffer;
+
+  if (vkQueueSubmit(transferQueue, 1, &submitInfo, current.fence) != VK_SUCCESS)
+    throw std::runtime_error("Failed to submit uploads!");
+
+  current.ticket = ++lastSubmitted;
+  pending.push_back(current);
+  current = {};
+  recording = false;
+
+  // The transfer queue is the graphics one, later submissions see the copies
+  if (!separateQueues())
+    lastAcquired = lastSubmitted;
+
+  return lastSubmitted;
+}
+
+void UploadBatcher::acquireLocked(UploadTicket ticket, bool wait) {
+  // Acquires are submitted in ticket order, after the copies they follow
+  for (Batch &batch : pending) {
+    if (batch.ticket > ticket)
+      break;
+    if (batch.acquired)
+      continue;
+
+    if (wait)
+      vkWaitForFences(device, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+    else if (vkGetFenceStatus(device, batch.fence) != VK_SUCCESS)
+      break;
+
+    // Read before the acquire resets the queries
+    readStatsLocked(batch);
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &batch.graphicsCommandBuffer;
+
+    if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, batch.acquireFence) != VK_SUCCESS)
+      throw std::runtime_error("Failed to submit uploads!");
+
+    batch.acquired = true;
+    // The batch is reused only once the acquire completed
+    batch.queriesReset = batch.queryPool != VK_NULL_HANDLE;
+    lastAcquired = batch.ticket;
+  }
+}
+
+void UploadBatcher::acquire() {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (separateQueues())
+    acquireLocked(lastSubmitted, false);
+}
+
+void UploadBatcher::readStatsLocked(const Batch &batch) {
+  UploadBatchStats stats = {};
+  stats.ticket = batch.ticket;
+  stats.bytes = batch.bytes;
+
+  uint64_t timestamps[2];
+  if (batch.timed && vkGetQueryPoolResults(
+      device, batch.queryPool, 0, 2,
+      sizeof(timestamps), timestamps, sizeof(uint64_t),
+      VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+    stats.timed = true;
+    stats.milliseconds = getTimestampMilliseconds(timestamps[0], timestamps[1], timestampPeriod, timestampValidBits);
+  }
+
+  lastStats = stats;
+}
+
+UploadBatchStats UploadBatcher::getLastBatchStats() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return lastStats;
+}
+
+UploadTicket UploadBatcher::getLastAcquired() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return lastAcquired;
+}
+
+void UploadBatcher::collectLocked() {
+  // Batches complete in submission order, with their acquire if any
+  while (!pending.empty()) {
+    Batch &batch = pending.front();
+    if (separateQueues() && !batch.acquired)
+      break;
+    if (vkGetFenceStatus(device, batch.acquired ? batch.acquireFence : batch.fence) != VK_SUCCESS)
+      break;
+
+    // Separate queues read the stats before acquiring
+    if (!separateQueues())
+      readStatsLocked(batch);
+
+    for (StagingBuffer &staging : batch.stagingBuffers) {
+      vkDestroyBuffer(device, staging.buffer, nullptr);
+      allocator->free(staging.memory);
+    }
+    batch.stagingBuffers.clear();
+
+    lastCompleted = batch.ticket;
+    available.push_back(batch);
+    pending.pop_front();
+  }
+}
+
+void UploadBatcher::collect() {
+  std::lock_guard<std::mutex> lock(mutex);
+  collectLocked();
+}
+
+bool UploadBatcher::isComplete(UploadTicket ticket) {
+  std::lock_guard<std::mutex> lock(mutex);
+  collectLocked();
+  return ticket <= lastCompleted;
+}
+
+void UploadBatcher::wait(UploadTicket ticket) {
+  bool needsFlush;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    needsFlush = recording && ticket > lastSubmitted;
+  }
+  if (needsFlush)
+    flush();
+
+  std::lock_guard<std::mutex> lock(mutex);
+  if (separateQueues())
+    acquireLocked(ticket, true);
+
+  for (const Batch &batch : pending) {
+    if (batch.ticket > ticket)
+      break;
+    vkWaitForFences(device, 1, separateQueues() ? &batch.acquireFence : &batch.fence, VK_TRUE, UINT64_MAX);
+  }
+  collectLocked();
+}
@@ -0,0 +1,254 @@
+#include <vertex_layout.h>
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+typedef struct AttributeFormatStruct {
+  VkFormat format;
+  uint32_t size;
+} AttributeFormat;
+
+static AttributeFormat positionFormat(VertexPositionFormat format) {
+  switch (format) {
+    case VERTEX_POSITION_UNORM16:
+      // Three component 16 bit formats are not required for vertex buffers
+      return { VK_FORMAT_R16G16B16A16_UNORM, 8 };
+    default:
+      return { VK_FORMAT_R32G32B32_SFLOAT, 12 };
+  }
+}
+
+static AttributeFormat colorFormat(VertexColorFormat format) {
+  switch (format) {
+    case VERTEX_COLOR_UNORM8:
+      return { VK_FORMAT_R8G8B8A8_UNORM, 4 };
+    default:
+      return { VK_FORMAT_R32G32B32_SFLOAT, 12 };
+  }
+}
+
+static AttributeFormat texCoordFormat(VertexTexCoordFormat format) {
+  switch (format) {
+    case VERTEX_TEXCOORD_FLOAT16:
+      return { VK_FORMAT_R16G16_SFLOAT, 4 };
+    case VERTEX_TEXCOORD_UNORM16:
+      return { VK_FORMAT_R16G16_UNORM, 4 };
+    default:
+      return { VK_FORMAT_R32G32_SFLOAT, 8 };
+  }
+}
+
+static AttributeFormat normalFormat(VertexNormalFormat format) {
+  switch (format) {
+    case VERTEX_NORMAL_OCT16:
+      return { VK_FORMAT_R16G16_SNORM, 4 };
+    default:
+      return { VK_FORMAT_R32G32B32_SFLOAT, 12 };
+  }
+}
+
+static uint16_t quantizeUnorm16(float value) {
+  return static_cast<uint16_t>(std::round(std::min(std::max(value, 0.0f), 1.0f) * 65535.0f));
+}
+
+static uint8_t quantizeUnorm8(float value) {
+  return static_cast<uint8_t>(std::round(std::min(std::max(value, 0.0f), 1.0f) * 255.0f));
+}
+
+static int16_t quantizeSnorm16(float value) {
+  return static_cast<int16_t>(std::round(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f));
+}
+
+uint16_t packHalf(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+
+  const uint32_t sign = (bits >> 16) & 0x8000;
+  const uint32_t floatExponent = (bits >> 23) & 0xff;
+  uint32_t mantissa = bits & 0x7fffff;
+
+  // Infinity and NaN
+  if (floatExponent == 0xff)
+    return static_cast<uint16_t>(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+
+  const int32_t exponent = static_cast<int32_t>(floatExponent) - 127 + 15;
+  if (exponent >= 31)
+    return static_cast<uint16_t>(sign | 0x7c00);
+
+  if (exponent <= 0) {
+    // Denormal half, or zero if too small
+    if (exponent < -10)
+      return static_cast<uint16_t>(sign);
+
+    mantissa |= 0x800000;
+    const uint32_t shift = static_cast<uint32_t>(14 - exponent);
+    uint32_t half = mantissa >> shift;
+    if ((mantissa >> (shift - 1)) & 1)
+      half++;
+
+    return static_cast<uint16_t>(sign | half);
+  }
+
+  uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+  // A carry out of the mantissa correctly bumps the exponent
+  if (mantissa & 0x1000)
+    half++;
+
+  return static_cast<uint16_t>(half);
+}
+
+void packOctahedral(const glm::vec3 &normal, int16_t out[2]) {
+  const float length = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+  if (length == 0.0f) {
+    out[0] = 0;
+    out[1] = 0;
+    return;
+  }
+
+  float x = normal.x / length;
+  float y = normal.y / length;
+
+  // Fold the lower hemisphere over the diagonals
+  if (normal.z < 0.0f) {
+    const float foldedX = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+    const float foldedY = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+    x = foldedX;
+    y = foldedY;
+  }
+
+  out[0] = quantizeSnorm16(x);
+  out[1] = quantizeSnorm16(y);
+}
+
+glm::vec3 unpackOctahedral(const int16_t encoded[2]) {
+  const float x = std::max(encoded[0] / 32767.0f, -1.0f);
+  const float y = std::max(encoded[1] / 32767.0f, -1.0f);
+
+  glm::vec3 normal(x, y, 1.0f - std::fabs(x) - std::fabs(y));
+  const float fold = std::max(-normal.z, 0.0f);
+  normal.x += normal.x >= 0.0f ? -fold : fold;
+  normal.y += normal.y >= 0.0f ? -fold : fold;
+
+  return glm::normalize(normal);
+}
+
+VertexLayout VertexLayout::uncompressed() {
+  VertexLayout layout = {};
+  layout.position = VERTEX_POSITION_FLOAT32;
+  layout.color = VERTEX_COLOR_FLOAT32;
+  layout.texCoord = VERTEX_TEXCOORD_FLOAT32;
+  layout.normal = VERTEX_NORMAL_FLOAT32;
+  return layout;
+}
+
+VertexLayout VertexLayout::quantized() {
+  VertexLayout layout = {};
+  layout.position = VERTEX_POSITION_UNORM16;
+  layout.color = VERTEX_COLOR_UNORM8;
+  layout.texCoord = VERTEX_TEXCOORD_FLOAT16;
+  layout.normal = VERTEX_NORMAL_OCT16;
+  return layout;
+}
+
+uint32_t VertexLayout::getStride() const {
+  return positionFormat(position).size +
+    colorFormat(color).size +
+    texCoordFormat(texCoord).size +
+    normalFormat(normal).size;
+}
+
+VkVertexInputBindingDescription VertexLayout::getBindingDescription() const {
+  VkVertexInputBindingDescription bindingDescription = {};
+  bindingDescription.binding = 0;
+  bindingDescription.stride = getStride();
+  bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+  return bindingDescription;
+}
+
+std::vector<VkVertexInputAttributeDescription> VertexLayout::getAttributeDescriptions() const {
+  const AttributeFormat formats[] = {
+    positionFormat(position),
+    colorFormat(color),
+    texCoordFormat(texCoord),
+    normalFormat(normal)
+  };
+
+  std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+  uint32_t offset = 0;
+  for (uint32_t i = 0; i < 4; i++) {
+    VkVertexInputAttributeDescription attribute = {};
+    attribute.binding = 0;
+    attribute.location = i;
+    attribute.format = formats[i].format;
+    attribute.offset = offset;
+    attributeDescriptions.push_back(attribute);
+
+    offset += formats[i].size;
+  }
+
+  return attributeDescriptions;
+}
+
+VertexDequantization VertexLayout::getDequantization(const MeshBounds &bounds) const {
+  VertexDequantization dequantization = {};
+  if (position == VERTEX_POSITION_UNORM16) {
+    dequantization.offset = glm::vec4(bounds.min, 0.0f);
+    dequantization.scale = glm::vec4(bounds.max - bounds.min, 1.0f);
+  } else
+    dequantization.scale = glm::vec4(1.0f);
+
+  return dequantization;
+}
+
+void VertexLayout::encode(const Vertex *vertices, size_t vertexCount, const MeshBounds &bounds, void *out) const {
+  const uint32_t stride = getStride();
+  const glm::vec3 extent = bounds.max - bounds.min;
+
+  char *destination = static_cast<char*>(out);
+  for (size_t i = 0; i < vertexCount; i++, destination += stride) {
+    const Vertex &vertex = vertices[i];
+    char *attribute = destination;
+
+    if (position == VERTEX_POSITION_UNORM16) {
+      uint16_t quantized[4] = {};
+      for (int c = 0; c < 3; c++)
+        quantized[c] = extent[c] > 0.0f ? quantizeUnorm16((vertex.pos[c] - bounds.min[c]) / extent[c]) : 0;
+      memcpy(attribute, quantized, sizeof(quantized));
+      attribute += sizeof(quantized);
+    } else {
+      memcpy(attribute, &vertex.pos, sizeof(vertex.pos));
+      attribute += sizeof(vertex.pos);
+    }
+
+    if (color == VERTEX_COLOR_UNORM8) {
+      const uint8_t quantized[4] = {
+        quantizeUnorm8(vertex.color.x), quantizeUnorm8(vertex.color.y), quantizeUnorm8(vertex.color.z), 255
+      };
+      memcpy(attribute, quantized, sizeof(quantized));
+      attribute += sizeof(quantized);
+    } else {
+      memcpy(attribute, &vertex.color, sizeof(vertex.color));
+      attribute += sizeof(vertex.color);
+    }
+
+    if (texCoord == VERTEX_TEXCOORD_FLOAT16 || texCoord == VERTEX_TEXCOORD_UNORM16) {
+      uint16_t quantized[2];
+      for (int c = 0; c < 2; c++)
+        quantized[c] = texCoord == VERTEX_TEXCOORD_FLOAT16 ? packHalf(vertex.texCoord[c]) : quantizeUnorm16(vertex.texCoord[c]);
+      memcpy(attribute, quantized, sizeof(quantized));
+      attribute += sizeof(quantized);
+    } else {
+      memcpy(attribute, &vertex.texCoord, sizeof(vertex.texCoord));
+      attribute += sizeof(vertex.texCoord);
+    }
+
+    if (normal == VERTEX_NORMAL_OCT16) {
+      int16_t encoded[2];
+      packOctahedral(vertex.normal, encoded);
+      memcpy(attribute, encoded, sizeof(encoded));
+    } else
+      memcpy(attribute, &vertex.normal, sizeof(vertex.normal));
+  }
+}
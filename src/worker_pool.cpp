@@ -0,0 +1,90 @@
+#include <worker_pool.h>
+
+WorkerPool::WorkerPool() :
+  task(nullptr),
+  taskCount(0),
+  nextTask(0),
+  busyThreads(0),
+  batch(0),
+  stopping(false)
+{}
+
+WorkerPool::~WorkerPool() {
+  stop();
+}
+
+void WorkerPool::start(uint32_t threadCount) {
+  stop();
+
+  stopping = false;
+  threads.reserve(threadCount);
+  for (uint32_t i = 0; i < threadCount; i++)
+    threads.emplace_back(&WorkerPool::workerLoop, this, batch);
+}
+
+void WorkerPool::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  batchStarted.notify_all();
+
+  for (std::thread &thread : threads)
+    thread.join();
+  threads.clear();
+}
+
+void WorkerPool::run(uint32_t count, const std::function<void(uint32_t)> &function) {
+  if (count == 0)
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    task = &function;
+    taskCount = count;
+    nextTask = 0;
+    error = nullptr;
+    busyThreads = static_cast<uint32_t>(threads.size());
+    batch++;
+  }
+  batchStarted.notify_all();
+
+  runTasks();
+
+  std::unique_lock<std::mutex> lock(mutex);
+  batchDone.wait(lock, [this] { return busyThreads == 0; });
+  task = nullptr;
+
+  if (error)
+    std::rethrow_exception(error);
+}
+
+void WorkerPool::runTasks() {
+  for (uint32_t i = nextTask++; i < taskCount; i = nextTask++) {
+    try {
+      (*task)(i);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!error)
+        error = std::current_exception();
+    }
+  }
+}
+
+void WorkerPool::workerLoop(uint64_t lastBatch) {
+  std::unique_lock<std::mutex> lock(mutex);
+
+  for (;;) {
+    batchStarted.wait(lock, [&] { return stopping || batch != lastBatch; });
+    if (stopping)
+      return;
+
+    lastBatch = batch;
+    lock.unlock();
+    runTasks();
+    lock.lock();
+
+    if (--busyThreads == 0)
+      batchDone.notify_one();
+  }
+}
@@ -0,0 +1,47 @@
+#include "gtest/gtest.h"
+
+#include <cpu_profiler.h>
+
+#include <sstream>
+
+TEST(CpuProfilerTests, KeepsLatestEventsPerThread) {
+  CpuProfiler profiler(4);
+  {
+    CpuProfileScope scope(profiler, "disabled");
+  }
+  ASSERT_TRUE(profiler.getEvents().empty());
+
+  profiler.setEnabled(true);
+  for (uint64_t i = 0; i < 6; i++)
+    CpuProfileScope scope(profiler, "scope");
+
+  std::thread thread([&]() {
+    profiler.record("worker", 10, 30);
+  });
+  thread.join();
+
+  const std::vector<std::vector<CpuProfileEvent>> events = profiler.getEvents();
+  ASSERT_EQ(events.size(), 2u);
+  ASSERT_EQ(events[0].size(), 4u);
+  ASSERT_STREQ(events[0][0].name, "scope");
+  ASSERT_EQ(events[1].size(), 1u);
+  ASSERT_EQ(events[1][0].start, 10u);
+  ASSERT_EQ(events[1][0].duration, 20u);
+
+  profiler.clear();
+  ASSERT_TRUE(profiler.getEvents()[0].empty());
+}
+
+TEST(CpuProfilerTests, WritesChromeTrace) {
+  CpuProfiler profiler;
+  profiler.setThreadName("main \"thread\"");
+  profiler.record("draw", 1500, 4250);
+
+  std::ostringstream out;
+  profiler.writeChromeTrace(out);
+  const std::string trace = out.str();
+
+  ASSERT_EQ(trace.rfind("{\"traceEvents\":[", 0), 0u);
+  ASSERT_NE(trace.find("\"args\":{\"name\":\"main \\\"thread\\\"\"}"), std::string::npos);
+  ASSERT_NE(trace.find("{\"name\":\"draw\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":1.500,\"dur\":2.750}"), std::string::npos);
+}
@@ -0,0 +1,51 @@
+#include "gtest/gtest.h"
+
+#include <descriptor_allocator.h>
+
+TEST(DescriptorAllocatorTests, ExpandsContiguousEntries) {
+  // Two buffers then three images, laid out one after the other
+  struct {
+    VkDescriptorBufferInfo buffers[2];
+    VkDescriptorImageInfo images[3];
+  } data = {};
+
+  std::vector<VkDescriptorUpdateTemplateEntryKHR> entries(2);
+  entries[0] = { 0, 0, 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, sizeof(VkDescriptorBufferInfo) };
+  entries[1] = { 3, 1, 3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, sizeof(data.buffers), sizeof(VkDescriptorImageInfo) };
+
+  const std::vector<VkWriteDescriptorSet> writes = expandDescriptorUpdate(VK_NULL_HANDLE, entries, &data);
+  ASSERT_EQ(writes.size(), 2u);
+
+  ASSERT_EQ(writes[0].dstBinding, 0u);
+  ASSERT_EQ(writes[0].descriptorCount, 2u);
+  ASSERT_EQ(writes[0].pBufferInfo, data.buffers);
+  ASSERT_EQ(writes[0].pImageInfo, nullptr);
+
+  ASSERT_EQ(writes[1].dstBinding, 3u);
+  ASSERT_EQ(writes[1].dstArrayElement, 1u);
+  ASSERT_EQ(writes[1].descriptorCount, 3u);
+  ASSERT_EQ(writes[1].pImageInfo, data.images);
+  ASSERT_EQ(writes[1].pBufferInfo, nullptr);
+}
+
+TEST(DescriptorAllocatorTests, ExpandsStridedEntriesPerElement) {
+  // Infos interleaved with other data
+  struct Element {
+    VkDescriptorBufferInfo buffer;
+    uint32_t material;
+  };
+  Element elements[3] = {};
+
+  std::vector<VkDescriptorUpdateTemplateEntryKHR> entries(1);
+  entries[0] = { 2, 4, 3, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, sizeof(Element) };
+
+  const std::vector<VkWriteDescriptorSet> writes = expandDescriptorUpdate(VK_NULL_HANDLE, entries, elements);
+  ASSERT_EQ(writes.size(), 3u);
+
+  for (uint32_t i = 0; i < writes.size(); i++) {
+    ASSERT_EQ(writes[i].dstBinding, 2u);
+    ASSERT_EQ(writes[i].dstArrayElement, 4u + i);
+    ASSERT_EQ(writes[i].descriptorCount, 1u);
+    ASSERT_EQ(writes[i].pBufferInfo, &elements[i].buffer);
+  }
+}
@@ -0,0 +1,20 @@
+#include "gtest/gtest.h"
+
+#include <gpu_profiler.h>
+
+TEST(GpuProfilerTests, ConvertsTicksToMilliseconds) {
+  // 2 500 000 ticks of 0.4 ns
+  ASSERT_DOUBLE_EQ(getTimestampMilliseconds(1000, 2501000, 0.4f, 64), 2500000 * double(0.4f) / 1e6);
+  ASSERT_DOUBLE_EQ(getTimestampMilliseconds(7, 7, 1.0f, 64), 0.0);
+}
+
+TEST(GpuProfilerTests, HandlesWrappedTimestamps) {
+  // 36 valid bits, the end wrapped around past zero
+  const uint64_t begin = (uint64_t(1) << 36) - 1000;
+  const uint64_t end = 500;
+  ASSERT_DOUBLE_EQ(getTimestampMilliseconds(begin, end, 1.0f, 36), 1500 / 1e6);
+
+  // Invalid high bits are ignored
+  const uint64_t garbage = uint64_t(0xABCD) << 48;
+  ASSERT_DOUBLE_EQ(getTimestampMilliseconds(garbage | 100, 300, 1.0f, 36), 200 / 1e6);
+}
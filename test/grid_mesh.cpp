@@ -0,0 +1,31 @@
+#include "grid_mesh.h"
+
+void buildGrid(
+  uint32_t resolution,
+  std::vector<Vertex> &vertices,
+  std::vector<uint32_t> &indices,
+  float (*height)(float x, float y)) {
+  const uint32_t side = resolution + 1;
+  vertices.clear();
+  indices.clear();
+
+  for (uint32_t y = 0; y < side; y++) {
+    for (uint32_t x = 0; x < side; x++) {
+      const float fx = static_cast<float>(x), fy = static_cast<float>(y);
+      Vertex vertex = {};
+      vertex.pos = { fx, fy, height ? height(fx, fy) : 0.0f };
+      vertex.color = { 1.0f, 1.0f, 1.0f };
+      vertex.texCoord = { fx / resolution, fy / resolution };
+      vertex.normal = { 0.0f, 0.0f, 1.0f };
+      vertices.push_back(vertex);
+    }
+  }
+
+  for (uint32_t y = 0; y < resolution; y++) {
+    for (uint32_t x = 0; x < resolution; x++) {
+      const uint32_t corner = y * side + x;
+      indices.insert(indices.end(), { corner, corner + 1, corner + side + 1 });
+      indices.insert(indices.end(), { corner, corner + side + 1, corner + side });
+    }
+  }
+}
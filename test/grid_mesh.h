@@ -0,0 +1,18 @@
+#pragma once
+
+#include <vertex.h>
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Builds a grid of resolution x resolution quads in the xy plane, from the
+ * origin to (resolution, resolution). Texture coordinates span the grid
+ * from 0 to 1. Shared by the unit tests and the benchmarks.
+ * @param height Height of the vertex at x, y, or null for a flat grid
+ */
+void buildGrid(
+  uint32_t resolution,
+  std::vector<Vertex> &vertices,
+  std::vector<uint32_t> &indices,
+  float (*height)(float x, float y) = nullptr);
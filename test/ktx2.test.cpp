@@ -0,0 +1,61 @@
+#include "gtest/gtest.h"
+
+#include <ktx2.h>
+
+#include <cstring>
+#include <vector>
+
+/**
+ * @return KTX2 file of a 4x4 RGBA8 texture with its 2x2 mip, levels stored
+ *         smallest first as in files written by the KTX tools
+ */
+static std::vector<unsigned char> makeKtx2() {
+  const unsigned char identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+  const uint32_t fields[9] = { VK_FORMAT_R8G8B8A8_UNORM, 1, 4, 4, 0, 0, 1, 2, 0 };
+  const uint64_t levels[6] = {
+    // Level 0
+    144, 64, 64,
+    // Level 1
+    128, 16, 16
+  };
+
+  std::vector<unsigned char> file(208, 0);
+  memcpy(file.data(), identifier, sizeof(identifier));
+  memcpy(file.data() + 12, fields, sizeof(fields));
+  memcpy(file.data() + 80, levels, sizeof(levels));
+  for (int i = 0; i < 16; i++)
+    file[128 + i] = 1;
+  for (int i = 0; i < 64; i++)
+    file[144 + i] = 2;
+
+  return file;
+}
+
+TEST(Ktx2Tests, ReadsLevels) {
+  const std::vector<unsigned char> file = makeKtx2();
+  const TextureData texture = parseKtx2(file.data(), file.size());
+
+  ASSERT_EQ(texture.format, VK_FORMAT_R8G8B8A8_UNORM);
+  ASSERT_EQ(texture.width, 4u);
+  ASSERT_EQ(texture.height, 4u);
+  ASSERT_EQ(texture.levels.size(), 2u);
+  ASSERT_EQ(texture.levels[0].size, 64u);
+  ASSERT_EQ(texture.levels[1].width, 2u);
+  ASSERT_EQ(texture.levels[1].size, 16u);
+  ASSERT_EQ(texture.levels[1].offset % 16, 0u);
+  ASSERT_EQ(texture.data[texture.levels[0].offset], 2);
+  ASSERT_EQ(texture.data[texture.levels[1].offset], 1);
+}
+
+TEST(Ktx2Tests, RejectsInvalidFiles) {
+  std::vector<unsigned char> file = makeKtx2();
+  file[1] = 'X';
+  ASSERT_THROW(parseKtx2(file.data(), file.size()), std::invalid_argument);
+
+  // Level past the end of the file
+  file = makeKtx2();
+  file.resize(192);
+  ASSERT_THROW(parseKtx2(file.data(), file.size()), std::invalid_argument);
+
+  ASSERT_THROW(parseKtx2(file.data(), 40), std::invalid_argument);
+}
@@ -0,0 +1,68 @@
+#include "gtest/gtest.h"
+
+#include <memory_allocator.h>
+
+TEST(MemoryAllocatorTests, RoundsToSizeClasses) {
+  ASSERT_EQ(getMemorySizeClass(1), 256u);
+  ASSERT_EQ(getMemorySizeClass(256), 256u);
+  ASSERT_EQ(getMemorySizeClass(257), 288u);
+  ASSERT_EQ(getMemorySizeClass(1000), 1024u);
+  ASSERT_EQ(getMemorySizeClass(1024), 1024u);
+  ASSERT_EQ(getMemorySizeClass(1025), 1152u);
+  ASSERT_EQ(getMemorySizeClass(3000), 3072u);
+  ASSERT_EQ(getMemorySizeClass(5000), 5120u);
+
+  // Steps are an eighth of the power of two below the request
+  for (VkDeviceSize size = 257; size < 1 << 20; size += 97)
+    ASSERT_LE(getMemorySizeClass(size) - size, size / 8);
+
+  ASSERT_EQ(getMemoryPoolIndex(3, true, 1024), 6u);
+  ASSERT_EQ(getMemoryPoolIndex(3, false, 1024), 7u);
+  ASSERT_EQ(getMemoryPoolIndex(3, false, 1), 6u);
+}
+
+TEST(MemoryAllocatorTests, PlacesAlignedRangesInBestFit) {
+  MemoryFreeRanges freeRanges;
+  freeRanges[100] = 1000;
+  freeRanges[2048] = 512;
+
+  // The first range fits once aligned, but the second one wastes less
+  VkDeviceSize offset = 0;
+  ASSERT_TRUE(allocateFreeRange(freeRanges, 512, 256, offset));
+  ASSERT_EQ(offset, 2048u);
+  ASSERT_EQ(freeRanges.size(), 1u);
+
+  // Padding and tail are split off the chosen range
+  ASSERT_TRUE(allocateFreeRange(freeRanges, 256, 256, offset));
+  ASSERT_EQ(offset, 256u);
+  ASSERT_EQ(freeRanges.size(), 2u);
+  ASSERT_EQ(freeRanges[100], 156u);
+  ASSERT_EQ(freeRanges[512], 588u);
+
+  ASSERT_FALSE(allocateFreeRange(freeRanges, 1024, 1, offset));
+}
+
+TEST(MemoryAllocatorTests, MergesAdjacentRangesOnFree) {
+  MemoryFreeRanges freeRanges;
+  freeRanges[0] = 4096;
+
+  VkDeviceSize first, second, third;
+  ASSERT_TRUE(allocateFreeRange(freeRanges, 1024, 1, first));
+  ASSERT_TRUE(allocateFreeRange(freeRanges, 1024, 1, second));
+  ASSERT_TRUE(allocateFreeRange(freeRanges, 1024, 1, third));
+  ASSERT_EQ(freeRanges.size(), 1u);
+
+  // Not adjacent to any free range
+  releaseFreeRange(freeRanges, first, 1024);
+  ASSERT_EQ(freeRanges.size(), 2u);
+
+  // Merged with the next free range
+  releaseFreeRange(freeRanges, third, 1024);
+  ASSERT_EQ(freeRanges.size(), 2u);
+  ASSERT_EQ(freeRanges[third], 2048u);
+
+  // Merged with both neighbours
+  releaseFreeRange(freeRanges, second, 1024);
+  ASSERT_EQ(freeRanges.size(), 1u);
+  ASSERT_EQ(freeRanges[0], 4096u);
+}
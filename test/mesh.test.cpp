@@ -0,0 +1,149 @@
+#include "gtest/gtest.h"
+
+#include <mesh.h>
+
+#include <cstring>
+#include <stdexcept>
+
+static Vertex makeVertex(float x, float y, float u, float v) {
+  Vertex vertex = {};
+  vertex.pos = {x, y, 0.0f};
+  vertex.color = {1.0f, 1.0f, 1.0f};
+  vertex.texCoord = {u, v};
+  return vertex;
+}
+
+TEST(MeshBuilderTests, WeldsIdenticalVertices) {
+  // Quad as two triangles, given as an unindexed stream
+  const Vertex quad[] = {
+    makeVertex(0, 0, 0, 0), makeVertex(1, 0, 1, 0), makeVertex(1, 1, 1, 1),
+    makeVertex(1, 1, 1, 1), makeVertex(0, 1, 0, 1), makeVertex(0, 0, 0, 0)
+  };
+
+  MeshBuilder builder;
+  for (const Vertex &vertex : quad)
+    builder.addVertex(vertex);
+
+  ASSERT_EQ(builder.getVertices().size(), 4u);
+  ASSERT_EQ(builder.getIndices(), (std::vector<uint32_t>{0, 1, 2, 2, 3, 0}));
+  ASSERT_FLOAT_EQ(builder.getReuseRatio(), 1.5f);
+}
+
+TEST(MeshBuilderTests, KeepsVerticesWithDifferentAttributes) {
+  MeshBuilder builder;
+  builder.addVertex(makeVertex(0, 0, 0, 0));
+  builder.addVertex(makeVertex(0, 0, 0, 1));
+
+  ASSERT_EQ(builder.getVertices().size(), 2u);
+}
+
+TEST(MeshBuilderTests, WeldsSignedZeros) {
+  MeshBuilder builder;
+  builder.addVertex(makeVertex(0.0f, 0, 0, 0));
+  builder.addVertex(makeVertex(-0.0f, 0, 0, 0));
+
+  ASSERT_EQ(builder.getVertices().size(), 1u);
+}
+
+TEST(MeshBuilderTests, GrowsPastInitialSize) {
+  MeshBuilder builder(4);
+  for (int pass = 0; pass < 2; pass++) {
+    for (int i = 0; i < 10000; i++)
+      builder.addVertex(makeVertex(static_cast<float>(i), 0, 0, 0));
+  }
+
+  ASSERT_EQ(builder.getVertices().size(), 10000u);
+  ASSERT_EQ(builder.getIndices().size(), 20000u);
+  ASSERT_EQ(builder.getIndices()[10000 + 1234], 1234u);
+  ASSERT_FLOAT_EQ(builder.getReuseRatio(), 2.0f);
+}
+
+TEST(SplitMeshTests, KeepsSmallMeshesWhole) {
+  const std::vector<Vertex> vertices = {
+    makeVertex(0, 0, 0, 0), makeVertex(1, 0, 1, 0), makeVertex(1, 1, 1, 1)
+  };
+  const std::vector<uint32_t> indices = {0, 1, 2};
+
+  std::vector<Vertex> outVertices;
+  std::vector<uint32_t> outIndices;
+  const std::vector<MeshChunk> chunks = splitMesh(vertices, indices, MAX_INDEX16_VERTICES, outVertices, outIndices);
+
+  ASSERT_EQ(chunks.size(), 1u);
+  ASSERT_EQ(chunks[0].indexCount, 3u);
+  ASSERT_EQ(outIndices, indices);
+  ASSERT_TRUE(fitsIndex16(outIndices.data(), outIndices.size()));
+}
+
+TEST(SplitMeshTests, SplitsIntoChunksOfBoundedSize) {
+  // Triangle strip of 20 vertices, chunks of at most 8 vertices
+  std::vector<Vertex> vertices;
+  for (int i = 0; i < 20; i++)
+    vertices.push_back(makeVertex(static_cast<float>(i), static_cast<float>(i % 2), 0, 0));
+
+  std::vector<uint32_t> indices;
+  for (uint32_t i = 0; i + 2 < 20; i++) {
+    indices.push_back(i);
+    indices.push_back(i + 1);
+    indices.push_back(i + 2);
+  }
+
+  std::vector<Vertex> outVertices;
+  std::vector<uint32_t> outIndices;
+  const std::vector<MeshChunk> chunks = splitMesh(vertices, indices, 8, outVertices, outIndices);
+
+  ASSERT_GT(chunks.size(), 1u);
+  ASSERT_EQ(outIndices.size(), indices.size());
+
+  uint32_t indexCount = 0;
+  for (const MeshChunk &chunk : chunks) {
+    ASSERT_EQ(chunk.firstIndex, indexCount);
+    indexCount += chunk.indexCount;
+
+    // Each chunk draws the triangles of the source, with local indices
+    for (uint32_t i = chunk.firstIndex; i < chunk.firstIndex + chunk.indexCount; i++) {
+      ASSERT_LT(outIndices[i], 8u);
+      const Vertex &vertex = outVertices[chunk.vertexOffset + outIndices[i]];
+      ASSERT_EQ(memcmp(&vertex, &vertices[indices[i]], sizeof(Vertex)), 0);
+    }
+  }
+  ASSERT_EQ(indexCount, indices.size());
+}
+
+TEST(SplitMeshTests, RejectsInvalidIndices) {
+  const std::vector<Vertex> vertices(4, makeVertex(0, 0, 0, 0));
+
+  std::vector<Vertex> outVertices;
+  std::vector<uint32_t> outIndices;
+  ASSERT_THROW(splitMesh(vertices, {0, 1}, 3, outVertices, outIndices), std::invalid_argument);
+  ASSERT_THROW(splitMesh(vertices, {0, 1, 9}, 3, outVertices, outIndices), std::invalid_argument);
+}
+
+TEST(PackMeshTests, AppendsLevelsOfDetail) {
+  const std::vector<Vertex> vertices = {
+    makeVertex(0, 0, 0, 0), makeVertex(1, 0, 1, 0), makeVertex(1, 1, 1, 1), makeVertex(0, 1, 0, 1)
+  };
+  const std::vector<MeshLod> lods = {{{0, 1, 2, 2, 3, 0}, 0.0f}, {{0, 1, 2}, 0.25f}};
+
+  // Shared vertices, one chunk per level
+  const PackedMesh shared = packMesh(vertices, lods, MAX_INDEX16_VERTICES);
+  ASSERT_EQ(shared.vertices.size(), 4u);
+  ASSERT_EQ(shared.indices, (std::vector<uint32_t>{0, 1, 2, 2, 3, 0, 0, 1, 2}));
+  ASSERT_EQ(shared.lods.size(), 2u);
+  ASSERT_EQ(shared.lods[1].firstChunk, 1u);
+  ASSERT_FLOAT_EQ(shared.lods[1].error, 0.25f);
+  ASSERT_EQ(shared.chunks[1].firstIndex, 6u);
+  ASSERT_EQ(shared.chunks[1].vertexOffset, 0);
+
+  // Split levels get their own vertices
+  const PackedMesh split = packMesh(vertices, lods, 3);
+  ASSERT_EQ(split.lods.size(), 2u);
+  for (const MeshLodRange &lod : split.lods) {
+    for (uint32_t chunk = lod.firstChunk; chunk < lod.firstChunk + lod.chunkCount; chunk++) {
+      const MeshChunk &c = split.chunks[chunk];
+      for (uint32_t i = c.firstIndex; i < c.firstIndex + c.indexCount; i++)
+        ASSERT_LT(c.vertexOffset + split.indices[i], split.vertices.size());
+    }
+  }
+  const MeshChunk &coarse = split.chunks[split.lods[1].firstChunk];
+  ASSERT_EQ(memcmp(&split.vertices[coarse.vertexOffset + split.indices[coarse.firstIndex + 2]], &vertices[2], sizeof(Vertex)), 0);
+}
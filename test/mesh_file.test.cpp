@@ -0,0 +1,136 @@
+#include "gtest/gtest.h"
+
+#include <mesh_file.h>
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+static const char *TEST_MESH_PATH = "mesh_file_test.cmsh";
+
+static std::vector<Vertex> makeTriangle() {
+  std::vector<Vertex> vertices(3, Vertex{});
+  vertices[0].pos = {0.0f, 0.0f, 0.0f};
+  vertices[1].pos = {2.0f, 0.0f, 0.0f};
+  vertices[2].pos = {0.0f, 2.0f, 0.0f};
+  return vertices;
+}
+
+TEST(MeshFileTests, RoundTrip) {
+  const std::vector<Vertex> vertices = makeTriangle();
+  const std::vector<MeshLod> lods = {{{0, 1, 2}, 0.0f}};
+
+  MeshFile::write(TEST_MESH_PATH, vertices, lods, 42, VertexLayout::uncompressed());
+
+  MeshFile file;
+  file.open(TEST_MESH_PATH);
+
+  const MeshFileHeader &header = file.getHeader();
+  ASSERT_TRUE(file.hasVertexLayout(VertexLayout::uncompressed()));
+  ASSERT_FALSE(file.hasVertexLayout(VertexLayout::quantized()));
+  ASSERT_EQ(header.vertexCount, 3u);
+  ASSERT_EQ(header.indexCount, 3u);
+  ASSERT_EQ(header.vertexDataOffset % MESH_FILE_ALIGNMENT, 0u);
+  ASSERT_EQ(header.indexDataOffset % MESH_FILE_ALIGNMENT, 0u);
+  ASSERT_FLOAT_EQ(header.boundsMax[0], 2.0f);
+  ASSERT_FLOAT_EQ(header.boundsMax[1], 2.0f);
+
+  ASSERT_EQ(memcmp(file.getVertexData(), vertices.data(), sizeof(Vertex) * vertices.size()), 0);
+  // Small meshes get 16 bit indices and a single chunk
+  const uint16_t indices16[] = {0, 1, 2};
+  ASSERT_EQ(header.indexSize, sizeof(uint16_t));
+  ASSERT_EQ(memcmp(file.getIndexData(), indices16, sizeof(indices16)), 0);
+  ASSERT_EQ(header.chunkCount, 1u);
+  ASSERT_EQ(file.getChunks()[0].indexCount, 3u);
+  ASSERT_EQ(header.lodCount, 1u);
+  ASSERT_EQ(file.getLods()[0].chunkCount, 1u);
+
+  file.close();
+  std::remove(TEST_MESH_PATH);
+}
+
+TEST(MeshFileTests, InvalidatedBySourceOrLayout) {
+  const VertexLayout layout = VertexLayout::quantized();
+  MeshFile::write(TEST_MESH_PATH, makeTriangle(), {{{0, 1, 2}, 0.0f}}, 42, layout);
+
+  ASSERT_TRUE(MeshFile::isCurrent(TEST_MESH_PATH, 42, layout));
+  ASSERT_FALSE(MeshFile::isCurrent(TEST_MESH_PATH, 43, layout));
+  ASSERT_FALSE(MeshFile::isCurrent(TEST_MESH_PATH, 42, VertexLayout::uncompressed()));
+  ASSERT_FALSE(MeshFile::isCurrent("missing.cmsh", 42, layout));
+
+  std::remove(TEST_MESH_PATH);
+}
+
+TEST(MeshFileTests, StoresLevelsOfDetail) {
+  const std::vector<MeshLod> lods = {{{0, 1, 2, 2, 1, 0}, 0.0f}, {{0, 1, 2}, 0.5f}};
+  MeshFile::write(TEST_MESH_PATH, makeTriangle(), lods, 42, VertexLayout::uncompressed());
+
+  MeshFile file;
+  file.open(TEST_MESH_PATH);
+
+  const MeshFileHeader &header = file.getHeader();
+  ASSERT_EQ(header.vertexCount, 3u);
+  ASSERT_EQ(header.indexCount, 9u);
+  ASSERT_EQ(header.lodCount, 2u);
+
+  const MeshLodRange &coarse = file.getLods()[1];
+  ASSERT_FLOAT_EQ(coarse.error, 0.5f);
+  ASSERT_EQ(coarse.chunkCount, 1u);
+  ASSERT_EQ(file.getChunks()[coarse.firstChunk].firstIndex, 6u);
+  ASSERT_EQ(file.getChunks()[coarse.firstChunk].indexCount, 3u);
+
+  file.close();
+  std::remove(TEST_MESH_PATH);
+}
+
+TEST(MeshFileTests, RejectsInvalidFiles) {
+  FILE *file = fopen(TEST_MESH_PATH, "wb");
+  fputs("not a mesh", file);
+  fclose(file);
+
+  MeshFile meshFile;
+  ASSERT_THROW(meshFile.open(TEST_MESH_PATH), std::runtime_error);
+
+  std::remove(TEST_MESH_PATH);
+}
+
+/**
+ * Overwrites bytes of the test mesh file.
+ */
+template<typename T>
+static void patchMeshFile(uint64_t offset, const T &value) {
+  FILE *file = fopen(TEST_MESH_PATH, "r+b");
+  fseek(file, static_cast<long>(offset), SEEK_SET);
+  fwrite(&value, sizeof(T), 1, file);
+  fclose(file);
+}
+
+TEST(MeshFileTests, RejectsCorruptRanges) {
+  const VertexLayout layout = VertexLayout::uncompressed();
+  MeshFile::write(TEST_MESH_PATH, makeTriangle(), {{{0, 1, 2}, 0.0f}}, 42, layout);
+
+  uint64_t chunkDataOffset;
+  {
+    MeshFile meshFile;
+    meshFile.open(TEST_MESH_PATH);
+    chunkDataOffset = meshFile.getHeader().chunkDataOffset;
+  }
+
+  // The size of the vertices wraps around to a small value
+  const uint64_t vertexCount = UINT64_MAX / layout.getStride() + 1;
+  patchMeshFile(offsetof(MeshFileHeader, vertexCount), vertexCount);
+
+  MeshFile meshFile;
+  ASSERT_THROW(meshFile.open(TEST_MESH_PATH), std::runtime_error);
+
+  // Indices of the chunk address past the last vertex once offset
+  patchMeshFile(offsetof(MeshFileHeader, vertexCount), uint64_t(3));
+  ASSERT_NO_THROW(meshFile.open(TEST_MESH_PATH));
+  meshFile.close();
+
+  patchMeshFile(chunkDataOffset + offsetof(MeshChunk, vertexOffset), int32_t(1));
+  ASSERT_THROW(meshFile.open(TEST_MESH_PATH), std::runtime_error);
+
+  std::remove(TEST_MESH_PATH);
+}
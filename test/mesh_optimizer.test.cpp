@@ -0,0 +1,126 @@
+#include "gtest/gtest.h"
+#include "grid_mesh.h"
+
+#include <mesh_optimizer.h>
+
+#include <algorithm>
+#include <array>
+#include <random>
+#include <stdexcept>
+
+static const uint32_t GRID_SIZE = 32;
+
+/**
+ * Grid of GRID_SIZE x GRID_SIZE quads, with triangles shuffled.
+ */
+static void makeShuffledGrid(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices) {
+  std::vector<uint32_t> gridIndices;
+  buildGrid(GRID_SIZE, vertices, gridIndices);
+
+  std::vector<std::array<uint32_t, 3>> triangles;
+  for (size_t i = 0; i < gridIndices.size(); i += 3)
+    triangles.push_back({gridIndices[i], gridIndices[i + 1], gridIndices[i + 2]});
+
+  std::mt19937 random(7);
+  std::shuffle(triangles.begin(), triangles.end(), random);
+  for (const auto &triangle : triangles)
+    indices.insert(indices.end(), triangle.begin(), triangle.end());
+}
+
+/**
+ * @return Triangles as sorted positions, to compare meshes regardless of
+ *         triangle and vertex order
+ */
+static std::vector<std::array<float, 9>> triangleSet(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices) {
+  std::vector<std::array<float, 9>> triangles;
+  for (size_t i = 0; i < indices.size(); i += 3) {
+    std::array<float, 9> triangle;
+    for (int corner = 0; corner < 3; corner++) {
+      for (int c = 0; c < 3; c++)
+        triangle[corner * 3 + c] = vertices[indices[i + corner]].pos[c];
+    }
+    triangles.push_back(triangle);
+  }
+
+  std::sort(triangles.begin(), triangles.end());
+  return triangles;
+}
+
+TEST(MeshOptimizerTests, AnalyzesVertexCache) {
+  const VertexCacheStatistics single = analyzeVertexCache({0, 1, 2}, 3);
+  ASSERT_EQ(single.vertexTransforms, 3u);
+  ASSERT_FLOAT_EQ(single.acmr, 3.0f);
+  ASSERT_FLOAT_EQ(single.atvr, 1.0f);
+
+  // Second triangle shares an edge with the first one
+  const VertexCacheStatistics quad = analyzeVertexCache({0, 1, 2, 2, 1, 3}, 4);
+  ASSERT_EQ(quad.vertexTransforms, 4u);
+  ASSERT_FLOAT_EQ(quad.acmr, 2.0f);
+
+  // Cache of 3 entries: vertex 0 is evicted before being used again
+  const VertexCacheStatistics evicted = analyzeVertexCache({0, 1, 2, 3, 4, 5, 0, 1, 2}, 6, 3);
+  ASSERT_EQ(evicted.vertexTransforms, 9u);
+  ASSERT_FLOAT_EQ(evicted.atvr, 1.5f);
+}
+
+TEST(MeshOptimizerTests, VertexCacheOrderImprovesAcmr) {
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> indices;
+  makeShuffledGrid(vertices, indices);
+
+  const auto triangles = triangleSet(vertices, indices);
+  const VertexCacheStatistics before = analyzeVertexCache(indices, vertices.size());
+
+  optimizeVertexCache(indices, vertices.size());
+  const VertexCacheStatistics after = analyzeVertexCache(indices, vertices.size());
+
+  ASSERT_EQ(triangleSet(vertices, indices), triangles);
+  ASSERT_LT(after.acmr, 1.0f);
+  ASSERT_LT(after.acmr, before.acmr * 0.5f);
+}
+
+TEST(MeshOptimizerTests, OverdrawOrderKeepsTrianglesAndLocality) {
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> indices;
+  makeShuffledGrid(vertices, indices);
+  optimizeVertexCache(indices, vertices.size());
+
+  const auto triangles = triangleSet(vertices, indices);
+  const VertexCacheStatistics before = analyzeVertexCache(indices, vertices.size());
+
+  optimizeOverdraw(indices, vertices, 1.05f);
+  const VertexCacheStatistics after = analyzeVertexCache(indices, vertices.size());
+
+  ASSERT_EQ(triangleSet(vertices, indices), triangles);
+  ASSERT_LT(after.acmr, before.acmr * 1.25f);
+}
+
+TEST(MeshOptimizerTests, VertexFetchOrderFollowsIndices) {
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> indices;
+  makeShuffledGrid(vertices, indices);
+
+  // Unreferenced vertex, dropped
+  vertices.push_back(Vertex{});
+
+  const auto triangles = triangleSet(vertices, indices);
+  optimizeMesh(vertices, indices);
+
+  ASSERT_EQ(triangleSet(vertices, indices), triangles);
+  ASSERT_EQ(vertices.size(), (GRID_SIZE + 1) * (GRID_SIZE + 1));
+
+  // Each index is at most one above the largest seen so far
+  uint32_t next = 0;
+  for (uint32_t index : indices) {
+    ASSERT_LE(index, next);
+    next = std::max(next, index + 1);
+  }
+}
+
+TEST(MeshOptimizerTests, RejectsInvalidIndices) {
+  std::vector<uint32_t> indices = {0, 1};
+  ASSERT_THROW(optimizeVertexCache(indices, 2), std::invalid_argument);
+
+  indices = {0, 1, 5};
+  ASSERT_THROW(optimizeVertexCache(indices, 3), std::invalid_argument);
+}
@@ -0,0 +1,129 @@
+#include "gtest/gtest.h"
+#include "grid_mesh.h"
+
+#include <mesh_simplifier.h>
+
+#include <cmath>
+#include <stdexcept>
+
+static const uint32_t GRID_SIZE = 16;
+
+static float flat(float, float) {
+  return 0.0f;
+}
+
+static float wavy(float x, float y) {
+  return std::sin(x * 0.7f) * std::cos(y * 0.5f);
+}
+
+static bool onBorder(const Vertex &vertex) {
+  return vertex.pos.x == 0.0f || vertex.pos.y == 0.0f || vertex.pos.x == GRID_SIZE || vertex.pos.y == GRID_SIZE;
+}
+
+TEST(MeshSimplifierTests, SimplifiesFlatSurfacesWithoutError) {
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> indices;
+  buildGrid(GRID_SIZE, vertices, indices, flat);
+
+  float error = -1.0f;
+  const std::vector<uint32_t> simplified = simplifyMesh(vertices, indices, 0, 1e-3f, &error);
+
+  ASSERT_LT(simplified.size(), indices.size() / 4);
+  ASSERT_EQ(simplified.size() % 3, 0u);
+  ASSERT_LT(error, 1e-3f);
+
+  // Borders are locked: every border vertex is still referenced
+  std::vector<bool> referenced(vertices.size(), false);
+  for (uint32_t index : simplified)
+    referenced[index] = true;
+  for (size_t i = 0; i < vertices.size(); i++) {
+    if (onBorder(vertices[i])) {
+      ASSERT_TRUE(referenced[i]);
+    }
+  }
+}
+
+TEST(MeshSimplifierTests, RespectsTargets) {
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> indices;
+  buildGrid(GRID_SIZE, vertices, indices, wavy);
+
+  float error = 0.0f;
+  const std::vector<uint32_t> half = simplifyMesh(vertices, indices, indices.size() / 2, 100.0f, &error);
+  ASSERT_LE(half.size(), indices.size() / 2);
+  ASSERT_GT(error, 0.0f);
+
+  const std::vector<uint32_t> exact = simplifyMesh(vertices, indices, 0, 0.0f, &error);
+  ASSERT_EQ(exact.size(), indices.size());
+  ASSERT_FLOAT_EQ(error, 0.0f);
+
+  const std::vector<uint32_t> bounded = simplifyMesh(vertices, indices, 0, 0.1f, &error);
+  ASSERT_LT(bounded.size(), indices.size());
+  ASSERT_LE(error, 0.1f);
+}
+
+TEST(MeshSimplifierTests, KeepsSeams) {
+  // Left and right halves of the grid use different texture coordinates
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> indices;
+  buildGrid(GRID_SIZE, vertices, indices, flat);
+
+  const size_t seamStart = vertices.size();
+  for (size_t i = 0; i < seamStart; i++) {
+    if (vertices[i].pos.x == GRID_SIZE / 2) {
+      Vertex copy = vertices[i];
+      copy.texCoord = {1.0f, 0.0f};
+      vertices.push_back(copy);
+    }
+  }
+  for (size_t i = 0; i < indices.size(); i += 3) {
+    const float centerX = (vertices[indices[i]].pos.x + vertices[indices[i + 1]].pos.x + vertices[indices[i + 2]].pos.x) / 3.0f;
+    if (centerX < GRID_SIZE / 2)
+      continue;
+
+    for (int corner = 0; corner < 3; corner++) {
+      const uint32_t index = indices[i + corner];
+      if (vertices[index].pos.x == GRID_SIZE / 2)
+        indices[i + corner] = static_cast<uint32_t>(seamStart + index / (GRID_SIZE + 1));
+    }
+  }
+
+  const std::vector<uint32_t> simplified = simplifyMesh(vertices, indices, 0, 1e-3f);
+  ASSERT_LT(simplified.size(), indices.size() / 2);
+
+  // Triangles never mix both sides of the seam
+  for (size_t i = 0; i < simplified.size(); i += 3) {
+    bool left = false, right = false;
+    for (int corner = 0; corner < 3; corner++) {
+      const Vertex &vertex = vertices[simplified[i + corner]];
+      if (vertex.pos.x < GRID_SIZE / 2)
+        left = true;
+      if (vertex.pos.x > GRID_SIZE / 2)
+        right = true;
+    }
+    ASSERT_FALSE(left && right);
+  }
+}
+
+TEST(MeshSimplifierTests, BuildsLodChain) {
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> indices;
+  buildGrid(GRID_SIZE, vertices, indices, wavy);
+
+  const std::vector<MeshLod> lods = buildLodChain(vertices, indices);
+
+  ASSERT_GT(lods.size(), 2u);
+  ASSERT_LE(lods.size(), MAX_MESH_LODS);
+  ASSERT_EQ(lods[0].indices, indices);
+  ASSERT_FLOAT_EQ(lods[0].error, 0.0f);
+  for (size_t i = 1; i < lods.size(); i++) {
+    ASSERT_LT(lods[i].indices.size(), lods[i - 1].indices.size());
+    ASSERT_GE(lods[i].error, lods[i - 1].error);
+  }
+}
+
+TEST(MeshSimplifierTests, RejectsInvalidIndices) {
+  const std::vector<Vertex> vertices(3, Vertex{});
+  ASSERT_THROW(simplifyMesh(vertices, {0, 1}, 0, 1.0f), std::invalid_argument);
+  ASSERT_THROW(simplifyMesh(vertices, {0, 1, 5}, 0, 1.0f), std::invalid_argument);
+}
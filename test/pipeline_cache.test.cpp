@@ -0,0 +1,61 @@
+#include "gtest/gtest.h"
+
+#include <pipeline_cache.h>
+
+#include <cstdio>
+#include <cstring>
+
+static VkPhysicalDeviceProperties makeProperties() {
+  VkPhysicalDeviceProperties properties = {};
+  properties.vendorID = 0x10de;
+  properties.deviceID = 0x1234;
+  for (uint8_t i = 0; i < VK_UUID_SIZE; i++)
+    properties.pipelineCacheUUID[i] = i;
+
+  return properties;
+}
+
+static std::vector<char> makeCache(const VkPhysicalDeviceProperties &properties) {
+  PipelineCacheHeader header = {};
+  header.headerSize = sizeof(header);
+  header.headerVersion = VK_PIPELINE_CACHE_HEADER_VERSION_ONE;
+  header.vendorID = properties.vendorID;
+  header.deviceID = properties.deviceID;
+  memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+  std::vector<char> data(sizeof(header) + 8, 'x');
+  memcpy(data.data(), &header, sizeof(header));
+  return data;
+}
+
+TEST(PipelineCacheTests, ChecksHeader) {
+  const VkPhysicalDeviceProperties properties = makeProperties();
+  const std::vector<char> data = makeCache(properties);
+  ASSERT_TRUE(isPipelineCacheCompatible(data.data(), data.size(), properties));
+  ASSERT_FALSE(isPipelineCacheCompatible(data.data(), 16, properties));
+
+  VkPhysicalDeviceProperties otherDevice = properties;
+  otherDevice.deviceID++;
+  ASSERT_FALSE(isPipelineCacheCompatible(data.data(), data.size(), otherDevice));
+
+  // New driver version
+  VkPhysicalDeviceProperties otherDriver = properties;
+  otherDriver.pipelineCacheUUID[0]++;
+  ASSERT_FALSE(isPipelineCacheCompatible(data.data(), data.size(), otherDriver));
+}
+
+TEST(PipelineCacheTests, SavesAndLoads) {
+  const char *path = "pipeline_cache.test.bin";
+  const VkPhysicalDeviceProperties properties = makeProperties();
+  const std::vector<char> data = makeCache(properties);
+
+  writePipelineCache(path, data);
+  ASSERT_EQ(readPipelineCache(path, properties), data);
+
+  VkPhysicalDeviceProperties otherDevice = properties;
+  otherDevice.vendorID++;
+  ASSERT_TRUE(readPipelineCache(path, otherDevice).empty());
+
+  std::remove(path);
+  ASSERT_TRUE(readPipelineCache(path, properties).empty());
+}
@@ -0,0 +1,208 @@
+#include "gtest/gtest.h"
+
+#include <render_graph.h>
+
+static const RenderImageDesc COLOR_DESC = { 64, 64, VK_FORMAT_R8G8B8A8_UNORM };
+static const RenderImageDesc DEPTH_DESC = { 64, 64, VK_FORMAT_D32_SFLOAT };
+
+static RenderResource importBackbuffer(RenderGraph &graph) {
+  const RenderResource backbuffer = graph.importImage(
+    "backbuffer",
+    COLOR_DESC,
+    VK_IMAGE_LAYOUT_UNDEFINED,
+    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+    VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+  graph.markOutput(backbuffer);
+  return backbuffer;
+}
+
+TEST(RenderGraphTests, CullsUnusedPasses) {
+  RenderGraph graph;
+  const RenderResource backbuffer = importBackbuffer(graph);
+  const RenderResource unused = graph.createImage("unused", COLOR_DESC);
+  const RenderResource counters = graph.importBuffer("counters");
+
+  const RenderPassHandle unusedPass = graph.addPass("unused", RENDER_PASS_TYPE_GRAPHICS, nullptr);
+  graph.writeColor(unusedPass, unused, VK_ATTACHMENT_LOAD_OP_CLEAR);
+
+  const RenderPassHandle statsPass = graph.addPass("stats", RENDER_PASS_TYPE_COMPUTE, nullptr);
+  graph.writeBuffer(statsPass, counters, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+  graph.setSideEffects(statsPass);
+
+  // Overwritten entirely by the main pass
+  const RenderPassHandle overwrittenPass = graph.addPass("overwritten", RENDER_PASS_TYPE_GRAPHICS, nullptr);
+  graph.writeColor(overwrittenPass, backbuffer, VK_ATTACHMENT_LOAD_OP_CLEAR);
+
+  const RenderPassHandle mainPass = graph.addPass("main", RENDER_PASS_TYPE_GRAPHICS, nullptr);
+  graph.writeColor(mainPass, backbuffer, VK_ATTACHMENT_LOAD_OP_CLEAR);
+
+  graph.compile();
+
+  ASSERT_TRUE(graph.isPassCulled(unusedPass));
+  ASSERT_FALSE(graph.isPassCulled(statsPass));
+  ASSERT_TRUE(graph.isPassCulled(overwrittenPass));
+  ASSERT_FALSE(graph.isPassCulled(mainPass));
+  ASSERT_EQ(graph.getGroupCount(), 2u);
+
+  uint32_t first, last;
+  ASSERT_FALSE(graph.getLifetime(unused, first, last));
+
+  // The render pass leaves the backbuffer ready to present
+  ASSERT_EQ(graph.getFinalBarriers().srcStages, 0u);
+}
+
+TEST(RenderGraphTests, SynchronizesReadsOnce) {
+  RenderGraph graph;
+  const RenderResource buffer = graph.importBuffer("buffer");
+
+  const RenderPassHandle writePass = graph.addPass("write", RENDER_PASS_TYPE_COMPUTE, nullptr);
+  graph.writeBuffer(writePass, buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+
+  RenderPassHandle readPasses[2];
+  for (RenderPassHandle &pass : readPasses) {
+    pass = graph.addPass("read", RENDER_PASS_TYPE_COMPUTE, nullptr);
+    graph.readBuffer(pass, buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    graph.setSideEffects(pass);
+  }
+
+  graph.compile();
+  ASSERT_EQ(graph.getGroupCount(), 3u);
+
+  // Nothing to wait for before the first write
+  ASSERT_EQ(graph.getGroupBarriers(0).srcStages, 0u);
+
+  const RenderBarrierBatch &readBarriers = graph.getGroupBarriers(1);
+  ASSERT_EQ(readBarriers.srcStages, static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT));
+  ASSERT_EQ(readBarriers.srcAccess, static_cast<VkAccessFlags>(VK_ACCESS_SHADER_WRITE_BIT));
+  ASSERT_EQ(readBarriers.dstAccess, static_cast<VkAccessFlags>(VK_ACCESS_SHADER_READ_BIT));
+  ASSERT_TRUE(readBarriers.images.empty());
+
+  // The write is already visible to the second read
+  ASSERT_EQ(graph.getGroupBarriers(2).srcStages, 0u);
+}
+
+TEST(RenderGraphTests, MergesPassesIntoSubpasses) {
+  RenderGraph graph;
+  const RenderResource backbuffer = importBackbuffer(graph);
+  const RenderResource albedo = graph.createImage("albedo", COLOR_DESC);
+  const RenderResource depth = graph.createImage("depth", DEPTH_DESC);
+  const RenderResource bloom = graph.createImage("bloom", COLOR_DESC);
+
+  const RenderPassHandle geometryPass = graph.addPass("geometry", RENDER_PASS_TYPE_GRAPHICS, nullptr);
+  graph.writeColor(geometryPass, albedo, VK_ATTACHMENT_LOAD_OP_CLEAR);
+  graph.writeDepth(geometryPass, depth, VK_ATTACHMENT_LOAD_OP_CLEAR);
+
+  // Reads albedo at the same pixel
+  const RenderPassHandle lightingPass = graph.addPass("lighting", RENDER_PASS_TYPE_GRAPHICS, nullptr);
+  graph.readAttachment(lightingPass, albedo);
+  graph.writeColor(lightingPass, bloom, VK_ATTACHMENT_LOAD_OP_CLEAR);
+
+  // Samples bloom anywhere, after the render pass
+  const RenderPassHandle compositePass = graph.addPass("composite", RENDER_PASS_TYPE_GRAPHICS, nullptr);
+  graph.readImage(compositePass, bloom, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+  graph.writeColor(compositePass, backbuffer, VK_ATTACHMENT_LOAD_OP_CLEAR);
+
+  graph.compile();
+  ASSERT_EQ(graph.getGroupCount(), 2u);
+  ASSERT_EQ(graph.getPassGroup(geometryPass), 0u);
+  ASSERT_EQ(graph.getPassGroup(lightingPass), 0u);
+  ASSERT_EQ(graph.getPassSubpass(lightingPass), 1u);
+  ASSERT_EQ(graph.getPassGroup(compositePass), 1u);
+
+  bool found = false;
+  for (const VkSubpassDependency &dependency : graph.getGroupDependencies(0)) {
+    if (dependency.srcSubpass != 0 || dependency.dstSubpass != 1)
+      continue;
+    found = true;
+    ASSERT_EQ(dependency.srcAccessMask, static_cast<VkAccessFlags>(VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT));
+    ASSERT_EQ(dependency.dstAccessMask, static_cast<VkAccessFlags>(VK_ACCESS_INPUT_ATTACHMENT_READ_BIT));
+    ASSERT_EQ(dependency.dependencyFlags, static_cast<VkDependencyFlags>(VK_DEPENDENCY_BY_REGION_BIT));
+  }
+  ASSERT_TRUE(found);
+
+  // Bloom is transitioned for sampling before the composite render pass
+  const RenderBarrierBatch &barriers = graph.getGroupBarriers(1);
+  ASSERT_EQ(barriers.images.size(), 1u);
+  ASSERT_EQ(barriers.images[0].resource, bloom);
+  ASSERT_EQ(barriers.images[0].oldLayout, static_cast<VkImageLayout>(VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL));
+  ASSERT_EQ(barriers.images[0].newLayout, static_cast<VkImageLayout>(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
+
+  uint32_t first, last;
+  ASSERT_TRUE(graph.getLifetime(albedo, first, last));
+  ASSERT_EQ(first, 0u);
+  ASSERT_EQ(last, 0u);
+  ASSERT_TRUE(graph.getLifetime(bloom, first, last));
+  ASSERT_EQ(first, 0u);
+  ASSERT_EQ(last, 1u);
+}
+
+TEST(RenderGraphTests, AliasesDisjointLifetimes) {
+  const std::vector<RenderAliasRequest> requests = {
+    { 0, 0, 100, 4 },
+    { 1, 2, 100, 4 },
+    { 0, 1, 50, 64 },
+    { 2, 2, 20, 4 }
+  };
+
+  std::vector<VkDeviceSize> offsets;
+  const VkDeviceSize size = assignAliasOffsets(requests, offsets);
+
+  // The first two share memory, the third overlaps both in time
+  ASSERT_EQ(offsets[0], 0u);
+  ASSERT_EQ(offsets[1], 0u);
+  ASSERT_EQ(offsets[2], 128u);
+  // Free again once the third is dead
+  ASSERT_EQ(offsets[3], 100u);
+  ASSERT_EQ(size, 178u);
+
+  for (size_t i = 0; i < requests.size(); i++) {
+    for (size_t j = i + 1; j < requests.size(); j++) {
+      const bool timeOverlap = requests[i].firstGroup <= requests[j].lastGroup && requests[j].firstGroup <= requests[i].lastGroup;
+      const bool memoryOverlap = offsets[i] < offsets[j] + requests[j].size && offsets[j] < offsets[i] + requests[i].size;
+      ASSERT_FALSE(timeOverlap && memoryOverlap);
+    }
+  }
+}
+
+TEST(RenderGraphTests, RejectsInvalidUses) {
+  RenderGraph graph;
+  const RenderResource image = graph.createImage("image", COLOR_DESC);
+  const RenderResource buffer = graph.importBuffer("buffer");
+
+  const RenderPassHandle computePass = graph.addPass("compute", RENDER_PASS_TYPE_COMPUTE, nullptr);
+  ASSERT_THROW(graph.writeColor(computePass, image, VK_ATTACHMENT_LOAD_OP_CLEAR), std::invalid_argument);
+  ASSERT_THROW(graph.readBuffer(computePass, image, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT), std::invalid_argument);
+  ASSERT_THROW(graph.writeImage(computePass, buffer, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT), std::invalid_argument);
+
+  const RenderPassHandle emptyPass = graph.addPass("empty", RENDER_PASS_TYPE_GRAPHICS, nullptr);
+  graph.setSideEffects(emptyPass);
+  ASSERT_THROW(graph.compile(), std::invalid_argument);
+}
+
+TEST(RenderGraphTests, ResizesWithoutRecompiling) {
+  RenderGraph graph;
+  const RenderResource backbuffer = importBackbuffer(graph);
+  const RenderResource depth = graph.createImage("depth", DEPTH_DESC);
+
+  const RenderPassHandle mainPass = graph.addPass("main", RENDER_PASS_TYPE_GRAPHICS, nullptr);
+  graph.writeColor(mainPass, backbuffer, VK_ATTACHMENT_LOAD_OP_CLEAR);
+  graph.writeDepth(mainPass, depth, VK_ATTACHMENT_LOAD_OP_CLEAR);
+  graph.compile();
+
+  const std::vector<VkSubpassDependency> dependencies = graph.getGroupDependencies(0);
+  graph.resize(128, 32);
+
+  ASSERT_EQ(graph.getGroupCount(), 1u);
+  ASSERT_EQ(graph.getPassGroup(mainPass), 0u);
+  ASSERT_EQ(graph.getGroupDependencies(0).size(), dependencies.size());
+
+  uint32_t first, last;
+  ASSERT_TRUE(graph.getLifetime(depth, first, last));
+  ASSERT_EQ(first, 0u);
+  ASSERT_EQ(last, 0u);
+
+  // Passes at another size would be grouped differently
+  const RenderImageDesc halfDesc = { 32, 32, VK_FORMAT_R8G8B8A8_UNORM };
+  graph.createImage("half", halfDesc);
+  ASSERT_THROW(graph.resize(64, 64), std::invalid_argument);
+}
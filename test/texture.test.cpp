@@ -0,0 +1,128 @@
+#include "gtest/gtest.h"
+
+#include <texture.h>
+
+TEST(TextureTests, CountsMipLevels) {
+  ASSERT_EQ(getMipLevelCount(1, 1), 1u);
+  ASSERT_EQ(getMipLevelCount(2, 1), 2u);
+  ASSERT_EQ(getMipLevelCount(256, 256), 9u);
+  ASSERT_EQ(getMipLevelCount(300, 20), 9u);
+}
+
+TEST(TextureTests, AveragesBlocks) {
+  // 2x2 checker of black and white, opaque
+  const unsigned char pixels[] = {
+    0, 0, 0, 255,   255, 255, 255, 255,
+    255, 255, 255, 255,   0, 0, 0, 255
+  };
+
+  std::vector<unsigned char> linear;
+  downsampleRgba8(pixels, 2, 2, false, linear);
+  ASSERT_EQ(linear.size(), 4u);
+  ASSERT_EQ(linear[0], 128);
+  ASSERT_EQ(linear[3], 255);
+
+  // Half intensity in linear space is brighter once encoded to sRGB
+  std::vector<unsigned char> srgb;
+  downsampleRgba8(pixels, 2, 2, true, srgb);
+  ASSERT_EQ(srgb[0], 188);
+  ASSERT_EQ(srgb[3], 255);
+}
+
+TEST(TextureTests, HandlesOddDimensions) {
+  // 3x1 gradient, the last column is averaged with itself
+  const unsigned char pixels[] = {
+    0, 0, 0, 0,   100, 100, 100, 100,   200, 200, 200, 200
+  };
+
+  std::vector<unsigned char> out;
+  downsampleRgba8(pixels, 3, 1, false, out);
+  ASSERT_EQ(out.size(), 4u);
+  ASSERT_EQ(out[0], 50);
+  ASSERT_EQ(out[3], 50);
+}
+
+TEST(TextureTests, AlignsLevels) {
+  const unsigned char texels[4] = { 1, 2, 3, 4 };
+
+  TextureData texture = {};
+  addTextureLevel(texture, 1, 1, texels, 4);
+  addTextureLevel(texture, 1, 1, texels, 4);
+  ASSERT_EQ(texture.levels[0].offset, 0u);
+  ASSERT_EQ(texture.levels[1].offset, 16u);
+  ASSERT_EQ(texture.data[16], 1);
+}
+
+TEST(TextureTests, DecodesBc1) {
+  // Red and blue endpoints, texels 1 and 2 use the second and the 2:1 blend
+  const unsigned char block[8] = { 0x00, 0xf8, 0x1f, 0x00, 0x24, 0x00, 0x00, 0x00 };
+
+  TextureData texture = {};
+  texture.format = VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+  texture.width = 4;
+  texture.height = 4;
+  addTextureLevel(texture, 4, 4, block, sizeof(block));
+
+  const TextureData decoded = decodeTexture(texture);
+  ASSERT_EQ(decoded.format, VK_FORMAT_R8G8B8A8_UNORM);
+  ASSERT_EQ(decoded.levels[0].size, 64u);
+
+  const unsigned char *texels = decoded.data.data();
+  ASSERT_EQ(texels[0], 255);
+  ASSERT_EQ(texels[2], 0);
+  ASSERT_EQ(texels[4], 0);
+  ASSERT_EQ(texels[6], 255);
+  ASSERT_EQ(texels[8], 170);
+  ASSERT_EQ(texels[10], 85);
+  ASSERT_EQ(texels[11], 255);
+}
+
+TEST(TextureTests, DecodesEtc2) {
+  // Individual mode, grey sub-blocks of 136 and 68 side by side, the first
+  // texel uses the negative modifier
+  const unsigned char block[8] = { 0x84, 0x84, 0x84, 0x00, 0x00, 0x01, 0x00, 0x00 };
+
+  TextureData texture = {};
+  texture.format = VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK;
+  texture.width = 4;
+  texture.height = 4;
+  addTextureLevel(texture, 4, 4, block, sizeof(block));
+
+  const TextureData decoded = decodeTexture(texture);
+  ASSERT_EQ(decoded.format, VK_FORMAT_R8G8B8A8_SRGB);
+
+  const unsigned char *texels = decoded.data.data();
+  ASSERT_EQ(texels[0], 134);
+  ASSERT_EQ(texels[1 * 4], 138);
+  ASSERT_EQ(texels[3 * 4], 70);
+  ASSERT_EQ(texels[12 * 4], 138);
+  ASSERT_EQ(texels[3], 255);
+}
+
+TEST(TextureTests, DecodesEacAlpha) {
+  // Base 128, multiplier 1, first table: the first texel uses the largest
+  // modifier, the others the first one
+  const unsigned char block[16] = {
+    0x80, 0x10, 0xe0, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x84, 0x84, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00
+  };
+
+  TextureData texture = {};
+  texture.format = VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK;
+  texture.width = 4;
+  texture.height = 4;
+  addTextureLevel(texture, 4, 4, block, sizeof(block));
+
+  const TextureData decoded = decodeTexture(texture);
+  const unsigned char *texels = decoded.data.data();
+  ASSERT_EQ(texels[3], 142);
+  ASSERT_EQ(texels[4 + 3], 125);
+  ASSERT_EQ(texels[0], 138);
+}
+
+TEST(TextureTests, RejectsUndecodableFormats) {
+  TextureData texture = {};
+  texture.format = VK_FORMAT_BC7_UNORM_BLOCK;
+  ASSERT_FALSE(canDecodeTexture(texture.format));
+  ASSERT_THROW(decodeTexture(texture), std::invalid_argument);
+}
@@ -0,0 +1,28 @@
+#include "gtest/gtest.h"
+
+#include <uniform_ring.h>
+
+TEST(UniformRingTests, AlignsRegions) {
+  ASSERT_EQ(getUniformRegionSize(1000, 256), 1024u);
+  ASSERT_EQ(getUniformRegionSize(1024, 256), 1024u);
+  ASSERT_EQ(getUniformRegionSize(1000, 1), 1000u);
+
+  // Regions follow each other, so each one starts aligned
+  ASSERT_EQ(getUniformRegionSize(3000, 64), 3008u);
+}
+
+TEST(UniformRingTests, AlignsAllocations) {
+  ASSERT_EQ(getUniformAllocationSize(1, 256), 256u);
+  ASSERT_EQ(getUniformAllocationSize(256, 256), 256u);
+  ASSERT_EQ(getUniformAllocationSize(257, 256), 512u);
+  ASSERT_EQ(getUniformAllocationSize(192, 64), 192u);
+  ASSERT_EQ(getUniformAllocationSize(0, 16), 0u);
+
+  // Allocations of mixed sizes all start aligned
+  VkDeviceSize head = 0;
+  for (VkDeviceSize size : {4, 192, 100, 64, 65}) {
+    ASSERT_EQ(head % 64, 0u);
+    head += getUniformAllocationSize(size, 64);
+  }
+  ASSERT_EQ(head, 64u + 192u + 128u + 64u + 128u);
+}
@@ -0,0 +1,89 @@
+#include "gtest/gtest.h"
+
+#include <vertex_layout.h>
+
+#include <cstring>
+
+TEST(VertexLayoutTests, DescribesPackedAttributes) {
+  const VertexLayout uncompressed = VertexLayout::uncompressed();
+  ASSERT_EQ(uncompressed.getStride(), sizeof(Vertex));
+
+  const auto attributes = uncompressed.getAttributeDescriptions();
+  ASSERT_EQ(attributes.size(), 4u);
+  ASSERT_EQ(attributes[0].offset, offsetof(Vertex, pos));
+  ASSERT_EQ(attributes[1].offset, offsetof(Vertex, color));
+  ASSERT_EQ(attributes[2].offset, offsetof(Vertex, texCoord));
+  ASSERT_EQ(attributes[3].offset, offsetof(Vertex, normal));
+
+  const VertexLayout quantized = VertexLayout::quantized();
+  ASSERT_EQ(quantized.getStride(), 20u);
+  ASSERT_EQ(quantized.getBindingDescription().stride, 20u);
+  ASSERT_EQ(quantized.getAttributeDescriptions()[3].format, VK_FORMAT_R16G16_SNORM);
+}
+
+TEST(VertexLayoutTests, UncompressedEncodingIsACopy) {
+  Vertex vertex = {};
+  vertex.pos = {1.0f, 2.0f, 3.0f};
+  vertex.texCoord = {0.25f, 0.5f};
+  vertex.normal = {0.0f, 1.0f, 0.0f};
+
+  const MeshBounds bounds = computeBounds(&vertex, 1);
+
+  Vertex encoded;
+  VertexLayout::uncompressed().encode(&vertex, 1, bounds, &encoded);
+  ASSERT_EQ(memcmp(&encoded, &vertex, sizeof(Vertex)), 0);
+}
+
+TEST(VertexLayoutTests, QuantizesPositionsWithinBounds) {
+  Vertex vertices[2] = {};
+  vertices[0].pos = {-1.0f, 0.0f, 2.0f};
+  vertices[1].pos = {3.0f, 0.0f, 4.0f};
+
+  const MeshBounds bounds = computeBounds(vertices, 2);
+  const VertexLayout layout = VertexLayout::quantized();
+
+  char encoded[40];
+  layout.encode(vertices, 2, bounds, encoded);
+
+  uint16_t first[4], second[4];
+  memcpy(first, encoded, sizeof(first));
+  memcpy(second, encoded + layout.getStride(), sizeof(second));
+  ASSERT_EQ(first[0], 0);
+  ASSERT_EQ(second[0], 65535);
+  ASSERT_EQ(second[1], 0);
+
+  // Shader side: unorm * scale + offset gives back the position
+  const VertexDequantization dequantization = layout.getDequantization(bounds);
+  ASSERT_FLOAT_EQ(second[0] / 65535.0f * dequantization.scale.x + dequantization.offset.x, 3.0f);
+  ASSERT_FLOAT_EQ(first[2] / 65535.0f * dequantization.scale.z + dequantization.offset.z, 2.0f);
+}
+
+TEST(VertexLayoutTests, PacksHalfFloats) {
+  ASSERT_EQ(packHalf(0.0f), 0x0000);
+  ASSERT_EQ(packHalf(-0.0f), 0x8000);
+  ASSERT_EQ(packHalf(1.0f), 0x3c00);
+  ASSERT_EQ(packHalf(-2.0f), 0xc000);
+  ASSERT_EQ(packHalf(0.5f), 0x3800);
+  ASSERT_EQ(packHalf(65504.0f), 0x7bff);
+  ASSERT_EQ(packHalf(1e6f), 0x7c00);
+  // Smallest denormal
+  ASSERT_EQ(packHalf(5.9604645e-8f), 0x0001);
+}
+
+TEST(VertexLayoutTests, OctahedralRoundTrip) {
+  const glm::vec3 normals[] = {
+    {0.0f, 0.0f, 1.0f},
+    {0.0f, 0.0f, -1.0f},
+    {1.0f, 0.0f, 0.0f},
+    glm::normalize(glm::vec3(1.0f, -2.0f, -3.0f)),
+    glm::normalize(glm::vec3(-0.3f, 0.8f, 0.1f))
+  };
+
+  for (const glm::vec3 &normal : normals) {
+    int16_t encoded[2];
+    packOctahedral(normal, encoded);
+    const glm::vec3 decoded = unpackOctahedral(encoded);
+
+    ASSERT_GT(glm::dot(normal, decoded), 0.99999f);
+  }
+}
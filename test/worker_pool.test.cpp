@@ -0,0 +1,49 @@
+#include "gtest/gtest.h"
+
+#include <worker_pool.h>
+
+#include <stdexcept>
+
+TEST(WorkerPoolTests, RunsEachTaskOnce) {
+  WorkerPool pool;
+  pool.start(3);
+  ASSERT_EQ(pool.getWorkerCount(), 4u);
+
+  for (int batch = 0; batch < 100; batch++) {
+    std::vector<std::atomic<uint32_t>> runs(37);
+    pool.run(static_cast<uint32_t>(runs.size()), [&](uint32_t i) {
+      runs[i]++;
+    });
+
+    for (const std::atomic<uint32_t> &count : runs)
+      ASSERT_EQ(count.load(), 1u);
+  }
+}
+
+TEST(WorkerPoolTests, RunsInlineWithoutThreads) {
+  WorkerPool pool;
+  uint32_t sum = 0;
+  pool.run(4, [&](uint32_t i) {
+    sum += i;
+  });
+  ASSERT_EQ(sum, 6u);
+}
+
+TEST(WorkerPoolTests, RethrowsErrors) {
+  WorkerPool pool;
+  pool.start(2);
+
+  std::atomic<uint32_t> runs(0);
+  ASSERT_THROW(pool.run(8, [&](uint32_t i) {
+    runs++;
+    if (i == 5)
+      throw std::runtime_error("task failed");
+  }), std::runtime_error);
+  ASSERT_EQ(runs.load(), 8u);
+
+  // Still usable afterwards
+  pool.run(2, [&](uint32_t) {
+    runs++;
+  });
+  ASSERT_EQ(runs.load(), 10u);
+}